@@ -86,6 +86,7 @@ static int lum_init(int thr_nb)
 
     params.iscsi_queue_depth = adm_cluster_get_param_int("target_queue_depth");
     params.bdev_queue_depth = adm_cluster_get_param_int("bdev_target_queue_depth");
+    params.bdev_threads = adm_cluster_get_param_int("bdev_target_threads");
     params.buffer_size = adm_cluster_get_param_int("target_buffer_size");
     params.target_listen_address = target_config_get_listen_address();
     iqn_copy(&params.target_iqn, lum_get_target_iqn());
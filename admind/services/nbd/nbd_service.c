@@ -71,11 +71,17 @@ nbd_init(int thr_nb)
     goto end_init;
   }
 
-  os_snprintf(client_network_type, sizeof(client_network_type), "TCP=%d",
-	   adm_cluster_get_param_int("tcp_client_buffer_size") / 1024);
-
-  os_snprintf(server_network_type, sizeof(server_network_type), "TCP=%d",
-	   adm_cluster_get_param_int("tcp_server_buffer_size") / 1024);
+  os_snprintf(client_network_type, sizeof(client_network_type),
+           "TCP=%d,IO_THREADS=%d,ZEROCOPY=%d",
+	   adm_cluster_get_param_int("tcp_client_buffer_size") / 1024,
+	   adm_cluster_get_param_int("tcp_io_threads"),
+	   adm_cluster_get_param_boolean("tcp_zerocopy"));
+
+  os_snprintf(server_network_type, sizeof(server_network_type),
+           "TCP=%d,IO_THREADS=%d,ZEROCOPY=%d",
+	   adm_cluster_get_param_int("tcp_server_buffer_size") / 1024,
+	   adm_cluster_get_param_int("tcp_io_threads"),
+	   adm_cluster_get_param_boolean("tcp_zerocopy"));
 
   data_net_timeout = adm_cluster_get_param_text("tcp_data_net_timeout");
 
@@ -115,12 +121,16 @@ nbd_init(int thr_nb)
         "-b", (char *)adm_cluster_get_param_text("max_request_size"),
         "-B", (char *)adm_cluster_get_param_text("io_barriers"),
         "-c", (char *)data_net_timeout,
-        /* -A and -M come from vrt, -B is used for vrt and nbd */
+        /* -A, -M and -E come from vrt, -B is used for vrt and nbd */
         "-A", (char *)node_id_str,
         "-M", (char *)adm_cluster_get_param_text("max_requests"),
+        "-E", (char *)adm_cluster_get_param_text("vrt_engine_threads"),
         /* VRT cl-tunables */
         "-s", (char *)adm_cluster_get_param_text("rebuilding_slowdown"),
         "-S", (char *)adm_cluster_get_param_text("degraded_rebuilding_slowdown"),
+        "-R", (char *)adm_cluster_get_param_text("rain1_read_policy"),
+        "-r", (char *)adm_cluster_get_param_text("rain1_dirty_zone_retention"),
+        "-L", (char *)adm_cluster_get_param_text("rebuilding_latency_target"),
         NULL
     };
 
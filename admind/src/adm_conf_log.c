@@ -0,0 +1,695 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "admind/src/adm_conf_log.h"
+#include "admind/src/adm_atomic_file.h"
+
+#include "common/include/exa_assert.h"
+#include "common/include/exa_error.h"
+#include "log/include/log.h"
+
+#include "os/include/os_error.h"
+#include "os/include/os_file.h"
+#include "os/include/os_inttypes.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_stdio.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The log starts with a header describing the configuration file it
+ * applies to, followed by the sizes of the spans of that file. Each save
+ * then appends a record made of operations building the new configuration
+ * from the previous one: either a copy of spans of the previous
+ * configuration, or the data of a new span.
+ */
+
+#define LOG_MAGIC         0x474c4345  /* "ECLG" */
+#define LOG_RECORD_MAGIC  0x52434345  /* "ECCR" */
+#define LOG_FORMAT        1
+
+#define LOG_OP_COPY  1
+#define LOG_OP_DATA  2
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t format;
+    uint32_t base_size;      /**< Size of the configuration file */
+    uint32_t nb_spans;       /**< Number of spans, whose sizes follow */
+    uint64_t base_hash;      /**< Hash of the configuration file */
+} log_header_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t size;           /**< Size of the operations following */
+    uint32_t nb_ops;
+    uint32_t unused;
+    uint64_t hash;           /**< Hash of the operations */
+} log_record_t;
+
+typedef struct
+{
+    uint32_t kind;           /**< LOG_OP_COPY or LOG_OP_DATA */
+    uint32_t start;          /**< COPY: first span of the previous config */
+    uint32_t count;          /**< COPY: number of spans, DATA: size of the
+                                  data following */
+} log_op_t;
+
+/** Configuration last saved, with its spans */
+static char *saved = NULL;
+static int saved_size = 0;
+static adm_conf_span_t *saved_spans = NULL;
+static int saved_nb_spans = 0;
+
+/** Size of the configuration file and of its log */
+static int base_size = 0;
+static int log_size = 0;
+
+static int get_log_path(const char *conf_path, char *path, size_t size)
+{
+    if (os_snprintf(path, size, "%s%s", conf_path, ADM_CONF_LOG_SUFFIX)
+        >= size)
+        return -ENAMETOOLONG;
+
+    return EXA_SUCCESS;
+}
+
+/* FNV-1a: the hash must tell a configuration file from the previous one,
+ * which a 16 bits checksum can't be trusted to do */
+static uint64_t compute_hash(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static bool log_header_applies(const log_header_t *header, const char *conf,
+                               size_t conf_size)
+{
+    return header->magic == LOG_MAGIC
+        && header->format == LOG_FORMAT
+        && header->base_size == conf_size
+        && header->base_hash == compute_hash(conf, conf_size);
+}
+
+static int read_file(const char *path, char **data, size_t *size);
+
+void adm_conf_log_reset(void)
+{
+    os_free(saved);
+    os_free(saved_spans);
+    saved_size = 0;
+    saved_nb_spans = 0;
+    base_size = 0;
+    log_size = 0;
+}
+
+/* Remember the configuration saved */
+static int remember(const char *buffer, int size,
+                    const adm_conf_span_t *spans, int nb_spans)
+{
+    char *copy;
+    adm_conf_span_t *spans_copy;
+
+    copy = os_malloc(size);
+    spans_copy = os_malloc(nb_spans * sizeof(adm_conf_span_t));
+    if (copy == NULL || spans_copy == NULL)
+    {
+        os_free(copy);
+        os_free(spans_copy);
+        adm_conf_log_reset();
+        return -ENOMEM;
+    }
+
+    memcpy(copy, buffer, size);
+    memcpy(spans_copy, spans, nb_spans * sizeof(adm_conf_span_t));
+
+    os_free(saved);
+    os_free(saved_spans);
+    saved = copy;
+    saved_size = size;
+    saved_spans = spans_copy;
+    saved_nb_spans = nb_spans;
+
+    return EXA_SUCCESS;
+}
+
+/* Rewrite the configuration file and start a new log */
+static int compact(const char *conf_path, const char *log_path,
+                   const char *buffer, int size,
+                   const adm_conf_span_t *spans, int nb_spans)
+{
+    log_header_t *header;
+    uint32_t *sizes;
+    size_t header_size = sizeof(log_header_t) + nb_spans * sizeof(uint32_t);
+    char *current = NULL;
+    size_t current_size = 0;
+    char *log = NULL;
+    size_t log_len = 0;
+    int i;
+    int err;
+
+    adm_conf_log_reset();
+
+    /* A log that doesn't apply to the current configuration file must not
+     * be left behind: it could apply to the new one */
+    err = read_file(conf_path, &current, &current_size);
+    if (err != EXA_SUCCESS && err != -ENOENT)
+        return err;
+
+    err = read_file(log_path, &log, &log_len);
+    if (err == EXA_SUCCESS
+        && (log_len < sizeof(log_header_t)
+            || !log_header_applies((log_header_t *)log, current, current_size)))
+        err = adm_conf_log_remove(conf_path);
+    else if (err == -ENOENT)
+        err = EXA_SUCCESS;
+    os_free(log);
+
+    /* The log of an identical configuration file gets replaced below */
+    if (err == EXA_SUCCESS
+        && (current == NULL || current_size != size
+            || memcmp(current, buffer, size) != 0))
+        err = adm_atomic_file_save(conf_path, buffer, size);
+    os_free(current);
+    if (err != EXA_SUCCESS)
+        return err;
+
+    header = os_malloc(header_size);
+    if (header == NULL)
+        return adm_conf_log_remove(conf_path);
+
+    header->magic = LOG_MAGIC;
+    header->format = LOG_FORMAT;
+    header->base_size = size;
+    header->nb_spans = nb_spans;
+    header->base_hash = compute_hash(buffer, size);
+
+    sizes = (uint32_t *)(header + 1);
+    for (i = 0; i < nb_spans; i++)
+        sizes[i] = spans[i].size;
+
+    /* The configuration file is up to date, so failing to start the log
+     * only means the next save will rewrite it again */
+    err = adm_atomic_file_save(log_path, header, header_size);
+    os_free(header);
+    if (err != EXA_SUCCESS)
+    {
+        exalog_warning("failed starting the configuration log '%s': %s",
+                       log_path, exa_error_msg(err));
+        return adm_conf_log_remove(conf_path);
+    }
+
+    if (remember(buffer, size, spans, nb_spans) == EXA_SUCCESS)
+    {
+        base_size = size;
+        log_size = header_size;
+    }
+
+    return EXA_SUCCESS;
+}
+
+/* Find the span saved matching a span, trying the expected one first */
+static int find_saved_span(const adm_conf_span_t *span, int expected)
+{
+    int i;
+
+    if (expected < saved_nb_spans
+        && saved_spans[expected].type == span->type
+        && uuid_is_equal(&saved_spans[expected].key, &span->key))
+        return expected;
+
+    for (i = 0; i < saved_nb_spans; i++)
+        if (saved_spans[i].type == span->type
+            && uuid_is_equal(&saved_spans[i].key, &span->key))
+            return i;
+
+    return -1;
+}
+
+/* Build the record bringing the configuration saved to a new one. Returns
+ * its size, 0 if the configuration didn't change. */
+static int build_record(const char *buffer, const adm_conf_span_t *spans,
+                        int nb_spans, char **record)
+{
+    log_op_t *ops;
+    log_record_t *header;
+    char *data;
+    int nb_ops = 0;
+    int size = 0;
+    bool changed = nb_spans != saved_nb_spans;
+    int expected = 0;
+    int i;
+
+    *record = NULL;
+
+    ops = os_malloc(nb_spans * sizeof(log_op_t));
+    if (ops == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < nb_spans; i++)
+    {
+        int j = find_saved_span(&spans[i], expected);
+
+        if (j >= 0 && saved_spans[j].size == spans[i].size
+            && memcmp(saved + saved_spans[j].offset, buffer + spans[i].offset,
+                      spans[i].size) == 0)
+        {
+            if (j != i)
+                changed = true;
+
+            if (nb_ops > 0 && ops[nb_ops - 1].kind == LOG_OP_COPY
+                && ops[nb_ops - 1].start + ops[nb_ops - 1].count == j)
+                ops[nb_ops - 1].count++;
+            else
+            {
+                ops[nb_ops].kind = LOG_OP_COPY;
+                ops[nb_ops].start = j;
+                ops[nb_ops].count = 1;
+                nb_ops++;
+                size += sizeof(log_op_t);
+            }
+        }
+        else
+        {
+            changed = true;
+            ops[nb_ops].kind = LOG_OP_DATA;
+            ops[nb_ops].start = i;
+            ops[nb_ops].count = spans[i].size;
+            nb_ops++;
+            size += sizeof(log_op_t) + spans[i].size;
+        }
+
+        if (j >= 0)
+            expected = j + 1;
+    }
+
+    if (!changed)
+    {
+        os_free(ops);
+        return 0;
+    }
+
+    *record = os_malloc(sizeof(log_record_t) + size);
+    if (*record == NULL)
+    {
+        os_free(ops);
+        return -ENOMEM;
+    }
+
+    data = *record + sizeof(log_record_t);
+    for (i = 0; i < nb_ops; i++)
+    {
+        log_op_t op = ops[i];
+
+        if (op.kind == LOG_OP_DATA)
+            op.start = 0;
+
+        memcpy(data, &op, sizeof(op));
+        data += sizeof(op);
+
+        if (op.kind == LOG_OP_DATA)
+        {
+            memcpy(data, buffer + spans[ops[i].start].offset, op.count);
+            data += op.count;
+        }
+    }
+
+    header = (log_record_t *)*record;
+    header->magic = LOG_RECORD_MAGIC;
+    header->size = size;
+    header->nb_ops = nb_ops;
+    header->unused = 0;
+    header->hash = compute_hash(*record + sizeof(log_record_t), size);
+
+    os_free(ops);
+
+    return sizeof(log_record_t) + size;
+}
+
+static int append_record(const char *log_path, const char *record, int size)
+{
+    FILE *file;
+    int err = EXA_SUCCESS;
+
+    file = fopen(log_path, "ab");
+    if (file == NULL)
+        return -errno;
+
+    if (fwrite(record, size, 1, file) != 1 || fflush(file) != 0)
+        err = -errno;
+
+    if (fclose(file) != 0 && err == EXA_SUCCESS)
+        err = -errno;
+
+    return err;
+}
+
+int adm_conf_log_save(const char *conf_path, const char *buffer, int size,
+                      const adm_conf_span_t *spans, int nb_spans)
+{
+    char log_path[OS_PATH_MAX];
+    char *record;
+    int record_size;
+    int err;
+
+    EXA_ASSERT(nb_spans > 0);
+    EXA_ASSERT(spans[0].offset == 0);
+    EXA_ASSERT(spans[nb_spans - 1].offset + spans[nb_spans - 1].size == size);
+
+    err = get_log_path(conf_path, log_path, sizeof(log_path));
+    if (err != EXA_SUCCESS)
+        return err;
+
+    if (saved == NULL)
+        return compact(conf_path, log_path, buffer, size, spans, nb_spans);
+
+    record_size = build_record(buffer, spans, nb_spans, &record);
+    if (record_size <= 0)
+        return record_size;
+
+    /* Rewrite the whole configuration once replaying the log would cost
+     * more than reading it */
+    if (log_size + record_size > base_size)
+    {
+        os_free(record);
+        return compact(conf_path, log_path, buffer, size, spans, nb_spans);
+    }
+
+    err = append_record(log_path, record, record_size);
+    os_free(record);
+    if (err != EXA_SUCCESS)
+    {
+        /* A partial record would hide the ones appended after it */
+        exalog_warning("failed appending to the configuration log '%s': %s",
+                       log_path, exa_error_msg(err));
+        return compact(conf_path, log_path, buffer, size, spans, nb_spans);
+    }
+
+    log_size += record_size;
+    err = remember(buffer, size, spans, nb_spans);
+    if (err != EXA_SUCCESS)
+        return err;
+
+    exalog_debug("appended %d bytes to '%s' for a configuration of %d bytes",
+                 record_size, log_path, size);
+
+    return EXA_SUCCESS;
+}
+
+/* Read a whole file, adding a NUL at the end */
+static int read_file(const char *path, char **data, size_t *size)
+{
+    FILE *file;
+    long len;
+    int err = EXA_SUCCESS;
+
+    *data = NULL;
+    *size = 0;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return -errno;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) < 0
+        || fseek(file, 0, SEEK_SET) != 0)
+    {
+        err = -errno;
+        goto done;
+    }
+
+    *data = os_malloc(len + 1);
+    if (*data == NULL)
+    {
+        err = -ENOMEM;
+        goto done;
+    }
+
+    if (len > 0 && fread(*data, len, 1, file) != 1)
+    {
+        err = ferror(file) ? -EIO : -EAGAIN;
+        os_free(*data);
+        goto done;
+    }
+
+    (*data)[len] = '\0';
+    *size = len;
+
+done:
+    fclose(file);
+    return err;
+}
+
+/* Apply a record to a configuration. On success, the configuration and
+ * the sizes of its spans are replaced with the new ones. */
+static int apply_record(const char *ops, size_t ops_size, uint32_t nb_ops,
+                        char **conf, size_t *conf_size,
+                        uint32_t **sizes, uint32_t *nb_spans)
+{
+    uint32_t *offsets;
+    uint32_t *new_sizes = NULL;
+    char *new_conf = NULL;
+    size_t new_conf_size = 0;
+    uint32_t new_nb_spans = 0;
+    size_t pos;
+    uint32_t i;
+    int err = -EINVAL;
+
+    offsets = os_malloc((*nb_spans + 1) * sizeof(uint32_t));
+    if (offsets == NULL)
+        return -ENOMEM;
+
+    offsets[0] = 0;
+    for (i = 0; i < *nb_spans; i++)
+        offsets[i + 1] = offsets[i] + (*sizes)[i];
+
+    /* First pass validates the operations and computes the sizes */
+    pos = 0;
+    for (i = 0; i < nb_ops; i++)
+    {
+        log_op_t op;
+
+        if (ops_size - pos < sizeof(op))
+            goto done;
+        memcpy(&op, ops + pos, sizeof(op));
+        pos += sizeof(op);
+
+        if (op.kind == LOG_OP_COPY)
+        {
+            if (op.start > *nb_spans || op.count > *nb_spans - op.start)
+                goto done;
+            new_conf_size += offsets[op.start + op.count] - offsets[op.start];
+            new_nb_spans += op.count;
+        }
+        else if (op.kind == LOG_OP_DATA)
+        {
+            if (op.count > ops_size - pos)
+                goto done;
+            pos += op.count;
+            new_conf_size += op.count;
+            new_nb_spans++;
+        }
+        else
+            goto done;
+    }
+
+    if (pos != ops_size)
+        goto done;
+
+    new_conf = os_malloc(new_conf_size + 1);
+    new_sizes = os_malloc((new_nb_spans + 1) * sizeof(uint32_t));
+    if (new_conf == NULL || new_sizes == NULL)
+    {
+        err = -ENOMEM;
+        goto done;
+    }
+
+    /* Second pass builds the new configuration */
+    new_conf_size = 0;
+    new_nb_spans = 0;
+    pos = 0;
+    for (i = 0; i < nb_ops; i++)
+    {
+        log_op_t op;
+
+        memcpy(&op, ops + pos, sizeof(op));
+        pos += sizeof(op);
+
+        if (op.kind == LOG_OP_COPY)
+        {
+            uint32_t len = offsets[op.start + op.count] - offsets[op.start];
+
+            memcpy(new_conf + new_conf_size, *conf + offsets[op.start], len);
+            memcpy(new_sizes + new_nb_spans, *sizes + op.start,
+                   op.count * sizeof(uint32_t));
+            new_conf_size += len;
+            new_nb_spans += op.count;
+        }
+        else
+        {
+            memcpy(new_conf + new_conf_size, ops + pos, op.count);
+            pos += op.count;
+            new_sizes[new_nb_spans++] = op.count;
+            new_conf_size += op.count;
+        }
+    }
+    new_conf[new_conf_size] = '\0';
+
+    os_free(*conf);
+    os_free(*sizes);
+    *conf = new_conf;
+    *conf_size = new_conf_size;
+    *sizes = new_sizes;
+    *nb_spans = new_nb_spans;
+    new_conf = NULL;
+    new_sizes = NULL;
+    err = EXA_SUCCESS;
+
+done:
+    os_free(new_conf);
+    os_free(new_sizes);
+    os_free(offsets);
+    return err;
+}
+
+int adm_conf_log_load(const char *conf_path, char **buffer, int *size)
+{
+    char log_path[OS_PATH_MAX];
+    char *log = NULL;
+    size_t log_len;
+    char *conf = NULL;
+    size_t conf_size;
+    uint32_t *sizes = NULL;
+    uint32_t nb_spans;
+    log_header_t header;
+    size_t pos;
+    uint64_t total;
+    uint32_t i;
+    int nb_records = 0;
+    int err;
+
+    *buffer = NULL;
+    *size = 0;
+
+    err = get_log_path(conf_path, log_path, sizeof(log_path));
+    if (err != EXA_SUCCESS)
+        return err;
+
+    err = read_file(log_path, &log, &log_len);
+    if (err == -ENOENT)
+        return 0;
+    if (err != EXA_SUCCESS)
+        return err;
+
+    err = read_file(conf_path, &conf, &conf_size);
+    if (err != EXA_SUCCESS)
+        goto done;
+
+    /* The log only applies to the configuration file it was started with */
+    if (log_len < sizeof(header))
+        goto done;
+    memcpy(&header, log, sizeof(header));
+    if (!log_header_applies(&header, conf, conf_size)
+        || header.nb_spans > (log_len - sizeof(header)) / sizeof(uint32_t))
+    {
+        exalog_debug("ignoring configuration log '%s' not matching '%s'",
+                     log_path, conf_path);
+        goto done;
+    }
+
+    nb_spans = header.nb_spans;
+    sizes = os_malloc((nb_spans + 1) * sizeof(uint32_t));
+    if (sizes == NULL)
+    {
+        err = -ENOMEM;
+        goto done;
+    }
+    memcpy(sizes, log + sizeof(header), nb_spans * sizeof(uint32_t));
+    pos = sizeof(header) + nb_spans * sizeof(uint32_t);
+
+    total = 0;
+    for (i = 0; i < nb_spans; i++)
+        total += sizes[i];
+    if (total != conf_size)
+    {
+        exalog_warning("ignoring corrupted configuration log '%s'", log_path);
+        goto done;
+    }
+
+    while (log_len - pos >= sizeof(log_record_t))
+    {
+        log_record_t record;
+
+        memcpy(&record, log + pos, sizeof(record));
+        if (record.magic != LOG_RECORD_MAGIC
+            || record.size > log_len - pos - sizeof(record)
+            || record.hash != compute_hash(log + pos + sizeof(record),
+                                           record.size))
+            break;
+
+        err = apply_record(log + pos + sizeof(record), record.size,
+                           record.nb_ops, &conf, &conf_size, &sizes, &nb_spans);
+        if (err != EXA_SUCCESS)
+        {
+            exalog_error("failed replaying record %d of '%s': %s",
+                         nb_records, log_path, exa_error_msg(err));
+            goto done;
+        }
+
+        pos += sizeof(record) + record.size;
+        nb_records++;
+    }
+
+    if (pos != log_len)
+        exalog_warning("ignoring partial record at the end of '%s'", log_path);
+
+    if (nb_records > 0)
+    {
+        *buffer = conf;
+        *size = conf_size;
+        conf = NULL;
+    }
+
+    exalog_debug("replayed %d records of '%s'", nb_records, log_path);
+
+done:
+    os_free(log);
+    os_free(conf);
+    os_free(sizes);
+
+    return err != EXA_SUCCESS ? err : nb_records;
+}
+
+int adm_conf_log_remove(const char *conf_path)
+{
+    char log_path[OS_PATH_MAX];
+    int err;
+
+    adm_conf_log_reset();
+
+    err = get_log_path(conf_path, log_path, sizeof(log_path));
+    if (err != EXA_SUCCESS)
+        return err;
+
+    if (unlink(log_path) != 0 && errno != ENOENT)
+        return -errno;
+
+    return EXA_SUCCESS;
+}
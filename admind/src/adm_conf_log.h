@@ -0,0 +1,99 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __ADM_CONF_LOG_H
+#define __ADM_CONF_LOG_H
+
+/** \file
+ * Change log of the configuration file.
+ *
+ * The serialized configuration is made of spans, one per object (node,
+ * group, volume...). When the configuration is saved, only the spans that
+ * changed since the previous save are appended to a log next to the
+ * configuration file, the others being referenced. The configuration file
+ * is rewritten when the log grows larger than it.
+ */
+
+#include "common/include/uuid.h"
+
+/** Suffix appended to the configuration file name to get its log */
+#define ADM_CONF_LOG_SUFFIX  ".log"
+
+/** Kind of object a span holds */
+typedef enum
+{
+    ADM_CONF_SPAN_HEADER,       /**< XML declaration and root element */
+    ADM_CONF_SPAN_CLUSTER,      /**< Cluster element and monitoring */
+    ADM_CONF_SPAN_NODE,         /**< Node and its disks */
+    ADM_CONF_SPAN_CLUSTER_END,  /**< End of the cluster element */
+    ADM_CONF_SPAN_GROUP,        /**< Group and its disks */
+    ADM_CONF_SPAN_VOLUME,       /**< Volume and its file system */
+    ADM_CONF_SPAN_GROUP_END,    /**< End of a group element */
+    ADM_CONF_SPAN_TUNABLES      /**< Tunables and end of the root element */
+} adm_conf_span_type_t;
+
+/** Part of the serialized configuration holding one object */
+typedef struct
+{
+    adm_conf_span_type_t type;
+    exa_uuid_t key;             /**< Identifies the object among its type */
+    int offset;                 /**< Offset in the configuration */
+    int size;                   /**< Size in bytes */
+} adm_conf_span_t;
+
+/**
+ * Save the configuration.
+ *
+ * Spans are matched with the ones previously saved by type and key, and the
+ * ones whose content is unchanged are not written again.
+ *
+ * @param[in] conf_path  Configuration file
+ * @param[in] buffer     Serialized configuration
+ * @param[in] size       Size of buffer
+ * @param[in] spans      Spans of buffer, covering it entirely and in order
+ * @param[in] nb_spans   Number of spans
+ *
+ * @return EXA_SUCCESS or a negative error code
+ */
+int adm_conf_log_save(const char *conf_path, const char *buffer, int size,
+                      const adm_conf_span_t *spans, int nb_spans);
+
+/**
+ * Read the configuration file and replay its log.
+ *
+ * A log that doesn't match the configuration file (the file was rewritten
+ * but the log wasn't reset yet) is ignored, and so is a record partially
+ * written at its end.
+ *
+ * @param[in]  conf_path  Configuration file
+ * @param[out] buffer     Configuration, NUL terminated, to free with
+ *                        os_free(); NULL if no record was replayed, in which
+ *                        case the configuration file is up to date
+ * @param[out] size       Size of the configuration
+ *
+ * @return the number of records replayed or a negative error code
+ */
+int adm_conf_log_load(const char *conf_path, char **buffer, int *size);
+
+/**
+ * Remove the log of a configuration file.
+ *
+ * @param[in] conf_path  Configuration file
+ *
+ * @return EXA_SUCCESS or a negative error code
+ */
+int adm_conf_log_remove(const char *conf_path);
+
+/**
+ * Forget the configuration last saved.
+ *
+ * The next save rewrites the whole configuration file.
+ */
+void adm_conf_log_reset(void);
+
+#endif /* __ADM_CONF_LOG_H */
@@ -23,6 +23,7 @@
 #include "admind/src/adm_disk.h"
 #include "admind/src/adm_group.h"
 #include "admind/src/adm_volume.h"
+#include "os/include/os_mem.h"
 
 #ifdef WITH_FS
 #include "admind/src/adm_fs.h"
@@ -33,10 +34,17 @@ typedef struct
   FILE *file;
   char *buffer;
   int size;
+  int growable;               /**< buffer is reallocated when full */
+  adm_conf_span_t *spans;     /**< spans of the objects, if wanted */
+  int nb_spans;
+  int max_spans;
   int create;
   int ret;
 } adm_serialize_handle_t;
 
+/* Initial size of a growable buffer */
+#define ADM_SERIALIZE_INITIAL_SIZE  1024
+
 
 static void  __attribute__ ((format (printf, 2, 3)))
 adm_serialize_printf(adm_serialize_handle_t *handle, const char *fmt, ...)
@@ -53,6 +61,34 @@ adm_serialize_printf(adm_serialize_handle_t *handle, const char *fmt, ...)
   {
     ret = vfprintf(handle->file, fmt, ap);
   }
+  else if (handle->growable)
+  {
+    va_list aq;
+
+    va_copy(aq, ap);
+    ret = os_vsnprintf(handle->buffer + handle->ret,
+	               handle->size - handle->ret, fmt, aq);
+    va_end(aq);
+    if (ret >= handle->size - handle->ret)
+    {
+      int size = handle->size;
+      char *buffer;
+
+      while (size - handle->ret <= ret)
+	size *= 2;
+
+      buffer = os_realloc(handle->buffer, size);
+      if (buffer == NULL)
+	ret = -ENOMEM;
+      else
+      {
+	handle->buffer = buffer;
+	handle->size = size;
+	ret = os_vsnprintf(handle->buffer + handle->ret,
+			   handle->size - handle->ret, fmt, ap);
+      }
+    }
+  }
   else if (handle->buffer != NULL)
   {
     ret = os_vsnprintf(handle->buffer + handle->ret,
@@ -80,6 +116,48 @@ adm_serialize_printf(adm_serialize_handle_t *handle, const char *fmt, ...)
 }
 
 
+/* Start the span of an object at the current position, ending the previous
+ * one. Nothing is done when the spans are not wanted. */
+static void
+adm_serialize_span(adm_serialize_handle_t *handle, adm_conf_span_type_t type,
+		   const exa_uuid_t *key)
+{
+  adm_conf_span_t *span;
+
+  if (handle->ret < 0 || handle->spans == NULL)
+    return;
+
+  if (handle->nb_spans == handle->max_spans)
+  {
+    adm_conf_span_t *spans = os_realloc(handle->spans, 2 * handle->max_spans
+					* sizeof(adm_conf_span_t));
+    if (spans == NULL)
+    {
+      exalog_error("cannot grow the spans: %s", exa_error_msg(-ENOMEM));
+      handle->ret = -ENOMEM;
+      return;
+    }
+    handle->spans = spans;
+    handle->max_spans *= 2;
+  }
+
+  if (handle->nb_spans > 0)
+  {
+    span = &handle->spans[handle->nb_spans - 1];
+    span->size = handle->ret - span->offset;
+  }
+
+  span = &handle->spans[handle->nb_spans++];
+  span->type = type;
+  if (key != NULL)
+    uuid_copy(&span->key, key);
+  else
+    uuid_zero(&span->key);
+  span->offset = handle->ret;
+  span->size = 0;
+}
+
+
 static void
 adm_serialize(adm_serialize_handle_t *handle)
 {
@@ -92,6 +170,7 @@ adm_serialize(adm_serialize_handle_t *handle)
 
   EXA_ASSERT(adm_cluster.created);
 
+  adm_serialize_span(handle, ADM_CONF_SPAN_HEADER, NULL);
   adm_serialize_printf(handle, "<?xml version=\"1.0\"?>\n");
 
   adm_serialize_printf(handle, "<Exanodes release=\"%s\"", EXA_VERSION);
@@ -106,6 +185,8 @@ adm_serialize(adm_serialize_handle_t *handle)
 
   /* Cluster */
 
+  adm_serialize_span(handle, ADM_CONF_SPAN_CLUSTER, &adm_cluster.uuid);
+
   adm_serialize_printf(handle, "  <cluster name=\"%s\""
 		       " uuid=\"" UUID_FMT "\">\n",
 		       adm_cluster.name,
@@ -129,6 +210,11 @@ adm_serialize(adm_serialize_handle_t *handle)
   {
     struct adm_nic *nic = adm_node_get_nic(node);
     struct adm_disk *disk;
+    exa_uuid_t key;
+
+    uuid_zero(&key);
+    key.id[0] = node->id;
+    adm_serialize_span(handle, ADM_CONF_SPAN_NODE, &key);
 
     adm_serialize_printf(handle, "    <node name=\"%s\" hostname=\"%s\""
 			 " number=\"%d\" spof_id=\"%"PRIspof_id"\">\n",
@@ -150,6 +236,7 @@ adm_serialize(adm_serialize_handle_t *handle)
     adm_serialize_printf(handle, "    </node>\n");
   }
 
+  adm_serialize_span(handle, ADM_CONF_SPAN_CLUSTER_END, NULL);
   adm_serialize_printf(handle, "  </cluster>\n");
 
   if (!handle->create)
@@ -159,6 +246,7 @@ adm_serialize(adm_serialize_handle_t *handle)
       struct adm_disk *disk;
       struct adm_volume *volume;
 
+      adm_serialize_span(handle, ADM_CONF_SPAN_GROUP, &group->uuid);
       adm_serialize_printf(handle, "  <diskgroup name=\"%s\""
 			  " layout=\"%s\" uuid=\"" UUID_FMT "\""
 			  " transaction=\"%s\" goal=\"%s%s\""
@@ -195,6 +283,7 @@ adm_serialize(adm_serialize_handle_t *handle)
 
       adm_group_for_each_volume (group, volume)
       {
+	adm_serialize_span(handle, ADM_CONF_SPAN_VOLUME, &volume->uuid);
 	adm_serialize_printf(handle, "      <volume name=\"%s\""
 			    " uuid=\"" UUID_FMT "\""
 			    " size=\"%" PRIu64 "\""
@@ -249,12 +338,14 @@ adm_serialize(adm_serialize_handle_t *handle)
 	adm_serialize_printf(handle, "      </volume>\n");
       }
 
+      adm_serialize_span(handle, ADM_CONF_SPAN_GROUP_END, &group->uuid);
       adm_serialize_printf(handle, "    </logical>\n");
 
       adm_serialize_printf(handle, "  </diskgroup>\n");
     }
   }
 
+  adm_serialize_span(handle, ADM_CONF_SPAN_TUNABLES, NULL);
   adm_serialize_printf(handle, "  <tunables>\n");
 
   adm_cluster_for_each_param(param)
@@ -270,6 +361,12 @@ adm_serialize(adm_serialize_handle_t *handle)
 
   adm_serialize_printf(handle, "</Exanodes>\n");
 
+  if (handle->ret >= 0 && handle->nb_spans > 0)
+  {
+    adm_conf_span_t *last = &handle->spans[handle->nb_spans - 1];
+    last->size = handle->ret - last->offset;
+  }
+
   if (handle->ret < 0)
     exalog_error("finished with %s", exa_error_msg(handle->ret));
   else
@@ -277,6 +374,63 @@ adm_serialize(adm_serialize_handle_t *handle)
 }
 
 
+int
+adm_serialize_to_buffer(char **buffer, adm_conf_span_t **spans, int *nb_spans,
+			int create)
+{
+  adm_serialize_handle_t handle;
+
+  *buffer = NULL;
+  if (spans != NULL)
+  {
+    *spans = NULL;
+    *nb_spans = 0;
+  }
+
+  handle.file      = NULL;
+  handle.buffer    = os_malloc(ADM_SERIALIZE_INITIAL_SIZE);
+  handle.size      = ADM_SERIALIZE_INITIAL_SIZE;
+  handle.growable  = true;
+  handle.spans     = NULL;
+  handle.nb_spans  = 0;
+  handle.max_spans = 0;
+  handle.create    = create;
+  handle.ret       = EXA_SUCCESS;
+
+  if (handle.buffer == NULL)
+    return -ENOMEM;
+
+  if (spans != NULL)
+  {
+    handle.max_spans = 64;
+    handle.spans = os_malloc(handle.max_spans * sizeof(adm_conf_span_t));
+    if (handle.spans == NULL)
+    {
+      os_free(handle.buffer);
+      return -ENOMEM;
+    }
+  }
+
+  adm_serialize(&handle);
+
+  if (handle.ret < 0)
+  {
+    os_free(handle.buffer);
+    os_free(handle.spans);
+    return handle.ret;
+  }
+
+  *buffer = handle.buffer;
+  if (spans != NULL)
+  {
+    *spans = handle.spans;
+    *nb_spans = handle.nb_spans;
+  }
+
+  return handle.ret;
+}
+
+
 int
 adm_serialize_to_memory(char *buffer, int size, int create)
 {
@@ -285,6 +439,10 @@ adm_serialize_to_memory(char *buffer, int size, int create)
   handle.file   = NULL;
   handle.buffer = buffer;
   handle.size   = size;
+  handle.growable = false;
+  handle.spans  = NULL;
+  handle.nb_spans = 0;
+  handle.max_spans = 0;
   handle.create = create;
   handle.ret    = EXA_SUCCESS;
 
@@ -302,6 +460,10 @@ adm_serialize_to_null(int create)
   handle.file   = NULL;
   handle.buffer = NULL;
   handle.size   = 0;
+  handle.growable = false;
+  handle.spans  = NULL;
+  handle.nb_spans = 0;
+  handle.max_spans = 0;
   handle.create = create;
   handle.ret    = EXA_SUCCESS;
 
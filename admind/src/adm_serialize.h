@@ -9,6 +9,22 @@
 #ifndef __ADM_SERIALIZE_H
 #define __ADM_SERIALIZE_H
 
+#include "admind/src/adm_conf_log.h"
+
+/**
+ * Serialize the configuration in a single pass.
+ *
+ * @param[out] buffer    Configuration, NUL terminated, to free with os_free()
+ * @param[out] spans     Spans of the objects in buffer, to free with
+ *                       os_free(); may be NULL if not wanted
+ * @param[out] nb_spans  Number of spans
+ * @param[in]  create    Whether serializing for a cluster creation
+ *
+ * @return the size of the configuration or a negative error code
+ */
+int adm_serialize_to_buffer(char **buffer, adm_conf_span_t **spans,
+                            int *nb_spans, int create);
+
 int adm_serialize_to_memory(char *buffer, int size, int create);
 int adm_serialize_to_null(int create);
 
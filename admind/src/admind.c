@@ -170,8 +170,7 @@ load_config(void)
 	return -EINVAL;
     }
 
-    error_val = adm_deserialize_from_file(conf_path,
-	                                  error_msg, false /* create */);
+    error_val = conf_load(error_msg);
 
     if (error_val != EXA_SUCCESS)
     {
@@ -212,9 +211,10 @@ load_config(void)
      * recovery of admind. */
     /* FIXME why it this stuff done here and not when actually reading the
      * config file ? */
-    adm_config_size = adm_serialize_to_null(false /* create */);
-    adm_config_buffer = os_malloc(adm_config_size + 1);
-    adm_serialize_to_memory(adm_config_buffer, adm_config_size + 1, false);
+    adm_config_size = adm_serialize_to_buffer(&adm_config_buffer, NULL, NULL,
+                                              false /* create */);
+    if (adm_config_size < 0)
+        return adm_config_size;
 
     exalog_info("Config file loaded (cluster '%s', UUID '" UUID_FMT "')",
 	         adm_cluster.name, UUID_VAL(&adm_cluster.uuid));
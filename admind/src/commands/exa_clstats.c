@@ -37,7 +37,7 @@ static void
 add_nbd_stats(int thr_nb, const struct nbd_stats_request *request,
 	      struct nbd_stats_reply *stats)
 {
-  char buf[1024];
+  char buf[2048];
   uint64_t msec;
 
   msec = stats->now - stats->last_reset;
@@ -46,12 +46,16 @@ add_nbd_stats(int thr_nb, const struct nbd_stats_request *request,
 	   "seq_sect_write=\"%"PRIu64"\" seq_req_read=\"%"PRIu64"\" seq_req_write=\"%"PRIu64"\" "
 	   "seq_seeks_read=\"%"PRIu64"\" seq_seeks_write=\"%"PRIu64"\" seq_seek_dist_read=\"%"PRIu64"\" "
 	   "seq_seek_dist_write=\"%"PRIu64"\" sect_read=\"%"PRIu64"\" sect_write=\"%"PRIu64"\" "
-	   "req_read=\"%"PRIu64"\" req_write=\"%"PRIu64"\" req_error=\"%"PRIu64"\" />",
+	   "req_read=\"%"PRIu64"\" req_write=\"%"PRIu64"\" req_error=\"%"PRIu64"\" "
+	   "tcp_send_calls=\"%"PRIu64"\" tcp_send_req=\"%"PRIu64"\" "
+	   "tcp_recv_calls=\"%"PRIu64"\" tcp_recv_req=\"%"PRIu64"\" />",
 	   request->node_name, request->disk_path, msec, stats->begin.nb_sect_read,
 	   stats->begin.nb_sect_write, stats->begin.nb_req_read, stats->begin.nb_req_write,
 	   stats->begin.nb_seeks_read, stats->begin.nb_seeks_write, stats->begin.nb_seek_dist_read,
 	   stats->begin.nb_seek_dist_write, stats->done.nb_sect_read, stats->done.nb_sect_write,
-	   stats->done.nb_req_read, stats->done.nb_req_write, stats->done.nb_req_err);
+	   stats->done.nb_req_read, stats->done.nb_req_write, stats->done.nb_req_err,
+	   stats->tcp.send_calls, stats->tcp.send_requests,
+	   stats->tcp.recv_calls, stats->tcp.recv_requests);
 
   send_payload_str(buf);
 }
@@ -103,25 +107,51 @@ get_nbd_stats(int thr_nb, bool reset)
 }
 
 
+/* Format the latency percentiles as XML attributes, prefixed by the
+ * latency kind (read_p50_us="..." ...) */
+static void
+format_latency_attrs(char *buf, size_t size,
+		     const struct vrt_stats_latency latency[VRT_LATENCY_TYPES])
+{
+  static const char *names[VRT_LATENCY_TYPES] = { "read", "write", "barrier" };
+  vrt_latency_type_t type;
+  size_t len = 0;
+
+  buf[0] = '\0';
+  for (type = VRT_LATENCY__FIRST; type <= VRT_LATENCY__LAST && len < size; type++)
+    len += os_snprintf(buf + len, size - len,
+		       " %s_lat_req=\"%"PRIu64"\" %s_p50_us=\"%"PRIu32"\""
+		       " %s_p99_us=\"%"PRIu32"\" %s_p999_us=\"%"PRIu32"\"",
+		       names[type], latency[type].nb_req,
+		       names[type], latency[type].p50_us,
+		       names[type], latency[type].p99_us,
+		       names[type], latency[type].p999_us);
+}
+
+
 static void
 add_vrt_stats(int thr_nb, struct vrt_stats_request *request,
 	      struct vrt_stats_reply *stats)
 {
-  char buf[1024];
+  char buf[2048];
+  char latency[512];
   uint64_t msec;
 
+  format_latency_attrs(latency, sizeof(latency), stats->latency);
+
   msec = stats->now - stats->last_reset;
   os_snprintf(buf, sizeof(buf),
            "<volume name=\"%s\" msec=\"%"PRIu64"\" seq_sect_read=\"%"PRIu64"\" "
 	   "seq_sect_write=\"%"PRIu64"\" seq_req_read=\"%"PRIu64"\" seq_req_write=\"%"PRIu64"\" "
 	   "seq_seeks_read=\"%"PRIu64"\" seq_seeks_write=\"%"PRIu64"\" seq_seek_dist_read=\"%"PRIu64"\" "
 	   "seq_seek_dist_write=\"%"PRIu64"\" sect_read=\"%"PRIu64"\" sect_write=\"%"PRIu64"\" "
-	   "req_read=\"%"PRIu64"\" req_write=\"%"PRIu64"\" req_error=\"%"PRIu64"\" />",
+	   "req_read=\"%"PRIu64"\" req_write=\"%"PRIu64"\" req_error=\"%"PRIu64"\"%s />",
 	   request->volume_name, msec, stats->begin.nb_sect_read,
 	   stats->begin.nb_sect_write, stats->begin.nb_req_read, stats->begin.nb_req_write,
 	   stats->begin.nb_seeks_read, stats->begin.nb_seeks_write, stats->begin.nb_seek_dist_read,
 	   stats->begin.nb_seek_dist_write, stats->done.nb_sect_read, stats->done.nb_sect_write,
-	   stats->done.nb_req_read, stats->done.nb_req_write, stats->done.nb_req_err);
+	   stats->done.nb_req_read, stats->done.nb_req_write, stats->done.nb_req_err,
+	   latency);
 
   send_payload_str(buf);
 }
@@ -175,6 +205,71 @@ get_vrt_stats(int thr_nb, bool reset)
 }
 
 
+static void
+add_vrt_rdev_stats(int thr_nb, const struct adm_disk *disk,
+		   const struct vrt_rdev_stats_reply *stats)
+{
+  char buf[1024];
+  char latency[512];
+
+  format_latency_attrs(latency, sizeof(latency), stats->latency);
+  os_snprintf(buf, sizeof(buf), "<rdev node=\"%s\" disk=\"%s\"%s />",
+	      adm_cluster_get_node_by_id(disk->node_id)->name, disk->path,
+	      latency);
+
+  send_payload_str(buf);
+}
+
+
+/* Latencies of the real devices, as seen by the VRT of each node */
+static void
+get_vrt_rdev_stats(int thr_nb, bool reset)
+{
+  struct adm_group *group;
+  struct adm_disk *disk;
+
+  adm_group_for_each_group(group)
+  {
+    adm_group_for_each_disk(group, disk)
+    {
+      exa_nodeid_t nodeid;
+      struct vrt_rdev_stats_request request;
+      struct vrt_rdev_stats_reply reply_vrt;
+      admwrk_request_t req;
+      int errval;
+
+      request.reset = reset;
+      uuid_copy(&request.group_uuid, &group->uuid);
+      uuid_copy(&request.rdev_uuid, &disk->vrt_uuid);
+
+      admwrk_run_command(thr_nb, &adm_service_vrt, &req,
+			 RPC_SERVICE_ADMIND_GETVRTRDEVSTATS,
+			 &request, sizeof(request));
+
+      while (admwrk_get_reply(&req, &nodeid, &reply_vrt, sizeof(reply_vrt),
+			      &errval))
+	{
+	  char nodetag[128 /*large enougth for tags bellow */
+	               + EXA_MAXSIZE_NODENAME
+	               + EXA_MAXSIZE_GROUPNAME];
+
+	  os_snprintf(nodetag, sizeof(nodetag),
+	           "<node name=\"%s\"%s><vrt><diskgroup name=\"%s\">",
+	           adm_cluster_get_node_by_id(nodeid)->name,
+		   errval == -ADMIND_ERR_NODE_DOWN ? " down=\"\"" : "",
+		   group->name);
+	  send_payload_str(nodetag);
+
+	  if (errval != -ADMIND_ERR_NODE_DOWN)
+	    add_vrt_rdev_stats(thr_nb, disk, &reply_vrt);
+
+	  send_payload_str("</diskgroup></vrt></node>");
+	}
+    }
+  }
+}
+
+
 static void
 cluster_clstats(int thr_nb, void *data, cl_error_desc_t *err_desc)
 {
@@ -187,6 +282,7 @@ cluster_clstats(int thr_nb, void *data, cl_error_desc_t *err_desc)
 
   get_nbd_stats(thr_nb, params->reset);
   get_vrt_stats(thr_nb, params->reset);
+  get_vrt_rdev_stats(thr_nb, params->reset);
 
   send_payload_str("</stats>");
 
@@ -220,6 +316,20 @@ local_getvrtstats(int thr_nb, void *msg)
 }
 
 
+static void
+local_getvrtrdevstats(int thr_nb, void *msg)
+{
+  const struct vrt_rdev_stats_request *request = msg;
+  struct vrt_rdev_stats_reply reply_msg;
+
+  /* The VRT replies empty latencies if the group is not known locally */
+  vrt_client_rdev_stat_get(adm_wt_get_localmb(), request, &reply_msg);
+
+  COMPILE_TIME_ASSERT(sizeof(reply_msg) <= ADM_MAILBOX_PAYLOAD_PER_NODE);
+  admwrk_reply(thr_nb, &reply_msg, sizeof(reply_msg));
+}
+
+
 const AdmCommand exa_clstats = {
   .code            = EXA_ADM_CLSTATS,
   .msg             = "clstats",
@@ -229,6 +339,7 @@ const AdmCommand exa_clstats = {
   .local_commands  = {
     { RPC_SERVICE_ADMIND_GETNBDSTATS, local_getnbdstats },
     { RPC_SERVICE_ADMIND_GETVRTSTATS, local_getvrtstats },
+    { RPC_SERVICE_ADMIND_GETVRTRDEVSTATS, local_getvrtrdevstats },
     { RPC_COMMAND_NULL, NULL }
   }
 };
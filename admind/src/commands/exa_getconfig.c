@@ -43,31 +43,18 @@ static void
 cluster_get_config(int thr_nb, void *dummy, cl_error_desc_t *err_desc)
 {
   char *buffer = NULL;
-  int size;
   int ret;
 
   exalog_debug("getconfig");
 
-  /* Compute buffer size */
-  adm_cluster_lock();
-  size = adm_serialize_to_null(true /* create */);
-  adm_cluster_unlock();
-
-  /* Alloc a buffer */
-  buffer = os_malloc(size + 1);
-  if (buffer == NULL)
-  {
-    set_error(err_desc, -ENOMEM, "Unable to allocate memory to perform command.");
-    return;
-  }
-
   /* Serialize the config */
   adm_cluster_lock();
-  ret = adm_serialize_to_memory(buffer, size + 1, true /* create */);
+  ret = adm_serialize_to_buffer(&buffer, NULL, NULL, true /* create */);
   adm_cluster_unlock();
   if (ret < EXA_SUCCESS)
   {
-    set_error(err_desc, ret, NULL);
+    set_error(err_desc, ret, ret == -ENOMEM ?
+              "Unable to allocate memory to perform command." : NULL);
     return;
   }
 
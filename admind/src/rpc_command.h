@@ -61,6 +61,7 @@ typedef enum rpc_command {
 #endif
  RPC_SERVICE_ADMIND_GETNBDSTATS,
  RPC_SERVICE_ADMIND_GETVRTSTATS,
+ RPC_SERVICE_ADMIND_GETVRTRDEVSTATS,
  RPC_SERVICE_ADMIND_RECOVER,
  RPC_SERVICE_ADMIND_STOP,
  RPC_SERVICE_ADMIND_CHECK_LICENSE,
@@ -10,7 +10,8 @@
 #include "admind/src/adm_cluster.h"
 #include "admind/src/adm_license.h"
 #include "admind/src/adm_serialize.h"
-#include "admind/src/adm_atomic_file.h"
+#include "admind/src/adm_conf_log.h"
+#include "admind/src/adm_deserialize.h"
 #include "common/include/exa_env.h"
 #include "common/include/exa_error.h"
 #include "os/include/os_mem.h"
@@ -35,6 +36,40 @@ conf_delete(void)
     /* The only acceptable errors are if the files were already removed. */
     EXA_ASSERT(unlink(conf_path) == 0 || errno == ENOENT);
     EXA_ASSERT(unlink(license_path) == 0 || errno == ENOENT);
+    EXA_ASSERT(adm_conf_log_remove(conf_path) == EXA_SUCCESS);
+}
+
+
+int
+conf_load(char *error_msg)
+{
+  char conf_path[OS_PATH_MAX];
+  char *buffer;
+  int size;
+  int ret;
+
+  exa_env_make_path(conf_path, sizeof(conf_path), exa_env_cachedir(),
+                    ADMIND_CONF_EXANODES_FILE);
+
+  ret = adm_conf_log_load(conf_path, &buffer, &size);
+  if (ret < 0)
+  {
+    os_snprintf(error_msg, EXA_MAXSIZE_LINE + 1,
+                "failed replaying the configuration log: %s",
+                exa_error_msg(ret));
+    return ret;
+  }
+
+  if (buffer == NULL)
+    return adm_deserialize_from_file(conf_path, error_msg, false /* create */);
+
+  exalog_debug("replayed %d changes of '%s'", ret, conf_path);
+
+  /* The next save rewrites the configuration file with the changes */
+  ret = adm_deserialize_from_memory(buffer, size, error_msg, false /* create */);
+  os_free(buffer);
+
+  return ret;
 }
 
 
@@ -42,6 +77,8 @@ static int
 conf_do_save(int64_t version)
 {
   char *buffer;
+  adm_conf_span_t *spans;
+  int nb_spans;
   int size;
   int ret;
   char conf_path[OS_PATH_MAX];
@@ -53,40 +90,25 @@ conf_do_save(int64_t version)
 
   adm_cluster.version = version;
 
-  do
+  /* Serialize the config */
+
+  adm_cluster_lock();
+  size = adm_serialize_to_buffer(&buffer, &spans, &nb_spans, false /* create */);
+  adm_cluster_unlock();
+  if (size < EXA_SUCCESS)
   {
-    /* Compute buffer size */
-
-    adm_cluster_lock();
-    size = adm_serialize_to_null(false /*create */);
-    adm_cluster_unlock();
-
-    /* Alloc a buffer */
-
-    buffer = os_malloc(size + 1);
-    if (buffer == NULL)
-    {
-      exalog_error("os_malloc() failed");
-      return -ENOMEM;
-    }
-
-    /* Serialize the config */
-
-    adm_cluster_lock();
-    ret = adm_serialize_to_memory(buffer, size + 1, false /*create */);
-    adm_cluster_unlock();
-    if (ret < EXA_SUCCESS)
-    {
-      exalog_error("adm_serialize_to_memory(): %s", exa_error_msg(ret));
-      goto error;
-    }
-  } while(ret != size);
-
-  ret = adm_atomic_file_save(conf_path, buffer, size);
+    exalog_error("adm_serialize_to_buffer(): %s", exa_error_msg(size));
+    return size;
+  }
+
+  /* Only the objects that changed since the previous save are written */
+  ret = adm_conf_log_save(conf_path, buffer, size, spans, nb_spans);
+  os_free(spans);
   if (ret)
   {
       exalog_error("failed saving cluster config file");
-      goto error;
+      os_free(buffer);
+      return ret;
   }
 
   adm_cluster_lock();
@@ -99,10 +121,6 @@ conf_do_save(int64_t version)
   exalog_debug("version %" PRId64 " successfully written",
 	       version);
   return EXA_SUCCESS;
-
-error:
-  os_free(buffer);
-  return ret;
 }
 
 
@@ -123,4 +141,5 @@ void conf_cleanup()
 {
     if (adm_config_buffer)
         os_free(adm_config_buffer);
+    adm_conf_log_reset();
 }
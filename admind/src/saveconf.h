@@ -13,6 +13,9 @@
 
 #define ADMIND_CONF_EXANODES_FILE   "exanodes.conf"
 
+/* called from admind startup: reads the config file and replays its log */
+int conf_load(char *error_msg);
+
 /* called from CLI commands when a change is done in the configfile */
 int conf_save_synchronous(void);
 
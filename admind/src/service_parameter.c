@@ -144,6 +144,23 @@ static exa_service_parameter_t exa_service_parameter_table[] = {
     .max             = 262144,
     .default_value   = "131072",
   },
+  {
+    .name            = "tcp_io_threads",
+    .description     = "The number of threads (per direction) handling the data network sockets of the\n"
+                       "NBD clients and servers. 0 means a single select() based thread per direction is used,\n"
+                       "otherwise peers are spread over that many epoll() based threads.",
+    .type            = EXA_PARAM_TYPE_INT,
+    .min             = 0,
+    .max             = 16,
+    .default_value   = "0",
+  },
+  {
+    .name            = "tcp_zerocopy",
+    .description     = "Send large payloads (64 KiB and more) on the data network without copying them\n"
+                       "into the kernel. Only effective when tcp_io_threads is not 0.",
+    .type            = EXA_PARAM_TYPE_BOOLEAN,
+    .default_value   = "FALSE",
+  },
   {
     .name            = "tcp_data_net_timeout",
     .description     = "The maximum wait time (in seconds) without receiving keepalives from clients before TCP data \n"
@@ -197,6 +214,16 @@ static exa_service_parameter_t exa_service_parameter_table[] = {
     .max             = 65535,
     .default_value   = "4096",
   },
+  {
+    .name            = "vrt_engine_threads",
+    .description     = "The number of threads of the virtualizer engine. The requests of a\n"
+                       "group are always handled by the same thread, so that several threads\n"
+                       "only help on nodes with several groups.",
+    .type            = EXA_PARAM_TYPE_INT,
+    .min             = 1,
+    .max             = VRT_MAX_ENGINE_THREADS,
+    .default_value   = "4",
+  },
   {
     .name            = "default_chunk_size",
     .description     = "Default chunk size in KiB. A small chunk size increases the memory consumption,\n"
@@ -247,6 +274,16 @@ static exa_service_parameter_t exa_service_parameter_table[] = {
     .max             = 256,
     .default_value   = "256",
   },
+  {
+    .name            = "bdev_target_threads",
+    .description     = "The number of threads submitting the IOs of the bdev target. Several\n"
+                       "threads help when the local block devices do many small IOs. With\n"
+                       "ublk, this is the number of hardware queues of each device.",
+    .type            = EXA_PARAM_TYPE_INT,
+    .min             = 1,
+    .max             = BDEV_TARGET_MAX_THREADS,
+    .default_value   = "4",
+  },
   {
     .name            = "target_buffer_size",
     .description     = "iSCSI target buffers size",
@@ -297,6 +334,46 @@ static exa_service_parameter_t exa_service_parameter_table[] = {
     .min             = 0,
     .max             = 4,
     .default_value   = "0", /* 0ms */
+  },
+  {
+    .name            = "rain1_read_policy",
+    .description     = "How the replica a read is done from is chosen on rain1 groups:\n"
+                       "first readable replica, each replica in turn, the replica with the\n"
+                       "least outstanding IOs (weighted by its latency) or the local replica.",
+    .type            = EXA_PARAM_TYPE_LIST,
+    .min             = 0,
+    .max             = 0,
+    .choices         =
+    {
+      "first",
+      "round_robin",
+      "least_outstanding",
+      "local",
+      NULL
+    },
+    .default_value   = "least_outstanding",
+  },
+  {
+    .name            = "rain1_dirty_zone_retention",
+    .description     = "Number of seconds a dirty zone of a rain1 group stays marked as being\n"
+                       "written after its last write, so that writing it again does not need\n"
+                       "to mark it first. 0 disables the retention. The dirty zones marked are\n"
+                       "resynchronized if the node crashes.",
+    .type            = EXA_PARAM_TYPE_INT,
+    .min             = 0,
+    .max             = 3600,
+    .default_value   = "30",
+  },
+  {
+    .name            = "rebuilding_latency_target",
+    .description     = "Latency in ms under which the rebuilding and resynchronization of rain1\n"
+                       "groups keep the 99th percentile of the client IOs on the disks, going\n"
+                       "as fast as this allows. 0 disables the adaptation: the rebuilding\n"
+                       "slowdowns are used instead.",
+    .type            = EXA_PARAM_TYPE_INT,
+    .min             = 0,
+    .max             = 10000,
+    .default_value   = "0",
   }
 };
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "admind/src/adm_conf_log.h"
+
+#include "common/include/exa_error.h"
+#include "os/include/os_dir.h"
+#include "os/include/os_file.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_stdio.h"
+
+#include <string.h>
+
+#define TMP_DIR    "." OS_FILE_SEP "tmp"
+#define CONF_FILE  TMP_DIR OS_FILE_SEP "test.conf"
+#define LOG_FILE   CONF_FILE ADM_CONF_LOG_SUFFIX
+
+#define NB_OBJECTS  8
+
+/* Configuration made of one span per object */
+static char conf[NB_OBJECTS * 256];
+static int conf_size;
+static adm_conf_span_t spans[NB_OBJECTS];
+static int nb_spans;
+
+/* Text of the objects, indexed by key */
+static char objects[NB_OBJECTS][256];
+
+static void set_object(int key, int version)
+{
+    os_snprintf(objects[key], sizeof(objects[key]),
+                "    <node name=\"node%d\" version=\"%d\">\n"
+                "      <network hostname=\"node%d.example.com\"/>\n"
+                "      <disk uuid=\"00000000:00000000:00000000:0000000%d\"/>\n"
+                "      <disk uuid=\"00000000:00000000:00000000:0000001%d\"/>\n"
+                "      <disk uuid=\"00000000:00000000:00000000:0000002%d\"/>\n"
+                "    </node>\n", key, version, key, key, key, key);
+}
+
+/* Build the configuration from the objects whose keys are given, in order */
+static void build(const int *keys, int nb)
+{
+    int i;
+
+    conf_size = 0;
+    nb_spans = nb;
+    for (i = 0; i < nb; i++)
+    {
+        int len = strlen(objects[keys[i]]);
+
+        spans[i].type = ADM_CONF_SPAN_NODE;
+        uuid_zero(&spans[i].key);
+        spans[i].key.id[0] = keys[i];
+        spans[i].offset = conf_size;
+        spans[i].size = len;
+        memcpy(conf + conf_size, objects[keys[i]], len);
+        conf_size += len;
+    }
+    conf[conf_size] = '\0';
+}
+
+static int save(const int *keys, int nb)
+{
+    build(keys, nb);
+    return adm_conf_log_save(CONF_FILE, conf, conf_size, spans, nb_spans);
+}
+
+static long file_size(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+
+    UT_ASSERT(file != NULL);
+    UT_ASSERT(fseek(file, 0, SEEK_END) == 0);
+    size = ftell(file);
+    fclose(file);
+
+    return size;
+}
+
+static void read_file(const char *path, char *data, long size)
+{
+    FILE *file = fopen(path, "rb");
+
+    UT_ASSERT(file != NULL);
+    UT_ASSERT(fread(data, size, 1, file) == 1);
+    fclose(file);
+}
+
+/* Check that the configuration file with its log is the current config */
+static void check_loaded(int expected_records)
+{
+    char *buffer;
+    int size;
+
+    UT_ASSERT_EQUAL(expected_records,
+                    adm_conf_log_load(CONF_FILE, &buffer, &size));
+
+    if (buffer == NULL)
+    {
+        static char data[sizeof(conf)];
+
+        UT_ASSERT_EQUAL(conf_size, file_size(CONF_FILE));
+        read_file(CONF_FILE, data, conf_size);
+        UT_ASSERT(memcmp(data, conf, conf_size) == 0);
+    }
+    else
+    {
+        UT_ASSERT_EQUAL(conf_size, size);
+        UT_ASSERT_EQUAL_STR(conf, buffer);
+        os_free(buffer);
+    }
+}
+
+static const int all_keys[NB_OBJECTS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+ut_setup()
+{
+    int i;
+
+    UT_ASSERT(os_dir_create_recursive(TMP_DIR) == 0);
+
+    adm_conf_log_reset();
+    for (i = 0; i < NB_OBJECTS; i++)
+        set_object(i, 0);
+}
+
+ut_cleanup()
+{
+    adm_conf_log_reset();
+    UT_ASSERT(os_dir_remove_tree(TMP_DIR) == 0);
+}
+
+ut_test(first_save_writes_the_whole_file)
+{
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    UT_ASSERT_EQUAL(conf_size, file_size(CONF_FILE));
+    check_loaded(0);
+}
+
+ut_test(changed_object_is_appended_to_the_log)
+{
+    long conf_file_size, log_file_size;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    conf_file_size = file_size(CONF_FILE);
+    log_file_size = file_size(LOG_FILE);
+
+    set_object(3, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    /* Only the object changed was written */
+    UT_ASSERT_EQUAL(conf_file_size, file_size(CONF_FILE));
+    UT_ASSERT(file_size(LOG_FILE) - log_file_size
+              < strlen(objects[3]) + 128);
+
+    check_loaded(1);
+}
+
+ut_test(unchanged_config_is_not_logged)
+{
+    long log_file_size;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    log_file_size = file_size(LOG_FILE);
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    UT_ASSERT_EQUAL(log_file_size, file_size(LOG_FILE));
+
+    check_loaded(0);
+}
+
+ut_test(added_removed_and_moved_objects_are_replayed)
+{
+    const int some_keys[] = { 0, 1, 2, 4, 5 };
+    const int more_keys[] = { 0, 1, 2, 4, 5, 6 };
+    const int moved_keys[] = { 6, 0, 1, 2, 4, 5, 3 };
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(some_keys, 5));
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(more_keys, 6));
+    set_object(1, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(more_keys, 6));
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(moved_keys, 7));
+
+    check_loaded(3);
+}
+
+ut_test(partial_record_is_ignored)
+{
+    char log[4096];
+    long log_file_size;
+    FILE *file;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    set_object(2, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    log_file_size = file_size(LOG_FILE);
+
+    set_object(5, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    UT_ASSERT(file_size(LOG_FILE) <= sizeof(log));
+
+    /* Tear the last record */
+    read_file(LOG_FILE, log, log_file_size + 10);
+    file = fopen(LOG_FILE, "wb");
+    UT_ASSERT(file != NULL);
+    UT_ASSERT(fwrite(log, log_file_size + 10, 1, file) == 1);
+    fclose(file);
+
+    set_object(5, 0);
+    build(all_keys, NB_OBJECTS);
+    check_loaded(1);
+}
+
+ut_test(log_not_matching_the_file_is_ignored)
+{
+    FILE *file;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    set_object(2, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    /* The file was rewritten but the log not started again */
+    build(all_keys, NB_OBJECTS - 1);
+    file = fopen(CONF_FILE, "wb");
+    UT_ASSERT(file != NULL);
+    UT_ASSERT(fwrite(conf, conf_size, 1, file) == 1);
+    fclose(file);
+
+    check_loaded(0);
+}
+
+ut_test(file_is_rewritten_when_log_outgrows_it)
+{
+    long conf_file_size;
+    char *buffer;
+    int size;
+    int nb_records;
+    int i;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    conf_file_size = file_size(CONF_FILE);
+
+    for (i = 1; i <= 2 * NB_OBJECTS; i++)
+    {
+        set_object(i % NB_OBJECTS, i);
+        UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+        UT_ASSERT(file_size(LOG_FILE) <= conf_file_size);
+    }
+
+    /* All changes are there, without replaying all of them */
+    nb_records = adm_conf_log_load(CONF_FILE, &buffer, &size);
+    os_free(buffer);
+    UT_ASSERT(nb_records >= 0);
+    UT_ASSERT(nb_records < 2 * NB_OBJECTS);
+    check_loaded(nb_records);
+}
+
+ut_test(save_after_reset_rewrites_the_whole_file)
+{
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    set_object(2, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    adm_conf_log_reset();
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    check_loaded(0);
+}
+
+ut_test(remove_deletes_the_log)
+{
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+    set_object(2, 1);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, save(all_keys, NB_OBJECTS));
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, adm_conf_log_remove(CONF_FILE));
+    UT_ASSERT(fopen(LOG_FILE, "rb") == NULL);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, adm_conf_log_remove(CONF_FILE));
+}
@@ -12,6 +12,7 @@
 #include <libxml/parser.h>
 
 #include "os/include/os_file.h"
+#include "os/include/os_mem.h"
 #include "os/include/os_string.h"
 
 #include "admind/src/adm_deserialize.h"
@@ -116,3 +117,34 @@ ut_test(serialize_to_memory)
     UT_FAIL();
   }
 }
+
+ut_test(serialize_to_buffer_gives_the_spans_of_the_objects)
+{
+  char *serialized;
+  adm_conf_span_t *spans;
+  int nb_spans;
+  int size;
+  int offset = 0;
+  int i;
+
+  UT_ASSERT(__deserialize_from_file("test.conf.in"));
+
+  size = adm_serialize_to_buffer(&serialized, &spans, &nb_spans,
+				 false /* create */);
+  UT_ASSERT_EQUAL(adm_serialize_to_null(false /* create */), size);
+  UT_ASSERT_EQUAL(size, strlen(serialized));
+
+  /* The spans cover the whole configuration, in order */
+  UT_ASSERT(nb_spans > 0);
+  UT_ASSERT_EQUAL(ADM_CONF_SPAN_HEADER, spans[0].type);
+  UT_ASSERT_EQUAL(ADM_CONF_SPAN_TUNABLES, spans[nb_spans - 1].type);
+  for (i = 0; i < nb_spans; i++)
+  {
+    UT_ASSERT_EQUAL(offset, spans[i].offset);
+    offset += spans[i].size;
+  }
+  UT_ASSERT_EQUAL(size, offset);
+
+  os_free(serialized);
+  os_free(spans);
+}
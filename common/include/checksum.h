@@ -95,6 +95,49 @@ checksum_t checksum_get_value(const checksum_context_t *ctx);
  */
 size_t checksum_get_size(const checksum_context_t *ctx);
 
+/** Implementations of the checksum computation */
+typedef enum
+{
+    CHECKSUM_IMPL_SCALAR,  /**< Portable C, two bytes at a time */
+    CHECKSUM_IMPL_SSE2,    /**< 16 bytes at a time, x86 only */
+    CHECKSUM_IMPL_AVX2     /**< 32 bytes at a time, x86 only */
+} checksum_impl_t;
+
+#define CHECKSUM_IMPL__FIRST  CHECKSUM_IMPL_SCALAR
+#define CHECKSUM_IMPL__LAST   CHECKSUM_IMPL_AVX2
+#define CHECKSUM_IMPL_IS_VALID(impl) \
+    ((impl) >= CHECKSUM_IMPL__FIRST && (impl) <= CHECKSUM_IMPL__LAST)
+
+/**
+ * Tell whether an implementation can be used on this CPU.
+ *
+ * @param[in] impl  Implementation
+ *
+ * @return true if the implementation is supported, false otherwise
+ */
+bool checksum_impl_supported(checksum_impl_t impl);
+
+/**
+ * Select the implementation used by the checksum functions.
+ *
+ * All the implementations compute the same checksums. The fastest one
+ * supported by the CPU is used by default: selecting another one is only
+ * useful to test and benchmark them.
+ *
+ * @param[in] impl  Implementation
+ *
+ * @return true if the implementation is selected, false if it is not
+ *         supported by the CPU
+ */
+bool checksum_select_impl(checksum_impl_t impl);
+
+/**
+ * Implementation used by the checksum functions.
+ *
+ * @return the implementation
+ */
+checksum_impl_t checksum_get_impl(void);
+
 #ifdef __cplusplus
 }
 #endif
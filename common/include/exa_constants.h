@@ -278,7 +278,7 @@ typedef int exa_bool_t;
 #define SERVERD_DATA_PORT	30796
 
 /** Maximum number of locked zone at same time on one disk by serverd */
-#define NBMAX_DISK_LOCKED_ZONES 32
+#define NBMAX_DISK_LOCKED_ZONES 1024
 
 /** 4 KB area reserved at the beginning of each device, in sectors */
 #define RDEV_RESERVED_AREA_IN_SECTORS  BYTES_TO_SECTORS(4096)
@@ -295,6 +295,11 @@ typedef int exa_bool_t;
 /* Product ID: must be 16 char long. */
 #define SCSI_PRODUCT_ID  "Exanodes        "
 
+/* --- Bdev target constants --------------------------------------- */
+
+/** Maximum number of threads submitting the IOs of the bdev target */
+#define BDEV_TARGET_MAX_THREADS  16   /* NOT_IN_PERL */
+
 /* --- VRT constants ---------------------------------------------- */
 
 /** Maximum number of real devices that the virtualizer can handle. */
@@ -348,6 +353,9 @@ typedef int exa_bool_t;
 /** Maximum number of chunks per disk group */
 #define VRT_NBMAX_CHUNKS_PER_GROUP   500000   /* NOT_IN_PERL */
 
+/** Maximum number of threads of the virtualizer engine */
+#define VRT_MAX_ENGINE_THREADS       16       /* NOT_IN_PERL */
+
 /* --- FS constants -------------------------------------------------- */
 
 #ifdef WITH_FS
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXA_HISTOGRAM_H__
+#define __EXA_HISTOGRAM_H__
+
+#include "os/include/os_inttypes.h"
+
+/**
+ * Log-linear histogram of values, typically latencies: each power of two
+ * is split in EXA_HISTOGRAM_SUB_BUCKETS buckets, so that a value is known
+ * with a precision of 1/EXA_HISTOGRAM_SUB_BUCKETS whatever its magnitude.
+ *
+ * Values are counted in one of several shards according to the CPU of the
+ * caller, so that threads recording values concurrently seldom share
+ * counters. Shards are merged when the histogram is read.
+ */
+
+/** log2 of the number of buckets per power of two */
+#define EXA_HISTOGRAM_SUB_BITS     3
+#define EXA_HISTOGRAM_SUB_BUCKETS  (1 << EXA_HISTOGRAM_SUB_BITS)
+
+/** Values are recorded up to 2^EXA_HISTOGRAM_MAX_BITS - 1 (larger values
+ * are counted as this one) */
+#define EXA_HISTOGRAM_MAX_BITS     26
+#define EXA_HISTOGRAM_MAX_VALUE    ((1ULL << EXA_HISTOGRAM_MAX_BITS) - 1)
+
+#define EXA_HISTOGRAM_NB_BUCKETS \
+    ((EXA_HISTOGRAM_MAX_BITS - EXA_HISTOGRAM_SUB_BITS + 1) * EXA_HISTOGRAM_SUB_BUCKETS)
+
+#define EXA_HISTOGRAM_NB_SHARDS    8
+
+typedef struct
+{
+    struct
+    {
+        uint64_t count[EXA_HISTOGRAM_NB_BUCKETS];
+    } shard[EXA_HISTOGRAM_NB_SHARDS];
+} exa_histogram_t;
+
+/** Merged counts of a histogram */
+typedef struct
+{
+    uint64_t total;
+    uint64_t count[EXA_HISTOGRAM_NB_BUCKETS];
+} exa_histogram_snapshot_t;
+
+/**
+ * Empty a histogram. Values recorded meanwhile may be lost.
+ *
+ * @param[out] hist  Histogram
+ */
+void exa_histogram_reset(exa_histogram_t *hist);
+
+/**
+ * Record a value in a histogram. Can be called concurrently.
+ *
+ * @param hist       Histogram
+ * @param[in] value  Value to record
+ */
+void exa_histogram_add(exa_histogram_t *hist, uint64_t value);
+
+/**
+ * Merge the shards of a histogram.
+ *
+ * @param[in]  hist  Histogram
+ * @param[out] snap  Merged counts
+ */
+void exa_histogram_snapshot(const exa_histogram_t *hist,
+                            exa_histogram_snapshot_t *snap);
+
+/**
+ * Get a percentile of the values of a histogram.
+ *
+ * @param[in] snap     Merged counts of the histogram
+ * @param[in] percent  Percentage of the values, in [0, 100]
+ *
+ * @return the upper bound of the bucket of the value below which are
+ *         percent % of the values, or 0 if there is no value
+ */
+uint64_t exa_histogram_percentile(const exa_histogram_snapshot_t *snap,
+                                  double percent);
+
+#endif /* __EXA_HISTOGRAM_H__ */
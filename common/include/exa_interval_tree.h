@@ -0,0 +1,92 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXA_INTERVAL_TREE_H__
+#define __EXA_INTERVAL_TREE_H__
+
+#include "os/include/os_inttypes.h"
+
+/**
+ * Index of intervals [start, end[ answering "which interval overlaps this
+ * one" in O(log n). This is an AVL tree ordered by start, each node
+ * knowing the highest end in its subtree.
+ *
+ * The tree does not allocate anything: nodes are provided by the caller
+ * and must remain valid as long as they are in the tree. Several intervals
+ * may be equal.
+ */
+typedef struct exa_interval_node
+{
+    uint64_t start;     /**< First value in the interval */
+    uint64_t end;       /**< First value after the interval */
+    /* Private */
+    uint64_t max_end;
+    int height;
+    struct exa_interval_node *left;
+    struct exa_interval_node *right;
+} exa_interval_node_t;
+
+typedef struct
+{
+    exa_interval_node_t *root;
+    unsigned int count;     /**< Number of intervals in the tree */
+} exa_interval_tree_t;
+
+/**
+ * Initialize an empty tree.
+ *
+ * @param[out] tree  Tree to initialize
+ */
+void exa_interval_tree_init(exa_interval_tree_t *tree);
+
+/**
+ * Insert an interval in a tree.
+ *
+ * @param     tree   Tree
+ * @param[in] node   Node to insert, not in any tree
+ * @param[in] start  First value in the interval
+ * @param[in] size   Number of values in the interval, not 0
+ */
+void exa_interval_tree_insert(exa_interval_tree_t *tree,
+                              exa_interval_node_t *node,
+                              uint64_t start, uint64_t size);
+
+/**
+ * Remove an interval from a tree.
+ *
+ * @param     tree  Tree
+ * @param[in] node  Node to remove, which must be in the tree
+ */
+void exa_interval_tree_remove(exa_interval_tree_t *tree,
+                              exa_interval_node_t *node);
+
+/**
+ * Find an interval in a tree.
+ *
+ * @param[in] tree   Tree
+ * @param[in] start  First value in the interval
+ * @param[in] size   Number of values in the interval
+ *
+ * @return a node holding exactly this interval, or NULL if there is none
+ */
+exa_interval_node_t *exa_interval_tree_find(const exa_interval_tree_t *tree,
+                                            uint64_t start, uint64_t size);
+
+/**
+ * Find an interval of a tree overlapping a given interval.
+ *
+ * @param[in] tree   Tree
+ * @param[in] start  First value in the interval
+ * @param[in] size   Number of values in the interval
+ *
+ * @return a node overlapping the interval, or NULL if there is none
+ */
+exa_interval_node_t *exa_interval_tree_overlap(const exa_interval_tree_t *tree,
+                                               uint64_t start, uint64_t size);
+
+#endif /* __EXA_INTERVAL_TREE_H__ */
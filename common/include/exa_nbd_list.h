@@ -15,6 +15,8 @@
 #include "os/include/os_atomic.h"
 #include "os/include/os_inttypes.h"
 
+#include "common/include/exa_pool.h"
+
 struct nbd_root_list;
 
 #define NBD_LIST_INFINITE UINT32_MAX
@@ -42,6 +44,17 @@ struct nbd_list
   /* First list given in select */
   struct nbd_list *select_list;
   unsigned waiters; /*< numbers of waiters sleeping in select on the list */
+  int notify_fd;    /*< event fd signalled when the list gets an element, or -1 */
+
+  /* Lock-free list with a single consumer, see nbd_list_set_mpsc() */
+  bool mpsc;
+  os_atomic_t incoming;   /*< last element posted and not yet seen by the
+                              consumer, chained to the previous ones through
+                              root->next, or NO_MORE_ELT */
+  struct nbd_list * volatile mpsc_waiter; /*< list whose select_sem to post
+                                              when an element is posted,
+                                              NULL if the consumer is not
+                                              waiting in select */
   char init_place[256]; /*< used for debugging list starvion */
 };
 
@@ -53,6 +66,8 @@ struct nbd_root_list
   int *next;
   long long *tag;
   struct nbd_list free;
+  exa_pool_t *free_cache; /*< serves the free list instead of its chain of
+                              elements, NULL if not used */
 };
 
 #define LISTWAIT        1
@@ -68,6 +83,7 @@ int __nbd_init_list(struct nbd_root_list *root_list, struct nbd_list *list, cons
 #define nbd_init_root(nb_elt, elt_size, root_list) \
     __nbd_init_root(nb_elt, elt_size, root_list, __FILE__, __LINE__)
 int __nbd_init_root(int nb_elt, int elt_size, struct nbd_root_list *root_list, const char *file, int line);
+int nbd_root_cache_free(struct nbd_root_list *root_list);
 void nbd_close_root(struct nbd_root_list *root_list);
 void *nbd_get_elt_by_num(int index, struct nbd_root_list *root);
 int nbd_set_tag(const void *payload, long long tag, struct nbd_root_list *root);
@@ -75,5 +91,7 @@ int nbd_get_next_by_tag(void **payload, long long tag, struct nbd_root_list *roo
 void nbd_close_list(struct nbd_list *list);
 int nbd_list_select(struct nbd_list **lists, bool *lists_found,
                     unsigned int nb_list, unsigned ms_timeout);
+void nbd_list_set_notify_fd(struct nbd_list *list, int fd);
+void nbd_list_set_mpsc(struct nbd_list *list);
 
 #endif
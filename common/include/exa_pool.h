@@ -0,0 +1,66 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXA_POOL_H__
+#define __EXA_POOL_H__
+
+#include "os/include/os_inttypes.h"
+
+/**
+ * Pool of free objects, identified by their index in [0, nb_objs[.
+ *
+ * Each thread gets and puts objects in a magazine of its own, so that
+ * threads allocating and freeing objects do not contend on a shared lock.
+ * Magazines are refilled from and flushed to a global depot, which is a
+ * lock-free stack, by batches of objects.
+ *
+ * Threads are spread on the magazines according to their thread-local
+ * storage address: a magazine is protected by a lock in case several
+ * threads share it, and so that a thread can take objects in the
+ * magazines of the others when the depot is empty. Hence no object is
+ * ever out of reach.
+ */
+typedef struct exa_pool exa_pool_t;
+
+/**
+ * Create a pool, with all its objects free.
+ *
+ * @param[in] nb_objs  Number of objects in the pool
+ *
+ * @return the pool, or NULL if out of memory
+ */
+exa_pool_t *exa_pool_create(unsigned int nb_objs);
+
+/**
+ * Delete a pool.
+ *
+ * @param[in] pool  Pool to delete
+ */
+void exa_pool_delete(exa_pool_t *pool);
+
+/**
+ * Get a free object from a pool.
+ *
+ * @param     pool  Pool
+ * @param[in] wait  Whether to wait for an object to be put back when all
+ *                  the objects are in use
+ *
+ * @return the index of the object, or -1 if all the objects are in use and
+ *         wait is false
+ */
+int exa_pool_get(exa_pool_t *pool, bool wait);
+
+/**
+ * Put an object back in a pool.
+ *
+ * @param     pool   Pool
+ * @param[in] index  Index of the object, which must be in use
+ */
+void exa_pool_put(exa_pool_t *pool, int index);
+
+#endif /* __EXA_POOL_H__ */
@@ -9,6 +9,14 @@
 #include "common/include/checksum.h"
 #include "common/include/exa_assert.h"
 
+/* The vectorized implementations rely on GCC's target attribute to be
+ * built without enabling SSE2/AVX2 for the whole file, and on
+ * __builtin_cpu_supports() to be chosen at runtime. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_WITH_SIMD
+#include <immintrin.h>
+#endif
+
 checksum_t exa_checksum(const void *buffer, size_t size)
 {
     checksum_context_t ctx;
@@ -33,9 +41,10 @@ static uint32_t __chksum_pair(uint32_t sum, uint8_t a, uint8_t b)
     return sum + (uint32_t)word16;
 }
 
-static uint32_t __chksum_array(uint32_t sum, const uint8_t *buf, size_t size)
+static uint32_t __chksum_array_scalar(uint32_t sum, const uint8_t *buf,
+                                      size_t size)
 {
-    int i;
+    size_t i;
     uint32_t new_sum = sum;
 
     if (size % 2 != 0)
@@ -47,6 +56,155 @@ static uint32_t __chksum_array(uint32_t sum, const uint8_t *buf, size_t size)
     return new_sum;
 }
 
+#ifdef CHECKSUM_WITH_SIMD
+
+/* The sum is a 32-bit sum of little-endian 16-bit words, wrapping around.
+ * The vectorized versions split it into several 32-bit sums, each also
+ * wrapping around: as addition modulo 2^32 is associative, the total of
+ * these sums is exactly the scalar sum. */
+
+__attribute__((target("sse2")))
+static uint32_t __chksum_array_sse2(uint32_t sum, const uint8_t *buf,
+                                    size_t size)
+{
+    const __m128i low_words = _mm_set1_epi32(0xFFFF);
+    __m128i acc = _mm_setzero_si128();
+    uint32_t lanes[4];
+    size_t i;
+
+    if (size % 2 != 0)
+        size--;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+
+        acc = _mm_add_epi32(acc, _mm_and_si128(v, low_words));
+        acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return __chksum_array_scalar(sum, buf + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t __chksum_array_avx2(uint32_t sum, const uint8_t *buf,
+                                    size_t size)
+{
+    const __m256i low_words = _mm256_set1_epi32(0xFFFF);
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m128i acc;
+    uint32_t lanes[4];
+    size_t i;
+
+    if (size % 2 != 0)
+        size--;
+
+    /* Two accumulators to avoid waiting for the previous addition */
+    for (i = 0; i + 64 <= size; i += 64)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(buf + i + 32));
+
+        acc0 = _mm256_add_epi32(acc0, _mm256_and_si256(v0, low_words));
+        acc1 = _mm256_add_epi32(acc1, _mm256_and_si256(v1, low_words));
+        acc0 = _mm256_add_epi32(acc0, _mm256_srli_epi32(v0, 16));
+        acc1 = _mm256_add_epi32(acc1, _mm256_srli_epi32(v1, 16));
+    }
+
+    acc0 = _mm256_add_epi32(acc0, acc1);
+    acc = _mm_add_epi32(_mm256_castsi256_si128(acc0),
+                        _mm256_extracti128_si256(acc0, 1));
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return __chksum_array_sse2(sum, buf + i, size - i);
+}
+
+#endif /* CHECKSUM_WITH_SIMD */
+
+typedef uint32_t (*chksum_array_func_t)(uint32_t sum, const uint8_t *buf,
+                                        size_t size);
+
+static uint32_t __chksum_array_select(uint32_t sum, const uint8_t *buf,
+                                      size_t size);
+
+/* Implementation in use, chosen on first use */
+static chksum_array_func_t __chksum_array = __chksum_array_select;
+static checksum_impl_t current_impl = CHECKSUM_IMPL_SCALAR;
+
+bool checksum_impl_supported(checksum_impl_t impl)
+{
+    switch (impl)
+    {
+    case CHECKSUM_IMPL_SCALAR:
+        return true;
+#ifdef CHECKSUM_WITH_SIMD
+    case CHECKSUM_IMPL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case CHECKSUM_IMPL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+bool checksum_select_impl(checksum_impl_t impl)
+{
+    if (!checksum_impl_supported(impl))
+        return false;
+
+    switch (impl)
+    {
+#ifdef CHECKSUM_WITH_SIMD
+    case CHECKSUM_IMPL_SSE2:
+        __chksum_array = __chksum_array_sse2;
+        break;
+    case CHECKSUM_IMPL_AVX2:
+        __chksum_array = __chksum_array_avx2;
+        break;
+#endif
+    default:
+        __chksum_array = __chksum_array_scalar;
+        break;
+    }
+    current_impl = impl;
+
+    return true;
+}
+
+/* Select the fastest implementation supported */
+static void checksum_select_best_impl(void)
+{
+    checksum_impl_t impl;
+
+    for (impl = CHECKSUM_IMPL__LAST; impl > CHECKSUM_IMPL__FIRST; impl--)
+        if (checksum_select_impl(impl))
+            return;
+
+    checksum_select_impl(CHECKSUM_IMPL_SCALAR);
+}
+
+checksum_impl_t checksum_get_impl(void)
+{
+    if (__chksum_array == __chksum_array_select)
+        checksum_select_best_impl();
+
+    return current_impl;
+}
+
+static uint32_t __chksum_array_select(uint32_t sum, const uint8_t *buf,
+                                      size_t size)
+{
+    checksum_select_best_impl();
+
+    return __chksum_array(sum, buf, size);
+}
+
 void checksum_feed(checksum_context_t *ctx, const void *buffer, size_t size)
 {
     const uint8_t *byte_buf = buffer;
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "common/include/exa_histogram.h"
+
+#include "os/include/os_atomic.h"
+#include "os/include/os_thread.h"
+
+#include <string.h>
+
+/* Values below EXA_HISTOGRAM_SUB_BUCKETS have a bucket each. Above, the
+ * bucket is given by the position of the highest bit set (the power of two)
+ * and the EXA_HISTOGRAM_SUB_BITS bits that follow it. */
+static unsigned int bucket_of(uint64_t value)
+{
+    unsigned int bit;
+
+    if (value > EXA_HISTOGRAM_MAX_VALUE)
+        value = EXA_HISTOGRAM_MAX_VALUE;
+
+    if (value < EXA_HISTOGRAM_SUB_BUCKETS)
+        return (unsigned int)value;
+
+    bit = 63 - __builtin_clzll(value);
+
+    return (bit - EXA_HISTOGRAM_SUB_BITS + 1) * EXA_HISTOGRAM_SUB_BUCKETS
+           + ((value >> (bit - EXA_HISTOGRAM_SUB_BITS))
+              & (EXA_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* Largest value counted in a bucket */
+static uint64_t bucket_max(unsigned int bucket)
+{
+    unsigned int shift;
+    uint64_t low;
+
+    if (bucket < EXA_HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+
+    shift = bucket / EXA_HISTOGRAM_SUB_BUCKETS - 1;
+    low = (uint64_t)(EXA_HISTOGRAM_SUB_BUCKETS
+                     + bucket % EXA_HISTOGRAM_SUB_BUCKETS) << shift;
+
+    return low + (1ULL << shift) - 1;
+}
+
+void exa_histogram_reset(exa_histogram_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void exa_histogram_add(exa_histogram_t *hist, uint64_t value)
+{
+    unsigned int shard = os_thread_current_cpu() % EXA_HISTOGRAM_NB_SHARDS;
+
+    /* Threads on other CPUs may share the shard, or this thread may have
+     * moved to another CPU: the increment must be atomic, but the counter
+     * is seldom in the cache of another CPU. */
+    os_atomic_add64(&hist->shard[shard].count[bucket_of(value)], 1);
+}
+
+void exa_histogram_snapshot(const exa_histogram_t *hist,
+                            exa_histogram_snapshot_t *snap)
+{
+    unsigned int s, b;
+
+    memset(snap, 0, sizeof(*snap));
+
+    for (s = 0; s < EXA_HISTOGRAM_NB_SHARDS; s++)
+        for (b = 0; b < EXA_HISTOGRAM_NB_BUCKETS; b++)
+        {
+            uint64_t count = ((volatile uint64_t *)hist->shard[s].count)[b];
+
+            snap->count[b] += count;
+            snap->total += count;
+        }
+}
+
+uint64_t exa_histogram_percentile(const exa_histogram_snapshot_t *snap,
+                                  double percent)
+{
+    uint64_t rank, seen = 0;
+    unsigned int b;
+
+    if (snap->total == 0)
+        return 0;
+
+    /* Rank of the value, starting at 1 */
+    rank = (uint64_t)(snap->total * percent / 100);
+    if (rank == 0)
+        rank = 1;
+    if (rank > snap->total)
+        rank = snap->total;
+
+    for (b = 0; b < EXA_HISTOGRAM_NB_BUCKETS; b++)
+    {
+        seen += snap->count[b];
+        if (seen >= rank)
+            return bucket_max(b);
+    }
+
+    return EXA_HISTOGRAM_MAX_VALUE;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "common/include/exa_interval_tree.h"
+
+#include "common/include/exa_assert.h"
+
+#include <stdlib.h>
+
+static int node_height(const exa_interval_node_t *node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+/* Recompute the height and max end of a node from its children */
+static void node_update(exa_interval_node_t *node)
+{
+    int hl = node_height(node->left);
+    int hr = node_height(node->right);
+
+    node->height = (hl > hr ? hl : hr) + 1;
+
+    node->max_end = node->end;
+    if (node->left != NULL && node->left->max_end > node->max_end)
+        node->max_end = node->left->max_end;
+    if (node->right != NULL && node->right->max_end > node->max_end)
+        node->max_end = node->right->max_end;
+}
+
+/* Order of the nodes in the tree: by start, then by end. Equal intervals
+ * are ordered by address so that each node has a distinct position. */
+static int node_cmp(const exa_interval_node_t *a, const exa_interval_node_t *b)
+{
+    if (a->start != b->start)
+        return a->start < b->start ? -1 : 1;
+    if (a->end != b->end)
+        return a->end < b->end ? -1 : 1;
+    if (a != b)
+        return a < b ? -1 : 1;
+    return 0;
+}
+
+static exa_interval_node_t *rotate_right(exa_interval_node_t *node)
+{
+    exa_interval_node_t *left = node->left;
+
+    node->left = left->right;
+    left->right = node;
+
+    node_update(node);
+    node_update(left);
+
+    return left;
+}
+
+static exa_interval_node_t *rotate_left(exa_interval_node_t *node)
+{
+    exa_interval_node_t *right = node->right;
+
+    node->right = right->left;
+    right->left = node;
+
+    node_update(node);
+    node_update(right);
+
+    return right;
+}
+
+/* Restore the balance of a subtree whose children are balanced and differ
+ * in height by 2 at most. Returns the new root of the subtree. */
+static exa_interval_node_t *rebalance(exa_interval_node_t *node)
+{
+    int balance;
+
+    node_update(node);
+    balance = node_height(node->left) - node_height(node->right);
+
+    if (balance > 1)
+    {
+        if (node_height(node->left->left) < node_height(node->left->right))
+            node->left = rotate_left(node->left);
+        return rotate_right(node);
+    }
+
+    if (balance < -1)
+    {
+        if (node_height(node->right->right) < node_height(node->right->left))
+            node->right = rotate_right(node->right);
+        return rotate_left(node);
+    }
+
+    return node;
+}
+
+static exa_interval_node_t *subtree_insert(exa_interval_node_t *root,
+                                           exa_interval_node_t *node)
+{
+    if (root == NULL)
+        return node;
+
+    if (node_cmp(node, root) < 0)
+        root->left = subtree_insert(root->left, node);
+    else
+        root->right = subtree_insert(root->right, node);
+
+    return rebalance(root);
+}
+
+/* Remove the leftmost node of a subtree, which is returned in *min */
+static exa_interval_node_t *subtree_remove_min(exa_interval_node_t *root,
+                                               exa_interval_node_t **min)
+{
+    if (root->left == NULL)
+    {
+        *min = root;
+        return root->right;
+    }
+
+    root->left = subtree_remove_min(root->left, min);
+
+    return rebalance(root);
+}
+
+static exa_interval_node_t *subtree_remove(exa_interval_node_t *root,
+                                           exa_interval_node_t *node)
+{
+    exa_interval_node_t *min, *right;
+    int cmp;
+
+    EXA_ASSERT_VERBOSE(root != NULL, "interval [%"PRIu64", %"PRIu64"[ not in tree",
+                       node->start, node->end);
+
+    cmp = node_cmp(node, root);
+    if (cmp < 0)
+        root->left = subtree_remove(root->left, node);
+    else if (cmp > 0)
+        root->right = subtree_remove(root->right, node);
+    else
+    {
+        if (root->left == NULL)
+            return root->right;
+        if (root->right == NULL)
+            return root->left;
+
+        /* Replace the node by its successor */
+        right = subtree_remove_min(root->right, &min);
+        min->left = root->left;
+        min->right = right;
+        root = min;
+    }
+
+    return rebalance(root);
+}
+
+void exa_interval_tree_init(exa_interval_tree_t *tree)
+{
+    tree->root = NULL;
+    tree->count = 0;
+}
+
+void exa_interval_tree_insert(exa_interval_tree_t *tree,
+                              exa_interval_node_t *node,
+                              uint64_t start, uint64_t size)
+{
+    EXA_ASSERT(size > 0);
+
+    node->start = start;
+    node->end = start + size;
+    node->left = NULL;
+    node->right = NULL;
+    node_update(node);
+
+    tree->root = subtree_insert(tree->root, node);
+    tree->count++;
+}
+
+void exa_interval_tree_remove(exa_interval_tree_t *tree,
+                              exa_interval_node_t *node)
+{
+    tree->root = subtree_remove(tree->root, node);
+    tree->count--;
+
+    node->left = NULL;
+    node->right = NULL;
+}
+
+exa_interval_node_t *exa_interval_tree_find(const exa_interval_tree_t *tree,
+                                            uint64_t start, uint64_t size)
+{
+    exa_interval_node_t *node = tree->root;
+    uint64_t end = start + size;
+
+    while (node != NULL)
+    {
+        if (start == node->start && end == node->end)
+            return node;
+
+        if (start < node->start || (start == node->start && end < node->end))
+            node = node->left;
+        else
+            node = node->right;
+    }
+
+    return NULL;
+}
+
+exa_interval_node_t *exa_interval_tree_overlap(const exa_interval_tree_t *tree,
+                                               uint64_t start, uint64_t size)
+{
+    exa_interval_node_t *node = tree->root;
+    uint64_t end = start + size;
+
+    if (size == 0)
+        return NULL;
+
+    while (node != NULL)
+    {
+        if (node->start < end && start < node->end)
+            return node;
+
+        /* If an interval of the left subtree ends after start, either it
+         * overlaps, or it starts after end and so do all the intervals of
+         * the right subtree: there is no need to look there. */
+        if (node->left != NULL && node->left->max_end > start)
+            node = node->left;
+        else
+            node = node->right;
+    }
+
+    return NULL;
+}
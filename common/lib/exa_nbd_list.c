@@ -12,14 +12,51 @@
 
 #include "log/include/log.h"
 
+#include "os/include/os_eventfd.h"
 #include "os/include/os_error.h"
 #include "os/include/os_stdio.h"
 #include "os/include/os_mem.h"
 #include "os/include/os_thread.h"
 
+/**
+ * Move the elements posted on a MPSC list since the last call at the end of
+ * the elements seen by the consumer. Only called by the consumer.
+ *
+ * @param list  MPSC list
+ */
+static void nbd_mpsc_take_incoming(struct nbd_list *list)
+{
+    int *next = list->root->next;
+    int index = os_atomic_xchg(&list->incoming, NO_MORE_ELT);
+    int first = NO_MORE_ELT;
+    int last = index;
+
+    /* The incoming elements are chained from the last posted one: reverse
+     * the chain to get them in the order they were posted */
+    while (index != NO_MORE_ELT)
+    {
+        int prev = next[index];
+
+        next[index] = first;
+        first = index;
+        index = prev;
+    }
+
+    if (first == NO_MORE_ELT)
+        return;
+
+    if (list->first_elt == NO_MORE_ELT)
+        list->first_elt = first;
+    else
+        next[list->last_elt] = first;
+    list->last_elt = last;
+}
+
+
 /**
  * Helper function used to remove a element from a list. This function assumes
- * that the caller has the lock of the List.
+ * that the caller has the lock of the List, or is the consumer of a MPSC
+ * list.
  *
  * @param[in]     list the list
  * @param[in:out] Index the index of the element found (ignored if NULL)
@@ -34,6 +71,9 @@ static void *nbd_list_remove_no_lock(struct nbd_list *list, int *index)
     if (list->must_die == LIST_DEAD)
         return NULL;
 
+    if (list->mpsc && list->first_elt == NO_MORE_ELT)
+        nbd_mpsc_take_incoming(list);
+
     if (list->first_elt == NO_MORE_ELT)
         return NULL;
 
@@ -62,6 +102,29 @@ static void *nbd_list_remove_no_lock(struct nbd_list *list, int *index)
 }
 
 
+/**
+ * Remove an element from the free list of a root list whose free elements
+ * are in a cache (see nbd_root_cache_free()).
+ */
+static void *nbd_free_cache_remove(struct nbd_root_list *root, int *index,
+                                   bool wait)
+{
+    int idx = exa_pool_get(root->free_cache, wait);
+
+    if (idx < 0)
+        return NULL;
+
+    EXA_ASSERT(root->next[idx] == NO_MORE_ELT);
+    root->tag[idx] = NO_MORE_ELT;
+    root->next[idx] = NOT_IN_LIST;
+
+    if (index != NULL)
+        *index = idx;
+
+    return (char *)root->payload + idx * root->elt_size;
+}
+
+
 /**
  * Get a element from a List Not
  *
@@ -87,15 +150,21 @@ void *__nbd_list_remove(struct nbd_list *list, int *index, int wait,
     if (index != NULL)
         *index = -1;
 
+    if (list == &list->root->free && list->root->free_cache != NULL)
+        return nbd_free_cache_remove(list->root, index, wait == LISTWAIT);
+
     do {
         struct nbd_list *lists_in[1];
         bool lists_out[1];
 
-        os_thread_mutex_lock(&list->lock);
-
-        payload = nbd_list_remove_no_lock(list, index);
-
-        os_thread_mutex_unlock(&list->lock);
+        if (list->mpsc)
+            payload = nbd_list_remove_no_lock(list, index);
+        else
+        {
+            os_thread_mutex_lock(&list->lock);
+            payload = nbd_list_remove_no_lock(list, index);
+            os_thread_mutex_unlock(&list->lock);
+        }
 
         if (wait != LISTWAIT || payload != NULL)
             break;
@@ -129,7 +198,10 @@ static bool nbd_list_is_empty(const struct nbd_list *list)
 
     /* If first and next_first are NO_MORE_ELT, the list is empty (no element
      * and no pending element) */
-    return list->first_elt == NO_MORE_ELT;
+    if (list->first_elt != NO_MORE_ELT)
+        return false;
+
+    return !list->mpsc || os_atomic_read(&list->incoming) == NO_MORE_ELT;
 }
 
 
@@ -151,7 +223,9 @@ static bool nbd_list_is_empty(const struct nbd_list *list)
  *                                                   ms_timeout milliseconds
  *                          0                      : Don't wait, just give the
  *                                                   no empty list.
- * @return number of non empty lists in given lists
+ * @return number of non empty lists in given lists. It may be 0 before the
+ *         timeout when MPSC lists are given, as a wake up meant for an
+ *         earlier call can be received.
  */
 int nbd_list_select(struct nbd_list **lists, bool *lists_found,
                     unsigned int nb_list, unsigned ms_timeout)
@@ -163,6 +237,10 @@ int nbd_list_select(struct nbd_list **lists, bool *lists_found,
     EXA_ASSERT(lists != NULL);
     EXA_ASSERT(lists_found != NULL);
 
+    for (i = 0; i < nb_list; i++)
+        EXA_ASSERT(lists[i] != &lists[i]->root->free
+                   || lists[i]->root->free_cache == NULL);
+
     for (i = 0; i < nb_list; i++)
         os_thread_mutex_lock(&lists[i]->lock);
 
@@ -176,7 +254,8 @@ int nbd_list_select(struct nbd_list **lists, bool *lists_found,
 
     if (count == 0 && wait)
     {
-        int err;
+        bool posted = false;
+        int err = 0;
 
         /* All lists are empty, so register to wait on list[0] */
         for (i = 0; i < nb_list; i++)
@@ -187,17 +266,37 @@ int nbd_list_select(struct nbd_list **lists, bool *lists_found,
             lists[0]->waiters++;
         }
 
+        /* Producers of MPSC lists do not take the lock: they see the
+         * registration, or it is done before their post and the list is
+         * seen not empty anymore */
+        for (i = 0; i < nb_list; i++)
+            if (lists[i]->mpsc)
+            {
+                void *prev = os_atomic_ptr_xchg(
+                        (void * volatile *)&lists[i]->mpsc_waiter, lists[0]);
+                EXA_ASSERT(prev == NULL);
+                if (!nbd_list_is_empty(lists[i]))
+                    posted = true;
+            }
+
         /* wait if needed */
         for (i = 0; i < nb_list; i++)
             os_thread_mutex_unlock(&lists[i]->lock);
 
-        if (ms_timeout == NBD_LIST_INFINITE)
+        if (posted)
+            err = 0;
+        else if (ms_timeout == NBD_LIST_INFINITE)
             err = os_sem_wait(&lists[0]->select_sem);
         else
             err = os_sem_waittimeout(&lists[0]->select_sem, ms_timeout);
 
         EXA_ASSERT(err == 0 || err == -EINTR || err == -ETIMEDOUT);
 
+        for (i = 0; i < nb_list; i++)
+            if (lists[i]->mpsc)
+                os_atomic_ptr_xchg((void * volatile *)&lists[i]->mpsc_waiter,
+                                   NULL);
+
         for (i = 0; i < nb_list; i++)
             os_thread_mutex_lock(&lists[i]->lock);
 
@@ -225,6 +324,50 @@ int nbd_list_select(struct nbd_list **lists, bool *lists_found,
 }
 
 
+/**
+ * Add an element on a MPSC list, without taking its lock.
+ *
+ * @param list   MPSC list
+ * @param index  index of the element to add
+ */
+static void nbd_mpsc_post(struct nbd_list *list, int index)
+{
+    struct nbd_root_list *root = list->root;
+    int head;
+
+    EXA_ASSERT(index >= 0 && index < root->nb_elt);
+    EXA_ASSERT(root->next[index] == NOT_IN_LIST);
+    root->tag[index] = -1;
+
+    if (list->must_die != LIST_ALIVE)
+    {
+        nbd_list_post(&root->free, NULL, index);
+        return;
+    }
+
+    do {
+        head = os_atomic_read(&list->incoming);
+        root->next[index] = head;
+    } while (os_atomic_cmpxchg(&list->incoming, head, index) != head);
+
+    /* The consumer cannot be waiting if there were elements it did not see */
+    if (head != NO_MORE_ELT)
+        return;
+
+    if (list->mpsc_waiter != NULL)
+    {
+        struct nbd_list *waiter =
+            os_atomic_ptr_xchg((void * volatile *)&list->mpsc_waiter, NULL);
+
+        if (waiter != NULL)
+            os_sem_post(&waiter->select_sem);
+    }
+
+    if (list->notify_fd >= 0)
+        os_eventfd_signal(list->notify_fd);
+}
+
+
 /**
  * Add an element on a list Note that nbd_list_post() only use
  * os_sem_post() and it's not a cancelation point so there are no need
@@ -237,12 +380,30 @@ int nbd_list_select(struct nbd_list **lists, bool *lists_found,
  */
 void nbd_list_post(struct nbd_list *list, void *payload, int index)
 {
-    os_thread_mutex_lock(&list->lock);
     if (payload != NULL)
         index =
             ((unsigned long) payload -
              (unsigned long) list->root->payload) / list->root->elt_size;
 
+    if (list == &list->root->free && list->root->free_cache != NULL)
+    {
+        EXA_ASSERT(index >= 0 && index < list->root->nb_elt);
+        EXA_ASSERT(list->root->next[index] == NOT_IN_LIST);
+        list->root->tag[index] = -1;
+        list->root->next[index] = NO_MORE_ELT;
+
+        exa_pool_put(list->root->free_cache, index);
+        return;
+    }
+
+    if (list->mpsc)
+    {
+        nbd_mpsc_post(list, index);
+        return;
+    }
+
+    os_thread_mutex_lock(&list->lock);
+
     EXA_ASSERT(index >= 0 && index < list->root->nb_elt);
     EXA_ASSERT(list->root->next[index] == NOT_IN_LIST);
     list->root->tag[index] = -1;
@@ -276,6 +437,9 @@ void nbd_list_post(struct nbd_list *list, void *payload, int index)
             for (i = list->select_list->waiters; i > 0; i--)
                 os_sem_post(&list->select_list->select_sem);
         }
+
+        if (list->notify_fd >= 0)
+            os_eventfd_signal(list->notify_fd);
     }
     else
     {
@@ -294,6 +458,47 @@ void nbd_list_post(struct nbd_list *list, void *payload, int index)
 }
 
 
+/**
+ * Have an event file descriptor signalled when an element is posted on a
+ * list that was empty, so that the list can be waited on along with other
+ * events. The reader must empty the list (or check it is empty) after
+ * resetting the event file descriptor and before waiting on it.
+ *
+ * @param list  list
+ * @param fd    event file descriptor (see os_eventfd.h), -1 to stop
+ *              signalling
+ */
+void nbd_list_set_notify_fd(struct nbd_list *list, int fd)
+{
+    os_thread_mutex_lock(&list->lock);
+    list->notify_fd = fd;
+    os_thread_mutex_unlock(&list->lock);
+}
+
+
+/**
+ * Make a list lock-free, provided a single thread removes elements from it
+ * (multiple producers, single consumer). Posting is a compare and exchange
+ * on the last posted element, and the consumer takes all the posted
+ * elements at once when it runs out of elements.
+ *
+ * Only the consumer may remove elements from the list or select it, and the
+ * list must be closed once its producers stopped posting on it.
+ *
+ * Must be called right after nbd_init_list(), on a list other than the free
+ * list.
+ *
+ * @param list  list
+ */
+void nbd_list_set_mpsc(struct nbd_list *list)
+{
+    EXA_ASSERT(list != &list->root->free);
+    EXA_ASSERT(list->first_elt == NO_MORE_ELT);
+
+    list->mpsc = true;
+}
+
+
 /**
  * Close a list
  *
@@ -329,6 +534,9 @@ void nbd_close_list(struct nbd_list *list)
 
     os_thread_mutex_unlock(&list->lock);
 
+    if (list->mpsc)
+        nbd_mpsc_take_incoming(list);
+
     /* We will get back all elt to the free list so because nbd_list_post() to
      * this list was forbiden, this list will be empty we cannot use
      * nbd_list_remove() because we forbid all nbd_list_remove() in previous
@@ -379,6 +587,10 @@ int __nbd_init_list(struct nbd_root_list *root_list, struct nbd_list *list,
     os_sem_init(&list->select_sem, 0);
     list->select_list = NULL;
     list->waiters = 0;
+    list->notify_fd = -1;
+    list->mpsc = false;
+    os_atomic_set(&list->incoming, NO_MORE_ELT);
+    list->mpsc_waiter = NULL;
 
     list->root = root_list;
     list->first_elt = NO_MORE_ELT;
@@ -413,10 +625,54 @@ void nbd_close_root(struct nbd_root_list *root_list)
     /* close the free list  */
     root_list->free.must_die = LIST_DEAD;
 
+    exa_pool_delete(root_list->free_cache);
+    root_list->free_cache = NULL;
+
     os_aligned_free(root_list->payload);
 }
 
 
+/**
+ * Keep the free elements of a root list in a cache with per-thread
+ * magazines (see exa_pool.h) rather than in the free list, so that
+ * threads removing and posting elements on the free list do not contend on
+ * its lock. Selecting on the free list is not possible anymore.
+ *
+ * Must be called right after nbd_init_root(), while all the elements are
+ * free.
+ *
+ * @param root_list  root list
+ *
+ * @return 0 if ok, -1 if out of memory
+ */
+int nbd_root_cache_free(struct nbd_root_list *root_list)
+{
+    int i;
+
+    EXA_ASSERT(root_list->free_cache == NULL);
+
+    root_list->free_cache = exa_pool_create(root_list->nb_elt);
+    if (root_list->free_cache == NULL)
+        return -1;
+
+    /* The pool is created with all its elements free: just empty the
+     * free list */
+    for (i = 0; i < root_list->nb_elt; i++)
+    {
+        void *elt = nbd_list_remove_no_lock(&root_list->free, NULL);
+        EXA_ASSERT(elt != NULL);
+    }
+
+    for (i = 0; i < root_list->nb_elt; i++)
+    {
+        root_list->tag[i] = -1;
+        root_list->next[i] = NO_MORE_ELT;
+    }
+
+    return 0;
+}
+
+
 /**
  * Create a root list, (m)allocate elements on this root list and
  * create the first list : root_list->free the list of free
@@ -444,6 +700,7 @@ int __nbd_init_root(int nb_elt, int elt_size, struct nbd_root_list *root_list,
 
     root_list->elt_size = elt_size;
     root_list->nb_elt   = nb_elt;
+    root_list->free_cache = NULL;
 
     if (root_list->payload == NULL)
         return -1;
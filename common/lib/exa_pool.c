@@ -0,0 +1,288 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "common/include/exa_pool.h"
+
+#include "common/include/exa_assert.h"
+
+#include "os/include/os_atomic.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_semaphore.h"
+#include "os/include/os_thread.h"
+
+/** Number of magazines of a pool */
+#define EXA_POOL_NB_MAGAZINES       32
+
+/** Maximum number of objects in a magazine */
+#define EXA_POOL_MAX_MAGAZINE_SIZE  32
+
+/** Magazines are aligned on cache lines so that threads do not share them */
+#define EXA_POOL_CACHE_LINE         64
+
+typedef struct
+{
+    os_thread_mutex_t lock;
+    unsigned int count;                        /**< Number of objects */
+    int objs[EXA_POOL_MAX_MAGAZINE_SIZE];      /**< Indexes of the objects */
+} magazine_t;
+
+/* The depot is a stack of objects linked through next[]. Its head holds the
+ * index of the first object in the low 32 bits, and a tag incremented on
+ * each change in the high 32 bits so that a head popped and pushed back
+ * between the read and the compare and exchange is noticed (ABA problem). */
+#define DEPOT_EMPTY            0xFFFFFFFFU
+#define DEPOT_INDEX(head)      ((uint32_t)((head) & 0xFFFFFFFFU))
+#define DEPOT_TAG(head)        ((uint32_t)((head) >> 32))
+#define DEPOT_HEAD(tag, index) (((uint64_t)(tag) << 32) | (uint32_t)(index))
+
+struct exa_pool
+{
+    volatile uint64_t depot;      /**< Head of the depot */
+    int *next;                    /**< Next object in the depot, or -1 */
+    unsigned int nb_objs;         /**< Number of objects in the pool */
+    unsigned int magazine_size;   /**< Objects per magazine, 0 if not used */
+    size_t magazine_stride;       /**< Bytes between two magazines */
+    char *magazines;
+    os_atomic_t waiters;          /**< Number of threads waiting for objects */
+    os_sem_t sem;                 /**< Posted when an object is put back
+                                       while there are waiters */
+};
+
+static __thread char thread_marker;
+
+static magazine_t *pool_magazine(const exa_pool_t *pool, unsigned int i)
+{
+    return (magazine_t *)(pool->magazines + i * pool->magazine_stride);
+}
+
+/* Magazine of the calling thread: threads are spread according to the
+ * address of their thread-local storage */
+static unsigned int thread_magazine(void)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)&thread_marker * 0x9E3779B97F4A7C15ULL;
+
+    return (unsigned int)(hash >> 32) % EXA_POOL_NB_MAGAZINES;
+}
+
+/* Push a chain of objects, already linked from first to last, on the depot */
+static void depot_push(exa_pool_t *pool, int first, int last)
+{
+    uint64_t head, new_head;
+
+    do
+    {
+        head = pool->depot;
+        pool->next[last] = DEPOT_INDEX(head) == DEPOT_EMPTY ? -1
+                                                            : (int)DEPOT_INDEX(head);
+        new_head = DEPOT_HEAD(DEPOT_TAG(head) + 1, first);
+    } while (os_atomic_cmpxchg64(&pool->depot, head, new_head) != head);
+}
+
+/* Pop at most max objects from the depot. Returns the number of objects. */
+static unsigned int depot_pop(exa_pool_t *pool, int *objs, unsigned int max)
+{
+    uint64_t head, new_head;
+    unsigned int n;
+
+    do
+    {
+        int cur;
+
+        head = pool->depot;
+        if (DEPOT_INDEX(head) == DEPOT_EMPTY)
+            return 0;
+
+        /* The links may be changed by other threads meanwhile, in which
+         * case the tag has changed too and the exchange fails */
+        cur = DEPOT_INDEX(head);
+        for (n = 0; n < max && cur >= 0 && cur < pool->nb_objs; n++)
+        {
+            objs[n] = cur;
+            cur = ((volatile int *)pool->next)[cur];
+        }
+
+        new_head = DEPOT_HEAD(DEPOT_TAG(head) + 1,
+                              cur < 0 ? DEPOT_EMPTY : (uint32_t)cur);
+    } while (os_atomic_cmpxchg64(&pool->depot, head, new_head) != head);
+
+    return n;
+}
+
+exa_pool_t *exa_pool_create(unsigned int nb_objs)
+{
+    exa_pool_t *pool;
+    unsigned int i;
+
+    EXA_ASSERT(nb_objs > 0 && nb_objs < DEPOT_EMPTY);
+
+    pool = os_malloc(sizeof(exa_pool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pool->next = os_malloc(nb_objs * sizeof(*pool->next));
+    if (pool->next == NULL)
+    {
+        os_free(pool);
+        return NULL;
+    }
+
+    pool->magazine_stride = (sizeof(magazine_t) + EXA_POOL_CACHE_LINE - 1)
+                            / EXA_POOL_CACHE_LINE * EXA_POOL_CACHE_LINE;
+    pool->magazines = os_aligned_malloc(EXA_POOL_NB_MAGAZINES * pool->magazine_stride,
+                                        EXA_POOL_CACHE_LINE, NULL);
+    if (pool->magazines == NULL)
+    {
+        os_free(pool->next);
+        os_free(pool);
+        return NULL;
+    }
+
+    /* Keep at most a quarter of the objects in the magazines, so that the
+     * depot seldom runs out of objects while there are some left */
+    pool->magazine_size = nb_objs / (4 * EXA_POOL_NB_MAGAZINES);
+    if (pool->magazine_size > EXA_POOL_MAX_MAGAZINE_SIZE)
+        pool->magazine_size = EXA_POOL_MAX_MAGAZINE_SIZE;
+
+    pool->nb_objs = nb_objs;
+
+    for (i = 0; i < EXA_POOL_NB_MAGAZINES; i++)
+    {
+        magazine_t *mag = pool_magazine(pool, i);
+
+        os_thread_mutex_init(&mag->lock);
+        mag->count = 0;
+    }
+
+    for (i = 0; i < nb_objs; i++)
+        pool->next[i] = i + 1 < nb_objs ? (int)i + 1 : -1;
+    pool->depot = DEPOT_HEAD(0, 0);
+
+    os_atomic_set(&pool->waiters, 0);
+    os_sem_init(&pool->sem, 0);
+
+    return pool;
+}
+
+void exa_pool_delete(exa_pool_t *pool)
+{
+    unsigned int i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < EXA_POOL_NB_MAGAZINES; i++)
+        os_thread_mutex_destroy(&pool_magazine(pool, i)->lock);
+
+    os_sem_destroy(&pool->sem);
+    os_aligned_free(pool->magazines);
+    os_free(pool->next);
+    os_free(pool);
+}
+
+/* Take an object from the magazine of another thread */
+static int pool_steal(exa_pool_t *pool, unsigned int own)
+{
+    unsigned int i;
+    int index = -1;
+
+    for (i = 1; i < EXA_POOL_NB_MAGAZINES && index < 0; i++)
+    {
+        magazine_t *mag = pool_magazine(pool, (own + i) % EXA_POOL_NB_MAGAZINES);
+
+        os_thread_mutex_lock(&mag->lock);
+        if (mag->count > 0)
+            index = mag->objs[--mag->count];
+        os_thread_mutex_unlock(&mag->lock);
+    }
+
+    return index;
+}
+
+static int pool_try_get(exa_pool_t *pool)
+{
+    unsigned int own;
+    magazine_t *mag;
+    int index = -1;
+
+    if (pool->magazine_size == 0)
+        return depot_pop(pool, &index, 1) == 1 ? index : -1;
+
+    own = thread_magazine();
+    mag = pool_magazine(pool, own);
+
+    os_thread_mutex_lock(&mag->lock);
+    if (mag->count == 0)
+        mag->count = depot_pop(pool, mag->objs, (pool->magazine_size + 1) / 2);
+    if (mag->count > 0)
+        index = mag->objs[--mag->count];
+    os_thread_mutex_unlock(&mag->lock);
+
+    if (index < 0)
+        index = pool_steal(pool, own);
+
+    return index;
+}
+
+int exa_pool_get(exa_pool_t *pool, bool wait)
+{
+    int index = pool_try_get(pool);
+
+    if (index >= 0 || !wait)
+        return index;
+
+    /* A thread putting an object back after we are registered as waiter
+     * puts it in the depot and posts the semaphore; one that put it in a
+     * magazine before is seen when looking into the magazines. */
+    os_atomic_inc(&pool->waiters);
+    while ((index = pool_try_get(pool)) < 0)
+        os_sem_wait(&pool->sem);
+    os_atomic_dec(&pool->waiters);
+
+    return index;
+}
+
+void exa_pool_put(exa_pool_t *pool, int index)
+{
+    EXA_ASSERT(index >= 0 && index < pool->nb_objs);
+
+    if (pool->magazine_size > 0)
+    {
+        magazine_t *mag = pool_magazine(pool, thread_magazine());
+        bool cached = false;
+
+        os_thread_mutex_lock(&mag->lock);
+        if (os_atomic_read(&pool->waiters) == 0)
+        {
+            /* Flush the older half of a full magazine to the depot */
+            if (mag->count == pool->magazine_size)
+            {
+                unsigned int half = (pool->magazine_size + 1) / 2;
+                unsigned int i;
+
+                for (i = 0; i + 1 < half; i++)
+                    pool->next[mag->objs[i]] = mag->objs[i + 1];
+                depot_push(pool, mag->objs[0], mag->objs[half - 1]);
+
+                for (i = half; i < mag->count; i++)
+                    mag->objs[i - half] = mag->objs[i];
+                mag->count -= half;
+            }
+            mag->objs[mag->count++] = index;
+            cached = true;
+        }
+        os_thread_mutex_unlock(&mag->lock);
+
+        if (cached)
+            return;
+    }
+
+    depot_push(pool, index, index);
+
+    if (os_atomic_read(&pool->waiters) > 0)
+        os_sem_post(&pool->sem);
+}
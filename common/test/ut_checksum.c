@@ -7,7 +7,12 @@
  */
 #include <unit_testing.h>
 #include "common/include/checksum.h"
+#include "os/include/os_mem.h"
 #include "os/include/os_random.h"
+#include "os/include/os_time.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 UT_SECTION(checksum)
 
@@ -243,3 +248,131 @@ ut_test(checksum_multiple_steps_is_equivalent_to_single_step)
 
     UT_ASSERT_EQUAL(size1, size2);
 }
+
+UT_SECTION(checksum_implementations)
+
+#define IMPL_BUF_SIZE  (1024 * 1024)
+
+static uint8_t *impl_buf;
+static checksum_impl_t default_impl;
+
+ut_setup()
+{
+    os_random_init();
+
+    default_impl = checksum_get_impl();
+
+    impl_buf = os_malloc(IMPL_BUF_SIZE);
+    UT_ASSERT(impl_buf != NULL);
+    os_get_random_bytes(impl_buf, IMPL_BUF_SIZE);
+}
+
+ut_cleanup()
+{
+    os_free(impl_buf);
+    checksum_select_impl(default_impl);
+    os_random_cleanup();
+}
+
+/* Checksum of the given pieces of impl_buf, fed one after the other */
+static checksum_t checksum_pieces(checksum_impl_t impl, size_t offset,
+                                  const size_t *sizes, int nb_sizes)
+{
+    checksum_context_t ctx;
+    int i;
+
+    UT_ASSERT(checksum_select_impl(impl));
+
+    checksum_reset(&ctx);
+    for (i = 0; i < nb_sizes; i++)
+    {
+        checksum_feed(&ctx, impl_buf + offset, sizes[i]);
+        offset += sizes[i];
+    }
+
+    return checksum_get_value(&ctx);
+}
+
+ut_test(default_impl_is_supported)
+{
+    UT_ASSERT(checksum_impl_supported(CHECKSUM_IMPL_SCALAR));
+    UT_ASSERT(checksum_impl_supported(checksum_get_impl()));
+}
+
+ut_test(all_impls_compute_the_same_checksums)
+{
+    checksum_impl_t impl;
+    int round;
+
+    for (round = 0; round < 2000; round++)
+    {
+        /* Random alignment and sizes, odd ones included, so that bytes
+         * get latched between pieces */
+        size_t sizes[3] = { rand() % 300, rand() % 5000, rand() % 70 };
+        size_t offset = rand() % 64;
+        checksum_t ref = checksum_pieces(CHECKSUM_IMPL_SCALAR, offset, sizes, 3);
+
+        for (impl = CHECKSUM_IMPL__FIRST; impl <= CHECKSUM_IMPL__LAST; impl++)
+        {
+            checksum_t c;
+
+            if (!checksum_impl_supported(impl))
+                continue;
+
+            c = checksum_pieces(impl, offset, sizes, 3);
+            UT_ASSERT_EQUAL(ref, c);
+        }
+    }
+}
+
+ut_test(all_impls_wrap_around_the_same_way)
+{
+    /* 1 MB of 0xFF bytes sums up to more than 2^32 */
+    size_t sizes[1] = { IMPL_BUF_SIZE - 1 };
+    checksum_impl_t impl;
+    checksum_t ref;
+
+    memset(impl_buf, 0xFF, IMPL_BUF_SIZE);
+    ref = checksum_pieces(CHECKSUM_IMPL_SCALAR, 1, sizes, 1);
+
+    for (impl = CHECKSUM_IMPL__FIRST; impl <= CHECKSUM_IMPL__LAST; impl++)
+    {
+        checksum_t c;
+
+        if (!checksum_impl_supported(impl))
+            continue;
+
+        c = checksum_pieces(impl, 1, sizes, 1);
+        UT_ASSERT_EQUAL(ref, c);
+    }
+}
+
+ut_test(benchmark_impls)
+{
+    static const char *names[] = { "scalar", "sse2", "avx2" };
+    checksum_impl_t impl;
+
+    for (impl = CHECKSUM_IMPL__FIRST; impl <= CHECKSUM_IMPL__LAST; impl++)
+    {
+        uint64_t begin, elapsed;
+        volatile checksum_t c;
+        int i;
+
+        if (!checksum_impl_supported(impl))
+        {
+            ut_printf("%-6s: not supported", names[impl]);
+            continue;
+        }
+
+        UT_ASSERT(checksum_select_impl(impl));
+
+        begin = os_gettimeofday_msec();
+        for (i = 0; i < 256; i++)
+            c = exa_checksum(impl_buf, IMPL_BUF_SIZE);
+        elapsed = os_gettimeofday_msec() - begin;
+
+        ut_printf("%-6s: %"PRIu64" MB/s", names[impl],
+                  elapsed == 0 ? 0 : 256 * 1000 / elapsed);
+        (void)c;
+    }
+}
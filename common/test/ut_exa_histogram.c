@@ -0,0 +1,123 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "common/include/exa_histogram.h"
+
+#include "os/include/os_mem.h"
+#include "os/include/os_thread.h"
+
+#define NB_THREADS  8
+#define NB_VALUES   100000
+
+static exa_histogram_t *hist;
+static exa_histogram_snapshot_t snap;
+
+ut_setup()
+{
+    hist = os_malloc(sizeof(*hist));
+    UT_ASSERT(hist != NULL);
+    exa_histogram_reset(hist);
+}
+
+ut_cleanup()
+{
+    os_free(hist);
+}
+
+ut_test(empty_histogram_has_null_percentiles)
+{
+    exa_histogram_snapshot(hist, &snap);
+
+    UT_ASSERT_EQUAL(0, snap.total);
+    UT_ASSERT_EQUAL(0, exa_histogram_percentile(&snap, 50));
+    UT_ASSERT_EQUAL(0, exa_histogram_percentile(&snap, 99.9));
+}
+
+ut_test(small_values_are_exact)
+{
+    uint64_t value;
+
+    for (value = 0; value < EXA_HISTOGRAM_SUB_BUCKETS; value++)
+    {
+        exa_histogram_reset(hist);
+        exa_histogram_add(hist, value);
+        exa_histogram_snapshot(hist, &snap);
+
+        UT_ASSERT_EQUAL(1, snap.total);
+        UT_ASSERT_EQUAL(value, exa_histogram_percentile(&snap, 50));
+    }
+}
+
+ut_test(large_values_are_known_within_precision)
+{
+    uint64_t value;
+
+    for (value = 1; value <= EXA_HISTOGRAM_MAX_VALUE; value = value * 3 + 1)
+    {
+        uint64_t upper;
+
+        exa_histogram_reset(hist);
+        exa_histogram_add(hist, value);
+        exa_histogram_snapshot(hist, &snap);
+        upper = exa_histogram_percentile(&snap, 50);
+
+        UT_ASSERT(upper >= value);
+        UT_ASSERT(upper - value <= value / EXA_HISTOGRAM_SUB_BUCKETS);
+    }
+}
+
+ut_test(too_large_values_are_clamped)
+{
+    exa_histogram_add(hist, 1ULL << 40);
+    exa_histogram_snapshot(hist, &snap);
+
+    UT_ASSERT_EQUAL(1, snap.total);
+    UT_ASSERT_EQUAL(EXA_HISTOGRAM_MAX_VALUE, exa_histogram_percentile(&snap, 100));
+}
+
+ut_test(percentiles_of_uniform_values)
+{
+    uint64_t value, p50, p99;
+
+    for (value = 1; value <= 1000; value++)
+        exa_histogram_add(hist, value);
+
+    exa_histogram_snapshot(hist, &snap);
+    p50 = exa_histogram_percentile(&snap, 50);
+    p99 = exa_histogram_percentile(&snap, 99);
+
+    UT_ASSERT_EQUAL(1000, snap.total);
+    UT_ASSERT(p50 >= 500 && p50 <= 500 + 500 / EXA_HISTOGRAM_SUB_BUCKETS);
+    UT_ASSERT(p99 >= 990 && p99 <= 990 + 990 / EXA_HISTOGRAM_SUB_BUCKETS);
+    UT_ASSERT(exa_histogram_percentile(&snap, 100) >= 1000);
+}
+
+static void add_values_thread(void *data)
+{
+    int i;
+
+    for (i = 0; i < NB_VALUES; i++)
+        exa_histogram_add(hist, i % 1000);
+}
+
+ut_test(concurrent_adds_are_all_counted)
+{
+    os_thread_t threads[NB_THREADS];
+    int i;
+
+    for (i = 0; i < NB_THREADS; i++)
+        UT_ASSERT(os_thread_create(&threads[i], 0, add_values_thread, NULL));
+    for (i = 0; i < NB_THREADS; i++)
+        os_thread_join(threads[i]);
+
+    exa_histogram_snapshot(hist, &snap);
+
+    UT_ASSERT_EQUAL((uint64_t)NB_THREADS * NB_VALUES, snap.total);
+}
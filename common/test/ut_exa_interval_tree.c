@@ -0,0 +1,157 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "common/include/exa_interval_tree.h"
+
+#include <stdlib.h>
+
+#define NB_NODES  500
+
+static exa_interval_tree_t tree;
+static exa_interval_node_t nodes[NB_NODES];
+static bool in_tree[NB_NODES];
+
+ut_setup()
+{
+    int i;
+
+    exa_interval_tree_init(&tree);
+    for (i = 0; i < NB_NODES; i++)
+        in_tree[i] = false;
+
+    srand(1789);
+}
+
+ut_cleanup()
+{
+}
+
+/* Check the tree is balanced and ordered, and that the max ends are right.
+ * Returns the height of the subtree. */
+static int check_subtree(const exa_interval_node_t *node, uint64_t *max_end)
+{
+    uint64_t max_left = 0, max_right = 0;
+    int hl, hr;
+
+    if (node == NULL)
+        return 0;
+
+    hl = check_subtree(node->left, &max_left);
+    hr = check_subtree(node->right, &max_right);
+
+    UT_ASSERT(hl - hr <= 1 && hr - hl <= 1);
+    UT_ASSERT(node->left == NULL || node->left->start <= node->start);
+    UT_ASSERT(node->right == NULL || node->right->start >= node->start);
+
+    *max_end = node->end;
+    if (max_left > *max_end)
+        *max_end = max_left;
+    if (max_right > *max_end)
+        *max_end = max_right;
+    UT_ASSERT_EQUAL(*max_end, node->max_end);
+
+    return (hl > hr ? hl : hr) + 1;
+}
+
+static void check_tree(void)
+{
+    uint64_t max_end;
+    unsigned int count = 0;
+    int i;
+
+    check_subtree(tree.root, &max_end);
+
+    for (i = 0; i < NB_NODES; i++)
+        if (in_tree[i])
+            count++;
+    UT_ASSERT_EQUAL(count, tree.count);
+}
+
+static bool brute_force_overlap(uint64_t start, uint64_t size)
+{
+    int i;
+
+    for (i = 0; i < NB_NODES; i++)
+        if (in_tree[i] && nodes[i].start < start + size
+            && start < nodes[i].end)
+            return true;
+
+    return false;
+}
+
+ut_test(empty_tree_has_no_overlap)
+{
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 0, 1000) == NULL);
+    UT_ASSERT(exa_interval_tree_find(&tree, 0, 1000) == NULL);
+}
+
+ut_test(overlap_bounds)
+{
+    exa_interval_tree_insert(&tree, &nodes[0], 100, 10);
+
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 90, 10) == NULL);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 110, 10) == NULL);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 100, 0) == NULL);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 91, 10) == &nodes[0]);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 109, 10) == &nodes[0]);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 0, 1000) == &nodes[0]);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 105, 1) == &nodes[0]);
+
+    exa_interval_tree_remove(&tree, &nodes[0]);
+    UT_ASSERT(exa_interval_tree_overlap(&tree, 105, 1) == NULL);
+    UT_ASSERT_EQUAL(0, tree.count);
+}
+
+ut_test(equal_intervals_are_found_and_removed_one_by_one)
+{
+    int i;
+
+    for (i = 0; i < 5; i++)
+        exa_interval_tree_insert(&tree, &nodes[i], 64, 128);
+
+    for (i = 0; i < 5; i++)
+    {
+        exa_interval_node_t *node = exa_interval_tree_find(&tree, 64, 128);
+
+        UT_ASSERT(node != NULL);
+        exa_interval_tree_remove(&tree, node);
+    }
+
+    UT_ASSERT(exa_interval_tree_find(&tree, 64, 128) == NULL);
+    UT_ASSERT(tree.root == NULL);
+}
+
+ut_test(random_inserts_and_removals_match_brute_force)
+{
+    int round;
+
+    for (round = 0; round < 20000; round++)
+    {
+        int i = rand() % NB_NODES;
+        uint64_t start = rand() % 100000;
+        uint64_t size = 1 + rand() % 500;
+        bool found;
+
+        if (in_tree[i])
+            exa_interval_tree_remove(&tree, &nodes[i]);
+        else
+            exa_interval_tree_insert(&tree, &nodes[i], rand() % 100000,
+                                     1 + rand() % 500);
+        in_tree[i] = !in_tree[i];
+
+        found = exa_interval_tree_overlap(&tree, start, size) != NULL;
+        UT_ASSERT_EQUAL(brute_force_overlap(start, size), found);
+
+        if (round % 1000 == 0)
+            check_tree();
+    }
+
+    check_tree();
+}
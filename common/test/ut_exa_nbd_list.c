@@ -7,6 +7,9 @@
  */
 #include <unit_testing.h>
 #include "common/include/exa_nbd_list.h"
+#include "os/include/os_eventfd.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
 
 UT_SECTION(nbd_list)
 
@@ -73,3 +76,255 @@ ut_test(write_in_all_elements_of_list)
     nbd_close_root(&root_list);
 }
 
+ut_test(post_on_empty_list_signals_notify_fd)
+{
+    struct nbd_root_list root_list;
+    struct nbd_list list;
+    struct elt *elt;
+    int fd;
+
+    int err = nbd_init_root(/*nb_elt*/ 37, sizeof(struct elt), &root_list);
+    UT_ASSERT_EQUAL(0, err);
+
+    err = nbd_init_list(&root_list, &list);
+    UT_ASSERT_EQUAL(0, err);
+
+    fd = os_eventfd_create();
+    UT_ASSERT(fd >= 0);
+    nbd_list_set_notify_fd(&list, fd);
+
+    /* Only the first post on the empty list signals */
+    elt = nbd_list_remove(&root_list.free, NULL, LISTWAIT);
+    nbd_list_post(&list, elt, -1);
+    elt = nbd_list_remove(&root_list.free, NULL, LISTWAIT);
+    nbd_list_post(&list, elt, -1);
+    UT_ASSERT_EQUAL(1, os_eventfd_reset(fd));
+
+    while ((elt = nbd_list_remove(&list, NULL, LISTNOWAIT)) != NULL)
+        nbd_list_post(&root_list.free, elt, -1);
+
+    elt = nbd_list_remove(&root_list.free, NULL, LISTWAIT);
+    nbd_list_post(&list, elt, -1);
+    UT_ASSERT_EQUAL(1, os_eventfd_wait(fd, 0));
+    UT_ASSERT_EQUAL(1, os_eventfd_reset(fd));
+
+    nbd_list_set_notify_fd(&list, -1);
+    os_eventfd_close(fd);
+
+    nbd_close_list(&list);
+    nbd_close_root(&root_list);
+}
+
+UT_SECTION(nbd_list_mpsc)
+
+#define MPSC_NB_ELTS       4096
+#define MPSC_MAX_PRODUCERS 32
+
+struct msg {
+    int producer;
+    int seq;
+};
+
+static struct nbd_root_list mpsc_root;
+static struct nbd_list mpsc_list;
+static int mpsc_nb_msgs;  /* per producer */
+
+ut_setup()
+{
+    int err = nbd_init_root(MPSC_NB_ELTS, sizeof(struct msg), &mpsc_root);
+    UT_ASSERT_EQUAL(0, err);
+
+    err = nbd_root_cache_free(&mpsc_root);
+    UT_ASSERT_EQUAL(0, err);
+
+    err = nbd_init_list(&mpsc_root, &mpsc_list);
+    UT_ASSERT_EQUAL(0, err);
+}
+
+ut_cleanup()
+{
+    nbd_close_list(&mpsc_list);
+    nbd_close_root(&mpsc_root);
+}
+
+ut_test(mpsc_list_keeps_post_order)
+{
+    int i;
+
+    nbd_list_set_mpsc(&mpsc_list);
+
+    for (i = 0; i < 100; i++)
+    {
+        struct msg *msg = nbd_list_remove(&mpsc_root.free, NULL, LISTWAIT);
+
+        msg->seq = i;
+        nbd_list_post(&mpsc_list, msg, -1);
+
+        /* Remove some of them while others are being posted */
+        if (i % 7 == 6)
+        {
+            msg = nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT);
+            UT_ASSERT(msg != NULL);
+            UT_ASSERT_EQUAL(i / 7, msg->seq);
+            nbd_list_post(&mpsc_root.free, msg, -1);
+        }
+    }
+
+    for (i = 100 / 7; i < 100; i++)
+    {
+        struct msg *msg = nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT);
+
+        UT_ASSERT(msg != NULL);
+        UT_ASSERT_EQUAL(i, msg->seq);
+        nbd_list_post(&mpsc_root.free, msg, -1);
+    }
+
+    UT_ASSERT(nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT) == NULL);
+}
+
+ut_test(mpsc_post_on_empty_list_signals_notify_fd)
+{
+    struct msg *msg;
+    int fd;
+
+    nbd_list_set_mpsc(&mpsc_list);
+
+    fd = os_eventfd_create();
+    UT_ASSERT(fd >= 0);
+    nbd_list_set_notify_fd(&mpsc_list, fd);
+
+    msg = nbd_list_remove(&mpsc_root.free, NULL, LISTWAIT);
+    nbd_list_post(&mpsc_list, msg, -1);
+    msg = nbd_list_remove(&mpsc_root.free, NULL, LISTWAIT);
+    nbd_list_post(&mpsc_list, msg, -1);
+    UT_ASSERT_EQUAL(1, os_eventfd_reset(fd));
+
+    while ((msg = nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT)) != NULL)
+        nbd_list_post(&mpsc_root.free, msg, -1);
+
+    msg = nbd_list_remove(&mpsc_root.free, NULL, LISTWAIT);
+    nbd_list_post(&mpsc_list, msg, -1);
+    UT_ASSERT_EQUAL(1, os_eventfd_reset(fd));
+
+    nbd_list_set_notify_fd(&mpsc_list, -1);
+    os_eventfd_close(fd);
+}
+
+ut_test(closing_mpsc_list_frees_its_elements)
+{
+    int i;
+
+    nbd_list_set_mpsc(&mpsc_list);
+
+    for (i = 0; i < MPSC_NB_ELTS; i++)
+        nbd_list_post(&mpsc_list,
+                      nbd_list_remove(&mpsc_root.free, NULL, LISTNOWAIT), -1);
+
+    UT_ASSERT(nbd_list_remove(&mpsc_root.free, NULL, LISTNOWAIT) == NULL);
+
+    /* Elements both seen and not seen yet by the consumer */
+    nbd_list_post(&mpsc_root.free,
+                  nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT), -1);
+    nbd_list_post(&mpsc_list,
+                  nbd_list_remove(&mpsc_root.free, NULL, LISTNOWAIT), -1);
+
+    nbd_close_list(&mpsc_list);
+
+    for (i = 0; i < MPSC_NB_ELTS; i++)
+        UT_ASSERT(nbd_list_remove(&mpsc_root.free, NULL, LISTNOWAIT) != NULL);
+}
+
+static void producer_thread(void *data)
+{
+    int producer = *(int *)data;
+    int seq;
+
+    for (seq = 0; seq < mpsc_nb_msgs; seq++)
+    {
+        struct msg *msg = nbd_list_remove(&mpsc_root.free, NULL, LISTWAIT);
+
+        msg->producer = producer;
+        msg->seq = seq;
+        nbd_list_post(&mpsc_list, msg, -1);
+    }
+}
+
+/* Have producers post messages and remove them as a single consumer.
+ * Returns the number of milliseconds it took. */
+static uint64_t run_producers(int nb_producers, int nb_msgs)
+{
+    os_thread_t threads[MPSC_MAX_PRODUCERS];
+    int ids[MPSC_MAX_PRODUCERS];
+    int next_seq[MPSC_MAX_PRODUCERS];
+    uint64_t begin;
+    int i;
+
+    mpsc_nb_msgs = nb_msgs;
+    begin = os_gettimeofday_msec();
+
+    for (i = 0; i < nb_producers; i++)
+    {
+        ids[i] = i;
+        next_seq[i] = 0;
+        UT_ASSERT(os_thread_create(&threads[i], 0, producer_thread, &ids[i]));
+    }
+
+    for (i = 0; i < nb_producers * nb_msgs; i++)
+    {
+        struct msg *msg = nbd_list_remove(&mpsc_list, NULL, LISTWAIT);
+        int producer = msg->producer;
+        int seq = msg->seq;
+
+        /* Messages of a producer are received in the order they were sent */
+        UT_ASSERT_EQUAL(next_seq[producer], seq);
+        next_seq[producer]++;
+
+        nbd_list_post(&mpsc_root.free, msg, -1);
+    }
+
+    for (i = 0; i < nb_producers; i++)
+        os_thread_join(threads[i]);
+
+    UT_ASSERT(nbd_list_remove(&mpsc_list, NULL, LISTNOWAIT) == NULL);
+
+    return os_gettimeofday_msec() - begin;
+}
+
+ut_test(concurrent_producers_on_mpsc_list)
+{
+    nbd_list_set_mpsc(&mpsc_list);
+    run_producers(8, 20000);
+}
+
+ut_test(concurrent_producers_on_locked_list)
+{
+    run_producers(8, 20000);
+}
+
+static void benchmark_producers(bool mpsc)
+{
+    int nb_producers;
+
+    if (mpsc)
+        nbd_list_set_mpsc(&mpsc_list);
+
+    for (nb_producers = 1; nb_producers <= MPSC_MAX_PRODUCERS; nb_producers *= 2)
+    {
+        int nb_msgs = 256000 / nb_producers;
+        uint64_t elapsed = run_producers(nb_producers, nb_msgs);
+
+        ut_printf("%-6s %2d producers: %"PRIu64" kmsg/s",
+                  mpsc ? "mpsc" : "locked", nb_producers,
+                  elapsed == 0 ? 0 : (uint64_t)nb_producers * nb_msgs / elapsed);
+    }
+}
+
+ut_test(benchmark_locked_list)
+{
+    benchmark_producers(false);
+}
+
+ut_test(benchmark_mpsc_list)
+{
+    benchmark_producers(true);
+}
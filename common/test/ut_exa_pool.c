@@ -0,0 +1,208 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "common/include/exa_pool.h"
+
+#include "os/include/os_atomic.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+/* Small enough not to use magazines */
+#define SMALL_POOL  10
+/* Large enough to use full magazines */
+#define LARGE_POOL  10000
+
+#define NB_THREADS  8
+
+static bool *in_use;
+
+ut_setup()
+{
+    in_use = os_malloc(LARGE_POOL * sizeof(bool));
+    UT_ASSERT(in_use != NULL);
+    memset(in_use, 0, LARGE_POOL * sizeof(bool));
+}
+
+ut_cleanup()
+{
+    os_free(in_use);
+}
+
+static void get_all_objects(exa_pool_t *pool, unsigned int nb_objs)
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_objs; i++)
+    {
+        int index = exa_pool_get(pool, false);
+
+        UT_ASSERT(index >= 0 && index < nb_objs);
+        UT_ASSERT(!in_use[index]);
+        in_use[index] = true;
+    }
+
+    UT_ASSERT_EQUAL(-1, exa_pool_get(pool, false));
+}
+
+static void put_all_objects(exa_pool_t *pool, unsigned int nb_objs)
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_objs; i++)
+    {
+        UT_ASSERT(in_use[i]);
+        in_use[i] = false;
+        exa_pool_put(pool, i);
+    }
+}
+
+ut_test(get_and_put_all_objects_of_small_pool)
+{
+    exa_pool_t *pool = exa_pool_create(SMALL_POOL);
+
+    UT_ASSERT(pool != NULL);
+
+    get_all_objects(pool, SMALL_POOL);
+    put_all_objects(pool, SMALL_POOL);
+    get_all_objects(pool, SMALL_POOL);
+
+    exa_pool_delete(pool);
+}
+
+ut_test(get_and_put_all_objects_of_large_pool)
+{
+    exa_pool_t *pool = exa_pool_create(LARGE_POOL);
+
+    UT_ASSERT(pool != NULL);
+
+    get_all_objects(pool, LARGE_POOL);
+    put_all_objects(pool, LARGE_POOL);
+    get_all_objects(pool, LARGE_POOL);
+
+    exa_pool_delete(pool);
+}
+
+static exa_pool_t *thread_pool;
+
+static void put_all_thread(void *data)
+{
+    put_all_objects(thread_pool, LARGE_POOL);
+}
+
+ut_test(objects_put_by_another_thread_are_reachable)
+{
+    os_thread_t thread;
+
+    thread_pool = exa_pool_create(LARGE_POOL);
+    UT_ASSERT(thread_pool != NULL);
+
+    get_all_objects(thread_pool, LARGE_POOL);
+
+    /* Some of the objects stay in the magazine of the other thread */
+    UT_ASSERT(os_thread_create(&thread, 0, put_all_thread, NULL));
+    os_thread_join(thread);
+
+    get_all_objects(thread_pool, LARGE_POOL);
+
+    exa_pool_delete(thread_pool);
+}
+
+static void put_one_later_thread(void *data)
+{
+    os_millisleep(100);
+    in_use[3] = false;
+    exa_pool_put(thread_pool, 3);
+}
+
+ut_test(waiting_get_is_woken_up_by_put)
+{
+    os_thread_t thread;
+    int index;
+
+    thread_pool = exa_pool_create(LARGE_POOL);
+    UT_ASSERT(thread_pool != NULL);
+
+    get_all_objects(thread_pool, LARGE_POOL);
+
+    UT_ASSERT(os_thread_create(&thread, 0, put_one_later_thread, NULL));
+    index = exa_pool_get(thread_pool, true);
+    os_thread_join(thread);
+
+    UT_ASSERT_EQUAL(3, index);
+
+    exa_pool_delete(thread_pool);
+}
+
+static os_atomic_t owner[LARGE_POOL];
+static os_atomic_t errors;
+
+static void get_put_thread(void *data)
+{
+    int max_held = *(int *)data;
+    int indexes[16];
+    int round, i;
+
+    for (round = 0; round < 20000; round++)
+    {
+        int nb = 1 + round % max_held;
+
+        for (i = 0; i < nb; i++)
+        {
+            indexes[i] = exa_pool_get(thread_pool, true);
+            /* Nobody else may own the object */
+            os_atomic_inc(&owner[indexes[i]]);
+            if (os_atomic_read(&owner[indexes[i]]) != 1)
+                os_atomic_inc(&errors);
+        }
+
+        for (i = 0; i < nb; i++)
+        {
+            os_atomic_dec(&owner[indexes[i]]);
+            exa_pool_put(thread_pool, indexes[i]);
+        }
+    }
+}
+
+static void concurrent_gets_and_puts(unsigned int nb_objs, int max_held)
+{
+    os_thread_t threads[NB_THREADS];
+    int i;
+
+    thread_pool = exa_pool_create(nb_objs);
+    UT_ASSERT(thread_pool != NULL);
+
+    for (i = 0; i < nb_objs; i++)
+        os_atomic_set(&owner[i], 0);
+    os_atomic_set(&errors, 0);
+
+    for (i = 0; i < NB_THREADS; i++)
+        UT_ASSERT(os_thread_create(&threads[i], 0, get_put_thread, &max_held));
+    for (i = 0; i < NB_THREADS; i++)
+        os_thread_join(threads[i]);
+
+    UT_ASSERT_EQUAL(0, os_atomic_read(&errors));
+
+    /* All the objects are back */
+    get_all_objects(thread_pool, nb_objs);
+
+    exa_pool_delete(thread_pool);
+}
+
+ut_test(concurrent_gets_and_puts_on_large_pool)
+{
+    concurrent_gets_and_puts(LARGE_POOL, 16);
+}
+
+/* Fewer objects than threads: threads have to wait for each other */
+ut_test(concurrent_gets_and_puts_on_scarce_pool)
+{
+    concurrent_gets_and_puts(NB_THREADS / 2, 1);
+}
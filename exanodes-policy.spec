@@ -77,6 +77,10 @@ cat > $RPM_BUILD_ROOT/%{_pkgdatadir}/default_tunables.conf << EOF
     <tunable name="multicast_port" default_value="30798"/>
     <tunable name="rebuilding_slowdown" default_value="1"/>
     <tunable name="degraded_rebuilding_slowdown" default_value="0"/>
+    <tunable name="rain1_read_policy" default_value="least_outstanding"/>
+    <tunable name="rain1_dirty_zone_retention" default_value="30"/>
+    <tunable name="rebuilding_latency_target" default_value="0"/>
+    <tunable name="vrt_engine_threads" default_value="4"/>
   </tunables>
 </Exanodes>
 EOF
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXATRACE_H
+#define __EXATRACE_H
+
+/** \file
+ * Tracepoints of the IO path.
+ *
+ * The tracepoints are always compiled in and cost a test of a flag while
+ * tracing is disabled. Once enabled (with EXATRACE_ENV at startup or with
+ * the exa_trace tool at any time), each tracepoint records a timestamped
+ * event in a ring buffer of its thread, in shared memory, where exa_trace
+ * reads them.
+ *
+ * An event identifies the object of its layer (a request, a bio...) and,
+ * for the beginning of an IO, the object of the upper layer it was
+ * submitted by, so that the timeline of each IO through the layers can be
+ * rebuilt.
+ */
+
+#include "os/include/os_inttypes.h"
+
+/** Set to 1 to enable tracing when a daemon starts */
+#define EXATRACE_ENV  "EXANODES_TRACE"
+
+/** Layers of the IO path, from top to bottom */
+typedef enum
+{
+    EXATRACE_LAYER_TARGET,
+    EXATRACE_LAYER_LUM,
+    EXATRACE_LAYER_VRT,
+    EXATRACE_LAYER_VRT_IO,
+    EXATRACE_LAYER_NBD_CLIENT,
+    EXATRACE_LAYER_NBD_SERVER,
+    EXATRACE_LAYER_RDEV
+#define EXATRACE_LAYER__LAST  EXATRACE_LAYER_RDEV
+} exatrace_layer_t;
+
+#define EXATRACE_NB_LAYERS  (EXATRACE_LAYER__LAST + 1)
+
+typedef enum
+{
+    EXATRACE_KIND_BEGIN,   /**< IO submitted to the layer */
+    EXATRACE_KIND_END,     /**< IO completed by the layer */
+    EXATRACE_KIND_MARK     /**< Step of an IO in the layer */
+} exatrace_kind_t;
+
+/*
+ * Events: name, layer, kind.
+ *
+ * For BEGIN events, the parent is the id of the upper layer object, the
+ * value the size of the IO in bytes. For END events, the value is the
+ * status of the IO.
+ *
+ * The NBD client identifies a request by its request number, and the NBD
+ * server gives as parent the EXATRACE_WIRE_KEY() of the request it
+ * received.
+ */
+#define EXATRACE_EVENTS                                                 \
+    EXATRACE_EVENT(TARGET_BEGIN,      TARGET,     BEGIN)                \
+    EXATRACE_EVENT(TARGET_END,        TARGET,     END)                  \
+    EXATRACE_EVENT(LUM_BEGIN,         LUM,        BEGIN)                \
+    EXATRACE_EVENT(LUM_END,           LUM,        END)                  \
+    EXATRACE_EVENT(VRT_BEGIN,         VRT,        BEGIN)                \
+    EXATRACE_EVENT(VRT_END,           VRT,        END)                  \
+    EXATRACE_EVENT(VRT_IO_BEGIN,      VRT_IO,     BEGIN)                \
+    EXATRACE_EVENT(VRT_IO_END,        VRT_IO,     END)                  \
+    EXATRACE_EVENT(NBD_CLIENT_BEGIN,  NBD_CLIENT, BEGIN)                \
+    EXATRACE_EVENT(NBD_CLIENT_END,    NBD_CLIENT, END)                  \
+    EXATRACE_EVENT(NBD_SERVER_BEGIN,  NBD_SERVER, BEGIN)                \
+    EXATRACE_EVENT(NBD_SERVER_PARKED, NBD_SERVER, MARK)                 \
+    EXATRACE_EVENT(NBD_SERVER_REPLY,  NBD_SERVER, MARK)                 \
+    EXATRACE_EVENT(NBD_SERVER_END,    NBD_SERVER, END)                  \
+    EXATRACE_EVENT(RDEV_BEGIN,        RDEV,       BEGIN)                \
+    EXATRACE_EVENT(RDEV_END,          RDEV,       END)
+
+typedef enum
+{
+#define EXATRACE_EVENT(name, layer, kind)  EXATRACE_##name,
+    EXATRACE_EVENTS
+#undef EXATRACE_EVENT
+    EXATRACE_NB_EVENTS
+} exatrace_event_t;
+
+/** Key of an NBD request on the wire */
+#define EXATRACE_WIRE_KEY(client_node, req_num) \
+    (((uint64_t)(client_node) << 48) | ((uint64_t)(req_num) & 0xffffffffffffULL))
+
+/** Flag tested by the tracepoints, in shared memory once initialized */
+extern volatile const uint32_t *exatrace_enabled;
+
+/**
+ * Trace an event.
+ *
+ * @param event   Event, without its EXATRACE_ prefix
+ * @param id      Object of the layer
+ * @param parent  Object of the upper layer
+ * @param value   Size or status
+ */
+#define EXATRACE(event, id, parent, value)                              \
+    do {                                                                \
+        if (__builtin_expect(*exatrace_enabled != 0, 0))                \
+            exatrace_record(EXATRACE_##event, (uint64_t)(uintptr_t)(id),\
+                            (uint64_t)(uintptr_t)(parent),              \
+                            (uint32_t)(value));                         \
+    } while (0)
+
+void exatrace_record(exatrace_event_t event, uint64_t id, uint64_t parent,
+                     uint32_t value);
+
+/**
+ * Create the trace buffers of the process.
+ *
+ * Tracing is enabled right away if EXATRACE_ENV is set to 1.
+ *
+ * @param[in] name     Name of the process, as given to exa_trace
+ * @param[in] node_id  Id of the node
+ *
+ * @return EXA_SUCCESS or a negative error code
+ */
+int exatrace_static_init(const char *name, uint32_t node_id);
+
+/** Delete the trace buffers of the process */
+void exatrace_static_clean(void);
+
+/** Name of an event */
+const char *exatrace_event_name(exatrace_event_t event);
+
+/** Layer of an event */
+exatrace_layer_t exatrace_event_layer(exatrace_event_t event);
+
+/** Kind of an event */
+exatrace_kind_t exatrace_event_kind(exatrace_event_t event);
+
+/** Name of a layer */
+const char *exatrace_layer_name(exatrace_layer_t layer);
+
+#endif /* __EXATRACE_H */
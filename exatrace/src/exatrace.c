@@ -0,0 +1,214 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "exatrace/include/exatrace.h"
+#include "exatrace/src/exatrace_buffer.h"
+
+#include "common/include/exa_assert.h"
+#include "common/include/exa_error.h"
+
+#include "os/include/os_process.h"
+#include "os/include/os_shm.h"
+#include "os/include/os_stdio.h"
+#include "os/include/os_string.h"
+#include "os/include/os_time.h"
+#include "os/include/strlcpy.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct
+{
+    const char *name;
+    exatrace_layer_t layer;
+    exatrace_kind_t kind;
+} events[EXATRACE_NB_EVENTS] =
+{
+#define EXATRACE_EVENT(name, layer, kind) \
+    { #name, EXATRACE_LAYER_##layer, EXATRACE_KIND_##kind },
+    EXATRACE_EVENTS
+#undef EXATRACE_EVENT
+};
+
+static const char *layer_names[EXATRACE_NB_LAYERS] =
+{
+    [EXATRACE_LAYER_TARGET]     = "target",
+    [EXATRACE_LAYER_LUM]        = "lum",
+    [EXATRACE_LAYER_VRT]        = "vrt",
+    [EXATRACE_LAYER_VRT_IO]     = "vrt_io",
+    [EXATRACE_LAYER_NBD_CLIENT] = "nbd_client",
+    [EXATRACE_LAYER_NBD_SERVER] = "nbd_server",
+    [EXATRACE_LAYER_RDEV]       = "rdev"
+};
+
+/* Tracepoints test this until the buffers exist */
+static const uint32_t disabled = 0;
+volatile const uint32_t *exatrace_enabled = &disabled;
+
+static os_shm_t *shm = NULL;
+static exatrace_buffer_t *buffer = NULL;
+
+/* Incremented each time the buffers are created */
+static uint32_t generation = 0;
+
+/* Slot of the thread, taken when it first traces in this generation */
+static __thread exatrace_slot_t *thread_slot = NULL;
+static __thread uint32_t thread_generation = 0;
+
+const char *exatrace_event_name(exatrace_event_t event)
+{
+    EXA_ASSERT(event < EXATRACE_NB_EVENTS);
+    return events[event].name;
+}
+
+exatrace_layer_t exatrace_event_layer(exatrace_event_t event)
+{
+    EXA_ASSERT(event < EXATRACE_NB_EVENTS);
+    return events[event].layer;
+}
+
+exatrace_kind_t exatrace_event_kind(exatrace_event_t event)
+{
+    EXA_ASSERT(event < EXATRACE_NB_EVENTS);
+    return events[event].kind;
+}
+
+const char *exatrace_layer_name(exatrace_layer_t layer)
+{
+    EXA_ASSERT(layer < EXATRACE_NB_LAYERS);
+    return layer_names[layer];
+}
+
+/* Slots are never given back: the threads of the IO path live as long as
+ * the process, and the events of a thread gone are still worth reading */
+static exatrace_slot_t *take_slot(void)
+{
+    int i;
+
+    for (i = 0; i < EXATRACE_NB_SLOTS; i++)
+        if (os_atomic_read(&buffer->slots[i].owner) == 0
+            && os_atomic_cmpxchg(&buffer->slots[i].owner, 0, 1) == 0)
+            return &buffer->slots[i];
+
+    return NULL;
+}
+
+void exatrace_record(exatrace_event_t event, uint64_t id, uint64_t parent,
+                     uint32_t value)
+{
+    exatrace_slot_t *slot = thread_slot;
+    exatrace_record_t *record;
+    struct timespec now;
+    uint64_t head;
+
+    if (thread_generation != generation)
+    {
+        if (buffer == NULL)
+            return;
+
+        slot = take_slot();
+        if (slot == NULL)
+        {
+            os_atomic_inc(&buffer->lost);
+            return;
+        }
+        thread_slot = slot;
+        thread_generation = generation;
+    }
+
+    os_get_monotonic_time(&now);
+
+    head = slot->head;
+    record = &slot->records[head & (EXATRACE_SLOT_RECORDS - 1)];
+
+    record->time_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    record->id = id;
+    record->parent = parent;
+    record->event = event;
+    record->slot = slot - buffer->slots;
+    record->value = value;
+
+    /* Only this thread writes the slot: publishing the record only needs
+     * it to be written before the head */
+    __atomic_store_n(&slot->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int exatrace_slot_read(const exatrace_slot_t *slot, exatrace_record_t *records)
+{
+    uint64_t head, first, valid_first, i;
+
+    head = __atomic_load_n(&slot->head, __ATOMIC_ACQUIRE);
+    first = head > EXATRACE_SLOT_RECORDS ? head - EXATRACE_SLOT_RECORDS : 0;
+
+    for (i = first; i < head; i++)
+        records[i - first] = slot->records[i & (EXATRACE_SLOT_RECORDS - 1)];
+
+    /* The record being written after the head overwrites the oldest one */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&slot->head, __ATOMIC_ACQUIRE);
+    valid_first = head >= EXATRACE_SLOT_RECORDS
+                  ? head - EXATRACE_SLOT_RECORDS + 1 : 0;
+
+    if (valid_first <= first)
+        return i - first;
+
+    if (valid_first >= i)
+        return 0;
+
+    memmove(records, records + (valid_first - first),
+            (i - valid_first) * sizeof(exatrace_record_t));
+
+    return i - valid_first;
+}
+
+int exatrace_static_init(const char *name, uint32_t node_id)
+{
+    char id[OS_SHM_ID_MAXLEN];
+    const char *env;
+
+    EXA_ASSERT(shm == NULL);
+
+    if (os_snprintf(id, sizeof(id), EXATRACE_SHM_FMT, name) >= sizeof(id))
+        return -ENAMETOOLONG;
+
+    shm = os_shm_create(id, sizeof(exatrace_buffer_t));
+    if (shm == NULL)
+        return -ENOMEM;
+
+    /* The shared memory is zeroed when created */
+    buffer = os_shm_get_data(shm);
+    buffer->version = EXATRACE_VERSION;
+    buffer->node_id = node_id;
+    buffer->pid = os_process_id();
+    buffer->nb_slots = EXATRACE_NB_SLOTS;
+    buffer->slot_records = EXATRACE_SLOT_RECORDS;
+    strlcpy(buffer->name, name, sizeof(buffer->name));
+
+    env = getenv(EXATRACE_ENV);
+    buffer->enabled = env != NULL && strcmp(env, "1") == 0;
+    buffer->magic = EXATRACE_MAGIC;
+
+    generation++;
+    exatrace_enabled = &buffer->enabled;
+
+    return EXA_SUCCESS;
+}
+
+void exatrace_static_clean(void)
+{
+    if (shm == NULL)
+        return;
+
+    /* The threads of the IO path are gone by now */
+    exatrace_enabled = &disabled;
+    buffer = NULL;
+
+    os_shm_delete(shm);
+    shm = NULL;
+}
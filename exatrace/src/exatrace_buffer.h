@@ -0,0 +1,83 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXATRACE_BUFFER_H
+#define __EXATRACE_BUFFER_H
+
+/** \file
+ * Trace buffers of a process, in shared memory.
+ *
+ * Each thread that traces takes a slot, whose ring buffer only it writes:
+ * it copies a record at its head and then publishes it by incrementing
+ * the head. A reader copies the records below the head and discards the
+ * ones the writer may have overwritten meanwhile, i.e. the ones more than
+ * a ring size below the head once the copy is done.
+ */
+
+#include "exatrace/include/exatrace.h"
+
+#include "os/include/os_atomic.h"
+#include "os/include/os_inttypes.h"
+
+#define EXATRACE_MAGIC         0x45585452  /* "EXTR" */
+#define EXATRACE_VERSION       1
+
+/** Number of threads of a process that can trace */
+#define EXATRACE_NB_SLOTS      64
+
+/** Number of records of a thread, must be a power of 2 */
+#define EXATRACE_SLOT_RECORDS  4096
+
+#define EXATRACE_NAME_MAX      32
+
+/** Shared memory of a process */
+#define EXATRACE_SHM_FMT       "exatrace_%s"
+
+typedef struct
+{
+    uint64_t time_ns;        /**< Monotonic time */
+    uint64_t id;
+    uint64_t parent;
+    uint16_t event;
+    uint16_t slot;           /**< Thread that recorded the event */
+    uint32_t value;
+} exatrace_record_t;
+
+typedef struct
+{
+    os_atomic_t owner;       /**< Non zero once taken by a thread */
+    uint32_t unused;
+    volatile uint64_t head;  /**< Number of records ever written */
+    exatrace_record_t records[EXATRACE_SLOT_RECORDS];
+} exatrace_slot_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    volatile uint32_t enabled;
+    uint32_t node_id;
+    uint32_t pid;
+    uint32_t nb_slots;
+    uint32_t slot_records;
+    os_atomic_t lost;        /**< Events of threads that got no slot */
+    char name[EXATRACE_NAME_MAX];
+    exatrace_slot_t slots[EXATRACE_NB_SLOTS];
+} exatrace_buffer_t;
+
+/**
+ * Copy the records of a slot that are still valid.
+ *
+ * @param[in]  slot     Slot to read
+ * @param[out] records  Buffer of EXATRACE_SLOT_RECORDS records
+ *
+ * @return the number of records copied, oldest first
+ */
+int exatrace_slot_read(const exatrace_slot_t *slot, exatrace_record_t *records);
+
+#endif /* __EXATRACE_BUFFER_H */
@@ -0,0 +1,651 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "exatrace/src/exatrace_timeline.h"
+
+#include "common/include/exa_assert.h"
+#include "common/include/exa_error.h"
+
+#include "os/include/os_mem.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Spans opened and not closed yet, by layer and id */
+#define OPEN_HASH_BITS  16
+#define OPEN_HASH_SIZE  (1 << OPEN_HASH_BITS)
+
+/* Server spans sampled to estimate the offset between two clocks */
+#define OFFSET_SAMPLES  64
+
+static unsigned open_hash(exatrace_layer_t layer, uint64_t id)
+{
+    uint64_t key = (id ^ ((uint64_t)layer << 56)) * 0x9e3779b97f4a7c15ULL;
+    return key >> (64 - OPEN_HASH_BITS);
+}
+
+static int open_find(const exatrace_timeline_t *timeline, const int *open,
+                     exatrace_layer_t layer, uint64_t id)
+{
+    int s;
+
+    for (s = open[open_hash(layer, id)]; s >= 0; s = timeline->spans[s].hash_next)
+        if (timeline->spans[s].layer == layer && timeline->spans[s].id == id)
+            return s;
+
+    return -1;
+}
+
+static void open_add(exatrace_timeline_t *timeline, int *open, int s)
+{
+    exatrace_span_t *span = &timeline->spans[s];
+    unsigned h = open_hash(span->layer, span->id);
+
+    span->hash_next = open[h];
+    open[h] = s;
+}
+
+static void open_remove(exatrace_timeline_t *timeline, int *open, int s)
+{
+    exatrace_span_t *span = &timeline->spans[s];
+    int *prev = &open[open_hash(span->layer, span->id)];
+
+    while (*prev != s)
+        prev = &timeline->spans[*prev].hash_next;
+
+    *prev = span->hash_next;
+}
+
+static int new_span(exatrace_timeline_t *timeline)
+{
+    exatrace_span_t *span;
+
+    if (timeline->nb_spans == timeline->max_spans)
+    {
+        int max_spans = timeline->max_spans == 0 ? 1024 : 2 * timeline->max_spans;
+        exatrace_span_t *spans;
+
+        spans = os_realloc(timeline->spans, max_spans * sizeof(exatrace_span_t));
+        if (spans == NULL)
+            return -1;
+
+        timeline->spans = spans;
+        timeline->max_spans = max_spans;
+    }
+
+    span = &timeline->spans[timeline->nb_spans];
+    memset(span, 0, sizeof(*span));
+    span->parent = -1;
+    span->first_child = -1;
+    span->next_sibling = -1;
+    span->hash_next = -1;
+
+    return timeline->nb_spans++;
+}
+
+/* Children are kept in the order they were added, i.e. by time */
+static void add_child(exatrace_timeline_t *timeline, int parent, int child)
+{
+    int *last = &timeline->spans[parent].first_child;
+
+    while (*last >= 0)
+        last = &timeline->spans[*last].next_sibling;
+
+    *last = child;
+    timeline->spans[child].parent = parent;
+}
+
+static int build_process(exatrace_timeline_t *timeline, int *open, int p,
+                         const exatrace_process_t *process)
+{
+    int i;
+
+    for (i = 0; i < OPEN_HASH_SIZE; i++)
+        open[i] = -1;
+
+    for (i = 0; i < process->nb_records; i++)
+    {
+        const exatrace_record_t *record = &process->records[i];
+        exatrace_layer_t layer;
+        exatrace_span_t *span;
+        int s;
+
+        if (record->event >= EXATRACE_NB_EVENTS)
+            continue;
+
+        layer = exatrace_event_layer(record->event);
+        s = open_find(timeline, open, layer, record->id);
+
+        switch (exatrace_event_kind(record->event))
+        {
+        case EXATRACE_KIND_BEGIN:
+            /* The end of the previous IO with this id was lost */
+            if (s >= 0)
+                open_remove(timeline, open, s);
+
+            s = new_span(timeline);
+            if (s < 0)
+                return -ENOMEM;
+
+            span = &timeline->spans[s];
+            span->layer = layer;
+            span->process = p;
+            span->id = record->id;
+            span->parent_id = record->parent;
+            span->begin_ns = record->time_ns;
+            span->size = record->value;
+            if (layer == EXATRACE_LAYER_NBD_CLIENT)
+                span->wire_key = EXATRACE_WIRE_KEY(process->node_id, record->id);
+
+            open_add(timeline, open, s);
+
+            /* The parent of a server span is in the client process */
+            if (layer != EXATRACE_LAYER_TARGET
+                && layer != EXATRACE_LAYER_NBD_SERVER)
+            {
+                int parent = open_find(timeline, open, layer - 1,
+                                       record->parent);
+                if (parent >= 0)
+                    add_child(timeline, parent, s);
+            }
+            break;
+
+        case EXATRACE_KIND_END:
+            if (s < 0)
+                break;
+
+            span = &timeline->spans[s];
+            span->end_ns = record->time_ns;
+            span->complete = true;
+            span->status = (int)record->value;
+            open_remove(timeline, open, s);
+            break;
+
+        case EXATRACE_KIND_MARK:
+            if (s < 0)
+                break;
+
+            span = &timeline->spans[s];
+            if (span->nb_marks < EXATRACE_SPAN_MAX_MARKS)
+            {
+                span->mark_events[span->nb_marks] = record->event;
+                span->mark_ns[span->nb_marks] = record->time_ns;
+                span->nb_marks++;
+            }
+            break;
+        }
+    }
+
+    return EXA_SUCCESS;
+}
+
+/* Sort context: qsort() has none */
+static const exatrace_span_t *sorted_spans;
+
+static uint64_t span_key(const exatrace_span_t *span)
+{
+    return span->layer == EXATRACE_LAYER_NBD_CLIENT ? span->wire_key
+                                                    : span->parent_id;
+}
+
+static int compare_by_key(const void *a, const void *b)
+{
+    const exatrace_span_t *sa = &sorted_spans[*(const int *)a];
+    const exatrace_span_t *sb = &sorted_spans[*(const int *)b];
+
+    if (span_key(sa) != span_key(sb))
+        return span_key(sa) < span_key(sb) ? -1 : 1;
+    if (sa->begin_ns != sb->begin_ns)
+        return sa->begin_ns < sb->begin_ns ? -1 : 1;
+    return 0;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t *)a;
+    int64_t vb = *(const int64_t *)b;
+
+    return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+static int64_t span_middle(const exatrace_span_t *span)
+{
+    return span->begin_ns + (span->end_ns - span->begin_ns) / 2;
+}
+
+/* First client span with the key, or nb_clients if none */
+static int find_key(const exatrace_timeline_t *timeline, const int *clients,
+                    int nb_clients, uint64_t key)
+{
+    int low = 0, high = nb_clients;
+
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if (timeline->spans[clients[middle]].wire_key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low < nb_clients && timeline->spans[clients[low]].wire_key == key
+           ? low : nb_clients;
+}
+
+/**
+ * Find the client span that sent the request of a server span. The spans
+ * of a client with the same key are disjoint, since a request number is
+ * not reused before the request completes.
+ */
+static int match_client(const exatrace_timeline_t *timeline,
+                        const int *clients, int nb_clients,
+                        const exatrace_span_t *server, int64_t offset,
+                        bool same_clock)
+{
+    uint64_t key = server->parent_id;
+    int64_t middle = span_middle(server) - offset;
+    int first, last, best = -1;
+    int64_t best_distance = 0;
+    int c;
+
+    first = find_key(timeline, clients, nb_clients, key);
+    for (last = first; last < nb_clients; last++)
+        if (timeline->spans[clients[last]].wire_key != key)
+            break;
+
+    for (c = first; c < last; c++)
+    {
+        const exatrace_span_t *client = &timeline->spans[clients[c]];
+        int64_t distance;
+
+        if (!client->complete)
+            continue;
+
+        if ((int64_t)client->begin_ns <= middle && middle <= (int64_t)client->end_ns)
+            return clients[c];
+
+        if (same_clock)
+            continue;
+
+        distance = span_middle(client) - middle;
+        if (distance < 0)
+            distance = -distance;
+        if (best < 0 || distance < best_distance)
+        {
+            best = clients[c];
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Estimate the offset of the clock of the server relative to the clock of
+ * the client: it is the difference between the middles of a server span
+ * and of the client span that sent its request, for most of the server
+ * spans, whereas the differences with the other client spans of the same
+ * key spread: these are disjoint and longer than the server span, so they
+ * are at least a server span away.
+ */
+static int64_t estimate_offset(const exatrace_timeline_t *timeline,
+                               const int *clients, int nb_clients,
+                               const int *servers, int nb_servers)
+{
+    int64_t *candidates;
+    int nb_candidates = 0, max_candidates = 0;
+    int step = nb_servers / OFFSET_SAMPLES + 1;
+    int64_t offset = 0;
+    int64_t window = 0;
+    int best_count = 0;
+    int i, j;
+
+    for (i = 0; i < nb_servers; i += step)
+    {
+        const exatrace_span_t *server = &timeline->spans[servers[i]];
+        uint64_t key = server->parent_id;
+        int first = find_key(timeline, clients, nb_clients, key);
+
+        if (i == 0 || server->end_ns - server->begin_ns < 2 * window)
+            window = (server->end_ns - server->begin_ns) / 2;
+
+        for (j = first; j < nb_clients; j++)
+            if (timeline->spans[clients[j]].wire_key != key)
+                break;
+        max_candidates += j - first;
+    }
+
+    if (max_candidates == 0)
+        return 0;
+
+    candidates = os_malloc(max_candidates * sizeof(int64_t));
+    if (candidates == NULL)
+        return 0;
+
+    for (i = 0; i < nb_servers; i += step)
+    {
+        const exatrace_span_t *server = &timeline->spans[servers[i]];
+        int first = find_key(timeline, clients, nb_clients, server->parent_id);
+
+        for (j = first; j < nb_clients; j++)
+        {
+            const exatrace_span_t *client = &timeline->spans[clients[j]];
+
+            if (client->wire_key != server->parent_id)
+                break;
+
+            if (client->complete
+                && client->end_ns - client->begin_ns
+                   >= server->end_ns - server->begin_ns)
+                candidates[nb_candidates++] = span_middle(server)
+                                              - span_middle(client);
+        }
+    }
+
+    qsort(candidates, nb_candidates, sizeof(int64_t), compare_int64);
+
+    /* Densest window of candidates */
+    for (i = 0, j = 0; j < nb_candidates; j++)
+    {
+        while (candidates[j] - candidates[i] > window)
+            i++;
+
+        if (j - i + 1 > best_count)
+        {
+            best_count = j - i + 1;
+            offset = candidates[(i + j) / 2];
+        }
+    }
+
+    os_free(candidates);
+
+    return offset;
+}
+
+static void shift_span(exatrace_timeline_t *timeline, int s, int64_t offset)
+{
+    exatrace_span_t *span = &timeline->spans[s];
+    int i;
+
+    span->begin_ns -= offset;
+    if (span->complete)
+        span->end_ns -= offset;
+    for (i = 0; i < span->nb_marks; i++)
+        span->mark_ns[i] -= offset;
+
+    for (i = span->first_child; i >= 0; i = timeline->spans[i].next_sibling)
+        shift_span(timeline, i, offset);
+}
+
+/**
+ * Attach the server spans of a server process that answered the requests
+ * of a client node.
+ */
+static int attach_servers(exatrace_timeline_t *timeline,
+                          const exatrace_process_t *processes,
+                          const int *clients, int nb_clients,
+                          const int *servers, int nb_servers)
+{
+    const exatrace_span_t *first = &timeline->spans[servers[0]];
+    bool same_clock = first->parent_id >> 48
+                      == processes[first->process].node_id;
+    int64_t offset = 0;
+    int *matches;
+    int i;
+
+    matches = os_malloc(nb_servers * sizeof(int));
+    if (matches == NULL)
+        return -ENOMEM;
+
+    if (!same_clock)
+    {
+        int64_t *diffs;
+        int nb_diffs = 0;
+
+        offset = estimate_offset(timeline, clients, nb_clients,
+                                 servers, nb_servers);
+
+        /* Refine it over all the requests matched */
+        diffs = os_malloc(nb_servers * sizeof(int64_t));
+        if (diffs == NULL)
+        {
+            os_free(matches);
+            return -ENOMEM;
+        }
+
+        for (i = 0; i < nb_servers; i++)
+        {
+            const exatrace_span_t *server = &timeline->spans[servers[i]];
+            int c = match_client(timeline, clients, nb_clients, server,
+                                 offset, false);
+            if (c >= 0)
+                diffs[nb_diffs++] = span_middle(server)
+                                    - span_middle(&timeline->spans[c]);
+        }
+
+        if (nb_diffs > 0)
+        {
+            qsort(diffs, nb_diffs, sizeof(int64_t), compare_int64);
+            offset = diffs[nb_diffs / 2];
+        }
+
+        os_free(diffs);
+    }
+
+    /* Match all of them before shifting any */
+    for (i = 0; i < nb_servers; i++)
+        matches[i] = match_client(timeline, clients, nb_clients,
+                                  &timeline->spans[servers[i]], offset,
+                                  same_clock);
+
+    for (i = 0; i < nb_servers; i++)
+    {
+        if (matches[i] < 0)
+            continue;
+
+        shift_span(timeline, servers[i], offset);
+        add_child(timeline, matches[i], servers[i]);
+    }
+
+    os_free(matches);
+
+    return EXA_SUCCESS;
+}
+
+static int compare_by_process(const void *a, const void *b)
+{
+    const exatrace_span_t *sa = &sorted_spans[*(const int *)a];
+    const exatrace_span_t *sb = &sorted_spans[*(const int *)b];
+    uint64_t node_a = sa->parent_id >> 48;
+    uint64_t node_b = sb->parent_id >> 48;
+
+    if (sa->process != sb->process)
+        return sa->process < sb->process ? -1 : 1;
+    if (node_a != node_b)
+        return node_a < node_b ? -1 : 1;
+    return compare_by_key(a, b);
+}
+
+static int link_servers(exatrace_timeline_t *timeline,
+                        const exatrace_process_t *processes)
+{
+    int *clients, *servers;
+    int nb_clients = 0, nb_servers = 0;
+    int err = EXA_SUCCESS;
+    int i, first;
+
+    clients = os_malloc((timeline->nb_spans + 1) * sizeof(int));
+    servers = os_malloc((timeline->nb_spans + 1) * sizeof(int));
+    if (clients == NULL || servers == NULL)
+    {
+        os_free(clients);
+        os_free(servers);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < timeline->nb_spans; i++)
+    {
+        const exatrace_span_t *span = &timeline->spans[i];
+
+        if (span->layer == EXATRACE_LAYER_NBD_CLIENT)
+            clients[nb_clients++] = i;
+        else if (span->layer == EXATRACE_LAYER_NBD_SERVER && span->complete)
+            servers[nb_servers++] = i;
+    }
+
+    sorted_spans = timeline->spans;
+    qsort(clients, nb_clients, sizeof(int), compare_by_key);
+    qsort(servers, nb_servers, sizeof(int), compare_by_process);
+
+    /* Each server process with each client node has its own clock offset */
+    for (first = 0; first < nb_servers && err == EXA_SUCCESS; first = i)
+    {
+        const exatrace_span_t *span = &timeline->spans[servers[first]];
+
+        for (i = first + 1; i < nb_servers; i++)
+        {
+            const exatrace_span_t *other = &timeline->spans[servers[i]];
+
+            if (other->process != span->process
+                || other->parent_id >> 48 != span->parent_id >> 48)
+                break;
+        }
+
+        err = attach_servers(timeline, processes, clients, nb_clients,
+                             servers + first, i - first);
+    }
+
+    os_free(clients);
+    os_free(servers);
+
+    return err;
+}
+
+int exatrace_timeline_build(exatrace_timeline_t *timeline,
+                            const exatrace_process_t *processes,
+                            int nb_processes)
+{
+    int *open;
+    int err = EXA_SUCCESS;
+    int p;
+
+    memset(timeline, 0, sizeof(*timeline));
+
+    open = os_malloc(OPEN_HASH_SIZE * sizeof(int));
+    if (open == NULL)
+        return -ENOMEM;
+
+    for (p = 0; p < nb_processes && err == EXA_SUCCESS; p++)
+        err = build_process(timeline, open, p, &processes[p]);
+
+    os_free(open);
+
+    if (err == EXA_SUCCESS)
+        err = link_servers(timeline, processes);
+
+    if (err != EXA_SUCCESS)
+        exatrace_timeline_free(timeline);
+
+    return err;
+}
+
+void exatrace_timeline_free(exatrace_timeline_t *timeline)
+{
+    os_free(timeline->spans);
+    timeline->nb_spans = 0;
+    timeline->max_spans = 0;
+}
+
+void exatrace_timeline_stats(const exatrace_timeline_t *timeline,
+                             exatrace_layer_stats_t stats[EXATRACE_NB_LAYERS])
+{
+    int i, c;
+
+    memset(stats, 0, EXATRACE_NB_LAYERS * sizeof(exatrace_layer_stats_t));
+
+    for (i = 0; i < timeline->nb_spans; i++)
+    {
+        const exatrace_span_t *span = &timeline->spans[i];
+        exatrace_layer_stats_t *layer_stats = &stats[span->layer];
+        uint64_t duration, covered_begin = 0, covered_end = 0;
+        bool covered = false;
+
+        if (!span->complete)
+            continue;
+
+        for (c = span->first_child; c >= 0; c = timeline->spans[c].next_sibling)
+        {
+            const exatrace_span_t *child = &timeline->spans[c];
+
+            if (!child->complete)
+                continue;
+
+            if (!covered || child->begin_ns < covered_begin)
+                covered_begin = child->begin_ns;
+            if (!covered || child->end_ns > covered_end)
+                covered_end = child->end_ns;
+            covered = true;
+        }
+
+        /* Children of another clock may slightly overflow */
+        if (covered_begin < span->begin_ns)
+            covered_begin = span->begin_ns;
+        if (covered_end > span->end_ns)
+            covered_end = span->end_ns;
+
+        duration = span->end_ns - span->begin_ns;
+
+        layer_stats->count++;
+        layer_stats->total_ns += duration;
+        if (duration > layer_stats->max_ns)
+            layer_stats->max_ns = duration;
+        layer_stats->own_ns += duration;
+        if (covered && covered_end > covered_begin)
+            layer_stats->own_ns -= covered_end - covered_begin;
+    }
+}
+
+int exatrace_timeline_slowest(const exatrace_timeline_t *timeline,
+                              int *roots, int max)
+{
+    int nb_roots = 0;
+    int i, j;
+
+    for (i = 0; i < timeline->nb_spans; i++)
+    {
+        const exatrace_span_t *span = &timeline->spans[i];
+        uint64_t duration;
+
+        if (span->parent >= 0 || !span->complete)
+            continue;
+
+        duration = span->end_ns - span->begin_ns;
+
+        /* Insert it among the slowest, slowest first */
+        for (j = nb_roots; j > 0; j--)
+        {
+            const exatrace_span_t *other = &timeline->spans[roots[j - 1]];
+
+            if (other->end_ns - other->begin_ns >= duration)
+                break;
+            if (j < max)
+                roots[j] = roots[j - 1];
+        }
+
+        if (j < max)
+        {
+            roots[j] = i;
+            if (nb_roots < max)
+                nb_roots++;
+        }
+    }
+
+    return nb_roots;
+}
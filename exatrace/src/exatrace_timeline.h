@@ -0,0 +1,114 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __EXATRACE_TIMELINE_H
+#define __EXATRACE_TIMELINE_H
+
+/** \file
+ * Timelines of the IOs, rebuilt from the events traced by the processes.
+ *
+ * Within a process, the span of an IO in a layer goes from its BEGIN to its
+ * END event and is the child of the span of the upper layer it was
+ * submitted by. The spans of the NBD server are children of the spans of
+ * the NBD client that sent the request: when both run on the same node,
+ * they share the same clock, otherwise the offset between the clocks of
+ * the nodes is estimated from the requests and the server spans are
+ * shifted by it.
+ */
+
+#include "exatrace/include/exatrace.h"
+#include "exatrace/src/exatrace_buffer.h"
+
+#include <stdbool.h>
+
+/** Events of a process, sorted by time */
+typedef struct
+{
+    char name[EXATRACE_NAME_MAX];
+    uint32_t node_id;
+    uint32_t pid;
+    uint64_t lost;
+    const exatrace_record_t *records;
+    int nb_records;
+} exatrace_process_t;
+
+#define EXATRACE_SPAN_MAX_MARKS  4
+
+typedef struct
+{
+    exatrace_layer_t layer;
+    int process;                 /**< Index of the process */
+    uint64_t id;
+    uint64_t parent_id;          /**< Id of the upper layer object */
+    uint64_t wire_key;           /**< NBD client spans only */
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    bool complete;               /**< Whether its END was seen */
+    uint32_t size;
+    int status;
+    int nb_marks;
+    exatrace_event_t mark_events[EXATRACE_SPAN_MAX_MARKS];
+    uint64_t mark_ns[EXATRACE_SPAN_MAX_MARKS];
+    int parent;                  /**< Index of the parent span or -1 */
+    int first_child;             /**< Index of the first child or -1 */
+    int next_sibling;            /**< Index of the next sibling or -1 */
+    int hash_next;               /**< Used while building */
+} exatrace_span_t;
+
+typedef struct
+{
+    exatrace_span_t *spans;
+    int nb_spans;
+    int max_spans;
+} exatrace_timeline_t;
+
+typedef struct
+{
+    uint64_t count;              /**< Number of complete spans */
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t own_ns;             /**< Time not covered by the children */
+} exatrace_layer_stats_t;
+
+/**
+ * Rebuild the timelines of the IOs.
+ *
+ * @param[out] timeline      Timeline built
+ * @param[in]  processes     Processes traced
+ * @param[in]  nb_processes  Number of processes
+ *
+ * @return EXA_SUCCESS or -ENOMEM
+ */
+int exatrace_timeline_build(exatrace_timeline_t *timeline,
+                            const exatrace_process_t *processes,
+                            int nb_processes);
+
+void exatrace_timeline_free(exatrace_timeline_t *timeline);
+
+/**
+ * Compute the statistics of each layer over the complete spans.
+ *
+ * @param[in]  timeline  Timeline
+ * @param[out] stats     Statistics, indexed by layer
+ */
+void exatrace_timeline_stats(const exatrace_timeline_t *timeline,
+                             exatrace_layer_stats_t stats[EXATRACE_NB_LAYERS]);
+
+/**
+ * Find the slowest complete IOs, i.e. spans without parent.
+ *
+ * @param[in]  timeline  Timeline
+ * @param[out] roots     Indexes of the spans, slowest first
+ * @param[in]  max       Maximum number of spans to find
+ *
+ * @return the number of spans found
+ */
+int exatrace_timeline_slowest(const exatrace_timeline_t *timeline,
+                              int *roots, int max);
+
+#endif /* __EXATRACE_TIMELINE_H */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "exatrace/include/exatrace.h"
+#include "exatrace/src/exatrace_buffer.h"
+
+#include "common/include/exa_error.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_shm.h"
+#include "os/include/os_thread.h"
+
+#include <stdlib.h>
+
+#define NAME  "ut_exatrace"
+
+#define NB_THREADS  4
+
+static os_shm_t *shm;
+static exatrace_buffer_t *buffer;
+static exatrace_record_t records[EXATRACE_SLOT_RECORDS];
+
+static void start(bool enabled)
+{
+    if (enabled)
+        setenv(EXATRACE_ENV, "1", 1);
+    else
+        unsetenv(EXATRACE_ENV);
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_static_init(NAME, 3));
+
+    /* Look at the buffers the way exa_trace does */
+    shm = os_shm_get("exatrace_" NAME, sizeof(exatrace_buffer_t));
+    UT_ASSERT(shm != NULL);
+    buffer = os_shm_get_data(shm);
+}
+
+ut_cleanup()
+{
+    if (shm != NULL)
+        os_shm_release(shm);
+    shm = NULL;
+    exatrace_static_clean();
+}
+
+ut_test(buffers_describe_the_process)
+{
+    start(false);
+
+    UT_ASSERT_EQUAL(EXATRACE_MAGIC, buffer->magic);
+    UT_ASSERT_EQUAL(3, buffer->node_id);
+    UT_ASSERT_EQUAL_STR(NAME, buffer->name);
+    UT_ASSERT_EQUAL(0, buffer->enabled);
+}
+
+ut_test(nothing_is_recorded_before_init)
+{
+    EXATRACE(VRT_BEGIN, 1, 2, 4096);
+
+    start(true);
+    UT_ASSERT_EQUAL(0, exatrace_slot_read(&buffer->slots[0], records));
+}
+
+ut_test(nothing_is_recorded_while_disabled)
+{
+    start(false);
+
+    EXATRACE(VRT_BEGIN, 1, 2, 4096);
+    UT_ASSERT_EQUAL(0, os_atomic_read(&buffer->slots[0].owner));
+}
+
+ut_test(events_are_recorded_once_enabled)
+{
+    start(false);
+
+    buffer->enabled = 1;
+    EXATRACE(VRT_BEGIN, 1, 2, 4096);
+    EXATRACE(VRT_END, 1, 0, -5);
+
+    UT_ASSERT_EQUAL(2, exatrace_slot_read(&buffer->slots[0], records));
+
+    UT_ASSERT_EQUAL(EXATRACE_VRT_BEGIN, records[0].event);
+    UT_ASSERT_EQUAL(1, records[0].id);
+    UT_ASSERT_EQUAL(2, records[0].parent);
+    UT_ASSERT_EQUAL(4096, records[0].value);
+
+    UT_ASSERT_EQUAL(EXATRACE_VRT_END, records[1].event);
+    UT_ASSERT_EQUAL(-5, (int)records[1].value);
+    UT_ASSERT(records[1].time_ns >= records[0].time_ns);
+}
+
+ut_test(oldest_events_are_overwritten)
+{
+    int nb;
+    int i;
+
+    start(true);
+
+    for (i = 0; i < EXATRACE_SLOT_RECORDS + 10; i++)
+        EXATRACE(RDEV_BEGIN, i, 0, 0);
+
+    /* The oldest one left may be being overwritten */
+    nb = exatrace_slot_read(&buffer->slots[0], records);
+    UT_ASSERT_EQUAL(EXATRACE_SLOT_RECORDS - 1, nb);
+
+    for (i = 0; i < nb; i++)
+        UT_ASSERT_EQUAL(i + 11, records[i].id);
+}
+
+static void trace_thread(void *arg)
+{
+    int i;
+
+    for (i = 0; i < 100; i++)
+        EXATRACE(NBD_CLIENT_BEGIN, i, arg, 0);
+}
+
+ut_test(each_thread_has_its_slot)
+{
+    os_thread_t threads[NB_THREADS];
+    int i, s;
+
+    start(true);
+
+    for (i = 0; i < NB_THREADS; i++)
+        UT_ASSERT(os_thread_create(&threads[i], 0, trace_thread,
+                                   (void *)(uintptr_t)i));
+    for (i = 0; i < NB_THREADS; i++)
+        os_thread_join(threads[i]);
+
+    for (s = 0; s < NB_THREADS; s++)
+    {
+        uint64_t parent;
+
+        UT_ASSERT_EQUAL(100, exatrace_slot_read(&buffer->slots[s], records));
+
+        /* All the events of a slot come from the same thread */
+        parent = records[0].parent;
+        for (i = 0; i < 100; i++)
+        {
+            UT_ASSERT_EQUAL(parent, records[i].parent);
+            UT_ASSERT_EQUAL(i, records[i].id);
+            UT_ASSERT_EQUAL(s, records[i].slot);
+        }
+    }
+
+    UT_ASSERT_EQUAL(0, os_atomic_read(&buffer->lost));
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "exatrace/src/exatrace_timeline.h"
+
+#include "common/include/exa_error.h"
+
+#include <string.h>
+
+#define CLIENT  0
+#define SERVER  1
+
+#define MAX_RECORDS  4096
+
+#define NB_REQUESTS  200
+
+static exatrace_record_t records[2][MAX_RECORDS];
+static exatrace_process_t processes[2];
+static exatrace_timeline_t timeline;
+
+static void add(int p, uint64_t time_us, exatrace_event_t event, uint64_t id,
+                uint64_t parent, uint32_t value)
+{
+    exatrace_record_t *record = &records[p][processes[p].nb_records++];
+
+    UT_ASSERT(processes[p].nb_records <= MAX_RECORDS);
+
+    record->time_ns = time_us * 1000;
+    record->event = event;
+    record->id = id;
+    record->parent = parent;
+    record->value = value;
+}
+
+static void set_processes(uint32_t client_node, uint32_t server_node)
+{
+    memset(processes, 0, sizeof(processes));
+
+    strcpy(processes[CLIENT].name, "exa_clientd");
+    processes[CLIENT].node_id = client_node;
+    processes[CLIENT].records = records[CLIENT];
+
+    strcpy(processes[SERVER].name, "exa_serverd");
+    processes[SERVER].node_id = server_node;
+    processes[SERVER].records = records[SERVER];
+}
+
+/* The only child of a span, of the layer below */
+static int child(int s)
+{
+    int c = timeline.spans[s].first_child;
+
+    UT_ASSERT(c >= 0);
+    UT_ASSERT_EQUAL(-1, timeline.spans[c].next_sibling);
+    UT_ASSERT_EQUAL(timeline.spans[s].layer + 1, timeline.spans[c].layer);
+
+    return c;
+}
+
+/* An IO through all the layers, with the server on the same node */
+static void trace_io(uint64_t t)
+{
+    add(CLIENT, t + 0,  EXATRACE_TARGET_BEGIN,     7,   0,   4096);
+    add(CLIENT, t + 1,  EXATRACE_LUM_BEGIN,        100, 7,   4096);
+    add(CLIENT, t + 2,  EXATRACE_VRT_BEGIN,        200, 100, 4096);
+    add(CLIENT, t + 3,  EXATRACE_VRT_IO_BEGIN,     300, 200, 4096);
+    add(CLIENT, t + 4,  EXATRACE_NBD_CLIENT_BEGIN, 5,   300, 4096);
+    add(SERVER, t + 6,  EXATRACE_NBD_SERVER_BEGIN, 900, EXATRACE_WIRE_KEY(1, 5), 4096);
+    add(SERVER, t + 7,  EXATRACE_RDEV_BEGIN,       900, 900, 4096);
+    add(SERVER, t + 15, EXATRACE_RDEV_END,         900, 0,   0);
+    add(SERVER, t + 16, EXATRACE_NBD_SERVER_REPLY, 900, 0,   0);
+    add(SERVER, t + 18, EXATRACE_NBD_SERVER_END,   900, 0,   0);
+    add(CLIENT, t + 20, EXATRACE_NBD_CLIENT_END,   5,   0,   0);
+    add(CLIENT, t + 21, EXATRACE_VRT_IO_END,       300, 0,   0);
+    add(CLIENT, t + 22, EXATRACE_VRT_END,          200, 0,   0);
+    add(CLIENT, t + 23, EXATRACE_LUM_END,          100, 0,   0);
+    add(CLIENT, t + 25, EXATRACE_TARGET_END,       7,   0,   -5);
+}
+
+ut_cleanup()
+{
+    exatrace_timeline_free(&timeline);
+}
+
+ut_test(io_is_followed_through_the_layers)
+{
+    int root, s;
+
+    set_processes(1, 1);
+    trace_io(1000);
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_timeline_build(&timeline, processes, 2));
+    UT_ASSERT_EQUAL(1, exatrace_timeline_slowest(&timeline, &root, 1));
+
+    UT_ASSERT_EQUAL(EXATRACE_LAYER_TARGET, timeline.spans[root].layer);
+    UT_ASSERT_EQUAL(25000, timeline.spans[root].end_ns
+                           - timeline.spans[root].begin_ns);
+    UT_ASSERT_EQUAL(-5, timeline.spans[root].status);
+
+    for (s = root; timeline.spans[s].layer != EXATRACE_LAYER_RDEV; s = child(s))
+        UT_ASSERT(timeline.spans[s].complete);
+
+    /* The server spans were not shifted */
+    s = timeline.spans[s].parent;
+    UT_ASSERT_EQUAL(EXATRACE_LAYER_NBD_SERVER, timeline.spans[s].layer);
+    UT_ASSERT_EQUAL(1006000, timeline.spans[s].begin_ns);
+    UT_ASSERT_EQUAL(1, timeline.spans[s].nb_marks);
+    UT_ASSERT_EQUAL(EXATRACE_NBD_SERVER_REPLY, timeline.spans[s].mark_events[0]);
+    UT_ASSERT_EQUAL(SERVER, timeline.spans[s].process);
+}
+
+ut_test(time_not_spent_in_lower_layers_is_own_time)
+{
+    exatrace_layer_stats_t stats[EXATRACE_NB_LAYERS];
+
+    set_processes(1, 1);
+    trace_io(1000);
+    trace_io(2000);
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_timeline_build(&timeline, processes, 2));
+    exatrace_timeline_stats(&timeline, stats);
+
+    UT_ASSERT_EQUAL(2, stats[EXATRACE_LAYER_TARGET].count);
+    UT_ASSERT_EQUAL(50000, stats[EXATRACE_LAYER_TARGET].total_ns);
+    UT_ASSERT_EQUAL(25000, stats[EXATRACE_LAYER_TARGET].max_ns);
+    UT_ASSERT_EQUAL(2 * (25000 - 22000), stats[EXATRACE_LAYER_TARGET].own_ns);
+
+    /* The client waits for the server 12us of its 16us */
+    UT_ASSERT_EQUAL(2 * 4000, stats[EXATRACE_LAYER_NBD_CLIENT].own_ns);
+    UT_ASSERT_EQUAL(2 * 8000, stats[EXATRACE_LAYER_RDEV].own_ns);
+}
+
+ut_test(ended_io_without_begin_is_ignored)
+{
+    exatrace_layer_stats_t stats[EXATRACE_NB_LAYERS];
+
+    set_processes(1, 1);
+    add(CLIENT, 10, EXATRACE_VRT_END, 200, 0, 0);
+    add(CLIENT, 12, EXATRACE_VRT_BEGIN, 200, 0, 4096);
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_timeline_build(&timeline, processes, 2));
+    exatrace_timeline_stats(&timeline, stats);
+
+    UT_ASSERT_EQUAL(1, timeline.nb_spans);
+    UT_ASSERT(!timeline.spans[0].complete);
+    UT_ASSERT_EQUAL(0, stats[EXATRACE_LAYER_VRT].count);
+    UT_ASSERT_EQUAL(0, exatrace_timeline_slowest(&timeline, NULL, 0));
+}
+
+ut_test(slowest_ios_come_first)
+{
+    int roots[3];
+    int i;
+
+    set_processes(1, 1);
+    for (i = 0; i < 10; i++)
+    {
+        uint64_t duration = i == 4 ? 90 : i == 7 ? 80 : 10 + i;
+
+        add(CLIENT, 100 * i, EXATRACE_TARGET_BEGIN, i, 0, 512);
+        add(CLIENT, 100 * i + duration, EXATRACE_TARGET_END, i, 0, 0);
+    }
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_timeline_build(&timeline, processes, 2));
+    UT_ASSERT_EQUAL(3, exatrace_timeline_slowest(&timeline, roots, 3));
+
+    UT_ASSERT_EQUAL(4, timeline.spans[roots[0]].id);
+    UT_ASSERT_EQUAL(7, timeline.spans[roots[1]].id);
+    UT_ASSERT_EQUAL(9, timeline.spans[roots[2]].id);
+}
+
+ut_test(server_on_another_node_is_aligned_on_the_client)
+{
+    const int64_t offset_us = -5000000;
+    uint64_t t = 10000000;
+    int i;
+
+    set_processes(1, 2);
+
+    /* Request numbers are reused once the requests completed, and the
+     * requests are sent irregularly */
+    for (i = 0; i < NB_REQUESTS; i++, t += 10 + (i * 7) % 5)
+    {
+        uint64_t jitter = i % 3;
+
+        add(CLIENT, t, EXATRACE_NBD_CLIENT_BEGIN, i % 4, 0, 4096);
+        add(SERVER, t + 2 + jitter + offset_us, EXATRACE_NBD_SERVER_BEGIN,
+            1000 + i, EXATRACE_WIRE_KEY(1, i % 4), 4096);
+        add(SERVER, t + 6 + offset_us, EXATRACE_NBD_SERVER_END, 1000 + i, 0, 0);
+        add(CLIENT, t + 8, EXATRACE_NBD_CLIENT_END, i % 4, 0, 0);
+    }
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, exatrace_timeline_build(&timeline, processes, 2));
+
+    for (i = 0; i < timeline.nb_spans; i++)
+    {
+        const exatrace_span_t *span = &timeline.spans[i];
+        const exatrace_span_t *parent;
+        int request;
+
+        if (span->layer != EXATRACE_LAYER_NBD_SERVER)
+            continue;
+
+        request = span->id - 1000;
+        UT_ASSERT(span->parent >= 0);
+        parent = &timeline.spans[span->parent];
+
+        UT_ASSERT_EQUAL(request % 4, parent->id);
+        UT_ASSERT_EQUAL(records[CLIENT][2 * request].time_ns, parent->begin_ns);
+
+        /* Within the jitter of the estimate */
+        UT_ASSERT(span->begin_ns >= parent->begin_ns + 1000);
+        UT_ASSERT(span->end_ns <= parent->end_ns - 1000);
+    }
+}
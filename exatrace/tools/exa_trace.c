@@ -0,0 +1,515 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/** \file
+ * Control the tracing of the IO path and read the traces.
+ *
+ * The traces of the processes of a node are dumped into a file, and the
+ * files of several nodes are read together to rebuild the timelines of
+ * the IOs across the nodes.
+ */
+
+#include "exatrace/include/exatrace.h"
+#include "exatrace/src/exatrace_buffer.h"
+#include "exatrace/src/exatrace_timeline.h"
+
+#include "common/include/exa_conversion.h"
+#include "common/include/exa_error.h"
+#include "common/include/exa_names.h"
+
+#include "os/include/os_error.h"
+#include "os/include/os_file.h"
+#include "os/include/os_getopt.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_shm.h"
+#include "os/include/os_stdio.h"
+#include "os/include/os_string.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Daemons that trace the IO path */
+static const exa_daemon_id_t traced_daemons[] =
+    { EXA_DAEMON_CLIENTD, EXA_DAEMON_SERVERD };
+#define NB_TRACED_DAEMONS  (sizeof(traced_daemons) / sizeof(traced_daemons[0]))
+
+#define DEFAULT_NB_SLOWEST  10
+
+/** Header of the records of a process in a dump file */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t node_id;
+    uint32_t pid;
+    char name[EXATRACE_NAME_MAX];
+    uint64_t lost;
+    uint32_t nb_records;
+    uint32_t unused;
+} dump_header_t;
+
+static const char *self;
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Trace the IO path of the node.\n"
+        "\n"
+        "Usage: %s enable|disable|status\n"
+        "       %s dump <file>\n"
+        "       %s show [--slowest <n>] <file>...\n"
+        "\n"
+        "   enable, disable  Start or stop tracing in the running daemons\n"
+        "   status           Tell whether they trace\n"
+        "   dump             Save the events traced so far into <file>\n"
+        "   show             Rebuild the timelines of the IOs from the files dumped\n"
+        "                    on one or several nodes, and display the time spent\n"
+        "                    in each layer and the <n> slowest IOs (%d by default)\n"
+        "\n"
+        "Tracing can also be enabled when the daemons start by setting\n"
+        "%s=1 in their environment.\n"
+        "\n", self, self, self, DEFAULT_NB_SLOWEST, EXATRACE_ENV);
+}
+
+/* Map the trace buffers of a process, NULL if it does not trace */
+static os_shm_t *buffer_get(const char *name, exatrace_buffer_t **buffer)
+{
+    char id[OS_SHM_ID_MAXLEN];
+    const exatrace_buffer_t *header;
+    os_shm_t *shm;
+    bool valid;
+
+    os_snprintf(id, sizeof(id), EXATRACE_SHM_FMT, name);
+
+    /* Check the header before mapping the whole buffers */
+    shm = os_shm_get(id, offsetof(exatrace_buffer_t, slots));
+    if (shm == NULL)
+        return NULL;
+
+    header = os_shm_get_data(shm);
+    valid = header->magic == EXATRACE_MAGIC
+            && header->version == EXATRACE_VERSION
+            && header->nb_slots == EXATRACE_NB_SLOTS
+            && header->slot_records == EXATRACE_SLOT_RECORDS;
+    os_shm_release(shm);
+
+    if (!valid)
+    {
+        fprintf(stderr, "Trace buffers of %s have an unknown format\n", name);
+        return NULL;
+    }
+
+    shm = os_shm_get(id, sizeof(exatrace_buffer_t));
+    if (shm != NULL)
+        *buffer = os_shm_get_data(shm);
+
+    return shm;
+}
+
+static int set_enabled(bool enabled)
+{
+    int found = 0;
+    int i;
+
+    for (i = 0; i < NB_TRACED_DAEMONS; i++)
+    {
+        exatrace_buffer_t *buffer;
+        os_shm_t *shm = buffer_get(exa_daemon_name(traced_daemons[i]), &buffer);
+
+        if (shm == NULL)
+            continue;
+
+        buffer->enabled = enabled;
+        os_shm_release(shm);
+        found++;
+    }
+
+    if (found == 0)
+    {
+        fprintf(stderr, "No daemon is running\n");
+        return -ENOENT;
+    }
+
+    return EXA_SUCCESS;
+}
+
+static int show_status(void)
+{
+    int i;
+
+    for (i = 0; i < NB_TRACED_DAEMONS; i++)
+    {
+        exatrace_buffer_t *buffer;
+        os_shm_t *shm = buffer_get(exa_daemon_name(traced_daemons[i]), &buffer);
+        uint64_t recorded = 0;
+        int nb_slots = 0;
+        int s;
+
+        if (shm == NULL)
+        {
+            printf("%-12s not running\n", exa_daemon_name(traced_daemons[i]));
+            continue;
+        }
+
+        for (s = 0; s < EXATRACE_NB_SLOTS; s++)
+            if (os_atomic_read(&buffer->slots[s].owner) != 0)
+            {
+                recorded += buffer->slots[s].head;
+                nb_slots++;
+            }
+
+        printf("%-12s %s, %d threads, %"PRIu64" events, %d lost\n",
+               buffer->name, buffer->enabled ? "enabled" : "disabled",
+               nb_slots, recorded, os_atomic_read(&buffer->lost));
+
+        os_shm_release(shm);
+    }
+
+    return EXA_SUCCESS;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const exatrace_record_t *ra = a;
+    const exatrace_record_t *rb = b;
+
+    if (ra->time_ns != rb->time_ns)
+        return ra->time_ns < rb->time_ns ? -1 : 1;
+    return 0;
+}
+
+static int dump_process(FILE *file, const exatrace_buffer_t *buffer)
+{
+    exatrace_record_t *records;
+    dump_header_t header;
+    int nb_records = 0;
+    int s;
+
+    records = os_malloc(EXATRACE_NB_SLOTS * EXATRACE_SLOT_RECORDS
+                        * sizeof(exatrace_record_t));
+    if (records == NULL)
+        return -ENOMEM;
+
+    for (s = 0; s < EXATRACE_NB_SLOTS; s++)
+        if (os_atomic_read(&buffer->slots[s].owner) != 0)
+            nb_records += exatrace_slot_read(&buffer->slots[s],
+                                             records + nb_records);
+
+    qsort(records, nb_records, sizeof(exatrace_record_t), compare_records);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = EXATRACE_MAGIC;
+    header.version = EXATRACE_VERSION;
+    header.node_id = buffer->node_id;
+    header.pid = buffer->pid;
+    os_strlcpy(header.name, buffer->name, sizeof(header.name));
+    header.lost = os_atomic_read(&buffer->lost);
+    header.nb_records = nb_records;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1
+        || (nb_records > 0
+            && fwrite(records, sizeof(exatrace_record_t), nb_records, file)
+               != nb_records))
+    {
+        os_free(records);
+        return -EIO;
+    }
+
+    printf("%s: %d events\n", buffer->name, nb_records);
+
+    os_free(records);
+
+    return EXA_SUCCESS;
+}
+
+static int dump(const char *path)
+{
+    FILE *file;
+    int found = 0;
+    int err = EXA_SUCCESS;
+    int i;
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to create '%s': %s\n", path,
+                os_strerror(errno));
+        return -errno;
+    }
+
+    for (i = 0; i < NB_TRACED_DAEMONS && err == EXA_SUCCESS; i++)
+    {
+        exatrace_buffer_t *buffer;
+        os_shm_t *shm = buffer_get(exa_daemon_name(traced_daemons[i]), &buffer);
+
+        if (shm == NULL)
+            continue;
+
+        err = dump_process(file, buffer);
+        os_shm_release(shm);
+        found++;
+    }
+
+    if (fclose(file) != 0 && err == EXA_SUCCESS)
+        err = -EIO;
+
+    if (err != EXA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to write '%s': %s\n", path,
+                exa_error_msg(err));
+        remove(path);
+        return err;
+    }
+
+    if (found == 0)
+    {
+        fprintf(stderr, "No daemon is running\n");
+        remove(path);
+        return -ENOENT;
+    }
+
+    return EXA_SUCCESS;
+}
+
+/* Read the processes of a dump file, appended to the ones already read */
+static int load(const char *path, exatrace_process_t **processes,
+                int *nb_processes)
+{
+    dump_header_t header;
+    FILE *file;
+    int err = EXA_SUCCESS;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open '%s': %s\n", path, os_strerror(errno));
+        return -errno;
+    }
+
+    while (fread(&header, sizeof(header), 1, file) == 1)
+    {
+        exatrace_process_t *process;
+        exatrace_record_t *records;
+
+        if (header.magic != EXATRACE_MAGIC
+            || header.version != EXATRACE_VERSION)
+        {
+            fprintf(stderr, "'%s' is not a trace file\n", path);
+            err = -EINVAL;
+            break;
+        }
+
+        process = os_realloc(*processes,
+                             (*nb_processes + 1) * sizeof(exatrace_process_t));
+        records = os_malloc((header.nb_records + 1) * sizeof(exatrace_record_t));
+        if (process == NULL || records == NULL)
+        {
+            if (process != NULL)
+                *processes = process;
+            os_free(records);
+            err = -ENOMEM;
+            break;
+        }
+        *processes = process;
+
+        if (fread(records, sizeof(exatrace_record_t), header.nb_records, file)
+            != header.nb_records)
+        {
+            fprintf(stderr, "'%s' is truncated\n", path);
+            os_free(records);
+            err = -EINVAL;
+            break;
+        }
+
+        process = &(*processes)[*nb_processes];
+        os_strlcpy(process->name, header.name, sizeof(process->name));
+        process->node_id = header.node_id;
+        process->pid = header.pid;
+        process->lost = header.lost;
+        process->records = records;
+        process->nb_records = header.nb_records;
+        (*nb_processes)++;
+    }
+
+    fclose(file);
+
+    return err;
+}
+
+static double to_us(uint64_t ns)
+{
+    return ns / 1000.0;
+}
+
+static void print_span(const exatrace_timeline_t *timeline,
+                       const exatrace_process_t *processes, int s,
+                       uint64_t origin_ns, int depth)
+{
+    const exatrace_span_t *span = &timeline->spans[s];
+    int i;
+
+    printf("%*s+%-10.1f %10.1f us  %-10s %s:%u size %u status %d",
+           2 * depth, "", to_us(span->begin_ns - origin_ns),
+           to_us(span->end_ns - span->begin_ns),
+           exatrace_layer_name(span->layer), processes[span->process].name,
+           processes[span->process].node_id, span->size, span->status);
+
+    for (i = 0; i < span->nb_marks; i++)
+        printf(", %s at +%.1f", exatrace_event_name(span->mark_events[i]),
+               to_us(span->mark_ns[i] - origin_ns));
+    printf("\n");
+
+    for (i = span->first_child; i >= 0; i = timeline->spans[i].next_sibling)
+        if (timeline->spans[i].complete)
+            print_span(timeline, processes, i, origin_ns, depth + 1);
+}
+
+static int show(char *paths[], int nb_paths, int nb_slowest)
+{
+    exatrace_process_t *processes = NULL;
+    exatrace_layer_stats_t stats[EXATRACE_NB_LAYERS];
+    exatrace_timeline_t timeline;
+    int nb_processes = 0;
+    int *roots = NULL;
+    int nb_roots;
+    int err = EXA_SUCCESS;
+    int i;
+
+    for (i = 0; i < nb_paths && err == EXA_SUCCESS; i++)
+        err = load(paths[i], &processes, &nb_processes);
+
+    if (err == EXA_SUCCESS)
+    {
+        err = exatrace_timeline_build(&timeline, processes, nb_processes);
+        if (err != EXA_SUCCESS)
+            fprintf(stderr, "Failed to rebuild the timelines: %s\n",
+                    exa_error_msg(err));
+    }
+
+    if (err != EXA_SUCCESS)
+        goto done;
+
+    for (i = 0; i < nb_processes; i++)
+        if (processes[i].lost > 0)
+            printf("%s:%u lost %"PRIu64" events of threads without buffer\n",
+                   processes[i].name, processes[i].node_id, processes[i].lost);
+
+    exatrace_timeline_stats(&timeline, stats);
+
+    printf("%-10s %10s %12s %12s %12s\n", "LAYER", "IOS", "AVERAGE(us)",
+           "MAX(us)", "OWN(us)");
+    for (i = 0; i < EXATRACE_NB_LAYERS; i++)
+    {
+        if (stats[i].count == 0)
+            continue;
+
+        printf("%-10s %10"PRIu64" %12.1f %12.1f %12.1f\n",
+               exatrace_layer_name(i), stats[i].count,
+               to_us(stats[i].total_ns) / stats[i].count,
+               to_us(stats[i].max_ns),
+               to_us(stats[i].own_ns) / stats[i].count);
+    }
+
+    roots = os_malloc((nb_slowest + 1) * sizeof(int));
+    if (roots == NULL)
+    {
+        err = -ENOMEM;
+        exatrace_timeline_free(&timeline);
+        goto done;
+    }
+
+    nb_roots = exatrace_timeline_slowest(&timeline, roots, nb_slowest);
+    for (i = 0; i < nb_roots; i++)
+    {
+        printf("\nIO #%d\n", i + 1);
+        print_span(&timeline, processes, roots[i],
+                   timeline.spans[roots[i]].begin_ns, 0);
+    }
+
+    os_free(roots);
+    exatrace_timeline_free(&timeline);
+
+done:
+    for (i = 0; i < nb_processes; i++)
+    {
+        exatrace_record_t *records = (exatrace_record_t *)processes[i].records;
+        os_free(records);
+    }
+    os_free(processes);
+
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_opts[] =
+        {
+            { "help",     no_argument,       NULL, 'h' },
+            { "slowest",  required_argument, NULL, 'n' },
+            { NULL,       0,                 NULL, 0   }
+        };
+    unsigned int nb_slowest = DEFAULT_NB_SLOWEST;
+    const char *command;
+    int long_idx, err;
+
+    /* Note: this modifies argv[0] */
+    self = os_program_name(argv[0]);
+
+    while (true)
+    {
+        int c = os_getopt_long(argc, argv, "hn:", long_opts, &long_idx);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'h':
+            usage();
+            exit(0);
+            break;
+
+        case 'n':
+            if (to_uint(optarg, &nb_slowest) != 0)
+            {
+                fprintf(stderr, "Invalid number of IOs: '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+
+        default:
+            exit(1);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage();
+        exit(1);
+    }
+
+    command = argv[optind++];
+
+    if (strcmp(command, "show") == 0 && optind < argc)
+        err = show(argv + optind, argc - optind, nb_slowest);
+    else if (strcmp(command, "dump") == 0 && optind == argc - 1)
+        err = dump(argv[optind]);
+    else if (strcmp(command, "enable") == 0 && optind == argc)
+        err = set_enabled(true);
+    else if (strcmp(command, "disable") == 0 && optind == argc)
+        err = set_enabled(false);
+    else if (strcmp(command, "status") == 0 && optind == argc)
+        err = show_status();
+    else
+    {
+        fprintf(stderr, "Invalid command line\n");
+        exit(1);
+    }
+
+    return err == EXA_SUCCESS ? 0 : 1;
+}
@@ -17,6 +17,11 @@
  * messages that have a loglevel with a lower priority than the
  * currently configured loglevel.
  *
+ * In binary mode, debug and trace messages are not formatted by the
+ * client but buffered in binary (see logbin.h) and formatted by logd.
+ * Other messages are always sent right away as text, so that they are
+ * neither delayed nor lost.
+ *
  * The handling of modules is kinda ugly: the module's pointer
  * THIS_MODULE is explicitely cast to a thread id (pid_t).
  */
@@ -27,6 +32,7 @@
 #include "os/include/os_stdio.h"
 
 #include "examsg/src/objpoolapi.h"
+#include "logbin.h"
 #include "logd.h"
 #include "logd_com.h"
 
@@ -34,6 +40,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 
@@ -56,6 +63,7 @@ void exalog_static_init(void)
 void exalog_static_clean(void)
 {
    EXA_ASSERT(loglevels_shm);
+   logbin_stop();
    os_shm_release(loglevels_shm);
    loglevels_shm = NULL;
 }
@@ -98,7 +106,7 @@ log_msg(exalog_level_t level, const char *file,
 	const char *func, uint32_t line, const char *fmt, va_list al)
 {
   exalog_data_t data;
-  const exalog_level_t *loglevels;
+  const exalog_shm_t *shm;
   exalog_msg_t *msg = &data.d.log_msg;
   const char *pfile;
   size_t size;
@@ -112,17 +120,32 @@ log_msg(exalog_level_t level, const char *file,
   if (!loglevels_shm)
       return;
 
-  loglevels = os_shm_get_data(loglevels_shm);
+  shm = os_shm_get_data(loglevels_shm);
 
-  EXA_ASSERT(loglevels);
+  EXA_ASSERT(shm);
 
-  if (level > loglevels[my_cid])
+  if (level > shm->loglevels[my_cid])
     return;
 
+  if (shm->binary && level >= EXALOG_LEVEL_DEBUG)
+  {
+      va_list bin_al;
+
+      va_copy(bin_al, al);
+      r = logbin_append(level, my_cid, file, func, line, fmt, bin_al);
+      va_end(bin_al);
+
+      if (r == 0)
+      {
+          errno = saved_errno;
+          return;
+      }
+  }
+
   /*
    * Build message
    */
-  memset(&data, 0, sizeof(data));
+  memset(msg, 0, sizeof(*msg));
 
   data.type = LOG_MSG;
 
@@ -144,9 +167,8 @@ log_msg(exalog_level_t level, const char *file,
 
   /* Compute size */
   if (size > sizeof(msg->msg))
-    size = sizeof(data);
-  else
-    size += sizeof(data) - sizeof(msg->msg);
+    size = sizeof(msg->msg);
+  size += offsetof(exalog_data_t, d.log_msg.msg);
 
   r = logd_com_send(&data, size);
   if (r)
@@ -0,0 +1,527 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/** \file
+ * Binary log buffers of a logging client.
+ *
+ * A format is identified by its index in a table of the process, looked up
+ * with the addresses of the format and file name and the line of the call
+ * (they are string literals, so these do not change). Its arguments are
+ * parsed when it is first used.
+ *
+ * Threads are spread on LOGBIN_NB_RINGS ring buffers according to the
+ * address of their thread-local storage. A thread reserves room for a
+ * record with a compare and exchange, copies it and publishes it by
+ * setting its sequence, derived from the offset of the record in the
+ * ring. The flusher reads records in order as long as they are published,
+ * and zeroes them so that a sequence left by an older record is never
+ * mistaken for a published one.
+ */
+
+#include "log/src/logbin.h"
+
+#include "log/src/logd_com.h"
+#include "log/src/logfmt.h"
+
+#include "common/include/exa_assert.h"
+
+#include "os/include/os_atomic.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_process.h"
+#include "os/include/os_semaphore.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+#include "os/include/strlcpy.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+/** Number of ring buffers of a process */
+#define LOGBIN_NB_RINGS       16
+
+/** Size of a ring buffer */
+#define LOGBIN_RING_SIZE      (32 * 1024)
+
+/** Maximum size of a record */
+#define LOGBIN_RECORD_MAX     1024
+
+/** Maximum number of slots tried when looking up a format */
+#define LOGBIN_FORMAT_PROBES  16
+
+/** Longer formats are logged as text */
+#define LOGBIN_FORMAT_MAX     512
+
+/** Period of the flusher, in ms */
+#define LOGBIN_FLUSH_PERIOD   10
+
+#define LOGBIN_FLUSHER_STACK_SIZE  (64 * 1024)
+
+/** Number of times a batch is sent again, 1 ms apart, while logd has no
+ * room for it */
+#define LOGBIN_SEND_RETRIES   100
+
+#define LOGBIN_ALIGN(size, align)  (((size) + (align) - 1) & ~(size_t)((align) - 1))
+
+/* Records are aligned on the size of their header, so that there is always
+ * room for a padding record at the end of a ring, and the low bit of their
+ * offset is free to make sure a sequence is never 0 */
+#define LOGBIN_SEQ(offset)  ((int)((uint32_t)(offset) | 1))
+
+typedef struct {
+    os_atomic_t seq;     /**< LOGBIN_SEQ() of the offset once published */
+    uint32_t size;       /**< size of the record, header included */
+    uint32_t padding;    /**< whether the record only skips the end of
+                              the ring */
+    uint32_t unused;
+} logbin_hdr_t;
+
+typedef struct {
+    volatile uint64_t reserved;  /**< bytes reserved by the producers */
+    volatile uint64_t consumed;  /**< bytes read by the flusher */
+    os_atomic_t lost;            /**< messages dropped as the ring was full */
+    uint64_t data[LOGBIN_RING_SIZE / sizeof(uint64_t)];
+} logbin_ring_t;
+
+enum {
+    FORMAT_EMPTY,
+    FORMAT_FILLING,   /**< being registered */
+    FORMAT_READY,
+    FORMAT_INVALID    /**< cannot be logged in binary */
+};
+
+typedef struct {
+    os_atomic_t state;
+    const char *fmt;
+    const char *file;
+    const char *func;
+    uint32_t line;
+    int nb_args;
+    logfmt_arg_t args[LOGFMT_MAX_ARGS];
+    bool sent;        /**< definition sent to logd, used by the flusher */
+} logbin_format_t;
+
+typedef struct {
+    logbin_ring_t rings[LOGBIN_NB_RINGS];
+    logbin_format_t formats[EXALOG_MAX_FORMATS];
+    os_sem_t wakeup;           /**< posted when a ring is half full */
+    os_thread_t flusher;
+    volatile bool stop;
+    exalog_data_t batch;       /**< batch being filled by the flusher */
+} logbin_t;
+
+enum {
+    LOGBIN_NONE,
+    LOGBIN_STARTING,
+    LOGBIN_RUNNING,
+    LOGBIN_STOPPED
+};
+
+static os_atomic_t logbin_state;
+/* Not freed when stopped as other threads may still be looking at it */
+static logbin_t *logbin = NULL;
+
+static __thread char thread_marker;
+
+static logbin_ring_t *thread_ring(void)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)&thread_marker * 0x9E3779B97F4A7C15ULL;
+
+    return &logbin->rings[(hash >> 32) % LOGBIN_NB_RINGS];
+}
+
+/**
+ * Find the id of a format, registering it if needed.
+ *
+ * @return the id, -EAGAIN if it is being registered by another thread,
+ *         -ENOSPC if the table is full or the error of logfmt_parse()
+ */
+static int format_lookup(const char *file, const char *func, uint32_t line,
+                         const char *fmt)
+{
+    uint64_t hash = ((uint64_t)(uintptr_t)fmt ^ ((uint64_t)(uintptr_t)file << 1)
+                     ^ line) * 0x9E3779B97F4A7C15ULL;
+    unsigned int id = (hash >> 32) % EXALOG_MAX_FORMATS;
+    int probe;
+
+    for (probe = 0; probe < LOGBIN_FORMAT_PROBES;
+         probe++, id = (id + 1) % EXALOG_MAX_FORMATS)
+    {
+        logbin_format_t *f = &logbin->formats[id];
+        int state;
+
+        if (os_atomic_read(&f->state) == FORMAT_EMPTY
+            && os_atomic_cmpxchg(&f->state, FORMAT_EMPTY,
+                                 FORMAT_FILLING) == FORMAT_EMPTY)
+        {
+            f->fmt = fmt;
+            f->file = file;
+            f->func = func;
+            f->line = line;
+            f->nb_args = strlen(fmt) < LOGBIN_FORMAT_MAX
+                         ? logfmt_parse(fmt, f->args) : -E2BIG;
+
+            os_atomic_set(&f->state, f->nb_args >= 0 ? FORMAT_READY
+                                                     : FORMAT_INVALID);
+            return f->nb_args >= 0 ? id : f->nb_args;
+        }
+
+        state = os_atomic_read(&f->state);
+        if (state == FORMAT_FILLING)
+            return -EAGAIN;
+
+        if (f->fmt == fmt && f->file == file && f->line == line)
+            return state == FORMAT_READY ? id : -EINVAL;
+    }
+
+    return -ENOSPC;
+}
+
+static void ring_put(logbin_ring_t *ring, const void *record, uint32_t size)
+{
+    char *data = (char *)ring->data;
+    uint64_t offset, pos, pad, used;
+    logbin_hdr_t *hdr;
+
+    do
+    {
+        offset = ring->reserved;
+        pos = offset % LOGBIN_RING_SIZE;
+        pad = LOGBIN_RING_SIZE - pos < size ? LOGBIN_RING_SIZE - pos : 0;
+        used = offset - __atomic_load_n(&ring->consumed, __ATOMIC_ACQUIRE);
+
+        if (used + pad + size > LOGBIN_RING_SIZE)
+        {
+            os_atomic_inc(&ring->lost);
+            return;
+        }
+    } while (os_atomic_cmpxchg64(&ring->reserved, offset,
+                                 offset + pad + size) != offset);
+
+    if (pad != 0)
+    {
+        hdr = (logbin_hdr_t *)(data + pos);
+        hdr->size = pad;
+        hdr->padding = true;
+        os_atomic_set(&hdr->seq, LOGBIN_SEQ(offset));
+
+        offset += pad;
+        pos = 0;
+    }
+
+    /* The sequence copied is 0, it is set last */
+    hdr = (logbin_hdr_t *)(data + pos);
+    memcpy(hdr, record, size);
+    os_atomic_set(&hdr->seq, LOGBIN_SEQ(offset));
+
+    if (used <= LOGBIN_RING_SIZE / 2
+        && used + pad + size > LOGBIN_RING_SIZE / 2)
+        os_sem_post(&logbin->wakeup);
+}
+
+static void ring_add_lost(logbin_ring_t *ring, int count)
+{
+    int lost;
+
+    do
+        lost = os_atomic_read(&ring->lost);
+    while (os_atomic_cmpxchg(&ring->lost, lost, lost + count) != lost);
+}
+
+/**
+ * Account for a batch that logd did not get: its messages are reported lost
+ * with the next message of the ring, and its formats are sent again with
+ * the next messages using them.
+ */
+static void batch_drop(logbin_ring_t *ring)
+{
+    exalog_batch_t *batch = &logbin->batch.d.log_batch;
+    uint32_t offset = 0;
+    int count = 0;
+
+    while (offset < batch->size)
+    {
+        exalog_entry_t *hdr = (exalog_entry_t *)((char *)batch->data + offset);
+
+        if (hdr->type == LOG_ENTRY_FORMAT)
+            logbin->formats[((exalog_entry_format_t *)hdr)->id].sent = false;
+        else
+            count += 1 + ((exalog_entry_msg_t *)hdr)->lost;
+
+        offset += hdr->size;
+    }
+
+    if (count > 0)
+        ring_add_lost(ring, count);
+}
+
+/**
+ * Send the batch to logd.
+ *
+ * @param ring  Ring whose lost counter accounts for the batch if it cannot
+ *              be sent
+ */
+static void batch_send(logbin_ring_t *ring)
+{
+    exalog_batch_t *batch = &logbin->batch.d.log_batch;
+    int retries = 0;
+    int err;
+
+    if (batch->size == 0)
+        return;
+
+    logbin->batch.type = LOG_BATCH;
+    batch->pid = os_process_id();
+
+    /* Wait a bit for logd to make room rather than losing a whole batch,
+     * but not forever: the rings would fill up meanwhile */
+    while ((err = logd_com_send(&logbin->batch,
+                                offsetof(exalog_data_t, d.log_batch.data)
+                                + batch->size)) == -ENOSPC
+           && retries++ < LOGBIN_SEND_RETRIES)
+        os_millisleep(1);
+
+    if (err != 0)
+        batch_drop(ring);
+
+    batch->size = 0;
+}
+
+/**
+ * Make room for entries in the batch, sending it if it is too full.
+ */
+static void batch_make_room(logbin_ring_t *ring, size_t size)
+{
+    EXA_ASSERT(size <= EXALOG_BATCH_MAX);
+
+    if (logbin->batch.d.log_batch.size + size > EXALOG_BATCH_MAX)
+        batch_send(ring);
+}
+
+static void *batch_reserve(size_t size)
+{
+    exalog_batch_t *batch = &logbin->batch.d.log_batch;
+    void *entry;
+
+    EXA_ASSERT(batch->size + size <= EXALOG_BATCH_MAX);
+
+    entry = (char *)batch->data + batch->size;
+    batch->size += size;
+
+    return entry;
+}
+
+static const char *format_file(const logbin_format_t *f)
+{
+    const char *file = strrchr(f->file, '/');
+
+    return file != NULL ? file + 1 : f->file;
+}
+
+static size_t format_entry_size(const logbin_format_t *f)
+{
+    return LOGBIN_ALIGN(sizeof(exalog_entry_format_t)
+                        + strnlen(format_file(f), EXALOG_NAME_MAX - 1) + 1
+                        + strnlen(f->func, EXALOG_NAME_MAX - 1) + 1
+                        + strlen(f->fmt) + 1, sizeof(uint64_t));
+}
+
+static void batch_add_format(uint32_t id, const logbin_format_t *f)
+{
+    const char *file = format_file(f);
+    size_t file_len, func_len, fmt_len, size;
+    exalog_entry_format_t *entry;
+    char *str;
+
+    file_len = strnlen(file, EXALOG_NAME_MAX - 1) + 1;
+    func_len = strnlen(f->func, EXALOG_NAME_MAX - 1) + 1;
+    fmt_len = strlen(f->fmt) + 1;
+    size = format_entry_size(f);
+
+    entry = batch_reserve(size);
+    entry->hdr.type = LOG_ENTRY_FORMAT;
+    entry->hdr.size = size;
+    entry->id = id;
+    entry->line = f->line;
+
+    str = (char *)(entry + 1);
+    strlcpy(str, file, file_len);
+    strlcpy(str + file_len, f->func, func_len);
+    memcpy(str + file_len + func_len, f->fmt, fmt_len);
+}
+
+static void ring_drain(logbin_ring_t *ring)
+{
+    char *data = (char *)ring->data;
+    uint64_t offset = ring->consumed;
+
+    while (true)
+    {
+        logbin_hdr_t *hdr = (logbin_hdr_t *)(data + offset % LOGBIN_RING_SIZE);
+        int seq = LOGBIN_SEQ(offset);
+        uint32_t size;
+
+        /* Locked read, so that the record is not read before its sequence */
+        if (os_atomic_cmpxchg(&hdr->seq, seq, seq) != seq)
+            break;
+
+        size = hdr->size;
+
+        if (!hdr->padding)
+        {
+            exalog_entry_msg_t *msg = (exalog_entry_msg_t *)(hdr + 1);
+            logbin_format_t *f = &logbin->formats[msg->id];
+            exalog_entry_msg_t *entry;
+
+            /* A message is in the same batch as the definition of its
+             * format, if any: when a batch is dropped, the formats it
+             * defined are sent again before they are used */
+            batch_make_room(ring, msg->hdr.size
+                                  + (f->sent ? 0 : format_entry_size(f)));
+
+            if (!f->sent)
+            {
+                batch_add_format(msg->id, f);
+                f->sent = true;
+            }
+
+            entry = batch_reserve(msg->hdr.size);
+            memcpy(entry, msg, msg->hdr.size);
+            entry->lost = os_atomic_xchg(&ring->lost, 0);
+        }
+
+        memset(hdr, 0, size);
+        offset += size;
+
+        /* The flusher is the only writer of consumed: a release store is
+         * enough to publish it, and makes sure the record is cleared
+         * before its room is reserved again */
+        __atomic_store_n(&ring->consumed, offset, __ATOMIC_RELEASE);
+    }
+}
+
+static void logbin_flush(void)
+{
+    int i;
+
+    for (i = 0; i < LOGBIN_NB_RINGS; i++)
+        ring_drain(&logbin->rings[i]);
+
+    /* The batch holds messages of any ring: if it is lost, the first ring
+     * reports it */
+    batch_send(&logbin->rings[0]);
+}
+
+static void logbin_flusher(void *unused)
+{
+    while (!logbin->stop)
+    {
+        os_sem_waittimeout(&logbin->wakeup, LOGBIN_FLUSH_PERIOD);
+        logbin_flush();
+    }
+
+    logbin_flush();
+}
+
+/**
+ * Set up the buffers and the flusher of the process.
+ *
+ * @return true if binary logging is possible
+ */
+static bool logbin_start(void)
+{
+    logbin_t *lb;
+
+    if (os_atomic_read(&logbin_state) == LOGBIN_RUNNING)
+        return true;
+
+    /* Another thread is starting it, or it was stopped */
+    if (os_atomic_cmpxchg(&logbin_state, LOGBIN_NONE,
+                          LOGBIN_STARTING) != LOGBIN_NONE)
+        return false;
+
+    lb = os_malloc(sizeof(logbin_t));
+    if (lb == NULL)
+    {
+        os_atomic_set(&logbin_state, LOGBIN_STOPPED);
+        return false;
+    }
+
+    memset(lb, 0, sizeof(*lb));
+    os_sem_init(&lb->wakeup, 0);
+    logbin = lb;
+
+    if (!os_thread_create(&lb->flusher, LOGBIN_FLUSHER_STACK_SIZE,
+                          logbin_flusher, NULL))
+    {
+        os_atomic_set(&logbin_state, LOGBIN_STOPPED);
+        return false;
+    }
+
+    os_atomic_set(&logbin_state, LOGBIN_RUNNING);
+
+    return true;
+}
+
+void logbin_stop(void)
+{
+    if (os_atomic_cmpxchg(&logbin_state, LOGBIN_RUNNING,
+                          LOGBIN_STOPPED) != LOGBIN_RUNNING)
+        return;
+
+    logbin->stop = true;
+    os_sem_post(&logbin->wakeup);
+    os_thread_join(logbin->flusher);
+}
+
+int logbin_append(exalog_level_t level, ExamsgID cid, const char *file,
+                  const char *func, uint32_t line, const char *fmt,
+                  va_list al)
+{
+    uint64_t record[LOGBIN_RECORD_MAX / sizeof(uint64_t)];
+    logbin_hdr_t *hdr = (logbin_hdr_t *)record;
+    exalog_entry_msg_t *msg = (exalog_entry_msg_t *)(hdr + 1);
+    const logbin_format_t *f;
+    struct timeval now;
+    size_t size;
+    int id, n;
+
+    if (!logbin_start())
+        return -EAGAIN;
+
+    id = format_lookup(file, func, line, fmt);
+    if (id < 0)
+        return id;
+
+    f = &logbin->formats[id];
+    n = logfmt_encode(f->args, f->nb_args, msg + 1,
+                      sizeof(record) - sizeof(*hdr) - sizeof(*msg), al);
+    if (n < 0)
+        return n;
+
+    os_gettimeofday(&now);
+
+    size = LOGBIN_ALIGN(sizeof(*hdr) + sizeof(*msg) + n, sizeof(*hdr));
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->size = size;
+
+    msg->hdr.type = LOG_ENTRY_MSG;
+    msg->hdr.size = size - sizeof(*hdr);
+    msg->id = id;
+    msg->lost = 0;
+    msg->level = level;
+    msg->cid = cid;
+    msg->usec = now.tv_usec;
+    msg->sec = now.tv_sec;
+    msg->args_size = n;
+
+    ring_put(thread_ring(), record, size);
+
+    return 0;
+}
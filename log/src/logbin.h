@@ -0,0 +1,53 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __LOGBIN_H
+#define __LOGBIN_H
+
+/** \file
+ * Binary log buffers of a logging client.
+ *
+ * Messages are copied unformatted (format id and raw arguments) in
+ * lock-free ring buffers shared by the threads of the process, and a
+ * flusher thread sends them by batches to logd, which formats them.
+ */
+
+#include "log/include/log.h"
+
+#include <stdarg.h>
+
+/**
+ * Log a message in binary.
+ *
+ * The buffers and their flusher are set up on the first call. When the
+ * buffer of the calling thread is full, the message is dropped and counted
+ * as lost.
+ *
+ * @param[in] level  Log level
+ * @param[in] cid    Component id
+ * @param[in] file   File name
+ * @param[in] func   Function name
+ * @param[in] line   Line number
+ * @param[in] fmt    Message format, printf syntax
+ * @param[in] al     Argument list
+ *
+ * @return 0 if the message was handled (logged or lost), a negative error
+ *         code if it must be logged as text instead
+ */
+int logbin_append(exalog_level_t level, ExamsgID cid, const char *file,
+                  const char *func, uint32_t line, const char *fmt,
+                  va_list al);
+
+/**
+ * Flush the binary log buffers and stop their flusher.
+ *
+ * Messages logged afterwards are logged as text.
+ */
+void logbin_stop(void);
+
+#endif /* __LOGBIN_H */
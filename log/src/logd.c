@@ -24,6 +24,7 @@
 #include "os/include/os_syslog.h"
 #include "os/include/os_error.h"
 #include "os/include/os_stdio.h"
+#include "os/include/os_mem.h"
 
 #include "common/include/exa_constants.h"
 #include "common/include/threadonize.h"
@@ -36,6 +37,24 @@
 
 #include "logd.h"
 #include "logd_com.h"
+#include "logfmt.h"
+
+/** Maximum number of processes whose binary formats are kept */
+#define LOG_BIN_PROCESSES  32
+
+/** Binary format of a process */
+typedef struct {
+  char file[EXALOG_NAME_MAX];
+  char func[EXALOG_NAME_MAX];
+  uint32_t line;
+  char *fmt;
+} log_format_t;
+
+/** Binary formats of a process, indexed by id */
+typedef struct {
+  os_pid_t pid;
+  log_format_t *formats[EXALOG_MAX_FORMATS];
+} log_process_t;
 
 /** Log file name */
 static char exalog_file[OS_PATH_MAX];
@@ -50,6 +69,9 @@ static bool need_reopen;  /**< Need to reopen the log file ? */
 
 static os_thread_t thr_log;
 
+static log_process_t *bin_processes[LOG_BIN_PROCESSES];
+static unsigned int bin_next_evicted;  /**< next process to forget */
+
 /** Log level names */
 static const char *loglevel_tab[] =
   {
@@ -133,7 +155,8 @@ int log_init(const char *logfile_name)
 {
     int ret;
     ExamsgID id;
-    exalog_level_t *ll;
+    exalog_shm_t *shm;
+    const char *binary;
     char name[EXA_MAXSIZE_HOSTNAME + 1] = "localhost";
 
     /* make sure init is done only once */
@@ -148,10 +171,13 @@ int log_init(const char *logfile_name)
     if (!p_loglevels_shm)
 	return -ENOMEM;
 
-    ll = os_shm_get_data(p_loglevels_shm);
+    shm = os_shm_get_data(p_loglevels_shm);
     /* Reset log levels to default when starting */
     for (id = EXAMSG_FIRST_ID; id <= EXAMSG_LAST_ID; id++)
-	ll[id] = EXALOG_DEFAULT_LEVEL;
+	shm->loglevels[id] = EXALOG_DEFAULT_LEVEL;
+
+    binary = getenv(EXALOG_BINARY_ENV);
+    shm->binary = binary != NULL && strcmp(binary, "1") == 0;
 
     os_host_canonical_name("localhost", name, sizeof(name));
 
@@ -188,10 +214,33 @@ int log_init(const char *logfile_name)
 /**
  * Shutdown logging facility.
  */
+static void log_process_free(log_process_t *proc)
+{
+  int id;
+
+  for (id = 0; id < EXALOG_MAX_FORMATS; id++)
+    if (proc->formats[id])
+      {
+	os_free(proc->formats[id]->fmt);
+	os_free(proc->formats[id]);
+      }
+
+  os_free(proc);
+}
+
 static void log_exit(void)
 {
+    int i;
+
     logd_com_exit();
 
+    for (i = 0; i < LOG_BIN_PROCESSES; i++)
+	if (bin_processes[i])
+	{
+	    log_process_free(bin_processes[i]);
+	    bin_processes[i] = NULL;
+	}
+
     os_shm_delete(p_loglevels_shm);
 
     if (logfile)
@@ -319,7 +368,7 @@ log_rotate(void)
 static void
 log_configure(const exalog_config_t *cfg)
 {
-  exalog_level_t *loglevels = os_shm_get_data(p_loglevels_shm);
+  exalog_shm_t *shm = os_shm_get_data(p_loglevels_shm);
   int c, cmin, cmax;
 
   EXA_ASSERT(EXAMSG_ID_VALID(cfg->component)
@@ -334,18 +383,18 @@ log_configure(const exalog_config_t *cfg)
     cmin = cmax = cfg->component;
 
   for (c = cmin; c <= cmax; c++)
-      loglevels[c] = cfg->level;
+      shm->loglevels[c] = cfg->level;
 }
 
 /**
- * Append a message to the log.
+ * Write a message to the log, without flushing it.
  *
  * \param[in] msg  Log message
  *
  * \return 0 on success, a negative error code otherwise
  */
 static int
-log_append(const exalog_msg_t *msg)
+log_write(const exalog_msg_t *msg)
 {
   int ret;
   struct tm date;
@@ -422,9 +471,6 @@ log_append(const exalog_msg_t *msg)
 #endif
       if (ret<0)
 	return ret;
-
-      if (fflush(logfile))
-	return -errno;
     }
 
 #ifdef DEBUG
@@ -476,12 +522,209 @@ log_append(const exalog_msg_t *msg)
   if (ret < 0)
     return ret;
 
+  return 0;
+}
+
+/**
+ * Append a message to the log.
+ *
+ * \param[in] msg  Log message
+ *
+ * \return 0 on success, a negative error code otherwise
+ */
+static int
+log_append(const exalog_msg_t *msg)
+{
+  int ret = log_write(msg);
+
+  if (ret)
+    return ret;
+
   if (fflush(logfile))
     return -errno;
 
   return 0;
 }
 
+/**
+ * Get the binary formats of a process, forgetting the ones of the oldest
+ * process known when there are too many.
+ *
+ * \param[in] pid  Process id
+ *
+ * \return the formats or NULL if out of memory
+ */
+static log_process_t *
+log_process_get(os_pid_t pid)
+{
+  log_process_t *proc;
+  int i;
+
+  for (i = 0; i < LOG_BIN_PROCESSES; i++)
+    if (bin_processes[i] && bin_processes[i]->pid == pid)
+      return bin_processes[i];
+
+  proc = os_malloc(sizeof(log_process_t));
+  if (!proc)
+    return NULL;
+
+  memset(proc, 0, sizeof(*proc));
+  proc->pid = pid;
+
+  i = bin_next_evicted;
+  bin_next_evicted = (bin_next_evicted + 1) % LOG_BIN_PROCESSES;
+
+  if (bin_processes[i])
+    log_process_free(bin_processes[i]);
+  bin_processes[i] = proc;
+
+  return proc;
+}
+
+/**
+ * Record the definition of a binary format. A format defined again
+ * replaces the old one, as a pid may have been reused.
+ *
+ * \param[in] proc   Process
+ * \param[in] entry  Definition
+ */
+static void
+log_format_define(log_process_t *proc, const exalog_entry_format_t *entry)
+{
+  const char *file = (const char *)(entry + 1);
+  const char *end = (const char *)entry + entry->hdr.size;
+  const char *func, *fmt;
+  log_format_t *f;
+
+  if (entry->id >= EXALOG_MAX_FORMATS)
+    return;
+
+  func = memchr(file, '\0', end - file);
+  if (!func)
+    return;
+  func++;
+
+  fmt = memchr(func, '\0', end - func);
+  if (!fmt)
+    return;
+  fmt++;
+
+  if (!memchr(fmt, '\0', end - fmt))
+    return;
+
+  f = proc->formats[entry->id];
+  if (!f)
+    {
+      f = os_malloc(sizeof(log_format_t));
+      if (!f)
+	return;
+      proc->formats[entry->id] = f;
+    }
+  else
+    os_free(f->fmt);
+
+  strlcpy(f->file, file, sizeof(f->file));
+  strlcpy(f->func, func, sizeof(f->func));
+  f->line = entry->line;
+  f->fmt = os_strdup(fmt);
+}
+
+/**
+ * Format a binary message and write it to the log, without flushing it.
+ *
+ * \param[in] proc   Process
+ * \param[in] entry  Message
+ *
+ * \return 0 on success, a negative error code otherwise
+ */
+static int
+log_write_entry(const log_process_t *proc, const exalog_entry_msg_t *entry)
+{
+  const log_format_t *f = NULL;
+  exalog_msg_t msg;
+
+  if (!EXALOG_LEVEL_IS_VALID(entry->level)
+      || entry->level == EXALOG_LEVEL_NONE
+      || !EXAMSG_ID_VALID(entry->cid))
+    return 0;
+
+  if (entry->id < EXALOG_MAX_FORMATS)
+    f = proc->formats[entry->id];
+
+  memset(&msg, 0, sizeof(msg));
+
+  if (!f || !f->fmt)
+    os_snprintf(msg.msg, sizeof(msg.msg),
+		"unknown binary log format %u", entry->id);
+  else
+    {
+      strlcpy(msg.file, f->file, sizeof(msg.file));
+      strlcpy(msg.func, f->func, sizeof(msg.func));
+      msg.line = f->line;
+
+      if (entry->args_size > entry->hdr.size - sizeof(*entry)
+	  || logfmt_decode(f->fmt, entry + 1, entry->args_size,
+			   msg.msg, sizeof(msg.msg)))
+	os_snprintf(msg.msg, sizeof(msg.msg),
+		    "malformed binary log message for '%s'", f->fmt);
+    }
+
+  msg.rclock.tv_sec = entry->sec;
+  msg.rclock.tv_usec = entry->usec;
+  msg.level = entry->level;
+  msg.cid = entry->cid;
+  msg.lost = entry->lost;
+
+  return log_write(&msg);
+}
+
+/**
+ * Append a batch of binary messages to the log, flushing it once.
+ *
+ * \param[in] batch  Batch
+ *
+ * \return 0 on success, a negative error code otherwise
+ */
+static int
+log_batch(const exalog_batch_t *batch)
+{
+  const char *data = (const char *)batch->data;
+  log_process_t *proc = log_process_get(batch->pid);
+  uint32_t pos = 0;
+  int ret = 0;
+
+  if (!proc)
+    return 0;
+
+  while (ret == 0 && pos + sizeof(exalog_entry_t) <= batch->size)
+    {
+      const exalog_entry_t *entry = (const exalog_entry_t *)(data + pos);
+
+      if (entry->size < sizeof(*entry) || entry->size > batch->size - pos)
+	break;
+
+      switch (entry->type)
+	{
+	case LOG_ENTRY_FORMAT:
+	  if (entry->size > sizeof(exalog_entry_format_t))
+	    log_format_define(proc, (const exalog_entry_format_t *)entry);
+	  break;
+
+	case LOG_ENTRY_MSG:
+	  if (entry->size >= sizeof(exalog_entry_msg_t))
+	    ret = log_write_entry(proc, (const exalog_entry_msg_t *)entry);
+	  break;
+	}
+
+      pos += entry->size;
+    }
+
+  if (fflush(logfile) && ret == 0)
+    ret = -errno;
+
+  return ret;
+}
+
 /**
  * Suspend logging.
  *
@@ -540,7 +783,11 @@ void exalog_loop(void *dummy)
 	      break;
 
 	  case LOG_MSG:
-	      err = log_append(&logmsg.d.log_msg);
+	  case LOG_BATCH:
+	      if (logmsg.type == LOG_MSG)
+		  err = log_append(&logmsg.d.log_msg);
+	      else
+		  err = log_batch(&logmsg.d.log_batch);
 	      if (err)
 	      {
 		  os_syslog(OS_SYSLOG_DEBUG,
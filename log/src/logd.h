@@ -17,9 +17,18 @@
 
 #include "log/include/log.h"
 
-#define EXALOG_SHM_SIZE (sizeof(exalog_level_t) * (EXAMSG_LAST_ID + 1))
+/** Logging configuration shared with the clients */
+typedef struct exalog_shm {
+  exalog_level_t loglevels[EXAMSG_LAST_ID + 1];  /**< level of each component */
+  bool binary;  /**< log debug and trace messages in binary, see logbin.h */
+} exalog_shm_t;
+
+#define EXALOG_SHM_SIZE sizeof(exalog_shm_t)
 #define EXALOG_SHM_ID   "exanodes-log"
 
+/** Environment variable enabling the binary logging mode when set to 1 */
+#define EXALOG_BINARY_ENV  "EXANODES_LOG_BINARY"
+
 /* Default loglevel */
 #if defined(WITH_TRACE)
 #define EXALOG_DEFAULT_LEVEL  EXALOG_LEVEL_TRACE
@@ -11,6 +11,7 @@
 
 #include <os/include/os_inttypes.h>
 #include <os/include/os_time.h>
+#include <os/include/os_process.h>
 
 #include "log/include/log.h"
 
@@ -35,11 +36,53 @@ typedef struct exalog_msg {
   char msg[EXALOG_MSG_MAX];		/**< text */
 } exalog_msg_t;
 
+/** Maximum number of binary formats of a process */
+#define EXALOG_MAX_FORMATS  4096
+
+/** Maximum size of the entries of a batch */
+#define EXALOG_BATCH_MAX  4000
+
+/** Batch of binary log entries of a process, see logbin.c.
+ * Entries are aligned on 8 bytes and start with an exalog_entry_t. */
+typedef struct exalog_batch {
+  os_pid_t pid;				/**< process that logged */
+  uint32_t size;			/**< size of the entries */
+  uint64_t data[EXALOG_BATCH_MAX / sizeof(uint64_t)];
+} exalog_batch_t;
+
+typedef struct exalog_entry {
+  enum { LOG_ENTRY_FORMAT, LOG_ENTRY_MSG } type;
+  uint32_t size;			/**< size of the entry, header included */
+} exalog_entry_t;
+
+/** Definition of a format id, sent before the first message using it.
+ * It is followed by the file name, function name and format, each one
+ * NUL terminated. */
+typedef struct exalog_entry_format {
+  exalog_entry_t hdr;
+  uint32_t id;				/**< format id */
+  uint32_t line;			/**< line number */
+} exalog_entry_format_t;
+
+/** Binary log message, followed by its arguments as encoded by
+ * logfmt_encode() */
+typedef struct exalog_entry_msg {
+  exalog_entry_t hdr;
+  uint32_t id;				/**< format id */
+  uint32_t lost;			/**< messages lost before this one */
+  uint16_t level;			/**< log level */
+  uint16_t cid;				/**< component id */
+  uint32_t usec;			/**< microseconds of the date */
+  int64_t sec;				/**< seconds of the date */
+  uint32_t args_size;			/**< size of the arguments */
+} exalog_entry_msg_t;
+
 typedef struct exalog_data {
-    enum { LOG_CONFIG, LOG_HOST, LOG_MSG, LOG_QUIT } type;
+    enum { LOG_CONFIG, LOG_HOST, LOG_MSG, LOG_BATCH, LOG_QUIT } type;
     union {
 	exalog_config_t log_config;
 	exalog_msg_t    log_msg;
+	exalog_batch_t  log_batch;
 	char hostname[EXA_MAXSIZE_HOSTNAME + 1];
     } d;
 } exalog_data_t;
@@ -12,9 +12,15 @@
 #include "logd_com.h"
 #include <errno.h>
 
-/** Maximum number of log messages in the mailbox */
+/** Maximum number of text log messages in the mailbox */
 #define EXALOG_MAX_MESSAGES  128
 
+/* Messages take the room they need in the mailbox: size it in exalog_data_t,
+ * which includes the batches of binary messages, but with the room of
+ * EXALOG_MAX_MESSAGES text messages */
+#define EXALOG_MBOX_MESSAGES \
+  (EXALOG_MAX_MESSAGES * sizeof(exalog_msg_t) / sizeof(exalog_data_t))
+
 static ExamsgHandle mh;  /**< Examsg handle */
 
 int logd_com_init(void)
@@ -30,7 +36,8 @@ int logd_com_init(void)
     }
 
   /* Create local mailbox */
-  s = examsgAddMbox(mh, EXAMSG_LOGD_ID, EXALOG_MAX_MESSAGES, sizeof(exalog_msg_t));
+  s = examsgAddMbox(mh, EXAMSG_LOGD_ID, EXALOG_MBOX_MESSAGES,
+                    sizeof(exalog_data_t));
   if (s)
     {
       os_syslog(OS_SYSLOG_ERROR, "Cannot log mailbox mailbox, error = %d", s);
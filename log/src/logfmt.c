@@ -0,0 +1,480 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "log/src/logfmt.h"
+
+#include "log/include/log.h"
+
+#include "os/include/os_stdio.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+/** Size of an encoded argument other than a string */
+#define LOGFMT_ARG_SIZE  sizeof(uint64_t)
+
+/** Length of an encoded NULL string */
+#define LOGFMT_NULL_STRING  0xFFFF
+
+/** Maximum length of a conversion specification */
+#define LOGFMT_SPEC_MAX  32
+
+/** Conversion specification of a format */
+typedef struct {
+    size_t len;          /**< length in the format */
+    bool literal;        /**< "%%" */
+    bool width_star;     /**< width given by an argument */
+    int precision;       /**< LOGFMT_PRECISION_xxx or the precision */
+    logfmt_kind_t kind;  /**< type of the argument */
+} logfmt_spec_t;
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Scan the conversion specification at the start of a format.
+ *
+ * @param[in]  fmt   Format, starting with a '%'
+ * @param[out] spec  Conversion specification
+ *
+ * @return 0 if successful, -EINVAL if the conversion cannot be encoded
+ */
+static int scan_spec(const char *fmt, logfmt_spec_t *spec)
+{
+    enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T } len;
+    const char *p = fmt + 1;
+    const char *q;
+
+    spec->literal = false;
+    spec->width_star = false;
+    spec->precision = LOGFMT_PRECISION_NONE;
+
+    if (*p == '%')
+    {
+        spec->literal = true;
+        spec->len = 2;
+        return 0;
+    }
+
+    /* Positional arguments ("%1$d") */
+    for (q = p; is_digit(*q); q++)
+        ;
+    if (*q == '$')
+        return -EINVAL;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL)
+        p++;
+
+    if (*p == '*')
+    {
+        spec->width_star = true;
+        p++;
+    }
+    else
+        while (is_digit(*p))
+            p++;
+
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->precision = LOGFMT_PRECISION_STAR;
+            p++;
+        }
+        else
+        {
+            spec->precision = 0;
+            while (is_digit(*p))
+            {
+                spec->precision = spec->precision * 10 + *p - '0';
+                if (spec->precision > INT16_MAX)
+                    return -EINVAL;
+                p++;
+            }
+        }
+    }
+
+    switch (*p)
+    {
+    case 'h':
+        p++;
+        len = LEN_H;
+        if (*p == 'h')
+        {
+            p++;
+            len = LEN_HH;
+        }
+        break;
+    case 'l':
+        p++;
+        len = LEN_L;
+        if (*p == 'l')
+        {
+            p++;
+            len = LEN_LL;
+        }
+        break;
+    case 'q':
+        p++;
+        len = LEN_LL;
+        break;
+    case 'j':
+        p++;
+        len = LEN_J;
+        break;
+    case 'z':
+        p++;
+        len = LEN_Z;
+        break;
+    case 't':
+        p++;
+        len = LEN_T;
+        break;
+    default:
+        len = LEN_NONE;
+        break;
+    }
+
+    switch (*p)
+    {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        switch (len)
+        {
+        case LEN_NONE: case LEN_HH: case LEN_H: spec->kind = LOGFMT_INT; break;
+        case LEN_L: spec->kind = LOGFMT_LONG; break;
+        case LEN_LL: spec->kind = LOGFMT_LLONG; break;
+        case LEN_J: spec->kind = LOGFMT_INTMAX; break;
+        case LEN_Z: spec->kind = LOGFMT_SIZE; break;
+        case LEN_T: spec->kind = LOGFMT_PTRDIFF; break;
+        }
+        break;
+
+    case 'e': case 'E': case 'f': case 'F':
+    case 'g': case 'G': case 'a': case 'A':
+        /* "l" has no effect on doubles, long doubles are not handled */
+        if (len != LEN_NONE && len != LEN_L)
+            return -EINVAL;
+        spec->kind = LOGFMT_DOUBLE;
+        break;
+
+    case 'c':
+        if (len != LEN_NONE)
+            return -EINVAL;
+        spec->kind = LOGFMT_INT;
+        break;
+
+    case 's':
+        if (len != LEN_NONE)
+            return -EINVAL;
+        spec->kind = LOGFMT_STRING;
+        break;
+
+    case 'p':
+        if (len != LEN_NONE)
+            return -EINVAL;
+        spec->kind = LOGFMT_PTR;
+        break;
+
+    default:
+        /* %n, %m (errno is not the caller's one anymore), wide characters,
+         * long doubles, end of the format... */
+        return -EINVAL;
+    }
+
+    spec->len = p + 1 - fmt;
+    if (spec->len >= LOGFMT_SPEC_MAX)
+        return -EINVAL;
+
+    return 0;
+}
+
+int logfmt_parse(const char *fmt, logfmt_arg_t *args)
+{
+    int nb_args = 0;
+    const char *p = fmt;
+
+    while ((p = strchr(p, '%')) != NULL)
+    {
+        logfmt_spec_t spec;
+        int err = scan_spec(p, &spec);
+
+        if (err != 0)
+            return err;
+
+        p += spec.len;
+        if (spec.literal)
+            continue;
+
+        if (nb_args + spec.width_star
+            + (spec.precision == LOGFMT_PRECISION_STAR) + 1 > LOGFMT_MAX_ARGS)
+            return -E2BIG;
+
+        if (spec.width_star)
+        {
+            args[nb_args].kind = LOGFMT_INT;
+            args[nb_args].precision = LOGFMT_PRECISION_NONE;
+            nb_args++;
+        }
+
+        if (spec.precision == LOGFMT_PRECISION_STAR)
+        {
+            args[nb_args].kind = LOGFMT_INT;
+            args[nb_args].precision = LOGFMT_PRECISION_NONE;
+            nb_args++;
+        }
+
+        args[nb_args].kind = spec.kind;
+        args[nb_args].precision = spec.kind == LOGFMT_STRING ? spec.precision
+                                                             : LOGFMT_PRECISION_NONE;
+        nb_args++;
+    }
+
+    return nb_args;
+}
+
+int logfmt_encode(const logfmt_arg_t *args, int nb_args, void *buf,
+                  size_t size, va_list al)
+{
+    char *out = buf;
+    size_t fixed = 0, used = 0;
+    int last_int = -1;
+    int i;
+
+    /* Strings share what is left once the other arguments are counted */
+    for (i = 0; i < nb_args; i++)
+        fixed += args[i].kind == LOGFMT_STRING ? sizeof(uint16_t)
+                                               : LOGFMT_ARG_SIZE;
+    if (fixed > size)
+        return -ENOSPC;
+
+    for (i = 0; i < nb_args; i++)
+    {
+        uint64_t value = 0;
+        double d;
+
+        switch ((logfmt_kind_t)args[i].kind)
+        {
+        case LOGFMT_INT:
+            last_int = va_arg(al, int);
+            value = (uint64_t)(int64_t)last_int;
+            break;
+        case LOGFMT_LONG:
+            value = (uint64_t)va_arg(al, long);
+            break;
+        case LOGFMT_LLONG:
+            value = (uint64_t)va_arg(al, long long);
+            break;
+        case LOGFMT_SIZE:
+            value = (uint64_t)va_arg(al, size_t);
+            break;
+        case LOGFMT_INTMAX:
+            value = (uint64_t)va_arg(al, intmax_t);
+            break;
+        case LOGFMT_PTRDIFF:
+            value = (uint64_t)va_arg(al, ptrdiff_t);
+            break;
+        case LOGFMT_PTR:
+            value = (uint64_t)(uintptr_t)va_arg(al, void *);
+            break;
+        case LOGFMT_DOUBLE:
+            d = va_arg(al, double);
+            memcpy(&value, &d, sizeof(value));
+            break;
+
+        case LOGFMT_STRING:
+            {
+                const char *s = va_arg(al, const char *);
+                size_t max = size - fixed;
+                uint16_t len;
+
+                if (max > EXALOG_MSG_MAX)
+                    max = EXALOG_MSG_MAX;
+                if (args[i].precision >= 0 && (size_t)args[i].precision < max)
+                    max = args[i].precision;
+                if (args[i].precision == LOGFMT_PRECISION_STAR
+                    && last_int >= 0 && (size_t)last_int < max)
+                    max = last_int;
+
+                if (s == NULL)
+                {
+                    len = LOGFMT_NULL_STRING;
+                    memcpy(out + used, &len, sizeof(len));
+                    used += sizeof(len);
+                }
+                else
+                {
+                    len = strnlen(s, max);
+                    memcpy(out + used, &len, sizeof(len));
+                    memcpy(out + used + sizeof(len), s, len);
+                    used += sizeof(len) + len;
+                    fixed += len;
+                }
+            }
+            continue;
+        }
+
+        memcpy(out + used, &value, sizeof(value));
+        used += sizeof(value);
+    }
+
+    return used;
+}
+
+/** Read the next encoded argument other than a string */
+static int decode_value(const char *buf, size_t buf_size, size_t *pos,
+                        uint64_t *value)
+{
+    if (*pos + LOGFMT_ARG_SIZE > buf_size)
+        return -EINVAL;
+
+    memcpy(value, buf + *pos, sizeof(*value));
+    *pos += LOGFMT_ARG_SIZE;
+
+    return 0;
+}
+
+/** Format a single conversion, the text of the specification being in
+ * spec_str with its stars already replaced */
+static int decode_spec(const char *spec_str, const logfmt_spec_t *spec,
+                       const char *buf, size_t buf_size, size_t *pos,
+                       char *out, size_t out_size)
+{
+    uint64_t value;
+    double d;
+
+    if (spec->kind == LOGFMT_STRING)
+    {
+        char str[EXALOG_MSG_MAX + 1];
+        uint16_t len;
+
+        if (*pos + sizeof(len) > buf_size)
+            return -EINVAL;
+        memcpy(&len, buf + *pos, sizeof(len));
+        *pos += sizeof(len);
+
+        if (len == LOGFMT_NULL_STRING)
+            return os_snprintf(out, out_size, spec_str, "(null)");
+
+        if (len > EXALOG_MSG_MAX || *pos + len > buf_size)
+            return -EINVAL;
+        memcpy(str, buf + *pos, len);
+        str[len] = '\0';
+        *pos += len;
+
+        return os_snprintf(out, out_size, spec_str, str);
+    }
+
+    if (decode_value(buf, buf_size, pos, &value) != 0)
+        return -EINVAL;
+
+    switch (spec->kind)
+    {
+    case LOGFMT_INT:
+        return os_snprintf(out, out_size, spec_str, (int)value);
+    case LOGFMT_LONG:
+        return os_snprintf(out, out_size, spec_str, (long)value);
+    case LOGFMT_LLONG:
+        return os_snprintf(out, out_size, spec_str, (long long)value);
+    case LOGFMT_SIZE:
+        return os_snprintf(out, out_size, spec_str, (size_t)value);
+    case LOGFMT_INTMAX:
+        return os_snprintf(out, out_size, spec_str, (intmax_t)value);
+    case LOGFMT_PTRDIFF:
+        return os_snprintf(out, out_size, spec_str, (ptrdiff_t)value);
+    case LOGFMT_PTR:
+        return os_snprintf(out, out_size, spec_str, (void *)(uintptr_t)value);
+    case LOGFMT_DOUBLE:
+        memcpy(&d, &value, sizeof(d));
+        return os_snprintf(out, out_size, spec_str, d);
+    case LOGFMT_STRING:
+        break;
+    }
+
+    return -EINVAL;
+}
+
+int logfmt_decode(const char *fmt, const void *buf, size_t buf_size,
+                  char *out, size_t out_size)
+{
+    const char *p = fmt;
+    size_t pos = 0, n = 0;
+
+    if (out_size == 0)
+        return -EINVAL;
+
+    while (*p != '\0')
+    {
+        char spec_str[LOGFMT_SPEC_MAX + 2 * 12];
+        logfmt_spec_t spec;
+        uint64_t width = 0, precision = 0;
+        size_t i, j;
+        int r;
+
+        if (*p != '%')
+        {
+            if (n + 1 < out_size)
+                out[n++] = *p;
+            p++;
+            continue;
+        }
+
+        if (scan_spec(p, &spec) != 0)
+            return -EINVAL;
+
+        if (spec.literal)
+        {
+            if (n + 1 < out_size)
+                out[n++] = '%';
+            p += spec.len;
+            continue;
+        }
+
+        if (spec.width_star
+            && decode_value(buf, buf_size, &pos, &width) != 0)
+            return -EINVAL;
+        if (spec.precision == LOGFMT_PRECISION_STAR
+            && decode_value(buf, buf_size, &pos, &precision) != 0)
+            return -EINVAL;
+
+        /* Replace stars by their values; a negative precision is as if
+         * there were none */
+        for (i = 0, j = 0; i < spec.len; i++)
+        {
+            if (p[i] != '*')
+                spec_str[j++] = p[i];
+            else if (p[i - 1] != '.')
+                j += os_snprintf(spec_str + j, sizeof(spec_str) - j, "%d",
+                                 (int)width);
+            else if ((int)precision >= 0)
+                j += os_snprintf(spec_str + j, sizeof(spec_str) - j, "%d",
+                                 (int)precision);
+            else
+                j--;
+        }
+        spec_str[j] = '\0';
+
+        r = decode_spec(spec_str, &spec, buf, buf_size, &pos,
+                        out + n, out_size - n);
+        if (r < 0)
+            return -EINVAL;
+
+        n += r;
+        if (n >= out_size)
+            n = out_size - 1;
+
+        p += spec.len;
+    }
+
+    out[n] = '\0';
+
+    return pos == buf_size ? 0 : -EINVAL;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __LOGFMT_H
+#define __LOGFMT_H
+
+/** \file
+ * Deferred formatting of log messages.
+ *
+ * In binary mode, the arguments of a log message are copied raw along with
+ * an identifier of its format, and the message is only formatted by logd.
+ * Both sides parse the format the same way to know the type of each
+ * argument. As logd runs on the same host as the clients, arguments are
+ * stored in their native representation.
+ */
+
+#include "os/include/os_inttypes.h"
+
+#include <stdarg.h>
+
+/** Maximum number of arguments of a format encoded in binary */
+#define LOGFMT_MAX_ARGS  16
+
+/** Type of an argument, as given by its conversion and length modifier */
+typedef enum {
+    LOGFMT_INT,        /**< int, or smaller integers promoted to int */
+    LOGFMT_LONG,       /**< long (l) */
+    LOGFMT_LLONG,      /**< long long (ll, q) */
+    LOGFMT_SIZE,       /**< size_t (z) */
+    LOGFMT_INTMAX,     /**< intmax_t (j) */
+    LOGFMT_PTRDIFF,    /**< ptrdiff_t (t) */
+    LOGFMT_PTR,        /**< pointer (p) */
+    LOGFMT_DOUBLE,     /**< double (e, f, g, a) */
+    LOGFMT_STRING      /**< string (s), copied at encoding */
+} logfmt_kind_t;
+
+/** Precision of a string conversion */
+#define LOGFMT_PRECISION_NONE  -1   /**< the string is NUL terminated */
+#define LOGFMT_PRECISION_STAR  -2   /**< given by the previous argument */
+
+typedef struct {
+    uint8_t kind;        /**< a logfmt_kind_t */
+    int16_t precision;   /**< maximum length of a string argument */
+} logfmt_arg_t;
+
+/**
+ * Find out the arguments expected by a printf format.
+ *
+ * Star widths and precisions count as int arguments. Formats which
+ * cannot be formatted later (%n, %m, positional or wide arguments, long
+ * doubles...) are refused.
+ *
+ * @param[in]  fmt      Format
+ * @param[out] args     Arguments, LOGFMT_MAX_ARGS at most
+ *
+ * @return the number of arguments, -EINVAL if the format cannot be
+ *         encoded or -E2BIG if it has more than LOGFMT_MAX_ARGS arguments
+ */
+int logfmt_parse(const char *fmt, logfmt_arg_t *args);
+
+/**
+ * Copy the arguments of a message.
+ *
+ * Strings are truncated so that the encoded arguments fit in the buffer.
+ *
+ * @param[in]  args     Arguments, as returned by logfmt_parse()
+ * @param[in]  nb_args  Number of arguments
+ * @param[out] buf      Encoded arguments
+ * @param[in]  size     Size of buf
+ * @param[in]  al       Argument list
+ *
+ * @return the size of the encoded arguments or -ENOSPC if buf is too
+ *         small even for truncated strings
+ */
+int logfmt_encode(const logfmt_arg_t *args, int nb_args, void *buf,
+                  size_t size, va_list al);
+
+/**
+ * Format a message from its encoded arguments.
+ *
+ * The message is truncated to the size of the output buffer like
+ * os_snprintf() would do.
+ *
+ * @param[in]  fmt       Format the arguments were encoded for
+ * @param[in]  buf       Encoded arguments
+ * @param[in]  buf_size  Size of the encoded arguments
+ * @param[out] out       Message
+ * @param[in]  out_size  Size of out
+ *
+ * @return 0 if successful, -EINVAL if the arguments do not match the format
+ */
+int logfmt_decode(const char *fmt, const void *buf, size_t buf_size,
+                  char *out, size_t out_size);
+
+#endif /* __LOGFMT_H */
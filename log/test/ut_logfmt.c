@@ -0,0 +1,178 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "log/include/log.h"
+#include "log/src/logfmt.h"
+
+#include "os/include/os_stdio.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+static char buf[1024];
+static char decoded[EXALOG_MSG_MAX];
+static char expected[EXALOG_MSG_MAX];
+
+/* Encode the arguments of a format in buf */
+static int encode(const char *fmt, size_t size, ...)
+{
+    logfmt_arg_t args[LOGFMT_MAX_ARGS];
+    va_list al;
+    int nb_args, n;
+
+    nb_args = logfmt_parse(fmt, args);
+    if (nb_args < 0)
+        return nb_args;
+
+    va_start(al, size);
+    n = logfmt_encode(args, nb_args, buf, size, al);
+    va_end(al);
+
+    return n;
+}
+
+/* Check that a message formatted from its encoded arguments is the same
+ * as when formatted right away */
+#define UT_ASSERT_ROUND_TRIP(fmt, ...)                                     \
+    do {                                                                    \
+        int __n = encode(fmt, sizeof(buf), __VA_ARGS__);                   \
+        UT_ASSERT(__n >= 0);                                                \
+        UT_ASSERT_EQUAL(0, logfmt_decode(fmt, buf, __n, decoded,            \
+                                         sizeof(decoded)));                 \
+        os_snprintf(expected, sizeof(expected), fmt, __VA_ARGS__);          \
+        UT_ASSERT_EQUAL_STR(expected, decoded);                             \
+    } while (0)
+
+ut_test(parse_gives_the_kind_of_arguments)
+{
+    logfmt_arg_t args[LOGFMT_MAX_ARGS];
+
+    UT_ASSERT_EQUAL(9, logfmt_parse("%d %hhx %ld %llu %zu %jd %td %p %%%s",
+                                    args));
+    UT_ASSERT_EQUAL(LOGFMT_INT, args[0].kind);
+    UT_ASSERT_EQUAL(LOGFMT_INT, args[1].kind);
+    UT_ASSERT_EQUAL(LOGFMT_LONG, args[2].kind);
+    UT_ASSERT_EQUAL(LOGFMT_LLONG, args[3].kind);
+    UT_ASSERT_EQUAL(LOGFMT_SIZE, args[4].kind);
+    UT_ASSERT_EQUAL(LOGFMT_INTMAX, args[5].kind);
+    UT_ASSERT_EQUAL(LOGFMT_PTRDIFF, args[6].kind);
+    UT_ASSERT_EQUAL(LOGFMT_PTR, args[7].kind);
+    UT_ASSERT_EQUAL(LOGFMT_STRING, args[8].kind);
+    UT_ASSERT_EQUAL(LOGFMT_PRECISION_NONE, args[8].precision);
+}
+
+ut_test(parse_counts_stars_as_int_arguments)
+{
+    logfmt_arg_t args[LOGFMT_MAX_ARGS];
+
+    UT_ASSERT_EQUAL(3, logfmt_parse("%-*.*s", args));
+    UT_ASSERT_EQUAL(LOGFMT_INT, args[0].kind);
+    UT_ASSERT_EQUAL(LOGFMT_INT, args[1].kind);
+    UT_ASSERT_EQUAL(LOGFMT_STRING, args[2].kind);
+    UT_ASSERT_EQUAL(LOGFMT_PRECISION_STAR, args[2].precision);
+
+    UT_ASSERT_EQUAL(1, logfmt_parse("%.12s", args));
+    UT_ASSERT_EQUAL(12, args[0].precision);
+}
+
+ut_test(parse_refuses_formats_that_cannot_be_deferred)
+{
+    logfmt_arg_t args[LOGFMT_MAX_ARGS];
+
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("%n", args));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("error: %m", args));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("%1$d", args));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("%Lf", args));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("%ls", args));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_parse("trailing %", args));
+    UT_ASSERT_EQUAL(-E2BIG, logfmt_parse("%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d",
+                                         args));
+}
+
+ut_test(integers_round_trip)
+{
+    UT_ASSERT_ROUND_TRIP("%d %i %u %x %o", -12, 34, 56u, 0xabcd, 8);
+    UT_ASSERT_ROUND_TRIP("%x %hx %hhd", -1, 0x12345, 300);
+    UT_ASSERT_ROUND_TRIP("%ld %lu %lld %llx", -1L, 2UL, -3LL, 0x123456789ULL);
+    UT_ASSERT_ROUND_TRIP("%zu %zd %jd %td", (size_t)-1, (ssize_t)-2,
+                         (intmax_t)-3, (ptrdiff_t)-4);
+    UT_ASSERT_ROUND_TRIP("[%08x] [%-6d] [%+d] [%#o] [%c]", 0xbeef, 42, 7, 8,
+                         'z');
+}
+
+ut_test(doubles_and_pointers_round_trip)
+{
+    UT_ASSERT_ROUND_TRIP("%f %.3e %g %lf", 3.14159, -2.5e10, 0.0001, 1.5);
+    UT_ASSERT_ROUND_TRIP("%p %p", (void *)buf, (void *)NULL);
+}
+
+ut_test(strings_round_trip)
+{
+    UT_ASSERT_ROUND_TRIP("'%s' '%10s' '%-10s' '%%'", "abc", "right", "left");
+    UT_ASSERT_ROUND_TRIP("%.3s|%.*s|%*s", "truncated", 4, "precision", 6,
+                         "width");
+    UT_ASSERT_ROUND_TRIP("%*d|%-*d|%.*s", -5, 1, 3, 2, -1, "no precision");
+}
+
+ut_test(null_string_is_decoded_as_null)
+{
+    int n = encode("%s", sizeof(buf), NULL);
+
+    UT_ASSERT(n >= 0);
+    UT_ASSERT_EQUAL(0, logfmt_decode("%s", buf, n, decoded, sizeof(decoded)));
+    UT_ASSERT_EQUAL_STR("(null)", decoded);
+}
+
+ut_test(strings_are_only_read_up_to_their_precision)
+{
+    /* Not NUL terminated */
+    const char name[4] = { 'a', 'b', 'c', 'd' };
+    int n = encode("%.4s", sizeof(buf), name);
+
+    UT_ASSERT_EQUAL(sizeof(uint16_t) + 4, n);
+    UT_ASSERT_EQUAL(0, logfmt_decode("%.4s", buf, n, decoded, sizeof(decoded)));
+    UT_ASSERT_EQUAL_STR("abcd", decoded);
+}
+
+ut_test(strings_are_truncated_to_fit_the_buffer)
+{
+    int n = encode("%s %d", 16, "a rather long string", 5);
+
+    UT_ASSERT_EQUAL(16, n);
+    UT_ASSERT_EQUAL(0, logfmt_decode("%s %d", buf, n, decoded,
+                                     sizeof(decoded)));
+    UT_ASSERT_EQUAL_STR("a rath 5", decoded);
+
+    UT_ASSERT_EQUAL(-ENOSPC, encode("%d %d", 8, 1, 2));
+}
+
+ut_test(decoded_message_is_truncated_to_the_output)
+{
+    char small[8];
+    int n = encode("%s=%d", sizeof(buf), "value", 123456);
+
+    UT_ASSERT(n >= 0);
+    UT_ASSERT_EQUAL(0, logfmt_decode("%s=%d", buf, n, small, sizeof(small)));
+    UT_ASSERT_EQUAL_STR("value=1", small);
+}
+
+ut_test(decode_refuses_arguments_not_matching_the_format)
+{
+    int n = encode("%d", sizeof(buf), 1);
+
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_decode("%d %d", buf, n, decoded,
+                                           sizeof(decoded)));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_decode("none", buf, n, decoded,
+                                           sizeof(decoded)));
+    UT_ASSERT_EQUAL(-EINVAL, logfmt_decode("%s", buf, n, decoded,
+                                           sizeof(decoded)));
+}
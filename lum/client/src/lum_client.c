@@ -33,6 +33,7 @@ int lum_client_init(ExamsgHandle mh, const lum_init_params_t *params)
 
     req.init.init_params.iscsi_queue_depth = params->iscsi_queue_depth;
     req.init.init_params.bdev_queue_depth = params->bdev_queue_depth;
+    req.init.init_params.bdev_threads = params->bdev_threads;
 
     req.init.init_params.buffer_size = params->buffer_size;
     req.init.init_params.target_listen_address = params->target_listen_address;
@@ -14,6 +14,8 @@
 #include "common/include/exa_nbd_list.h"
 #include "common/include/exa_math.h"
 
+#include "exatrace/include/exatrace.h"
+
 #include <errno.h>
 
 typedef struct
@@ -35,6 +37,12 @@ int export_io_static_init(void)
 {
     nbd_init_root(NB_IO_IN_LUM, sizeof(lum_export_io_private_t),
                   &lum_pools.io_data);
+    if (nbd_root_cache_free(&lum_pools.io_data) < 0)
+    {
+        nbd_close_root(&lum_pools.io_data);
+        return -ENOMEM;
+    }
+
     return EXA_SUCCESS;
 }
 
@@ -63,6 +71,8 @@ static void __end_io(blockdevice_io_t *bio, int err)
     lum_export_end_io_t *callback = io_private->callback;
     void *caller_private_data = io_private->caller_private_data;
 
+    EXATRACE(LUM_END, bio, 0, err);
+
     /* IO is finished, error code and data are retrieved, we can safely
      * release the bio */
     lum_io_data_put(io_private);
@@ -110,6 +120,8 @@ void lum_export_submit_io(lum_export_t *export, blockdevice_io_type_t op, bool f
     io_data->caller_private_data = bi_private;
     io_data->callback            = callback;
 
+    EXATRACE(LUM_BEGIN, bio, bi_private, size);
+
     blockdevice_submit_io(lum_export_get_blockdevice(export), bio, op, sector, buf, size,
                             flush_cache, io_data, __end_io);
 }
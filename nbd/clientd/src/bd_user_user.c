@@ -16,6 +16,8 @@
 
 #include "common/include/exa_constants.h"
 
+#include "exatrace/include/exatrace.h"
+
 #include "log/include/log.h"
 
 #include "os/include/os_string.h"
@@ -128,6 +130,7 @@ void exa_bd_end_request(const nbd_io_desc_t *io)
 
     nbd_stat_request_done(&bdq->ndev->stats, &bdq->io);
     clientd_perf_end_request(&bdq->ndev->perfs, &bdq->perfs);
+    EXATRACE(NBD_CLIENT_END, io->req_num, 0, io->result);
 
     nbd_list_post(&request_root_list.free, bdq, -1);
 
@@ -248,6 +251,7 @@ static int exa_bdset_status(const exa_uuid_t *uuid, bdminor_state_t state)
          */
         while (nbd_get_next_by_tag((void **)&bdq, (long long int)ndev, &request_root_list) == 0)
         {
+            EXATRACE(NBD_CLIENT_END, bdq->io.req_num, 0, -EIO);
             blockdevice_end_io(bdq->bio, -EIO);
             nbd_list_post(&request_root_list.free, bdq, -1);
         }
@@ -285,6 +289,7 @@ void bd_get_stats(struct nbd_stats_reply *reply, const exa_uuid_t *uuid, bool re
         return;
 
     nbd_get_stats(&ndev->stats, reply, reset);
+    peer_get_stats(ndev->holder_id, &reply->tcp);
 }
 
 static int prepare_req_header(struct bd_kerneluser_queue *bdq, int req_index)
@@ -382,6 +387,7 @@ static void exa_bdmake_request(ndev_t *ndev, blockdevice_io_t *bio)
     nbd_stat_request_begin(&ndev->stats, &bdq->io);
 
     clientd_perf_make_request(&bdq->perfs, bdq->bio->type == BLOCKDEVICE_IO_READ);
+    EXATRACE(NBD_CLIENT_BEGIN, bdq->io.req_num, bio, bio->size);
 
     header_sending(bdq->ndev->holder_id, &bdq->io);
 }
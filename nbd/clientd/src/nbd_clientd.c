@@ -33,6 +33,8 @@
 
 #include "examsg/include/examsg.h"
 
+#include "exatrace/include/exatrace.h"
+
 #include "os/include/os_daemon_child.h"
 #include "os/include/os_getopt.h"
 #include "os/include/os_mem.h"
@@ -120,6 +122,14 @@ void header_sending(exa_nodeid_t to, nbd_io_desc_t *io)
                   NULL);
 }
 
+/**
+ * Get the batching counters of the connection to a server, see the
+ * FIXME of header_sending() about hiding tcp. */
+void peer_get_stats(exa_nodeid_t nid, nbd_tcp_stats_t *stats)
+{
+    tcp_get_peer_stats(&tcp, nid, stats);
+}
+
 static bool end_receiving(exa_nodeid_t from, const nbd_io_desc_t *io, void **data)
 {
     if (io->request_type == NBD_REQ_TYPE_READ && *data == NULL)
@@ -244,6 +254,7 @@ static int cleanup_clientd(void)
     err = stop_threads();
 
     exa_perf_instance_static_clean();
+    exatrace_static_clean();
 
     return err;
 }
@@ -451,15 +462,19 @@ int daemon_init(int argc, char *argv[])
     int opt;
     exa_nodeid_t my_node_id = EXA_NODEID_NONE;
     int vrt_max_requests = 0;
+    int vrt_engine_threads = 1;
     int vrt_rebuilding_slowdown_ms = -1;
     int vrt_degraded_rebuilding_slowdown_ms = -1;
+    rain1_read_policy_t rain1_read_policy = RAIN1_READ_POLICY_LEAST_OUTSTANDING;
+    int rain1_dzone_retention_s = -1;
+    int rain1_sync_latency_target_ms = 0;
     char *net_type = NULL;
     char *node_name = NULL;
     bool barrier_enable = true;
     int bd_buffer_size = DEFAULT_BD_BUFFER_SIZE;
     int max_req_num    = DEFAULT_MAX_CLIENT_REQUESTS;
 
-    while ((opt = os_getopt(argc, argv, "B:c:n:h:s:S:t:b:p:l:A:M:")) != -1)
+    while ((opt = os_getopt(argc, argv, "B:c:n:h:s:S:R:r:L:E:t:b:p:l:A:M:")) != -1)
     {
         switch (opt)
         {
@@ -479,6 +494,16 @@ int daemon_init(int argc, char *argv[])
             }
             break;
 
+        case 'E':
+            if (to_int(optarg, &vrt_engine_threads) != EXA_SUCCESS
+                || vrt_engine_threads < 1
+                || vrt_engine_threads > VRT_MAX_ENGINE_THREADS)
+            {
+                exalog_error("Invalid number of virtualizer threads");
+                return -EXA_ERR_INVALID_PARAM;
+            }
+            break;
+
         case 'B':
             if (strcmp(optarg, "TRUE") == 0)
                 barrier_enable = true;
@@ -494,6 +519,9 @@ int daemon_init(int argc, char *argv[])
         /* network type
          * to set the TCP buffers size to 128 K, the net_type must be
          * of the form: TCP=128
+         * optionally followed by ,IO_THREADS=<n> to use n epoll based
+         * threads per direction and ,ZEROCOPY=1 to send large payloads
+         * without copy (see init_tcp())
          */
         case 'n':
             net_type = optarg;
@@ -548,6 +576,33 @@ int daemon_init(int argc, char *argv[])
             }
             break;
 
+        case 'R':
+            if (rain1_read_policy_from_str(optarg, &rain1_read_policy)
+                != EXA_SUCCESS)
+            {
+                fprintf(stderr, "Invalid rain1 read policy");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'r':
+            if (to_int(optarg, &rain1_dzone_retention_s) != EXA_SUCCESS
+                || rain1_dzone_retention_s < 0)
+            {
+                fprintf(stderr, "Invalid rain1 dirty zone retention");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'L':
+            if (to_int(optarg, &rain1_sync_latency_target_ms) != EXA_SUCCESS
+                || rain1_sync_latency_target_ms < 0)
+            {
+                fprintf(stderr, "Invalid rebuilding latency target");
+                return EXIT_FAILURE;
+            }
+            break;
+
         default:
             fprintf(stderr, "Invalid parameter %c\n", opt);
         }
@@ -568,6 +623,15 @@ int daemon_init(int argc, char *argv[])
     if (exa_perf_instance_static_init() != 0)
         return -EINVAL; /* FIXME Use better error code */
 
+    retval = exatrace_static_init(exa_daemon_name(EXA_DAEMON_CLIENTD),
+                                  my_node_id);
+    if (retval != EXA_SUCCESS)
+    {
+        exalog_error("Failed to initialize the IO tracing: %s (%d)",
+                     exa_error_msg(retval), retval);
+        return retval;
+    }
+
     retval = init_clientd(net_type, node_name, barrier_enable,
                           max_req_num, bd_buffer_size);
     if (retval != EXA_SUCCESS)
@@ -577,9 +641,13 @@ int daemon_init(int argc, char *argv[])
 
     vrt_init(my_node_id,
              vrt_max_requests,
+             vrt_engine_threads,
              barrier_enable,
              vrt_rebuilding_slowdown_ms,
-             vrt_degraded_rebuilding_slowdown_ms);
+             vrt_degraded_rebuilding_slowdown_ms,
+             rain1_read_policy,
+             rain1_dzone_retention_s,
+             rain1_sync_latency_target_ms);
 
     retval = lum_export_static_init(my_node_id);
     if (retval != EXA_SUCCESS)
@@ -613,6 +681,7 @@ error_lum_thread_create:
     vrt_exit();
 
     exa_perf_instance_static_clean();
+    exatrace_static_clean();
     os_random_cleanup();
 
     return retval;
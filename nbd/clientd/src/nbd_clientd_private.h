@@ -10,8 +10,11 @@
 #define NBD_CLIENTD_PRIVATE_H
 
 #include "nbd/common/nbd_common.h"
+#include "nbd/common/nbd_tcp.h"
 #include "common/include/exa_nodeset.h"
 
 void header_sending(exa_nodeid_t to, nbd_io_desc_t *io);
 
+void peer_get_stats(exa_nodeid_t nid, nbd_tcp_stats_t *stats);
+
 #endif /* NBD_CLIENTD_PRIVATE_H */
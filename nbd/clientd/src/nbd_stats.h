@@ -11,6 +11,7 @@
 #include "nbd/clientd/include/nbd_clientd.h"
 
 #include "nbd/common/nbd_common.h"
+#include "nbd/common/nbd_tcp.h"
 
 #include "common/include/exa_constants.h"
 
@@ -82,6 +83,9 @@ struct nbd_stats_reply
     uint64_t now;
     struct nbd_stats_begin begin;
     struct nbd_stats_done done;
+    /** Batching of the connection to the server of the device: it is shared
+     * by the devices of that server and is not reset with the other stats */
+    nbd_tcp_stats_t tcp;
 };
 
 void nbd_stat_init(struct device_stats *stats);
@@ -50,16 +50,20 @@
 
 #include "common/include/exa_constants.h"
 #include "common/include/exa_error.h"
+#include "common/include/exa_math.h"
 #include "common/include/exa_select.h"
 #include "common/include/exa_socket.h"
 #include "common/include/threadonize.h"
 
+#include "os/include/os_atomic.h"
 #include "os/include/os_compiler.h"
 #include "os/include/os_error.h"
 #include "os/include/os_file.h"
 #include "os/include/os_mem.h"
 #include "os/include/os_network.h"
+#include "os/include/os_poll.h"
 #include "os/include/os_semaphore.h"
+#include "os/include/os_stdio.h"
 #include "os/include/os_string.h"
 #include "os/include/os_thread.h"
 #include "os/include/os_time.h"
@@ -69,19 +73,48 @@
 #define SOCK_LISTEN_FLAGS 1
 #define SOCK_FLAGS 2
 
+/** Max number of I/O workers per direction in epoll mode */
+#define TCP_MAX_IO_WORKERS 16
+
+/** Max number of readiness events handled per wakeup of an I/O worker */
+#define TCP_IO_WORKER_EVENTS 16
+
+/** Minimum payload size for which zero-copy sends are used: below this,
+ * the cost of pinning pages and handling the completion notification is
+ * higher than the cost of the copy. */
+#define TCP_ZEROCOPY_MIN_SIZE (64 * 1024)
+
+/** Max number of requests and of bytes queued for a peer that are gathered
+ * in a single send. The first request is always taken whatever its size. */
+#define TCP_SEND_BATCH_MAX_REQS  16
+#define TCP_SEND_BATCH_MAX_BYTES (256 * 1024)
+
+/** Size of the per-peer buffer receiving headers: the headers of several
+ * small requests (and possibly the beginning of their payload) are fetched
+ * with a single system call and parsed from there. */
+#define TCP_RECV_STAGING_SIZE 4096
+
 typedef enum {
     DATA_TRANSFER_COMPLETE    = 1,
     DATA_TRANSFER_PENDING     = 0,
     DATA_TRANSFER_ERROR       = -1
 } transfer_status_t;
 
-typedef struct {
+typedef struct send_desc {
     void *data1;
     size_t size1;
     void *data2;
     size_t size2;
     void *ctx; /* private context of caller */
     size_t bytes_sent;
+
+    /* Zero-copy: whether some data was sent without copy, number of
+     * zero-copy sends that must be completed by the kernel before the
+     * buffers can be released, and link in the list of the peer's sends
+     * waiting for this completion. */
+    bool zerocopied;
+    uint32_t zc_seq_end;
+    struct send_desc *zc_next;
 } send_desc_t;
 
 typedef struct
@@ -92,6 +125,25 @@ typedef struct
     int nb_readwrite;
 } pending_recv_t;
 
+typedef struct
+{
+    char data[TCP_RECV_STAGING_SIZE];
+    size_t start;  /**< first byte not parsed yet */
+    size_t end;    /**< end of the received bytes */
+} recv_staging_t;
+
+/** An I/O worker of the epoll transport: it handles one direction (send or
+ * receive) for the peers whose node id modulo the number of workers is
+ * its index. */
+typedef struct
+{
+    os_thread_t tid;
+    bool        run;
+    int         idx;
+    os_poll_t  *poll;
+    nbd_tcp_t  *nbd_tcp;
+} io_worker_t;
+
 struct tcp_plugin
 {
     struct nbd_root_list send_list;
@@ -116,6 +168,13 @@ struct tcp_plugin
         int         socket;
     } accept_thread;
 
+    /** Number of I/O workers per direction when using the epoll transport,
+     * 0 when using the single send and receive threads above. */
+    int nb_io_workers;
+    bool zerocopy;  /**< use zero-copy for large payloads (epoll only) */
+    io_worker_t send_workers[TCP_MAX_IO_WORKERS];
+    io_worker_t recv_workers[TCP_MAX_IO_WORKERS];
+
     os_thread_rwlock_t peers_lock; /** lock of the peer array */
     struct peer {
         int sock;             /**< sock fd of peer */
@@ -125,8 +184,26 @@ struct tcp_plugin
         /* Internal structure initialised before calling init_plugin used to send data */
         struct nbd_list send_list;
 
-        send_desc_t *pending_send;
+        /** Requests being sent, in order. Only the first one may have been
+         * partially sent. */
+        send_desc_t *pending_send[TCP_SEND_BATCH_MAX_REQS];
+        int nb_pending_send;
+
         pending_recv_t pending_recv;
+        recv_staging_t recv_staging;
+
+        nbd_tcp_stats_t stats;
+
+        bool send_armed;      /**< socket is watched for writability by its
+                                   send worker (epoll transport only) */
+
+        /* Zero-copy sends (epoll transport only) */
+        bool zerocopy;        /**< zero-copy is enabled on the socket */
+        uint32_t zc_issued;   /**< number of zero-copy sends issued */
+        os_atomic_t zc_completed; /**< number of zero-copy sends completed,
+                                       updated by both workers */
+        send_desc_t *zc_head; /**< fully sent, waiting for completion */
+        send_desc_t *zc_tail;
     } peers[EXA_MAX_NODES_NUMBER];
     int last_peer_idx; /*< keep record of the last peer idx that was
                            registered in order not to go through the whole
@@ -141,6 +218,224 @@ static void close_socket(int socket)
     os_closesocket(socket);
 }
 
+/**
+ * Close the socket of a peer. With zero-copy sends, the kernel may still
+ * send, or retransmit, queued data from the buffers of the requests, which
+ * are released once the socket is closed (see peer_zerocopy_flush()): the
+ * connection is reset so that the queued data is dropped. Sockets linger
+ * for 0 seconds (see internal_setsock_opt()), so closing one without
+ * shutting it down first resets it.
+ */
+static void peer_close_socket(struct peer *peer)
+{
+    if (peer->zerocopy)
+        os_closesocket(peer->sock);
+    else
+        close_socket(peer->sock);
+
+    peer->sock = -1;
+}
+
+static void request_processed(send_desc_t *send_desc, nbd_tcp_t *nbd_tcp, int error)
+{
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
+
+    EXA_ASSERT(send_desc != NULL);
+
+    if (nbd_tcp->end_sending)
+        nbd_tcp->end_sending(send_desc->ctx, error);
+
+    nbd_list_post(&tcp->send_list.free, send_desc, -1);
+}
+
+/* Tells if zero-copy send sequence number a is before b, taking care of
+ * the wrap around */
+static bool zc_seq_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * Release the sends of a peer whose zero-copy sends were all completed by
+ * the kernel.
+ *
+ * Must be called by the send worker of the peer or with peers_lock held for
+ * writing.
+ */
+static void peer_zerocopy_release(nbd_tcp_t *nbd_tcp, struct peer *peer)
+{
+    while (peer->zc_head != NULL
+           && !zc_seq_before(os_atomic_read(&peer->zc_completed),
+                             peer->zc_head->zc_seq_end))
+    {
+        send_desc_t *send_desc = peer->zc_head;
+
+        peer->zc_head = send_desc->zc_next;
+        if (peer->zc_head == NULL)
+            peer->zc_tail = NULL;
+
+        request_processed(send_desc, nbd_tcp, 0);
+    }
+}
+
+/**
+ * Fetch the zero-copy completions reported by the kernel for the socket of
+ * a peer. The error queue wakes up both workers of the peer until it is
+ * empty, so both fetch them.
+ *
+ * Must be called with peers_lock held (for reading at least) and with a
+ * valid socket.
+ */
+static void peer_zerocopy_collect(struct peer *peer)
+{
+    uint32_t low, high;
+
+    while (os_sock_zerocopy_completed(peer->sock, &low, &high) > 0)
+    {
+        int completed;
+
+        do {
+            completed = os_atomic_read(&peer->zc_completed);
+            if (!zc_seq_before(completed, high + 1))
+                break;
+        } while (os_atomic_cmpxchg(&peer->zc_completed, completed,
+                                   high + 1) != completed);
+    }
+}
+
+/**
+ * Fetch the zero-copy completions reported by the kernel for the socket of
+ * a peer, and release the corresponding sends.
+ *
+ * Same locking as peer_zerocopy_release().
+ */
+static void peer_zerocopy_reap(nbd_tcp_t *nbd_tcp, struct peer *peer)
+{
+    peer_zerocopy_collect(peer);
+    peer_zerocopy_release(nbd_tcp, peer);
+}
+
+/**
+ * Release all the sends of a peer waiting for a zero-copy completion. Used
+ * when its socket is closed by peer_close_socket(), which resets the
+ * connection so that the kernel does not send from the buffers anymore.
+ *
+ * Same locking as peer_zerocopy_release().
+ */
+static void peer_zerocopy_flush(nbd_tcp_t *nbd_tcp, struct peer *peer)
+{
+    os_atomic_set(&peer->zc_completed, peer->zc_issued);
+    peer_zerocopy_release(nbd_tcp, peer);
+}
+
+/**
+ * Queue a fully sent request until the kernel completes its zero-copy
+ * sends, or release it right away if there is nothing to wait for.
+ */
+static void peer_send_done(nbd_tcp_t *nbd_tcp, struct peer *peer,
+                           send_desc_t *send_desc)
+{
+    if (!send_desc->zerocopied
+        || !zc_seq_before(os_atomic_read(&peer->zc_completed),
+                          send_desc->zc_seq_end))
+    {
+        request_processed(send_desc, nbd_tcp, 0);
+        return;
+    }
+
+    send_desc->zc_next = NULL;
+    if (peer->zc_tail != NULL)
+        peer->zc_tail->zc_next = send_desc;
+    else
+        peer->zc_head = send_desc;
+    peer->zc_tail = send_desc;
+}
+
+static bool use_io_workers(const tcp_plugin_t *tcp)
+{
+    return tcp->nb_io_workers > 0;
+}
+
+static io_worker_t *peer_send_worker(tcp_plugin_t *tcp, int idx)
+{
+    return &tcp->send_workers[idx % tcp->nb_io_workers];
+}
+
+static io_worker_t *peer_recv_worker(tcp_plugin_t *tcp, int idx)
+{
+    return &tcp->recv_workers[idx % tcp->nb_io_workers];
+}
+
+/**
+ * Register the socket of a peer with the I/O workers in charge of it.
+ * Does nothing if the epoll transport is not used.
+ *
+ * Must be called with peers_lock held for writing.
+ *
+ * @param nbd_tcp  Tcp plugin
+ * @param idx      Index of the peer
+ */
+static void peer_attach_socket(nbd_tcp_t *nbd_tcp, int idx)
+{
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
+    struct peer *peer = &tcp->peers[idx];
+    int err;
+
+    if (!use_io_workers(tcp) || peer->sock < 0)
+        return;
+
+    peer->send_armed = false;
+
+    /* Sends of a previous connection, which was closed by the caller,
+     * cannot be completed anymore */
+    peer_zerocopy_flush(nbd_tcp, peer);
+    peer->zc_issued = 0;
+    os_atomic_set(&peer->zc_completed, 0);
+    peer->zerocopy = false;
+
+    if (tcp->zerocopy)
+    {
+        err = os_sock_set_zerocopy(peer->sock);
+        if (err == 0)
+            peer->zerocopy = true;
+        else
+            exalog_warning("Cannot enable zero-copy sends to '%s': %s (%d)",
+                           peer->ip_addr, os_strerror(-err), err);
+    }
+
+    err = os_poll_add(peer_recv_worker(tcp, idx)->poll, peer->sock,
+                      OS_POLL_IN, idx);
+    if (err == 0)
+        err = os_poll_add(peer_send_worker(tcp, idx)->poll, peer->sock, 0, idx);
+
+    EXA_ASSERT_VERBOSE(err == 0, "Failed to watch socket %d of peer %d: %s (%d)",
+                       peer->sock, idx, os_strerror(-err), err);
+
+    /* Requests may have been queued while the peer was disconnected */
+    os_poll_wakeup(peer_send_worker(tcp, idx)->poll);
+}
+
+/**
+ * Unregister the socket of a peer from its I/O workers. Must be called
+ * before the socket is closed. Does nothing if the epoll transport is not
+ * used.
+ *
+ * @param tcp  Tcp plugin info
+ * @param idx  Index of the peer
+ */
+static void peer_detach_socket(tcp_plugin_t *tcp, int idx)
+{
+    struct peer *peer = &tcp->peers[idx];
+
+    if (!use_io_workers(tcp) || peer->sock < 0)
+        return;
+
+    /* Failures are harmless: the socket may already be gone */
+    os_poll_remove(peer_recv_worker(tcp, idx)->poll, peer->sock);
+    os_poll_remove(peer_send_worker(tcp, idx)->poll, peer->sock);
+    peer->send_armed = false;
+}
+
 static int internal_setsock_opt(int sock, int islisten)
 {
   int autorisation;
@@ -208,16 +503,23 @@ static int internal_setsock_opt(int sock, int islisten)
 }
 
 
+static void staging_reset(recv_staging_t *staging)
+{
+    staging->start = 0;
+    staging->end = 0;
+}
+
 /**
  * Accept a connection from a peer and inform it
  *
- * @param tcp     Tcp plugin info
+ * @param nbd_tcp Tcp plugin
  * @param socket  Socket id of the connecting peer
  * @param addr    Network address of the connecting peer
  */
-static void server_accept_peer(tcp_plugin_t *tcp, int socket,
+static void server_accept_peer(nbd_tcp_t *nbd_tcp, int socket,
 				 struct in_addr *addr)
 {
+  tcp_plugin_t *tcp = nbd_tcp->tcp;
   int idx;
 
   os_thread_rwlock_wrlock(&tcp->peers_lock);
@@ -226,7 +528,13 @@ static void server_accept_peer(tcp_plugin_t *tcp, int socket,
   for (idx = 0; idx < EXA_MAX_NODES_NUMBER; idx++)
       if (!strcmp(tcp->peers[idx].ip_addr, os_inet_ntoa(*addr)))
       {
+          peer_detach_socket(tcp, idx);
+          /* The previous connection, if any, is replaced */
+          if (tcp->peers[idx].sock >= 0)
+              peer_close_socket(&tcp->peers[idx]);
           tcp->peers[idx].sock = socket;
+          staging_reset(&tcp->peers[idx].recv_staging);
+          peer_attach_socket(nbd_tcp, idx);
 	  break;
       }
 
@@ -250,7 +558,8 @@ static void server_accept_peer(tcp_plugin_t *tcp, int socket,
  */
 static void accept_thread(void *p)
 {
-  tcp_plugin_t *tcp = p;
+  nbd_tcp_t *nbd_tcp = p;
+  tcp_plugin_t *tcp = nbd_tcp->tcp;
   int newsockfd;
   struct sockaddr_in peer_address;
   int len;
@@ -281,7 +590,7 @@ static void accept_thread(void *p)
       }
 
       /* Accept this peer if it was already registered */
-      server_accept_peer(tcp, newsockfd, &peer_address.sin_addr);
+      server_accept_peer(nbd_tcp, newsockfd, &peer_address.sin_addr);
   }
 }
 
@@ -292,111 +601,343 @@ static void request_reset(pending_recv_t *request)
   request->buffer = NULL;
 }
 
-/* send header and buffer if any
+static size_t staging_len(const recv_staging_t *staging)
+{
+    return staging->end - staging->start;
+}
+
+static size_t send_desc_remaining(const send_desc_t *send_desc)
+{
+    return send_desc->size1 + send_desc->size2 - send_desc->bytes_sent;
+}
+
+/**
+ * Complete the batch of requests being sent to a peer with requests queued
+ * for it, within the TCP_SEND_BATCH_MAX_xxx limits.
  *
- * return value:
- *   DATA_TRANSFER_ERROR     socket invalid or closed.
- *   DATA_TRANSFER_COMPLETE  if successfully transferred all pending data
- *                           (header and buffer if any)
- *   DATA_TRANSFER_PENDING   if some remaining data to transfer
+ * @return true if the peer has something to send
  */
-static transfer_status_t request_send(int fd, send_desc_t *send_desc)
+static bool peer_fill_send_batch(struct peer *peer)
 {
-    int ret;
+    size_t bytes = 0;
+    int i;
+
+    for (i = 0; i < peer->nb_pending_send; i++)
+        bytes += send_desc_remaining(peer->pending_send[i]);
 
-    if (send_desc->bytes_sent < send_desc->size1)
+    while (peer->nb_pending_send < TCP_SEND_BATCH_MAX_REQS
+           && bytes < TCP_SEND_BATCH_MAX_BYTES)
     {
-        do {
-            ret = os_send(fd, send_desc->data1 + send_desc->bytes_sent,
-                          send_desc->size1 - send_desc->bytes_sent);
-        } while (ret == -EINTR);
+        send_desc_t *send_desc = nbd_list_remove(&peer->send_list, NULL,
+                                                 LISTNOWAIT);
+        if (send_desc == NULL)
+            break;
 
-        if (ret < 0)
-            return DATA_TRANSFER_ERROR;
+        peer->pending_send[peer->nb_pending_send++] = send_desc;
+        bytes += send_desc_remaining(send_desc);
+    }
 
-        send_desc->bytes_sent += ret;
+    return peer->nb_pending_send > 0;
+}
 
-        if (send_desc->bytes_sent < send_desc->size1 + send_desc->size2)
-            return DATA_TRANSFER_PENDING;
+/* send the remaining headers and buffers of a batch of requests, in a
+ * single call
+ *
+ * With zerocopy set, the send is done without copy if one of the remaining
+ * payloads is large enough; *zerocopied tells if it was the case.
+ *
+ * return value:
+ *   the number of bytes sent, or a negative error code if the socket is
+ *   invalid or closed.
+ */
+static int batch_send(int fd, send_desc_t *const *batch, int count,
+                      bool zerocopy, bool *zerocopied)
+{
+    os_iovec_t iov[2 * TCP_SEND_BATCH_MAX_REQS];
+    int iovcnt = 0;
+    int flags = 0;
+    int i, ret;
 
-        return DATA_TRANSFER_COMPLETE;
+    for (i = 0; i < count; i++)
+    {
+        const send_desc_t *send_desc = batch[i];
+        size_t payload_sent = 0;
+
+        if (send_desc->bytes_sent < send_desc->size1)
+        {
+            iov[iovcnt].iov_base = (char *)send_desc->data1 + send_desc->bytes_sent;
+            iov[iovcnt].iov_len = send_desc->size1 - send_desc->bytes_sent;
+            iovcnt++;
+        }
+        else
+            payload_sent = send_desc->bytes_sent - send_desc->size1;
+
+        if (send_desc->size2 > payload_sent)
+        {
+            iov[iovcnt].iov_base = (char *)send_desc->data2 + payload_sent;
+            iov[iovcnt].iov_len = send_desc->size2 - payload_sent;
+            iovcnt++;
+
+            if (zerocopy && send_desc->size2 - payload_sent >= TCP_ZEROCOPY_MIN_SIZE)
+                flags = OS_SEND_ZEROCOPY;
+        }
     }
 
     do {
-        ret = os_send(fd, send_desc->data2 + send_desc->bytes_sent - send_desc->size1,
-                      send_desc->size2);
+        ret = os_sendv(fd, iov, iovcnt, flags);
+        /* The kernel is out of memory to pin pages: fall back to a copy */
+        if (ret == -ENOBUFS && flags != 0)
+        {
+            flags = 0;
+            ret = -EINTR;
+        }
     } while (ret == -EINTR);
 
-    if (ret < 0)
-        return DATA_TRANSFER_ERROR;
-
-    send_desc->bytes_sent += ret;
+    *zerocopied = ret > 0 && flags != 0;
 
-    if (send_desc->bytes_sent < send_desc->size1 + send_desc->size2)
-        return DATA_TRANSFER_PENDING;
-
-    return DATA_TRANSFER_COMPLETE;
+    return ret;
 }
 
 /* receive header and buffer if any
+ *
+ * Headers are received in the staging buffer, which may get the following
+ * headers too; they are then parsed without any system call. A payload is
+ * taken from the staging buffer if it is already there, and received
+ * directly in the request buffer otherwise.
+ *
+ * At most one system call is done, and only when nothing can be parsed
+ * from the staging buffer.
  *
  * return value:
  *   DATA_TRANSFER_ERROR     socket invalid or closed.
  *   DATA_TRANSFER_COMPLETE  if successfully transferred all pending data
  *                           (header and buffer if any)
  *   DATA_TRANSFER_PENDING   if some remaining data to transfer
- *   DATA_TRANSFER_NEED_BUFFER payload data upcoming but no buffer yet.
  */
-static transfer_status_t request_recv(int fd, pending_recv_t *request)
+static transfer_status_t request_recv(int fd, pending_recv_t *request,
+                                      recv_staging_t *staging,
+                                      nbd_tcp_stats_t *stats)
 {
+    size_t remaining;
     int ret;
 
     if (request->nb_readwrite < NBD_HEADER_NET_SIZE)
+    {
+        if (staging_len(staging) < NBD_HEADER_NET_SIZE)
+        {
+            /* make room for as many bytes as possible */
+            memmove(staging->data, staging->data + staging->start,
+                    staging_len(staging));
+            staging->end -= staging->start;
+            staging->start = 0;
+
+            do {
+                ret = os_recv(fd, staging->data + staging->end,
+                              sizeof(staging->data) - staging->end, 0);
+            } while (ret == -EINTR);
+
+            if (ret <= 0) /* 0 means peer disconnected */
+                return DATA_TRANSFER_ERROR;
+
+            stats->recv_calls++;
+            staging->end += ret;
+
+            if (staging_len(staging) < NBD_HEADER_NET_SIZE)
+                return DATA_TRANSFER_PENDING;
+        }
+
+        memcpy(&request->io_desc, staging->data + staging->start,
+               NBD_HEADER_NET_SIZE);
+        staging->start += NBD_HEADER_NET_SIZE;
+        request->nb_readwrite = NBD_HEADER_NET_SIZE;
+        stats->recv_requests++;
+
+        /* now header was completely received, we can get the buffer size from it */
+	request->buf_size = request->io_desc.sector_nb << 9;
+        return DATA_TRANSFER_COMPLETE;
+    }
+
+    /* No buffer to receive the payload in */
+    if (request->buffer == NULL)
+        return DATA_TRANSFER_ERROR;
+
+    remaining = NBD_HEADER_NET_SIZE + request->buf_size - request->nb_readwrite;
+
+    if (remaining == 0)
+        return DATA_TRANSFER_COMPLETE;
+
+    if (staging_len(staging) > 0)
+    {
+        size_t size = MIN(staging_len(staging), remaining);
+
+        memcpy(request->buffer + request->nb_readwrite - NBD_HEADER_NET_SIZE,
+               staging->data + staging->start, size);
+        staging->start += size;
+        request->nb_readwrite += size;
+    }
+    else
     {
         do {
-            ret = os_recv(fd, (char *)&request->io_desc + request->nb_readwrite,
-                          NBD_HEADER_NET_SIZE - request->nb_readwrite, 0);
+            ret = os_recv(fd, request->buffer + request->nb_readwrite - NBD_HEADER_NET_SIZE,
+                          remaining, 0);
         } while (ret == -EINTR);
 
         if (ret <= 0) /* 0 means peer disconnected */
             return DATA_TRANSFER_ERROR;
 
+        stats->recv_calls++;
         request->nb_readwrite += ret;
+    }
 
-        if (request->nb_readwrite < NBD_HEADER_NET_SIZE)
-            return DATA_TRANSFER_PENDING;
+    if (request->nb_readwrite < NBD_HEADER_NET_SIZE + request->buf_size)
+        return DATA_TRANSFER_PENDING;
 
-        /* now header was completely received, we can get the buffer size from it */
-	request->buf_size = request->io_desc.sector_nb << 9;
-        return DATA_TRANSFER_COMPLETE;
+    return DATA_TRANSFER_COMPLETE;
+}
+
+/**
+ * Tells if request_recv() can progress without receiving from the socket.
+ */
+static bool request_recv_ready(const pending_recv_t *request,
+                               const recv_staging_t *staging)
+{
+    if (request->nb_readwrite < NBD_HEADER_NET_SIZE)
+        return staging_len(staging) >= NBD_HEADER_NET_SIZE;
+
+    return staging_len(staging) > 0;
+}
+
+/**
+ * Fail all the requests being sent or queued for a peer.
+ */
+static void peer_fail_sends(nbd_tcp_t *nbd_tcp, struct peer *peer)
+{
+    send_desc_t *send_desc;
+    int i;
+
+    for (i = 0; i < peer->nb_pending_send; i++)
+        request_processed(peer->pending_send[i], nbd_tcp, -1);
+    peer->nb_pending_send = 0;
+
+    while ((send_desc = nbd_list_remove(&peer->send_list, NULL, LISTNOWAIT)) != NULL)
+        request_processed(send_desc, nbd_tcp, -1);
+}
+
+/**
+ * Send the pending data of a peer, and handle completion and errors.
+ *
+ * Must be called with peers_lock held (for reading at least), with a valid
+ * socket and a pending send.
+ *
+ * @param nbd_tcp  Tcp plugin
+ * @param idx      Index of the peer
+ */
+static void peer_send(nbd_tcp_t *nbd_tcp, int idx)
+{
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
+    struct peer *peer = &tcp->peers[idx];
+    bool zerocopied = false;
+    int sent, done, i;
+
+    /* send remaining data if any */
+    sent = batch_send(peer->sock, peer->pending_send, peer->nb_pending_send,
+                      peer->zerocopy, &zerocopied);
+
+    if (sent < 0)
+    {
+        exalog_error("Failed to sending data to '%s' id=%d "
+                     "socket=%d", peer->ip_addr,
+                     peer->node_id, peer->sock);
+        for (i = 0; i < peer->nb_pending_send; i++)
+            request_processed(peer->pending_send[i], nbd_tcp, -1);
+        peer->nb_pending_send = 0;
+        peer_detach_socket(tcp, idx);
+        peer_close_socket(peer);
+        return;
     }
 
-    do {
-        ret = os_recv(fd, request->buffer + request->nb_readwrite - NBD_HEADER_NET_SIZE,
-                      NBD_HEADER_NET_SIZE + request->buf_size - request->nb_readwrite, 0);
-    } while (ret == -EINTR);
+    peer->stats.send_calls++;
 
-    if (ret <= 0) /* 0 means peer disconnected */
-        return DATA_TRANSFER_ERROR;
+    if (zerocopied)
+        peer->zc_issued++;
+
+    /* account the bytes sent to the requests, in order */
+    for (i = 0; i < peer->nb_pending_send && sent > 0; i++)
+    {
+        send_desc_t *send_desc = peer->pending_send[i];
+        size_t size = MIN(send_desc_remaining(send_desc), (size_t)sent);
 
-    request->nb_readwrite += ret;
+        send_desc->bytes_sent += size;
+        sent -= size;
 
-    if (request->nb_readwrite < NBD_HEADER_NET_SIZE + request->buf_size)
-        return DATA_TRANSFER_PENDING;
+        if (zerocopied)
+        {
+            send_desc->zerocopied = true;
+            send_desc->zc_seq_end = peer->zc_issued;
+        }
+    }
 
-    return DATA_TRANSFER_COMPLETE;
+    for (done = 0; done < peer->nb_pending_send; done++)
+    {
+        if (send_desc_remaining(peer->pending_send[done]) > 0)
+            break;
+        peer_send_done(nbd_tcp, peer, peer->pending_send[done]);
+    }
+
+    peer->stats.send_requests += done;
+    peer->nb_pending_send -= done;
+    memmove(peer->pending_send, peer->pending_send + done,
+            peer->nb_pending_send * sizeof(send_desc_t *));
 }
 
-static void request_processed(send_desc_t *send_desc, nbd_tcp_t *nbd_tcp, int error)
+/**
+ * Receive available data from a peer, and handle completion and errors.
+ *
+ * Must be called with peers_lock held (for reading at least) and with a
+ * valid socket.
+ *
+ * @param nbd_tcp  Tcp plugin
+ * @param idx      Index of the peer
+ */
+static void peer_receive(nbd_tcp_t *nbd_tcp, int idx)
 {
     tcp_plugin_t *tcp = nbd_tcp->tcp;
+    struct peer *peer = &tcp->peers[idx];
+    pending_recv_t *request = &peer->pending_recv;
+    transfer_status_t status;
 
-    EXA_ASSERT(send_desc != NULL);
+    /* Handle all the requests already in the staging buffer */
+    do {
+        status = request_recv(peer->sock, request, &peer->recv_staging,
+                              &peer->stats);
 
-    if (nbd_tcp->end_sending)
-        nbd_tcp->end_sending(send_desc->ctx, error);
+        if (status == DATA_TRANSFER_COMPLETE
+            && !nbd_tcp->keep_receiving(idx, &request->io_desc, (void **)&request->buffer))
+            request_reset(request);
+    } while (status == DATA_TRANSFER_COMPLETE
+             && request_recv_ready(request, &peer->recv_staging));
 
-    nbd_list_post(&tcp->send_list.free, send_desc, -1);
+    switch (status)
+    {
+    case DATA_TRANSFER_PENDING:
+    case DATA_TRANSFER_COMPLETE:
+        break;
+
+    case DATA_TRANSFER_ERROR:
+        request_reset(request);
+        staging_reset(&peer->recv_staging);
+        /* FIXME this should be an exalog_error but is debug for now
+         * because when stopping clientd, serverd close its socket
+         * by this place... TODO could be nice to indicate to serverd
+         * that the clientd is about to cut connections and thus it
+         * is normal to have its socket closed. */
+        exalog_debug("Failed to receive data from '%s' id=%d "
+                     "socket=%d", peer->ip_addr,
+                     peer->node_id, peer->sock);
+        peer_detach_socket(tcp, idx);
+        peer_close_socket(peer);
+        break;
+    }
 }
 
 /* thread for asynchronously sending data for a peer or a server */
@@ -424,10 +965,7 @@ static void send_thread(void *p)
 	  if (peer->sock < 0)
 	      continue;
 
-          if (peer->pending_send == NULL)
-              peer->pending_send = nbd_list_remove(&peer->send_list,
-                                                   NULL, LISTNOWAIT);
-          if (peer->pending_send != NULL)
+          if (peer_fill_send_batch(peer))
           {
 	      FD_SET(peer->sock, &fds);
 	      nfds = peer->sock > nfds ? peer->sock : nfds;
@@ -448,35 +986,13 @@ static void send_thread(void *p)
       for (i = 0; i <= tcp->last_peer_idx; i++)
       {
           struct peer *peer = &tcp->peers[i];
-	  if (peer->pending_send != NULL
+	  if (peer->nb_pending_send > 0
               /* Also check the socket is still valid because there is a race
                * with remove_peer function, thus the socket may be -1 even
                * if it was valid in the first part of loop. see bug #4581 and
                * #4607 */
 	      && peer->sock >= 0 && FD_ISSET(peer->sock, &fds))
-	  {
-		  /* send remaining data if any */
-		  switch(request_send(peer->sock, peer->pending_send))
-		  {
-		  case DATA_TRANSFER_COMPLETE:
-                      request_processed(peer->pending_send, nbd_tcp, 0);
-                      peer->pending_send = NULL;
-                      break;
-
-		  case DATA_TRANSFER_ERROR:
-                      exalog_error("Failed to sending data to '%s' id=%d "
-                                   "socket=%d", peer->ip_addr,
-                                   peer->node_id, peer->sock);
-                      request_processed(peer->pending_send, nbd_tcp, -1);
-                      peer->pending_send = NULL;
-                      close_socket(peer->sock);
-                      peer->sock = -1;
-                      break;
-
-		  case DATA_TRANSFER_PENDING:
-                      break;
-		  }
-          }
+	      peer_send(nbd_tcp, i);
       }
 
       os_thread_rwlock_unlock(&tcp->peers_lock);
@@ -526,40 +1042,126 @@ static void receive_thread(void *p)
       {
           struct peer *peer = &tcp->peers[i];
 	  if (peer->sock >= 0 && FD_ISSET(peer->sock ,&fds))
+              peer_receive(nbd_tcp, i);
+      }
+
+      os_thread_rwlock_unlock(&tcp->peers_lock);
+  }
+
+  exa_select_delete_handle(sh);
+}
+
+/*
+ * Send worker of the epoll transport. A peer's socket is watched for
+ * writability only while the peer has data to send; tcp_send_data() wakes
+ * the worker up when new data is queued.
+ */
+static void send_worker_thread(void *p)
+{
+  io_worker_t *worker = p;
+  nbd_tcp_t *nbd_tcp = worker->nbd_tcp;
+  tcp_plugin_t *tcp = nbd_tcp->tcp;
+  os_poll_event_t events[TCP_IO_WORKER_EVENTS];
+
+  while (worker->run)
+  {
+      int i, n;
+
+      os_thread_rwlock_rdlock(&tcp->peers_lock);
+      for (i = worker->idx; i <= tcp->last_peer_idx; i += tcp->nb_io_workers)
+      {
+          struct peer *peer = &tcp->peers[i];
+          bool want_send;
+
+          if (peer->sock < 0)
           {
-              pending_recv_t *request = &peer->pending_recv;
+              peer_zerocopy_flush(nbd_tcp, peer);
+              continue;
+          }
+
+          /* completions may have been fetched by the receive worker */
+          peer_zerocopy_release(nbd_tcp, peer);
+
+          want_send = peer_fill_send_batch(peer);
+          if (want_send != peer->send_armed
+              && os_poll_modify(worker->poll, peer->sock,
+                                want_send ? OS_POLL_OUT : 0, i) == 0)
+              peer->send_armed = want_send;
+      }
+      os_thread_rwlock_unlock(&tcp->peers_lock);
+
+      n = os_poll_wait(worker->poll, events, TCP_IO_WORKER_EVENTS, -1);
+      if (n <= 0)
+          continue;
+
+      os_thread_rwlock_rdlock(&tcp->peers_lock);
+      for (i = 0; i < n; i++)
+      {
+          struct peer *peer = &tcp->peers[events[i].key];
 
-              switch (request_recv(peer->sock, request))
+          /* the socket may have been removed since the wait, see bug #4581
+           * and #4607 */
+          if (peer->sock < 0)
+              continue;
+
+          /* zero-copy completions are reported on the error queue */
+          if (peer->zerocopy && (events[i].events & OS_POLL_ERR))
+              peer_zerocopy_reap(nbd_tcp, peer);
+
+          if (peer->nb_pending_send > 0)
+              peer_send(nbd_tcp, events[i].key);
+      }
+      os_thread_rwlock_unlock(&tcp->peers_lock);
+  }
+}
+
+/*
+ * Receive worker of the epoll transport. Unlike receive_thread(), peers
+ * added or removed are taken into account immediately since sockets are
+ * (un)registered with the worker as soon as they are (dis)connected.
+ */
+static void recv_worker_thread(void *p)
+{
+  io_worker_t *worker = p;
+  nbd_tcp_t *nbd_tcp = worker->nbd_tcp;
+  tcp_plugin_t *tcp = nbd_tcp->tcp;
+  os_poll_event_t events[TCP_IO_WORKER_EVENTS];
+
+  while (worker->run)
+  {
+      int i, n;
+
+      n = os_poll_wait(worker->poll, events, TCP_IO_WORKER_EVENTS, -1);
+      if (n <= 0)
+          continue;
+
+      os_thread_rwlock_rdlock(&tcp->peers_lock);
+      for (i = 0; i < n; i++)
+      {
+          struct peer *peer = &tcp->peers[events[i].key];
+
+          if (peer->sock < 0)
+              continue;
+
+          /* An error event alone is a pending zero-copy completion (a
+           * broken connection is reported as readable): receiving would
+           * block. The completions are fetched so that the error queue does
+           * not wake this worker up again, and released by the send
+           * worker. */
+          if (!(events[i].events & OS_POLL_IN))
+          {
+              if (peer->zerocopy)
               {
-              case DATA_TRANSFER_PENDING:
-                  break;
-
-              case DATA_TRANSFER_COMPLETE:
-                  if (!nbd_tcp->keep_receiving(i, &request->io_desc, (void **)&request->buffer))
-                      request_reset(request);
-                  break;
-
-              case DATA_TRANSFER_ERROR:
-                  request_reset(request);
-                  /* FIXME this should be an exalog_error but is debug for now
-                   * because when stopping clientd, serverd close its socket
-                   * by this place... TODO could be nice to indicate to serverd
-                   * that the clientd is about to cut connections and thus it
-                   * is normal to have its socket closed. */
-                  exalog_debug("Failed to receive data from '%s' id=%d "
-                               "socket=%d", peer->ip_addr,
-                               peer->node_id, peer->sock);
-                  close_socket(peer->sock);
-                  peer->sock = -1;
-                  break;
+                  peer_zerocopy_collect(peer);
+                  os_poll_wakeup(peer_send_worker(tcp, events[i].key)->poll);
               }
+              continue;
           }
-      }
 
+          peer_receive(nbd_tcp, events[i].key);
+      }
       os_thread_rwlock_unlock(&tcp->peers_lock);
   }
-
-  exa_select_delete_handle(sh);
 }
 
 void tcp_send_data(struct nbd_tcp *nbd_tcp, exa_nodeid_t to,
@@ -578,6 +1180,7 @@ void tcp_send_data(struct nbd_tcp *nbd_tcp, exa_nodeid_t to,
     send_desc->ctx   = ctx;
 
     send_desc->bytes_sent = 0;
+    send_desc->zerocopied = false;
 
     EXA_ASSERT(EXA_NODEID_VALID(to));
 
@@ -596,11 +1199,40 @@ void tcp_send_data(struct nbd_tcp *nbd_tcp, exa_nodeid_t to,
 
     nbd_list_post(&tcp->peers[to].send_list, send_desc, -1);
 
-    os_sem_post(&tcp->send_thread.semaphore);
+    if (use_io_workers(tcp))
+        os_poll_wakeup(peer_send_worker(tcp, to)->poll);
+    else
+        os_sem_post(&tcp->send_thread.semaphore);
 
     os_thread_rwlock_unlock(&tcp->peers_lock);
 }
 
+/**
+ * Get the batching counters of the connection to a peer. They count since
+ * the connection was established.
+ *
+ * The workers update the counters with peers_lock held for reading, so
+ * taking it for writing gives a consistent snapshot.
+ *
+ * @param[in]  nbd_tcp  TCP transport
+ * @param[in]  nid      Node id of the peer
+ * @param[out] stats    Counters of the peer (zeroed if not a valid peer)
+ */
+void tcp_get_peer_stats(nbd_tcp_t *nbd_tcp, exa_nodeid_t nid,
+                        nbd_tcp_stats_t *stats)
+{
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (!EXA_NODEID_VALID(nid))
+        return;
+
+    os_thread_rwlock_wrlock(&tcp->peers_lock);
+    *stats = tcp->peers[nid].stats;
+    os_thread_rwlock_unlock(&tcp->peers_lock);
+}
+
 static int client_connect_to_server(struct in_addr *inaddr,
                                     struct in_addr *local_addr)
 {
@@ -697,11 +1329,19 @@ int tcp_connect_to_peer(nbd_tcp_t *nbd_tcp, exa_nodeid_t nid)
         return -NET_ERR_INVALID_HOST;
     }
 
+    peer_detach_socket(tcp, nid);
+    /* The previous connection, if any, is replaced */
+    if (peer->sock >= 0)
+        peer_close_socket(peer);
+
     sock = client_connect_to_server(&node_addr, &tcp->data_addr);
     if (sock >= 0)
         peer->sock = sock;
     else
         peer->sock = -1;
+    staging_reset(&peer->recv_staging);
+
+    peer_attach_socket(nbd_tcp, nid);
 
     os_thread_rwlock_unlock(&tcp->peers_lock);
 
@@ -751,7 +1391,7 @@ int tcp_add_peer(exa_nodeid_t nid, const char *ip_addr, struct nbd_tcp *nbd_tcp)
 int tcp_remove_peer(uint64_t peer_id, struct nbd_tcp *nbd_tcp)
 {
   int sock;
-  send_desc_t *header;
+  bool closed;
   tcp_plugin_t *tcp = nbd_tcp->tcp;
   struct peer *peer = &tcp->peers[peer_id];
 
@@ -771,25 +1411,34 @@ int tcp_remove_peer(uint64_t peer_id, struct nbd_tcp *nbd_tcp)
   }
 
   os_thread_rwlock_wrlock(&tcp->peers_lock);
+  peer_detach_socket(tcp, peer_id);
   sock = peer->sock;
-  peer->sock = -1;
 
-  if (peer->pending_send != NULL)
-      request_processed(peer->pending_send, nbd_tcp, -1);
-  peer->pending_send = NULL;
+  /* The zero-copy sends are released right below: the socket must not
+   * send from their buffers anymore */
+  closed = sock != -1 && peer->zerocopy;
+  if (closed)
+      peer_close_socket(peer);
+  peer->sock = -1;
 
-  /* remove waiting requests to be sent from the nbd_tcp list */
-  while ((header = nbd_list_remove(&peer->send_list, NULL, LISTNOWAIT)) != NULL)
-      request_processed(header, nbd_tcp, -1);
+  /* fail the requests being sent and the ones waiting to be sent */
+  peer_fail_sends(nbd_tcp, peer);
+  peer_zerocopy_flush(nbd_tcp, peer);
 
   request_reset(&peer->pending_recv);
+  staging_reset(&peer->recv_staging);
+
+  memset(&peer->stats, 0, sizeof(peer->stats));
 
   os_thread_rwlock_unlock(&tcp->peers_lock);
 
-  if (sock != -1)
-    os_shutdown(sock, SHUT_RDWR);
-  else
+  if (sock == -1)
     return -NBD_ERR_NO_CONNECTION;
+
+  if (closed)
+    return EXA_SUCCESS;
+
+  os_shutdown(sock, SHUT_RDWR);
   /* we must avoid race with del_peer and other send_data , so we must get the semaphore */
   os_thread_rwlock_wrlock(&tcp->peers_lock);
 
@@ -849,7 +1498,7 @@ int tcp_start_listening(nbd_tcp_t *nbd_tcp)
     nbd_tcp->tcp->accept_thread.run = true;
     if (!exathread_create_named(&nbd_tcp->tcp->accept_thread.tid,
                 NBD_THREAD_STACK_SIZE + MIN_THREAD_STACK_SIZE_OF_THIS_PLUGIN,
-                accept_thread, nbd_tcp->tcp, "servTcpAccPlugin"))
+                accept_thread, nbd_tcp, "servTcpAccPlugin"))
     {
         exalog_error("cannot create accept thread: %s(%d)", exa_error_msg(err), err);
         close_socket(sock);
@@ -922,6 +1571,60 @@ static bool spawn_receive_thread(nbd_tcp_t *nbd_tcp)
     return true;
 }
 
+static void stop_io_workers(io_worker_t *workers, int nb)
+{
+    int i;
+
+    for (i = 0; i < nb; i++)
+    {
+        workers[i].run = false;
+        os_poll_wakeup(workers[i].poll);
+        os_thread_join(workers[i].tid);
+        os_poll_delete(workers[i].poll);
+    }
+}
+
+static bool spawn_io_workers(nbd_tcp_t *nbd_tcp, io_worker_t *workers,
+                             void (*worker_thread)(void *), const char *name)
+{
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
+    int i;
+
+    for (i = 0; i < tcp->nb_io_workers; i++)
+    {
+        io_worker_t *worker = &workers[i];
+        char thread_name[32];
+
+        worker->idx     = i;
+        worker->nbd_tcp = nbd_tcp;
+        worker->run     = true;
+        worker->poll    = os_poll_create();
+        if (worker->poll == NULL)
+        {
+            exalog_error("Cannot create poll set of %s worker %d.", name, i);
+            break;
+        }
+
+        os_snprintf(thread_name, sizeof(thread_name), "%s%d", name, i);
+        if (!exathread_create_named(&worker->tid,
+                    NBD_THREAD_STACK_SIZE + MIN_THREAD_STACK_SIZE_OF_THIS_PLUGIN,
+                    worker_thread, worker, thread_name))
+        {
+            exalog_error("Cannot create %s worker %d.", name, i);
+            os_poll_delete(worker->poll);
+            break;
+        }
+    }
+
+    if (i < tcp->nb_io_workers)
+    {
+        stop_io_workers(workers, i);
+        return false;
+    }
+
+    return true;
+}
+
 static void __cleanup_data(struct nbd_tcp *nbd_tcp)
 {
     tcp_plugin_t *tcp = nbd_tcp->tcp;
@@ -943,9 +1646,18 @@ static void __cleanup_data(struct nbd_tcp *nbd_tcp)
 
 void cleanup_tcp(struct nbd_tcp *nbd_tcp)
 {
-    stop_receive_thread(nbd_tcp->tcp);
+    tcp_plugin_t *tcp = nbd_tcp->tcp;
 
-    stop_send_thread(nbd_tcp->tcp);
+    if (use_io_workers(tcp))
+    {
+        stop_io_workers(tcp->recv_workers, tcp->nb_io_workers);
+        stop_io_workers(tcp->send_workers, tcp->nb_io_workers);
+    }
+    else
+    {
+        stop_receive_thread(tcp);
+        stop_send_thread(tcp);
+    }
 
     __cleanup_data(nbd_tcp);
 }
@@ -953,6 +1665,17 @@ void cleanup_tcp(struct nbd_tcp *nbd_tcp)
 /**
  * tcp_init initialise internal data,
  * launch the thread of receive data
+ *
+ * The network type is of the form "TCP=<buffer size in KiB>" or
+ * "TCP=<buffer size in KiB>,IO_THREADS=<n>[,ZEROCOPY=<0|1>]". When n is
+ * not 0, sends and receives are handled by n epoll based workers in each
+ * direction, each worker being in charge of the peers whose node id modulo
+ * n is its index. Otherwise, a single select based thread is used per
+ * direction. With the epoll workers, ZEROCOPY=1 can be given: payloads of at
+ * least TCP_ZEROCOPY_MIN_SIZE bytes are then sent without copy and
+ * end_sending() is called only once the kernel notified it does not
+ * use the buffers anymore.
+ *
  * @param nbd_tcp info on the new instance that we will fill
  * @return EXA_SUCCESS or error
  */
@@ -961,8 +1684,11 @@ int init_tcp(nbd_tcp_t *nbd_tcp, const char *hostname, const char *net_type,
 {
   tcp_plugin_t *tcp;
   int err, i;
+  int nb_io_workers = 0;
+  int zerocopy = 0;
 
-  if (sscanf(net_type, "TCP=%d", &TCP_buffers) == 1)
+  if (sscanf(net_type, "TCP=%d,IO_THREADS=%d,ZEROCOPY=%d", &TCP_buffers,
+             &nb_io_workers, &zerocopy) >= 1)
     TCP_buffers = TCP_buffers * 1024;
   else
   {
@@ -970,12 +1696,24 @@ int init_tcp(nbd_tcp_t *nbd_tcp, const char *hostname, const char *net_type,
       return -EINVAL;
   }
 
+  if (nb_io_workers < 0 || nb_io_workers > TCP_MAX_IO_WORKERS)
+  {
+      exalog_error("Bad number of I/O threads in network type '%s' (max %d)",
+                   net_type, TCP_MAX_IO_WORKERS);
+      return -EINVAL;
+  }
+
   tcp = os_malloc(sizeof(tcp_plugin_t));
 
   if (tcp == NULL)
     return -NBD_ERR_MALLOC_FAILED;
 
   nbd_tcp->tcp = tcp;
+  tcp->nb_io_workers = nb_io_workers;
+  tcp->zerocopy = zerocopy != 0 && nb_io_workers > 0;
+
+  if (zerocopy != 0 && nb_io_workers == 0)
+      exalog_warning("Zero-copy sends need I/O threads, they are disabled.");
 
   os_thread_rwlock_init(&tcp->peers_lock);
 
@@ -988,8 +1726,16 @@ int init_tcp(nbd_tcp_t *nbd_tcp, const char *hostname, const char *net_type,
       peer->sock         = -1;
       peer->node_id      = EXA_NODEID_NONE;
       peer->ip_addr[0]   = '\0';
-      peer->pending_send = NULL;
+      peer->nb_pending_send = 0;
+      peer->send_armed   = false;
+      peer->zerocopy     = false;
+      peer->zc_issued    = 0;
+      os_atomic_set(&peer->zc_completed, 0);
+      peer->zc_head      = NULL;
+      peer->zc_tail      = NULL;
       request_reset(&peer->pending_recv);
+      staging_reset(&peer->recv_staging);
+      memset(&peer->stats, 0, sizeof(peer->stats));
       nbd_init_list(&tcp->send_list, &peer->send_list);
   }
   tcp->last_peer_idx = 0;
@@ -1005,6 +1751,26 @@ int init_tcp(nbd_tcp_t *nbd_tcp, const char *hostname, const char *net_type,
       return err;
   }
 
+  if (use_io_workers(tcp))
+  {
+      if (!spawn_io_workers(nbd_tcp, tcp->recv_workers, recv_worker_thread,
+                            "TcpRcvWrk"))
+      {
+          __cleanup_data(nbd_tcp);
+          return -NBD_ERR_THREAD_CREATION;
+      }
+
+      if (!spawn_io_workers(nbd_tcp, tcp->send_workers, send_worker_thread,
+                            "TcpSndWrk"))
+      {
+          stop_io_workers(tcp->recv_workers, tcp->nb_io_workers);
+          __cleanup_data(nbd_tcp);
+          return -NBD_ERR_THREAD_CREATION;
+      }
+
+      return EXA_SUCCESS;
+  }
+
   if (!spawn_receive_thread(nbd_tcp))
   {
       __cleanup_data(nbd_tcp);
@@ -12,6 +12,15 @@
 #include "nbd/common/nbd_common.h"
 #include "common/include/exa_nodeset.h"
 
+/** Counters used to check how well requests are batched */
+typedef struct
+{
+    uint64_t send_calls;     /**< number of successful sends */
+    uint64_t send_requests;  /**< number of requests completely sent */
+    uint64_t recv_calls;     /**< number of successful receives */
+    uint64_t recv_requests;  /**< number of headers received */
+} nbd_tcp_stats_t;
+
 int init_tcp(nbd_tcp_t *nbd_tcp, const char *hostname, const char *net_type,
              int num_receive_headers);
 
@@ -31,4 +40,7 @@ void tcp_send_data(struct nbd_tcp *nbd_tcp, exa_nodeid_t to,
                    void *data1, size_t size1, void *data2, size_t size2,
                    void *ctx);
 
+void tcp_get_peer_stats(nbd_tcp_t *nbd_tcp, exa_nodeid_t nid,
+                        nbd_tcp_stats_t *stats);
+
 #endif
@@ -11,11 +11,14 @@
 #include <errno.h>
 
 #include "common/include/exa_thread_name.h"
+#include "common/include/exa_constants.h"
 #include "common/include/exa_error.h"
+#include "exatrace/include/exatrace.h"
 #include "log/include/log.h"
 #include "nbd/common/nbd_common.h"
 #include "nbd/serverd/nbd_disk_thread.h"
 #include "nbd/serverd/nbd_serverd.h"
+#include "os/include/os_eventfd.h"
 #include "os/include/os_stdio.h"
 #include "rdev/include/exa_rdev.h"
 
@@ -26,16 +29,15 @@
  * - server signal that the lock is now ok
  * - server continue to read new header and check for a unlocking
  * - if server read a header in a locked area and wasnot already unlocked
- * 		- it repost the header
- *              - wait for all pending request already sent to exa_rdev
- *              - wait for a unlocking
+ *              - it parks the header
+ *              - when a zone is unlocked, the parked headers that are not
+ *                in a locked zone anymore are sent to exa_rdev
  */
 
 int __exa_disk_zone_lock(device_t *dev, long first_sector, long size_in_sector,
                          bool lock)
 {
-  header_t *header = nbd_list_remove(&dev->disk_queue.root->free, NULL, LISTWAIT);
-  EXA_ASSERT(header != NULL);
+  header_t *header = dev->lock_header;
 
   header->type = NBD_HEADER_LOCK;
   header->lock.sector = first_sector;
@@ -83,7 +85,7 @@ int exa_disk_lock_zone(device_t *dev, long first_sector, long size_in_sector)
  */
 static void td_merge_lock(device_t *disk_device, header_t *header)
 {
-    int i;
+    exa_interval_node_t *locked_zone;
 
     EXA_ASSERT(header->type == NBD_HEADER_LOCK);
     EXA_ASSERT(header->lock.op == NBD_REQ_TYPE_LOCK
@@ -92,46 +94,38 @@ static void td_merge_lock(device_t *disk_device, header_t *header)
     switch (header->lock.op)
     {
     case NBD_REQ_TYPE_LOCK:
-        if (disk_device->nb_locked_zone >= NBMAX_DISK_LOCKED_ZONES)
+        if (disk_device->nb_locked_zone >= NBMAX_DISK_LOCKED_ZONES
+            || header->lock.sector_nb == 0)
         {
             disk_device->locking_return = -1;
             return;
         }
-        else
-        {
-            struct locked_zone *locked_zone = &disk_device->locked_zone[disk_device->nb_locked_zone];
 
-            locked_zone->sector    = header->lock.sector;
-            locked_zone->sector_count = header->lock.sector_nb;
-
-            disk_device->nb_locked_zone++;
-            disk_device->locking_return = 0;
-        }
+        disk_device->nb_locked_zone++;
+        locked_zone = disk_device->free_zone[NBMAX_DISK_LOCKED_ZONES
+                                             - disk_device->nb_locked_zone];
 
+        exa_interval_tree_insert(&disk_device->locked_zones, locked_zone,
+                                 header->lock.sector, header->lock.sector_nb);
+        disk_device->locking_return = 0;
         return;
 
     case NBD_REQ_TYPE_UNLOCK:
-        for (i = 0; i < disk_device->nb_locked_zone; i++)
+        locked_zone = exa_interval_tree_find(&disk_device->locked_zones,
+                                             header->lock.sector,
+                                             header->lock.sector_nb);
+        if (locked_zone == NULL)
         {
-            struct locked_zone *locked_zone = &disk_device->locked_zone[i];
-
-            if (locked_zone->sector == header->lock.sector
-                && locked_zone->sector_count == header->lock.sector_nb)
-            {
-                disk_device->locking_return = 0;
-                disk_device->nb_locked_zone--;
-
-                /* The array is not sorted but need to be consolidated, thus
-                 * when removing an element which is not at the end, we fill
-                 * the 'hole' by moving the last element to this place. */
-                if (i < disk_device->nb_locked_zone) /* last zone */
-                    disk_device->locked_zone[i] = disk_device->locked_zone[disk_device->nb_locked_zone];
-
-                return;
-            }
+            disk_device->locking_return = -1;
+            return;
         }
 
-        disk_device->locking_return = -1;
+        exa_interval_tree_remove(&disk_device->locked_zones, locked_zone);
+
+        disk_device->free_zone[NBMAX_DISK_LOCKED_ZONES
+                               - disk_device->nb_locked_zone] = locked_zone;
+        disk_device->nb_locked_zone--;
+        disk_device->locking_return = 0;
         return;
     }
 }
@@ -145,38 +139,50 @@ static void td_merge_lock(device_t *disk_device, header_t *header)
  */
 static bool td_is_locked(device_t *disk_device, header_t *header)
 {
-    int i;
+    return exa_interval_tree_overlap(&disk_device->locked_zones,
+                                     header->io.desc.sector,
+                                     header->io.desc.sector_nb) != NULL;
+}
 
-    for (i = 0; i < disk_device->nb_locked_zone; i++)
-    {
-        const struct locked_zone *locked_zone = &disk_device->locked_zone[i];
-        if (header->io.desc.sector < locked_zone->sector + locked_zone->sector_count
-            && header->io.desc.sector + header->io.desc.sector_nb > locked_zone->sector)
-            return true;
-    }
+/**
+ * Put aside an IO accessing a locked zone, until the zone is unlocked.
+ * @param disk_device the device
+ * @param header IO to park
+ */
+static void td_park(device_t *disk_device, header_t *header)
+{
+    EXATRACE(NBD_SERVER_PARKED, header, 0, 0);
+
+    header->next_parked = NULL;
+
+    if (disk_device->parked_last == NULL)
+        disk_device->parked_first = header;
+    else
+        disk_device->parked_last->next_parked = header;
 
-    return false;
+    disk_device->parked_last = header;
 }
 
+/** Max number of requests picked from the disk queue and submitted to the
+ * device at once, and of completions reaped at once */
+#define TD_BATCH_MAX  32
+
+/** Requests picked from the disk queue and not submitted yet */
+typedef struct
+{
+    exa_rdev_request_t reqs[TD_BATCH_MAX];
+    int nb;
+} td_batch_t;
+
 /**
- * send one request to device, it validate there is no problem with the
+ * Add an IO request to the batch of requests to submit.
  *
- * @header IN request to do
- *         OUT last request done
- * @return EXA_RDEV_REQUEST_END_OK       new request submitted successfully and header
- *                                       contains an old request succesfully done
- *         EXA_RDEV_REQUEST_END_ERROR    new request submitted successfully
- *                                       and header contains an old request that fail
- *         RDEV_REQUEST_NOT_ENOUGH_FREE_REQ not enough resources to submit a new request
+ * @param batch       batch of requests
+ * @param req_header  request to add
  */
-static int exa_td_process_one_request(header_t **header,
-                                      device_t *disk_device)
+static void td_batch_add(td_batch_t *batch, header_t *req_header)
 {
-  void * buffer;
-  int sector_nb;
-  uint64_t sector;
-  int retval;
-  header_t *req_header = *header;
+  exa_rdev_request_t *rdev_req;
 
   /* FIXME this is a ugly hack to prevent compiler to complain about
    * uninitialized variable. Actually, this is because the request type
@@ -184,12 +190,7 @@ static int exa_td_process_one_request(header_t **header,
    * Please remove this whe reworking header_t content... */
   rdev_op_t op = (rdev_op_t)-1;
 
-  /* submit this new request to exa_rdev and so to the disk driver */
-  sector_nb = req_header->io.desc.sector_nb;
-
-  buffer = req_header->io.buf;
-
-  sector = req_header->io.desc.sector;
+  EXA_ASSERT(batch->nb < TD_BATCH_MAX);
 
   EXA_ASSERT(NBD_REQ_TYPE_IS_VALID(req_header->io.desc.request_type));
   switch (req_header->io.desc.request_type)
@@ -206,21 +207,13 @@ static int exa_td_process_one_request(header_t **header,
       break;
   }
 
-  /* Be carefull the 'header' pointer can be modified */
-  retval = exa_rdev_make_request_new(op, (void *)header,
-                                     sector + RDEV_RESERVED_AREA_IN_SECTORS,
-                                     sector_nb, buffer, disk_device->handle);
+  rdev_req = &batch->reqs[batch->nb++];
 
-  if (retval == RDEV_REQUEST_NOT_ENOUGH_FREE_REQ)
-    return RDEV_REQUEST_NOT_ENOUGH_FREE_REQ;
-
-  if (*header != NULL)
-      (*header)->io.desc.result = retval == RDEV_REQUEST_END_OK ? 0 : -EIO;
-
-  if (retval < 0)
-    return RDEV_REQUEST_END_ERROR;
-
-  return retval;
+  rdev_req->op          = op;
+  rdev_req->sector      = req_header->io.desc.sector + RDEV_RESERVED_AREA_IN_SECTORS;
+  rdev_req->sector_nb   = req_header->io.desc.sector_nb;
+  rdev_req->buffer      = req_header->io.buf;
+  rdev_req->nbd_private = req_header;
 }
 
 /**
@@ -255,87 +248,187 @@ static header_t *pick_one_req(device_t *disk_device)
    return nbd_list_remove(&disk_device->disk_queue, NULL, LISTNOWAIT);
 }
 
-/** An error code means finished if it is OK or ERROR.
- * TODO this has nothing to do here. As a matter of fact, this thread
- * does not care if the IO was successful or not, it just cares if it is
- * finished or not. This means that a single error code would suffice. */
-#define means_finished(err) ((err) == RDEV_REQUEST_END_OK \
-                             || (err) == RDEV_REQUEST_END_ERROR)
-
 /**
- * Wait for the completion of a request and acknowledges upper layer it was
- * done. This function is blocking in case there are actually pending IO. If
- * not, it immediatly returns RDEV_REQUEST_ALL_ENDED.
+ * Get the completed IOs and acknowledge upper layer they were done.
+ * This function is blocking until min_nr IOs are completed (or the
+ * timeout expires) in case there are actually pending IOs. If not, it
+ * immediatly returns 0.
  *
- * @param disk_device  disk on which the request is.
+ * @param disk_device  disk on which the requests are.
+ * @param min_nr       number of IOs to wait for
+ * @param timeout_ms   timeout in milliseconds, -1 means infinite
  *
- * return RDEV_REQUEST_END_ERROR, RDEV_REQUEST_END_OK or RDEV_REQUEST_ALL_ENDED
+ * return the number of IOs completed
  */
-static int wait_and_complete_one_io(device_t *disk_device)
+static int reap_and_complete_ios(device_t *disk_device, int min_nr,
+                                 int timeout_ms)
 {
-    header_t *req;
-    int err = exa_rdev_wait_one_request((void *)&req, disk_device->handle);
+    exa_rdev_completion_t completions[TD_BATCH_MAX];
+    int i, n;
+
+    n = exa_rdev_reap(disk_device->handle, completions, min_nr, TD_BATCH_MAX,
+                      timeout_ms);
 
-    EXA_ASSERT(err == RDEV_REQUEST_ALL_ENDED || err == RDEV_REQUEST_END_ERROR
-               || err == RDEV_REQUEST_END_OK);
+    EXA_ASSERT_VERBOSE(n >= 0, "failed to get IO completions on %s: %d",
+                       disk_device->path, n);
 
-    if (!means_finished(err))
-        return err;
+    disk_device->io_in_flight -= n;
 
-    req->io.desc.result = err == RDEV_REQUEST_END_OK ? 0 : -EIO;
+    for (i = 0; i < n; i++)
+    {
+        header_t *req = completions[i].nbd_private;
 
-    handle_completed_io(disk_device, req);
+        req->io.desc.result = completions[i].status == RDEV_REQUEST_END_OK ? 0 : -EIO;
+        EXATRACE(RDEV_END, req, 0, req->io.desc.result);
+        handle_completed_io(disk_device, req);
+    }
 
-    return err;
+    return n;
 }
 
 static void __wait_for_all_completion(device_t *disk_device)
 {
-    while (wait_and_complete_one_io(disk_device) != RDEV_REQUEST_ALL_ENDED)
+    while (reap_and_complete_ios(disk_device, 1, -1) > 0)
         ;
 }
 
 /**
- * Waits for a new incoming request.
+ * Submit as many requests of the batch as the device accepts, in order,
+ * without waiting. The requests left are moved to the head of the batch.
  *
- * @param disk_device  disk on which we wait a request.
- * @param ms_timeout   timeout in milliseconds
+ * @param disk_device  disk on which the requests are.
+ * @param batch        requests to submit
  *
- * return a new request if one arrived before the timeout exipred.
- *        NULL it timeout expired.
+ * return the number of requests handed to the device (or failed)
  */
-static header_t *wait_new_req(device_t *disk_device, int ms_timeout)
+static int submit_batch_nowait(device_t *disk_device, td_batch_t *batch)
 {
-    struct nbd_list *lists_in[1];
-    bool has_elt[1];
-    header_t *req = NULL;
+    int done = 0;
+    int i;
 
-    lists_in[0] = &disk_device->disk_queue;
-    if (nbd_list_select(lists_in, has_elt, 1, ms_timeout) != 0)
-        req = nbd_list_remove(&disk_device->disk_queue, NULL, LISTNOWAIT);
+    while (done < batch->nb)
+    {
+        int ret = exa_rdev_submit_batch(disk_device->handle, batch->reqs + done,
+                                        batch->nb - done);
+        if (ret > 0)
+        {
+            /* Traced once submitted, as the ones left are submitted again */
+            for (i = done; i < done + ret; i++)
+                EXATRACE(RDEV_BEGIN, batch->reqs[i].nbd_private,
+                         batch->reqs[i].nbd_private,
+                         SECTORS_TO_BYTES(batch->reqs[i].sector_nb));
+
+            disk_device->io_in_flight += ret;
+            done += ret;
+        }
+        else if (ret == 0)
+            /* No room left in kernel for these IOs */
+            break;
+        else
+        {
+            /* The first request could not be submitted, fail it and go on
+             * with the following ones */
+            header_t *req = batch->reqs[done].nbd_private;
+
+            req->io.desc.result = -EIO;
+            handle_completed_io(disk_device, req);
+            done++;
+        }
+    }
+
+    batch->nb -= done;
+    if (batch->nb > 0 && done > 0)
+        memmove(batch->reqs, batch->reqs + done,
+                batch->nb * sizeof(exa_rdev_request_t));
 
-    return req;
+    return done;
+}
+
+/**
+ * Submit the batch of requests to the device, in order. The batch is
+ * empty upon return.
+ *
+ * @param disk_device  disk on which the requests are.
+ * @param batch        requests to submit
+ */
+static void submit_batch(device_t *disk_device, td_batch_t *batch)
+{
+    while (batch->nb > 0)
+        if (submit_batch_nowait(disk_device, batch) == 0)
+        {
+            /* There was no room in kernel for these IOs, thus
+             * we try to complete pending IOs to make some free
+             * space in kernel. There MUST be pending IOs. */
+            int nb_completed = reap_and_complete_ios(disk_device, 1, -1);
+            EXA_ASSERT(nb_completed > 0);
+        }
 }
 
-static int submit_req(device_t *disk_device, header_t **_req)
+/**
+ * Give the parked IOs another chance, once a zone was unlocked: the ones
+ * that are not in a locked zone anymore are added to the batch, in the
+ * order they were parked.
+ *
+ * @param disk_device  disk on which the requests are.
+ * @param batch        batch of requests to submit
+ */
+static void td_resume_parked(device_t *disk_device, td_batch_t *batch)
 {
-  header_t *req = *_req;
+    header_t *parked = disk_device->parked_first;
 
+    disk_device->parked_first = NULL;
+    disk_device->parked_last = NULL;
+
+    while (parked != NULL)
+    {
+        header_t *req = parked;
+
+        parked = req->next_parked;
+
+        if (td_is_locked(disk_device, req))
+        {
+            td_park(disk_device, req);
+            continue;
+        }
+
+        if (batch->nb == TD_BATCH_MAX)
+            submit_batch(disk_device, batch);
+        td_batch_add(batch, req);
+    }
+}
+
+/**
+ * Handle a request picked from the disk queue. IOs are added to the batch;
+ * the other requests need all previous IOs to be done, so they are handled
+ * right away once the batch is submitted and all IOs completed.
+ *
+ * @param disk_device  disk on which the request is.
+ * @param req          the request
+ * @param batch        batch of requests to submit
+ */
+static void handle_req(device_t *disk_device, header_t *req, td_batch_t *batch)
+{
   if (req->type == NBD_HEADER_LOCK)
   {
+      submit_batch(disk_device, batch);
+
       td_merge_lock(disk_device, req);
 
       __wait_for_all_completion(disk_device);
 
-      nbd_list_post(&nbd_server.list_root.free, req, -1);
-      *_req = NULL;
+      if (req->lock.op == NBD_REQ_TYPE_UNLOCK
+          && disk_device->locking_return == 0)
+          td_resume_parked(disk_device, batch);
+
+      /* The header is kept by the device for its next lock */
       os_sem_post(&disk_device->lock_sem_disk);
-      return RDEV_REQUEST_NONE_ENDED;
+      return;
   }
 
   if (req->io.desc.sector_nb == 0) /* Is a flush */
   {
       EXA_ASSERT(req->io.desc.request_type == NBD_REQ_TYPE_WRITE);
+      submit_batch(disk_device, batch);
       __wait_for_all_completion(disk_device);
       /* Once the flush is called, we wait for all pending IO to
        * finish. Upon return we have the guaranty that every
@@ -343,19 +436,45 @@ static int submit_req(device_t *disk_device, header_t **_req)
        * flushed. */
       exa_rdev_flush(disk_device->handle);
       req->io.desc.result = 0;
-      return RDEV_REQUEST_END_OK;
+      handle_completed_io(disk_device, req);
+      return;
   }
 
   if (!req->io.desc.bypass_lock && td_is_locked(disk_device, req))
   {
       /* Being here means that the IO cannot be done because of locks, thus
-       * we send back a EAGAIN to caller to tell that the IO must be
-       * re-submitted later. */
-      req->io.desc.result = -EAGAIN;
-      return RDEV_REQUEST_END_OK;
+       * it is kept until the zone is unlocked. */
+      td_park(disk_device, req);
+      return;
   }
 
-  return exa_td_process_one_request(_req, disk_device);
+  td_batch_add(batch, req);
+}
+
+/**
+ * Wait until there is something to do: a new request in the disk queue or,
+ * if the device signals them, an IO completion.
+ *
+ * @param disk_device  disk to wait on.
+ * @param batch        requests not submitted yet
+ */
+static void td_wait_event(device_t *disk_device, const td_batch_t *batch)
+{
+    if (!disk_device->completion_events && disk_device->io_in_flight > 0)
+    {
+        /* The device cannot signal completions, we must poll it to be
+         * noticed of them. This blocks until an IO completes, new requests
+         * wait in the disk queue meanwhile. */
+        reap_and_complete_ios(disk_device, 1, -1);
+        return;
+    }
+
+    /* A batch left over means the device is full: with completion events,
+     * the event fd is signalled when room is made */
+    EXA_ASSERT(batch->nb == 0 || disk_device->io_in_flight > 0);
+
+    if (os_eventfd_wait(disk_device->event_fd, 200 /* timeout in ms */) > 0)
+        os_eventfd_reset(disk_device->event_fd);
 }
 
 /**
@@ -365,9 +484,10 @@ static int submit_req(device_t *disk_device, header_t **_req)
  */
 void exa_td_main(void *p)
 {
-  bool pending_io = false;
   device_t *disk_device;
+  td_batch_t batch;
   char myname[32];
+  int i;
 
   exalog_as(EXAMSG_NBD_SERVER_ID);
 
@@ -376,73 +496,66 @@ void exa_td_main(void *p)
   os_snprintf(myname, 31, "serv%s", disk_device->path);
   exa_thread_name_set(myname);
 
-  memset(&disk_device->locked_zone, 0xEE, sizeof(disk_device->locked_zone));
+  exa_interval_tree_init(&disk_device->locked_zones);
+  for (i = 0; i < NBMAX_DISK_LOCKED_ZONES; i++)
+      disk_device->free_zone[i] = &disk_device->locked_zone[i];
   disk_device->nb_locked_zone = 0;
 
+  disk_device->parked_first = NULL;
+  disk_device->parked_last = NULL;
+
+  batch.nb = 0;
+
+  /* The thread never blocks on one source of events while the other one
+   * has something ready: completions are acknowledged and new requests
+   * submitted as they come, so that the device queue does not drain while
+   * requests wait in the disk queue. The event fd is reset before the
+   * sources are checked again, thus no event can be missed. */
 #define run (!disk_device->exit_thread)
   while (run)
   {
-      int err;
-
-      header_t *req = pick_one_req(disk_device);
+      bool progress = false;
+      header_t *req;
+      int n;
 
-      if (req == NULL && pending_io)
+      /* Acknowledge the IOs already completed, without waiting */
+      do {
+          n = reap_and_complete_ios(disk_device, 0, 0);
+          if (n > 0)
+              progress = true;
+      } while (n == TD_BATCH_MAX);
+
+      /* Gather the requests already queued (up to the batch size) so that
+       * they are submitted to the device with a single call. */
+      while (batch.nb < TD_BATCH_MAX
+             && (req = pick_one_req(disk_device)) != NULL)
       {
-          /* NOTE: This code make the thread to wait for the completion
-           * of at least one IO for an indefinite time (it calls
-           * 'exa_rdev_wait_one_request'). If during this time a new
-           * request occurs it will not be sent to the disk and I think it
-           * can cause some performance problems.
-           *
-           * The point here is that we must poll the block device to be
-           * noticed of the IO completion. One can convince himself of the
-           * problem by looking at 'exa_rdev_make_request_new'
-           * prototype. This function sends a new request to a device but
-           * it also gets the reply for some other request.
-           */
-          err = wait_and_complete_one_io(disk_device);
-          if (err == RDEV_REQUEST_ALL_ENDED)
-              pending_io = false;
-          continue;
+          handle_req(disk_device, req, &batch);
+          progress = true;
       }
-      else if (req == NULL && !pending_io)
-          do {
-              req = wait_new_req(disk_device, 200 /* timeout in ms */);
-          } while (req == NULL && run);
-
-      /* If req != NULL, the request must be handled otherwise it would be
-       * leaked. So even if run is false, we submit the IO and then exit the
-       * loop, the wait_for_all_completion will eventually make sure that any
-       * pending IOs was answerd. */
-      if (req == NULL)
-          break;
 
-      /* being here means a req needs to be handled */
-      EXA_ASSERT(req != NULL);
+      if (batch.nb > 0 && submit_batch_nowait(disk_device, &batch) > 0)
+          progress = true;
 
-      do {
-          err = submit_req(disk_device, &req);
-          if (err == RDEV_REQUEST_NOT_ENOUGH_FREE_REQ)
-          {
-              /* There was no room in kernel for this IO, thus
-               * we try to complete pending IOs to make some free
-               * space in kernel. */
-              int err2 = wait_and_complete_one_io(disk_device);
-              /* There MUST be pending IOs thus kernel cannot return
-               * RDEV_REQUEST_ALL_ENDED */
-              EXA_ASSERT(err2 != RDEV_REQUEST_ALL_ENDED);
-          }
-          else
-              pending_io = true;
-      } while (err == RDEV_REQUEST_NOT_ENOUGH_FREE_REQ);
-
-      EXA_ASSERT(means_finished(err) || err == RDEV_REQUEST_NONE_ENDED);
-
-      if (means_finished(err))
-          handle_completed_io(disk_device, req);
+      if (!progress)
+          td_wait_event(disk_device, &batch);
   }
 
-  /* Before leaving, make sure that all requests were successfully answerd
+  /* The requests picked must be handled otherwise they would be leaked.
+   * Before leaving, make sure that all requests were successfully answerd
    * by kernel. */
+  submit_batch(disk_device, &batch);
   __wait_for_all_completion(disk_device);
+
+  /* The IOs still parked are sent back with EAGAIN: the caller will
+   * re-submit them later. */
+  while (disk_device->parked_first != NULL)
+  {
+      header_t *req = disk_device->parked_first;
+
+      disk_device->parked_first = req->next_parked;
+      req->io.desc.result = -EAGAIN;
+      handle_completed_io(disk_device, req);
+  }
+  disk_device->parked_last = NULL;
 }
@@ -25,6 +25,7 @@
 #include "common/include/exa_error.h"
 #include "common/include/exa_names.h"
 #include "common/include/exa_perf_instance.h" /* for 'exa_perf_instance_get' */
+#include "exatrace/include/exatrace.h"
 #include "os/include/strlcpy.h"
 #include "log/include/log.h"
 #include "nbd/serverd/nbd_disk_thread.h"
@@ -60,6 +61,7 @@ static void tcp_server_end_sending(void *ctx, int error)
         nbd_list_post(&nbd_server.ti_queue.free, req->io.buf, -1);
 
     serverd_perf_end_request(&req->serv_perf);
+    EXATRACE(NBD_SERVER_END, req, 0, req->io.desc.result);
 
     nbd_list_post(&nbd_server.list_root.free, req, -1);
 }
@@ -72,6 +74,8 @@ static void nbd_server_send(exa_nodeid_t to, header_t *req)
 
     EXA_ASSERT(req->type == NBD_HEADER_RH);
 
+    EXATRACE(NBD_SERVER_REPLY, req, 0, req->io.desc.result);
+
     if (!send_data)
     {
         nbd_list_post(&nbd_server.ti_queue.free, req->io.buf, -1);
@@ -112,6 +116,9 @@ static bool nbd_recv_processing(exa_nodeid_t from, const nbd_io_desc_t *io, void
         serverd_perf_make_request(&req_header->serv_perf,
                                   io->request_type == NBD_REQ_TYPE_READ,
                                   io->sector, io->sector_nb);
+        EXATRACE(NBD_SERVER_BEGIN, req_header,
+                 EXATRACE_WIRE_KEY(from, io->req_num),
+                 SECTORS_TO_BYTES(io->sector_nb));
 
         /* put directly the header on the appropriate disk queue (the first
          * approach was to put this header on the control blocs queue for
@@ -196,6 +203,15 @@ static int init_serverd(char *net_type)
     nbd_init_root(nbd_server.num_receive_headers, /* as many buffer as headers. */
 		  nbd_server.bd_buffer_size, &nbd_server.ti_queue);
 
+    /* Headers and buffers are taken by the network threads and given back
+     * by the disk threads or the network threads once sent */
+    if (nbd_root_cache_free(&nbd_server.list_root) < 0
+        || nbd_root_cache_free(&nbd_server.ti_queue) < 0)
+    {
+        exalog_error("Cannot create caches of request headers and buffers");
+        return -NBD_ERR_SERVERD_INIT;
+    }
+
     os_thread_mutex_init(&nbd_server.mutex_edevs);
 
     /* FIXME memset is NOT a correct initialization  (especially for pointers...) */
@@ -492,6 +508,9 @@ int daemon_init(int argc, char *argv[])
 	    /* network type */
 	    /* to set the TCP buffers size to 128 K, the net_type must be
 	     * of the form: TCP=128
+	     * optionally followed by ,IO_THREADS=<n> to use n epoll based
+	     * threads per direction and ,ZEROCOPY=1 to send large payloads
+	     * without copy (see init_tcp())
 	     */
 	case 'n':
 	    net_type = optarg;
@@ -549,6 +568,14 @@ int daemon_init(int argc, char *argv[])
 	}
     }
 
+    retval = exatrace_static_init(exa_daemon_name(EXA_DAEMON_SERVERD),
+                                  nbd_server.node_id);
+    if (retval != EXA_SUCCESS)
+    {
+        exalog_error("Failed to initialize the IO tracing: %s", exa_error_msg(retval));
+        return retval;
+    }
+
     retval = init_serverd(net_type);
     if (retval != EXA_SUCCESS)
 	return retval;
@@ -564,6 +591,7 @@ int daemon_main(void)
     clean_serverd();
 
     exa_perf_instance_static_clean();
+    exatrace_static_clean();
 
     exalog_static_clean();
 
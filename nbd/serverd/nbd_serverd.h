@@ -19,6 +19,7 @@
 #endif
 
 #include "common/include/uuid.h"
+#include "common/include/exa_interval_tree.h"
 #include "common/include/exa_nodeset.h"
 
 #include "examsg/include/examsg.h"
@@ -32,7 +33,8 @@ struct device
   /* path to the disk device */
   char path[EXA_MAXSIZE_DEVPATH + 1];
   exa_rdev_handle_t *handle;
-  /* List of incoming requests (interface with 'ti_main' thread) */
+  /* List of incoming requests (interface with 'ti_main' thread). Only the
+   * disk thread removes requests from it, so it is lock-free (MPSC) */
   struct nbd_list disk_queue;
   /* Size of the device in sectors
    * FIXME: An accessor to rdev would be more suitable
@@ -41,22 +43,39 @@ struct device
 
   uint32_t dev_index;
 
-  struct locked_zone {
-      uint64_t sector;
-      uint64_t sector_count;
-  } locked_zone[NBMAX_DISK_LOCKED_ZONES];
+  /* Locked zones, indexed by sector. The nodes are taken from
+   * locked_zone[], the ones not in use are stacked in free_zone[]. */
+  exa_interval_tree_t locked_zones;
+  exa_interval_node_t locked_zone[NBMAX_DISK_LOCKED_ZONES];
+  exa_interval_node_t *free_zone[NBMAX_DISK_LOCKED_ZONES];
   int nb_locked_zone;
 
+  /* IOs on locked zones, resumed when a zone is unlocked */
+  struct header *parked_first;
+  struct header *parked_last;
+
   bool exit_thread;
 
-  /* used for lock/unlocking of zone */
+  /* Signalled when a request is posted on disk_queue and, if
+   * completion_events is true, when an IO completes on the device */
+  int event_fd;
+  bool completion_events;
+
+  /* Number of IOs submitted to the device and not completed yet. Only
+   * written by the disk thread, for statistics purposes */
+  unsigned int io_in_flight;
+
+  /* used for lock/unlocking of zone. The header is taken once for all
+   * when the device is exported: the free headers may all be held by IOs
+   * parked until the zone is unlocked. */
+  struct header *lock_header;
   int locking_return;
   os_sem_t lock_sem_disk;
 };
 
 typedef struct device device_t;
 
-typedef struct
+typedef struct header
 {
     enum {
         NBD_HEADER_LOCK = 1135,
@@ -83,6 +102,8 @@ typedef struct
 #ifdef WITH_PERF
     serv_perf_t serv_perf;
 #endif
+    /* next IO parked on the device (see device::parked_first) */
+    struct header *next_parked;
 } header_t;
 
 struct server
@@ -29,6 +29,7 @@
 
 #include "os/include/os_disk.h"
 #include "os/include/os_error.h"
+#include "os/include/os_eventfd.h"
 #include "os/include/os_file.h"
 #include "os/include/os_mem.h"
 #include "os/include/os_thread.h"
@@ -220,12 +221,37 @@ int export_device(const exa_uuid_t *uuid, char *device_path)
     }
 
     dev->handle = NULL;
+    dev->event_fd = -1;
     err = -CMD_EXP_ERR_OPEN_DEVICE;
 
     dev->handle = exa_rdev_handle_alloc(device_path);
     if (dev->handle == NULL)
         goto error;
 
+    /* IOs are done from/to the receive buffers of the server */
+    err = exa_rdev_register_buffers(dev->handle, nbd_server.ti_queue.payload,
+                                    nbd_server.ti_queue.elt_size,
+                                    nbd_server.ti_queue.nb_elt);
+    if (err != 0)
+        exalog_warning("Cannot register the IO buffers with '%s': %s (%d)",
+                       device_path, exa_error_msg(err), err);
+
+    /* The disk thread waits for new requests and IO completions alike */
+    dev->event_fd = os_eventfd_create();
+    if (dev->event_fd < 0)
+    {
+        err = dev->event_fd;
+        exalog_error("Cannot create the event fd of '%s': %s (%d)",
+                     device_path, exa_error_msg(err), err);
+        goto error;
+    }
+
+    err = exa_rdev_set_completion_eventfd(dev->handle, dev->event_fd);
+    dev->completion_events = err == 0;
+    if (err != 0 && err != -ENOTSUP)
+        exalog_warning("Cannot get IO completion events on '%s': %s (%d)",
+                       device_path, exa_error_msg(err), err);
+
     err = get_nb_sectors(device_path, &dev->size_in_sectors);
     if (err != EXA_SUCCESS)
         goto error;
@@ -246,10 +272,16 @@ int export_device(const exa_uuid_t *uuid, char *device_path)
 
     dev->dev_index = i;
     dev->exit_thread = false;
+    dev->io_in_flight = 0;
 
     nbd_init_list(&nbd_server.list_root, &dev->disk_queue);
+    nbd_list_set_mpsc(&dev->disk_queue);
+    nbd_list_set_notify_fd(&dev->disk_queue, dev->event_fd);
 
     /* resource needed to lock/unlock a zone */
+    dev->lock_header = nbd_list_remove(&nbd_server.list_root.free, NULL,
+                                       LISTWAIT);
+    EXA_ASSERT(dev->lock_header != NULL);
     os_sem_init (&dev->lock_sem_disk, 0);
 
     /* launch disk thread (TD) */
@@ -258,6 +290,7 @@ int export_device(const exa_uuid_t *uuid, char *device_path)
                                 exa_td_main, dev, "TD_thread"))
     {
         os_sem_destroy(&dev->lock_sem_disk);
+        nbd_list_post(&nbd_server.list_root.free, dev->lock_header, -1);
         err = -NBD_ERR_THREAD_CREATION;
         goto error;
     }
@@ -271,6 +304,8 @@ error:
     {
         if (dev->handle != NULL)
             exa_rdev_handle_free(dev->handle);
+        if (dev->event_fd >= 0)
+            os_eventfd_close(dev->event_fd);
         os_free(dev);
     }
     return err;
@@ -329,8 +364,11 @@ int unexport_device(const exa_uuid_t *uuid)
   if (dev->handle != NULL)
       exa_rdev_handle_free(dev->handle);
 
+  os_eventfd_close(dev->event_fd);
+
   /* close the semaphore used by the disk */
   os_sem_destroy(&dev->lock_sem_disk);
+  nbd_list_post(&nbd_server.list_root.free, dev->lock_header, -1);
 
   /* free used memory for the device */
   os_free(dev);
@@ -0,0 +1,423 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/*
+ * Benchmark of the server disk thread: a mixed load (small random reads,
+ * large writes and a few flushes) is posted on the disk queue of a device,
+ * as the NBD server would do, and the number of IOs in flight on the device
+ * is sampled while the load runs.
+ *
+ * The disk thread is not expected to let the device queue drain while
+ * requests are waiting in the disk queue: the sampled queue depth should
+ * stay close to the number of requests posted. Compare with -n, which
+ * makes the disk thread poll the device for completions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nbd/serverd/nbd_disk_thread.h"
+#include "nbd/serverd/nbd_serverd.h"
+
+#include "rdev/include/exa_rdev.h"
+
+#include "common/include/exa_constants.h"
+#include "common/include/exa_conversion.h"
+#include "common/include/exa_error.h"
+
+#include "os/include/os_disk.h"
+#include "os/include/os_error.h"
+#include "os/include/os_eventfd.h"
+#include "os/include/os_file.h"
+#include "os/include/os_getopt.h"
+#include "os/include/os_inttypes.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+#include "os/include/strlcpy.h"
+
+#define READ_SIZE       4096
+#define WRITE_SIZE      DEFAULT_BD_BUFFER_SIZE
+/** One request out of FLUSH_PERIOD is a flush */
+#define FLUSH_PERIOD    200
+#define SAMPLE_PERIOD_MS  5
+/** Size of the zones locked with --locks, as a fraction of the device */
+#define LOCK_ZONES      16
+
+/* Symbols used by the disk thread */
+server_t nbd_server;
+
+/** Name of this program */
+static const char *program = NULL;
+
+static struct
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t flushes;
+    uint64_t errors;
+    uint64_t bytes;
+} completed;
+
+static os_thread_mutex_t completed_lock;
+
+void nbd_server_end_io(header_t *req)
+{
+    os_thread_mutex_lock(&completed_lock);
+
+    if (req->io.desc.result != 0)
+        completed.errors++;
+    else if (req->io.desc.sector_nb == 0)
+        completed.flushes++;
+    else if (req->io.desc.request_type == NBD_REQ_TYPE_READ)
+        completed.reads++;
+    else
+        completed.writes++;
+
+    completed.bytes += (uint64_t)req->io.desc.sector_nb * SECTOR_SIZE;
+
+    os_thread_mutex_unlock(&completed_lock);
+
+    nbd_list_post(&nbd_server.ti_queue.free, req->io.buf, -1);
+    nbd_list_post(&nbd_server.list_root.free, req, -1);
+}
+
+static void usage(void)
+{
+    printf("Usage: %s [OPTIONS] DEVICE\n"
+           "Benchmark the disk thread of the NBD server with a mixed load.\n"
+           "DEVICE is overwritten.\n"
+           "  -d, --depth     Number of requests posted at once (default 64)\n"
+           "  -l, --locks     Lock a zone while posting each batch of requests,\n"
+           "                  as a rebuild does\n"
+           "  -n, --no-events Do not use IO completion events\n"
+           "  -s, --size      Size of DEVICE in MiB, needed for a regular file\n"
+           "  -t, --time      Duration in seconds (default 10)\n"
+           "  -w, --writes    Percentage of writes (default 30)\n"
+           "  -h, --help      Display this help and exit\n",
+           program);
+}
+
+/** Post a request on the disk queue, waiting for a free header */
+static void post_request(device_t *dev, unsigned int write_percent,
+                         uint64_t nb_sectors, uint64_t req_num)
+{
+    header_t *req;
+    void *buf;
+
+    req = nbd_list_remove(&nbd_server.list_root.free, NULL, LISTWAIT);
+    buf = nbd_list_remove(&nbd_server.ti_queue.free, NULL, LISTWAIT);
+
+    memset(req, 0, sizeof(*req));
+    req->type = NBD_HEADER_RH;
+    req->io.buf = buf;
+    req->io.desc.req_num = req_num;
+
+    if (req_num % FLUSH_PERIOD == FLUSH_PERIOD - 1)
+    {
+        req->io.desc.request_type = NBD_REQ_TYPE_WRITE;
+        req->io.desc.sector = 0;
+        req->io.desc.sector_nb = 0;
+    }
+    else if ((unsigned int)(rand() % 100) < write_percent)
+    {
+        req->io.desc.request_type = NBD_REQ_TYPE_WRITE;
+        req->io.desc.sector_nb = WRITE_SIZE / SECTOR_SIZE;
+        req->io.desc.sector = (rand() % (nb_sectors / req->io.desc.sector_nb))
+                              * req->io.desc.sector_nb;
+        memset(buf, (int)req_num, WRITE_SIZE);
+    }
+    else
+    {
+        req->io.desc.request_type = NBD_REQ_TYPE_READ;
+        req->io.desc.sector_nb = READ_SIZE / SECTOR_SIZE;
+        req->io.desc.sector = (rand() % (nb_sectors / req->io.desc.sector_nb))
+                              * req->io.desc.sector_nb;
+    }
+
+    nbd_list_post(&dev->disk_queue, req, -1);
+}
+
+static uint64_t elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+
+    return (now.tv_sec - start->tv_sec) * 1000
+           + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/** Size of the device, in bytes */
+static int get_size(const char *path, uint64_t *size)
+{
+    int fd, err;
+
+    fd = os_disk_open_raw(path, OS_DISK_READ);
+    if (fd < 0)
+        return fd;
+
+    err = os_disk_get_size(fd, size);
+    close(fd);
+
+    return err;
+}
+
+static int run_bench(const char *path, uint64_t dev_size, unsigned int depth,
+                     bool events, bool locks, unsigned int duration,
+                     unsigned int write_percent)
+{
+    device_t dev;
+    os_thread_t td;
+    struct timespec start;
+    uint64_t nb_sectors, req_num = 0, ms;
+    uint64_t nb_samples = 0, sum_depth = 0, nb_drained = 0;
+    unsigned int min_depth = depth, max_depth = 0;
+    int err;
+
+    if (dev_size / SECTOR_SIZE
+        <= RDEV_RESERVED_AREA_IN_SECTORS + WRITE_SIZE / SECTOR_SIZE)
+    {
+        fprintf(stderr, "'%s' is too small\n", path);
+        return -EINVAL;
+    }
+    nb_sectors = dev_size / SECTOR_SIZE - RDEV_RESERVED_AREA_IN_SECTORS;
+
+    memset(&nbd_server, 0, sizeof(nbd_server));
+    nbd_init_root(depth, sizeof(header_t), &nbd_server.list_root);
+    nbd_init_root(depth, WRITE_SIZE, &nbd_server.ti_queue);
+    if (nbd_root_cache_free(&nbd_server.list_root) < 0
+        || nbd_root_cache_free(&nbd_server.ti_queue) < 0)
+    {
+        fprintf(stderr, "cannot create caches of headers and buffers\n");
+        return -ENOMEM;
+    }
+
+    memset(&dev, 0, sizeof(dev));
+    strlcpy(dev.path, path, sizeof(dev.path));
+    dev.size_in_sectors = nb_sectors;
+
+    dev.handle = exa_rdev_handle_alloc(path);
+    if (dev.handle == NULL)
+    {
+        fprintf(stderr, "cannot open '%s' with exa_rdev\n", path);
+        err = -CMD_EXP_ERR_OPEN_DEVICE;
+        goto free_lists;
+    }
+
+    exa_rdev_register_buffers(dev.handle, nbd_server.ti_queue.payload,
+                              nbd_server.ti_queue.elt_size,
+                              nbd_server.ti_queue.nb_elt);
+
+    dev.event_fd = os_eventfd_create();
+    if (dev.event_fd < 0)
+    {
+        err = dev.event_fd;
+        fprintf(stderr, "cannot create event fd: %s\n", exa_error_msg(err));
+        goto free_handle;
+    }
+
+    if (events)
+    {
+        err = exa_rdev_set_completion_eventfd(dev.handle, dev.event_fd);
+        if (err != 0)
+            fprintf(stderr, "no IO completion events: %s\n", exa_error_msg(err));
+        dev.completion_events = err == 0;
+    }
+
+    nbd_init_list(&nbd_server.list_root, &dev.disk_queue);
+    nbd_list_set_mpsc(&dev.disk_queue);
+    nbd_list_set_notify_fd(&dev.disk_queue, dev.event_fd);
+    dev.lock_header = nbd_list_remove(&nbd_server.list_root.free, NULL,
+                                      LISTWAIT);
+    os_sem_init(&dev.lock_sem_disk, 0);
+
+    if (!os_thread_create(&td, 0, exa_td_main, &dev))
+    {
+        fprintf(stderr, "cannot create disk thread\n");
+        err = -NBD_ERR_THREAD_CREATION;
+        goto free_event_fd;
+    }
+
+    /* The requests are posted as soon as a header is free, which keeps
+     * depth requests between the disk queue and the device. The queue
+     * depth is sampled each time a batch of requests is posted. */
+    os_get_monotonic_time(&start);
+    while ((ms = elapsed_ms(&start)) < duration * 1000)
+    {
+        unsigned int in_flight;
+        uint64_t zone = 0;
+        int i;
+
+        /* The requests in the zone are parked until it is unlocked */
+        if (locks)
+        {
+            zone = (rand() % LOCK_ZONES) * (nb_sectors / LOCK_ZONES);
+            exa_disk_lock_zone(&dev, zone, nb_sectors / LOCK_ZONES);
+        }
+
+        for (i = 0; i < 8; i++)
+            post_request(&dev, write_percent, nb_sectors, req_num++);
+
+        if (locks)
+            exa_disk_unlock_zone(&dev, zone, nb_sectors / LOCK_ZONES);
+
+        if (ms < nb_samples * SAMPLE_PERIOD_MS)
+            continue;
+
+        in_flight = dev.io_in_flight;
+        nb_samples++;
+        sum_depth += in_flight;
+        if (in_flight < min_depth)
+            min_depth = in_flight;
+        if (in_flight > max_depth)
+            max_depth = in_flight;
+        if (in_flight == 0)
+            nb_drained++;
+    }
+    ms = elapsed_ms(&start);
+
+    dev.exit_thread = true;
+    os_thread_join(td);
+    err = 0;
+
+    printf("completion events: %s\n", dev.completion_events ? "yes" : "no");
+    printf("requests: %"PRIu64" reads, %"PRIu64" writes, %"PRIu64" flushes,"
+           " %"PRIu64" errors\n", completed.reads, completed.writes,
+           completed.flushes, completed.errors);
+    printf("throughput: %.0f IO/s, %.1f MiB/s\n",
+           (completed.reads + completed.writes) * 1000.0 / ms,
+           completed.bytes * 1000.0 / ms / (1024 * 1024));
+    if (nb_samples > 0)
+        printf("queue depth: avg %.1f, min %u, max %u, drained %.1f%% of"
+               " %"PRIu64" samples (%u requests posted)\n",
+               (double)sum_depth / nb_samples, min_depth, max_depth,
+               nb_drained * 100.0 / nb_samples, nb_samples, depth);
+
+free_event_fd:
+    os_sem_destroy(&dev.lock_sem_disk);
+    nbd_list_post(&nbd_server.list_root.free, dev.lock_header, -1);
+    nbd_close_list(&dev.disk_queue);
+    os_eventfd_close(dev.event_fd);
+free_handle:
+    exa_rdev_handle_free(dev.handle);
+free_lists:
+    nbd_close_root(&nbd_server.ti_queue);
+    nbd_close_root(&nbd_server.list_root);
+
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_opts[] =
+    {
+        { "depth",     required_argument, NULL, 'd' },
+        { "locks",     no_argument,       NULL, 'l' },
+        { "no-events", no_argument,       NULL, 'n' },
+        { "size",      required_argument, NULL, 's' },
+        { "time",      required_argument, NULL, 't' },
+        { "writes",    required_argument, NULL, 'w' },
+        { "help",      no_argument,       NULL, 'h' },
+        { NULL,        0,                 NULL, 0   }
+    };
+    unsigned int depth = 64, duration = 10, write_percent = 30;
+    uint64_t size_mb = 0, dev_size;
+    bool events = true, locks = false;
+    int c, err;
+
+    program = argv[0];
+
+    while ((c = os_getopt_long(argc, argv, "d:lns:t:w:h", long_opts, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'd':
+            if (to_uint(optarg, &depth) != EXA_SUCCESS || depth == 0)
+            {
+                fprintf(stderr, "invalid depth: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'l':
+            locks = true;
+            break;
+
+        case 'n':
+            events = false;
+            break;
+
+        case 's':
+            if (to_uint64(optarg, &size_mb) != EXA_SUCCESS || size_mb == 0)
+            {
+                fprintf(stderr, "invalid size: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 't':
+            if (to_uint(optarg, &duration) != EXA_SUCCESS || duration == 0)
+            {
+                fprintf(stderr, "invalid duration: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'w':
+            if (to_uint(optarg, &write_percent) != EXA_SUCCESS
+                || write_percent > 100)
+            {
+                fprintf(stderr, "invalid write percentage: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage();
+        return 1;
+    }
+
+    if (size_mb != 0)
+        dev_size = size_mb * 1024 * 1024;
+    else if ((err = get_size(argv[optind], &dev_size)) != 0)
+    {
+        fprintf(stderr, "cannot get the size of '%s': %s\n", argv[optind],
+                exa_error_msg(err));
+        return 1;
+    }
+
+    err = exa_rdev_static_init(RDEV_STATIC_GET);
+    if (err != 0)
+    {
+        fprintf(stderr, "failed initializating RDEV statics: error %d\n", err);
+        return 1;
+    }
+
+    os_thread_mutex_init(&completed_lock);
+
+    err = run_bench(argv[optind], dev_size, depth, events, locks, duration,
+                    write_percent);
+
+    os_thread_mutex_destroy(&completed_lock);
+    exa_rdev_static_clean(RDEV_STATIC_RELEASE);
+
+    return err ? 1 : 0;
+}
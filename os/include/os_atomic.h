@@ -79,10 +79,78 @@ void os_atomic_inc(os_atomic_t *atomic);
  * @param new_value this value will be the new value of *ptr if value of *ptr was old_value
  * @return value of *ptr
  *
- * @os_replace{Linux, cmpxchgl}
+ * @os_replace{Linux, lock, cmpxchgl}
  * @os_replace{Windows, InterlockedCompareExchange}
  */
 int os_atomic_cmpxchg(os_atomic_t *ptr, int old_value, int new_value);
 
+/**
+ * Atomically set the value of an atomic variable and get its previous
+ * value.
+ *
+ * @param atomic  atomic variable
+ * @param value   new value
+ *
+ * @return the previous value
+ *
+ * @os_replace{Linux, xchg}
+ * @os_replace{Windows, InterlockedExchange}
+ */
+int os_atomic_xchg(os_atomic_t *atomic, int value);
+
+/**
+ * Atomic compare and exchange of a 64-bit value.
+ *
+ * @param ptr        64-bit variable
+ * @param old_value  value expected for *ptr
+ * @param new_value  new value of *ptr if *ptr was old_value
+ *
+ * @return the previous value of *ptr
+ *
+ * @os_replace{Linux, cmpxchg8b, cmpxchgq}
+ * @os_replace{Windows, InterlockedCompareExchange64}
+ */
+uint64_t os_atomic_cmpxchg64(volatile uint64_t *ptr, uint64_t old_value,
+                             uint64_t new_value);
+
+/**
+ * Atomically add to a 64-bit value.
+ *
+ * @param ptr    64-bit variable
+ * @param value  value to add to *ptr
+ *
+ * @os_replace{Linux, xaddq}
+ * @os_replace{Windows, InterlockedExchangeAdd64}
+ */
+void os_atomic_add64(volatile uint64_t *ptr, uint64_t value);
+
+/**
+ * Atomically exchange a pointer.
+ *
+ * @param ptr    pointer variable
+ * @param value  new value of *ptr
+ *
+ * @return the previous value of *ptr
+ *
+ * @os_replace{Linux, xchg}
+ * @os_replace{Windows, InterlockedExchangePointer}
+ */
+void *os_atomic_ptr_xchg(void * volatile *ptr, void *value);
+
+/**
+ * Atomic compare and exchange of a pointer.
+ *
+ * @param ptr        pointer variable
+ * @param old_value  value expected for *ptr
+ * @param new_value  new value of *ptr if *ptr was old_value
+ *
+ * @return the previous value of *ptr
+ *
+ * @os_replace{Linux, cmpxchg}
+ * @os_replace{Windows, InterlockedCompareExchangePointer}
+ */
+void *os_atomic_ptr_cmpxchg(void * volatile *ptr, void *old_value,
+                            void *new_value);
+
 #endif /* _OS_ATOMIC_H */
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef _OS_EVENTFD_H
+#define _OS_EVENTFD_H
+
+#include "os/include/os_inttypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create an event file descriptor: a counter that is readable (in the
+ * poll sense) when non zero. It may be handed to the kernel, for instance
+ * to be signalled upon IO completion.
+ *
+ * @return the file descriptor, or a negative error code
+ *
+ * @os_replace{Linux, eventfd}
+ */
+int os_eventfd_create(void);
+
+/**
+ * Close an event file descriptor.
+ *
+ * @param fd  Event file descriptor
+ *
+ * @os_replace{Linux, close}
+ */
+void os_eventfd_close(int fd);
+
+/**
+ * Signal an event file descriptor.
+ *
+ * Safe to call from any thread.
+ *
+ * @param fd  Event file descriptor
+ *
+ * @os_replace{Linux, eventfd_write}
+ */
+void os_eventfd_signal(int fd);
+
+/**
+ * Reset an event file descriptor, without waiting.
+ *
+ * @param fd  Event file descriptor
+ *
+ * @return the number of signals since the last reset (0 if none)
+ *
+ * @os_replace{Linux, eventfd_read}
+ */
+uint64_t os_eventfd_reset(int fd);
+
+/**
+ * Wait for an event file descriptor to be signalled. The descriptor is
+ * not reset.
+ *
+ * @param fd          Event file descriptor
+ * @param timeout_ms  Timeout in milliseconds, -1 means infinite
+ *
+ * @return 1 if signalled, 0 on timeout, or a negative error code (-EINTR
+ *         when interrupted by a signal)
+ *
+ * @os_replace{Linux, poll}
+ */
+int os_eventfd_wait(int fd, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OS_EVENTFD_H */
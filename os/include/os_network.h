@@ -35,9 +35,13 @@ typedef unsigned int in_addr_t;
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
+#include <sys/uio.h>
 
 typedef int socket_t;
 
+/** Buffer descriptor for vectored I/O (fields iov_base and iov_len) */
+typedef struct iovec os_iovec_t;
+
 #endif
 
 #ifdef __cplusplus
@@ -231,6 +235,57 @@ int os_setsockopt(int s, int level, int optname, const void *optval, int optlen)
  */
 int os_send(int socket, const void *buffer, int length);
 
+/** Flag of os_sendv(): do not copy the data into the kernel, see
+ * os_sock_set_zerocopy() */
+#define OS_SEND_ZEROCOPY  0x1
+
+/**
+ * Send data gathered from several buffers over network using given
+ * connected socket, in a single call.
+ *
+ * With OS_SEND_ZEROCOPY, the buffers must not be modified until the kernel
+ * reports the completion of the call (see os_sock_zerocopy_completed()).
+ * Each call returning a positive value is given a sequence number by the
+ * kernel, starting from 0 for a socket.
+ *
+ * @param socket  The socket
+ * @param iov     The buffers
+ * @param iovcnt  Number of buffers
+ * @param flags   0 or OS_SEND_ZEROCOPY
+ *
+ * @return Number of bytes sent if successfull, negative error code otherwise
+ *
+ * @os_replace{Linux, sendmsg}
+ */
+int os_sendv(int socket, const os_iovec_t *iov, int iovcnt, int flags);
+
+/**
+ * Allow zero-copy sends on a socket.
+ *
+ * @param socket  The socket
+ *
+ * @return 0 if successful, a negative error code otherwise (-ENOPROTOOPT
+ *         when not supported by the kernel)
+ *
+ * @os_replace{Linux, setsockopt}
+ */
+int os_sock_set_zerocopy(int socket);
+
+/**
+ * Get the next completion of zero-copy sends from the error queue of a
+ * socket, without blocking.
+ *
+ * @param socket     The socket
+ * @param[out] low   Sequence number of the first completed send
+ * @param[out] high  Sequence number of the last completed send
+ *
+ * @return 1 if a completion was retrieved, 0 if there is none pending,
+ *         a negative error code otherwise
+ *
+ * @os_replace{Linux, recvmsg}
+ */
+int os_sock_zerocopy_completed(int socket, uint32_t *low, uint32_t *high);
+
 /**
  * Receive data from network using given socket
  *
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef _OS_POLL_H
+#define _OS_POLL_H
+
+#include "os/include/os_inttypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Readiness set: a set of file descriptors that can be waited on,
+ * updated incrementally, and woken up from another thread. */
+typedef struct os_poll os_poll_t;
+
+#define OS_POLL_IN   0x1  /**< fd is readable */
+#define OS_POLL_OUT  0x2  /**< fd is writable */
+#define OS_POLL_ERR  0x4  /**< fd is in error or hung up (output only) */
+
+typedef struct
+{
+    int events;   /**< OS_POLL_xxx flags that are ready */
+    int key;      /**< key given when the fd was added */
+} os_poll_event_t;
+
+/**
+ * Create a readiness set.
+ *
+ * @return the set or NULL if it could not be allocated
+ *
+ * @os_replace{Linux, epoll_create, eventfd}
+ */
+os_poll_t *os_poll_create(void);
+
+/**
+ * Delete a readiness set.
+ *
+ * The file descriptors in the set are not closed.
+ *
+ * @param poll  Set to delete
+ */
+void os_poll_delete(os_poll_t *poll);
+
+/**
+ * Add a file descriptor to a readiness set.
+ *
+ * @param poll    The set
+ * @param fd      File descriptor to watch
+ * @param events  OS_POLL_IN and/or OS_POLL_OUT, may be 0
+ * @param key     Value reported in os_poll_event_t::key, must be >= 0
+ *
+ * @return 0 if successful, a negative error code otherwise
+ *
+ * @os_replace{Linux, epoll_ctl}
+ */
+int os_poll_add(os_poll_t *poll, int fd, int events, int key);
+
+/**
+ * Change the events watched for a file descriptor already in the set.
+ *
+ * @param poll    The set
+ * @param fd      File descriptor
+ * @param events  OS_POLL_IN and/or OS_POLL_OUT, may be 0
+ * @param key     Value reported in os_poll_event_t::key, must be >= 0
+ *
+ * @return 0 if successful, a negative error code otherwise
+ *
+ * @os_replace{Linux, epoll_ctl}
+ */
+int os_poll_modify(os_poll_t *poll, int fd, int events, int key);
+
+/**
+ * Remove a file descriptor from a readiness set.
+ *
+ * @param poll  The set
+ * @param fd    File descriptor
+ *
+ * @return 0 if successful, a negative error code otherwise
+ *
+ * @os_replace{Linux, epoll_ctl}
+ */
+int os_poll_remove(os_poll_t *poll, int fd);
+
+/**
+ * Wait for file descriptors of the set to become ready.
+ *
+ * The wait also ends (with 0 events) when os_poll_wakeup() is called;
+ * wakeups that happen while nobody is waiting are not lost.
+ *
+ * @param[in]  poll        The set
+ * @param[out] events      Ready events
+ * @param[in]  max_events  Size of events
+ * @param[in]  timeout_ms  Timeout in milliseconds, -1 means infinite
+ *
+ * @return the number of events filled (0 on timeout or wakeup), or a
+ *         negative error code (-EINTR when interrupted by a signal)
+ *
+ * @os_replace{Linux, epoll_wait}
+ */
+int os_poll_wait(os_poll_t *poll, os_poll_event_t *events, int max_events,
+                 int timeout_ms);
+
+/**
+ * Wake up the thread waiting in os_poll_wait().
+ *
+ * Safe to call from any thread.
+ *
+ * @param poll  The set
+ *
+ * @os_replace{Linux, write}
+ */
+void os_poll_wakeup(os_poll_t *poll);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OS_POLL_H */
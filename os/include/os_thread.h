@@ -189,5 +189,17 @@ void os_thread_join(os_thread_t handle);
  */
 void os_thread_detach(os_thread_t handle);
 
+/**
+ * Get the CPU the calling thread is running on. The thread may run on
+ * another CPU as soon as the function returns: this is only a hint, e.g.
+ * to spread per-CPU data.
+ *
+ * @return the index of the CPU, 0 if it cannot be known
+ *
+ * @os_replace{Linux, sched_getcpu}
+ * @os_replace{Windows, GetCurrentProcessorNumber}
+ */
+unsigned int os_thread_current_cpu(void);
+
 #endif
 
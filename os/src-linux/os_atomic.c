@@ -13,13 +13,22 @@ int os_atomic_cmpxchg(os_atomic_t *ptr, int old_value, int new_value)
 {
     int32_t prev, old = old_value, new = new_value;
     volatile int32_t *memory = &(ptr->val);
-    __asm__ volatile("cmpxchgl %1,%2"
-                     : "=a"(prev)
-                     : "r"(new), "m"(*memory), "0"(old)
+    __asm__ volatile("lock cmpxchgl %2,%1"
+                     : "=a"(prev), "+m"(*memory)
+                     : "r"(new), "0"(old)
                      : "memory");
    return prev;
 }
 
+int os_atomic_xchg(os_atomic_t *atomic, int value)
+{
+    int32_t prev = value;
+    __asm__ __volatile__(
+        "lock xchg %0,%1\n"
+        : "+r" (prev), "+m" (atomic->val) : : "memory");
+    return prev;
+}
+
 void os_atomic_set(os_atomic_t *atomic, int value)
 {
     __asm__ __volatile__(
@@ -61,3 +70,25 @@ void os_atomic_inc(os_atomic_t *atomic)
         :"m" (atomic->val) : "memory");
 }
 
+
+uint64_t os_atomic_cmpxchg64(volatile uint64_t *ptr, uint64_t old_value,
+                             uint64_t new_value)
+{
+    return __sync_val_compare_and_swap(ptr, old_value, new_value);
+}
+
+void os_atomic_add64(volatile uint64_t *ptr, uint64_t value)
+{
+    __sync_fetch_and_add(ptr, value);
+}
+
+void *os_atomic_ptr_xchg(void * volatile *ptr, void *value)
+{
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+void *os_atomic_ptr_cmpxchg(void * volatile *ptr, void *old_value,
+                            void *new_value)
+{
+    return __sync_val_compare_and_swap(ptr, old_value, new_value);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "os/include/os_eventfd.h"
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+int os_eventfd_create(void)
+{
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    return fd < 0 ? -errno : fd;
+}
+
+void os_eventfd_close(int fd)
+{
+    close(fd);
+}
+
+void os_eventfd_signal(int fd)
+{
+    /* Can only fail if the counter overflows, which means it is already
+     * signalled anyway */
+    eventfd_write(fd, 1);
+}
+
+uint64_t os_eventfd_reset(int fd)
+{
+    eventfd_t value;
+
+    /* Non blocking: fails with EAGAIN if the counter is 0 */
+    if (eventfd_read(fd, &value) != 0)
+        return 0;
+
+    return value;
+}
+
+int os_eventfd_wait(int fd, int timeout_ms)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0)
+        return -errno;
+
+    return ret > 0 ? 1 : 0;
+}
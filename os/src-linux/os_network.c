@@ -19,6 +19,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <linux/errqueue.h>
 
 int os_net_init(void)
 {
@@ -150,6 +151,65 @@ int os_send(int socket, const void *buffer, int length)
     return retval;
 }
 
+int os_sendv(int socket, const os_iovec_t *iov, int iovcnt, int flags)
+{
+    struct msghdr msg;
+    int retval;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    retval = sendmsg(socket, &msg, flags & OS_SEND_ZEROCOPY ? MSG_ZEROCOPY : 0);
+    if (retval == -1)
+	retval = -errno;
+
+    return retval;
+}
+
+int os_sock_set_zerocopy(int socket)
+{
+    int one = 1;
+
+    if (setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1)
+        return -errno;
+
+    return 0;
+}
+
+int os_sock_zerocopy_completed(int socket, uint32_t *low, uint32_t *high)
+{
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    struct sock_extended_err *serr;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+              || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            continue;
+
+        serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+        if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            continue;
+
+        *low = serr->ee_info;
+        *high = serr->ee_data;
+        return 1;
+    }
+
+    /* Something that is not a zero-copy completion was dequeued */
+    return -EIO;
+}
+
 int os_recv(int socket, void *buffer, int length, int flags)
 {
     int retval;
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "os/include/os_poll.h"
+#include "os/include/os_assert.h"
+#include "os/include/os_error.h"
+#include "os/include/os_mem.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Key used internally for the wakeup eventfd; user keys are >= 0 */
+#define OS_POLL_WAKEUP_KEY  -1
+
+/* Max number of events fetched from the kernel at once */
+#define OS_POLL_MAX_EVENTS  64
+
+struct os_poll
+{
+    int epfd;
+    int wakeup_fd;
+};
+
+static uint32_t events_to_epoll(int events)
+{
+    uint32_t ev = 0;
+
+    if (events & OS_POLL_IN)
+        ev |= EPOLLIN;
+    if (events & OS_POLL_OUT)
+        ev |= EPOLLOUT;
+
+    return ev;
+}
+
+static int events_from_epoll(uint32_t ev)
+{
+    int events = 0;
+
+    if (ev & EPOLLIN)
+        events |= OS_POLL_IN;
+    if (ev & EPOLLOUT)
+        events |= OS_POLL_OUT;
+    if (ev & (EPOLLERR | EPOLLHUP))
+        events |= OS_POLL_ERR;
+
+    return events;
+}
+
+static int __poll_ctl(os_poll_t *poll, int op, int fd, int events, int key)
+{
+    struct epoll_event ev;
+
+    ev.events = events_to_epoll(events);
+    ev.data.u64 = 0;
+    ev.data.fd = key;
+
+    return epoll_ctl(poll->epfd, op, fd, &ev) == 0 ? 0 : -errno;
+}
+
+os_poll_t *os_poll_create(void)
+{
+    os_poll_t *poll = os_malloc(sizeof(os_poll_t));
+
+    if (poll == NULL)
+        return NULL;
+
+    poll->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (poll->epfd < 0)
+    {
+        os_free(poll);
+        return NULL;
+    }
+
+    poll->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (poll->wakeup_fd < 0)
+    {
+        close(poll->epfd);
+        os_free(poll);
+        return NULL;
+    }
+
+    if (__poll_ctl(poll, EPOLL_CTL_ADD, poll->wakeup_fd, OS_POLL_IN,
+                   OS_POLL_WAKEUP_KEY) != 0)
+    {
+        close(poll->wakeup_fd);
+        close(poll->epfd);
+        os_free(poll);
+        return NULL;
+    }
+
+    return poll;
+}
+
+void os_poll_delete(os_poll_t *poll)
+{
+    if (poll == NULL)
+        return;
+
+    close(poll->wakeup_fd);
+    close(poll->epfd);
+    os_free(poll);
+}
+
+int os_poll_add(os_poll_t *poll, int fd, int events, int key)
+{
+    OS_ASSERT(key >= 0);
+    return __poll_ctl(poll, EPOLL_CTL_ADD, fd, events, key);
+}
+
+int os_poll_modify(os_poll_t *poll, int fd, int events, int key)
+{
+    OS_ASSERT(key >= 0);
+    return __poll_ctl(poll, EPOLL_CTL_MOD, fd, events, key);
+}
+
+int os_poll_remove(os_poll_t *poll, int fd)
+{
+    /* A non-NULL event is needed by kernels older than 2.6.9 */
+    struct epoll_event ev;
+
+    return epoll_ctl(poll->epfd, EPOLL_CTL_DEL, fd, &ev) == 0 ? 0 : -errno;
+}
+
+int os_poll_wait(os_poll_t *poll, os_poll_event_t *events, int max_events,
+                 int timeout_ms)
+{
+    struct epoll_event ev[OS_POLL_MAX_EVENTS];
+    int n, i, count = 0;
+
+    OS_ASSERT(max_events > 0);
+
+    if (max_events > OS_POLL_MAX_EVENTS)
+        max_events = OS_POLL_MAX_EVENTS;
+
+    n = epoll_wait(poll->epfd, ev, max_events, timeout_ms);
+    if (n < 0)
+        return -errno;
+
+    for (i = 0; i < n; i++)
+    {
+        if (ev[i].data.fd == OS_POLL_WAKEUP_KEY)
+        {
+            eventfd_t value;
+            /* Drain the counter; a concurrent wakeup will rearm it */
+            eventfd_read(poll->wakeup_fd, &value);
+            continue;
+        }
+
+        events[count].events = events_from_epoll(ev[i].events);
+        events[count].key = ev[i].data.fd;
+        count++;
+    }
+
+    return count;
+}
+
+void os_poll_wakeup(os_poll_t *poll)
+{
+    eventfd_write(poll->wakeup_fd, 1);
+}
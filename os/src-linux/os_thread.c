@@ -9,6 +9,7 @@
 #include "os/include/os_compiler.h"
 #include "os/include/os_mem.h"
 #include "os/include/os_thread.h"
+#include <sched.h>
 #include <stdlib.h>
 
 typedef struct {
@@ -121,3 +122,10 @@ void os_thread_detach(os_thread_t handle)
     pthread_detach(handle);
 }
 
+unsigned int os_thread_current_cpu(void)
+{
+    int cpu = sched_getcpu();
+
+    return cpu < 0 ? 0 : (unsigned int)cpu;
+}
+
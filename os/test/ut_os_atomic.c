@@ -65,3 +65,56 @@ ut_test(cmpxchg)
 	UT_ASSERT(os_atomic_read(&var) == i + 2);
     }
 }
+
+ut_test(xchg)
+{
+    os_atomic_t var;
+
+    os_atomic_set(&var, -5);
+    UT_ASSERT(os_atomic_xchg(&var, 12) == -5);
+    UT_ASSERT(os_atomic_read(&var) == 12);
+}
+
+ut_test(cmpxchg64)
+{
+    volatile uint64_t var = 0x100000000ULL;
+
+    UT_ASSERT(os_atomic_cmpxchg64(&var, 0, 1) == 0x100000000ULL);
+    UT_ASSERT(var == 0x100000000ULL);
+
+    UT_ASSERT(os_atomic_cmpxchg64(&var, 0x100000000ULL, 0x200000001ULL)
+              == 0x100000000ULL);
+    UT_ASSERT(var == 0x200000001ULL);
+}
+
+ut_test(add64)
+{
+    volatile uint64_t var = 0xFFFFFFFFULL;
+
+    os_atomic_add64(&var, 1);
+    UT_ASSERT(var == 0x100000000ULL);
+}
+
+ut_test(ptr_xchg)
+{
+    int a, b;
+    void * volatile ptr = &a;
+
+    UT_ASSERT(os_atomic_ptr_xchg(&ptr, &b) == &a);
+    UT_ASSERT(ptr == &b);
+
+    UT_ASSERT(os_atomic_ptr_xchg(&ptr, NULL) == &b);
+    UT_ASSERT(ptr == NULL);
+}
+
+ut_test(ptr_cmpxchg)
+{
+    int a, b;
+    void * volatile ptr = &a;
+
+    UT_ASSERT(os_atomic_ptr_cmpxchg(&ptr, &b, NULL) == &a);
+    UT_ASSERT(ptr == &a);
+
+    UT_ASSERT(os_atomic_ptr_cmpxchg(&ptr, &a, &b) == &a);
+    UT_ASSERT(ptr == &b);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "os/include/os_eventfd.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+UT_SECTION(os_eventfd)
+
+ut_test(create_and_close)
+{
+    int fd = os_eventfd_create();
+
+    UT_ASSERT(fd >= 0);
+    os_eventfd_close(fd);
+}
+
+ut_test(wait_times_out_when_not_signalled)
+{
+    int fd = os_eventfd_create();
+
+    UT_ASSERT_EQUAL(0, os_eventfd_wait(fd, 10));
+    UT_ASSERT_EQUAL(0, os_eventfd_reset(fd));
+
+    os_eventfd_close(fd);
+}
+
+ut_test(signals_are_counted_until_reset)
+{
+    int fd = os_eventfd_create();
+
+    os_eventfd_signal(fd);
+    os_eventfd_signal(fd);
+    os_eventfd_signal(fd);
+
+    /* Waiting does not reset */
+    UT_ASSERT_EQUAL(1, os_eventfd_wait(fd, 1000));
+    UT_ASSERT_EQUAL(1, os_eventfd_wait(fd, 1000));
+
+    UT_ASSERT_EQUAL(3, os_eventfd_reset(fd));
+    UT_ASSERT_EQUAL(0, os_eventfd_wait(fd, 10));
+
+    os_eventfd_close(fd);
+}
+
+static void signal_thread(void *arg)
+{
+    int fd = *(int *)arg;
+
+    os_millisleep(50);
+    os_eventfd_signal(fd);
+}
+
+ut_test(signal_from_another_thread)
+{
+    int fd = os_eventfd_create();
+    os_thread_t thread;
+
+    UT_ASSERT(os_thread_create(&thread, 0, signal_thread, &fd));
+
+    UT_ASSERT_EQUAL(1, os_eventfd_wait(fd, 10000));
+    os_thread_join(thread);
+
+    UT_ASSERT_EQUAL(1, os_eventfd_reset(fd));
+
+    os_eventfd_close(fd);
+}
@@ -424,6 +424,77 @@ ut_test(send_receive)
     }
 }
 
+ut_test(sendv_receive)
+{
+    char header[] = "header:";
+    char payload[] = "payload";
+    char receive_buffer[BUFFER_SIZE];
+    os_iovec_t iov[2];
+    int total = sizeof(header) - 1 + sizeof(payload);
+    int size;
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header) - 1;
+    iov[1].iov_base = payload;
+    iov[1].iov_len = sizeof(payload);
+
+    UT_ASSERT_EQUAL(total, os_sendv(client_sock, iov, 2, 0));
+
+    size = 0;
+    while (size != total)
+    {
+        int ret = os_recv(accept_sock, receive_buffer + size, total - size, 0);
+        UT_ASSERT(ret > 0);
+        size += ret;
+    }
+
+    UT_ASSERT_EQUAL_STR("header:payload", receive_buffer);
+}
+
+ut_test(sendv_zerocopy_is_completed)
+{
+    static char payload[65536];
+    char receive_buffer[4096];
+    os_iovec_t iov;
+    uint32_t low = 42, high = 42;
+    int size, ret, retries;
+
+    ret = os_sock_set_zerocopy(client_sock);
+    if (ret == -ENOPROTOOPT || ret == -EOPNOTSUPP)
+    {
+        ut_printf("zero-copy not supported by this kernel");
+        return;
+    }
+    UT_ASSERT_EQUAL(0, ret);
+
+    /* No completion before anything is sent */
+    UT_ASSERT_EQUAL(0, os_sock_zerocopy_completed(client_sock, &low, &high));
+
+    iov.iov_base = payload;
+    iov.iov_len = sizeof(payload);
+    UT_ASSERT(os_sendv(client_sock, &iov, 1, OS_SEND_ZEROCOPY) > 0);
+
+    size = 0;
+    while (size < sizeof(payload))
+    {
+        ret = os_recv(accept_sock, receive_buffer, sizeof(receive_buffer), 0);
+        UT_ASSERT(ret > 0);
+        size += ret;
+    }
+
+    for (retries = 0; retries < 100; retries++)
+    {
+        ret = os_sock_zerocopy_completed(client_sock, &low, &high);
+        if (ret != 0)
+            break;
+        os_millisleep(10);
+    }
+
+    UT_ASSERT_EQUAL(1, ret);
+    UT_ASSERT_EQUAL(0, low);
+    UT_ASSERT_EQUAL(0, high);
+}
+
 ut_test(sendto_recvfrom)
 {
     char send_buffer[BUFFER_SIZE];
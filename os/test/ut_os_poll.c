@@ -0,0 +1,143 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+#include <unistd.h>
+
+#include "os/include/os_compiler.h"
+#include "os/include/os_error.h"
+#include "os/include/os_poll.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+UT_SECTION(os_poll)
+
+ut_test(create_and_delete)
+{
+    os_poll_t *poll = os_poll_create();
+
+    UT_ASSERT(poll != NULL);
+    os_poll_delete(poll);
+}
+
+ut_test(wait_times_out_when_nothing_is_ready)
+{
+    os_poll_t *poll = os_poll_create();
+    os_poll_event_t ev[4];
+
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+    os_poll_delete(poll);
+}
+
+ut_test(readable_fd_is_reported_with_its_key)
+{
+    os_poll_t *poll = os_poll_create();
+    os_poll_event_t ev[4];
+    int fds[2];
+    char c = 'x';
+
+    UT_ASSERT_EQUAL(0, pipe(fds));
+    UT_ASSERT_EQUAL(0, os_poll_add(poll, fds[0], OS_POLL_IN, 42));
+
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+
+    UT_ASSERT_EQUAL(1, write(fds[1], &c, 1));
+    UT_ASSERT_EQUAL(1, os_poll_wait(poll, ev, 4, 1000));
+    UT_ASSERT_EQUAL(42, ev[0].key);
+    UT_ASSERT(ev[0].events & OS_POLL_IN);
+
+    /* Once removed, the fd is not reported anymore */
+    UT_ASSERT_EQUAL(0, os_poll_remove(poll, fds[0]));
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+
+    close(fds[0]);
+    close(fds[1]);
+    os_poll_delete(poll);
+}
+
+ut_test(modify_toggles_watched_events)
+{
+    os_poll_t *poll = os_poll_create();
+    os_poll_event_t ev[4];
+    int fds[2];
+
+    UT_ASSERT_EQUAL(0, pipe(fds));
+
+    /* A pipe write end is always writable */
+    UT_ASSERT_EQUAL(0, os_poll_add(poll, fds[1], 0, 7));
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+
+    UT_ASSERT_EQUAL(0, os_poll_modify(poll, fds[1], OS_POLL_OUT, 8));
+    UT_ASSERT_EQUAL(1, os_poll_wait(poll, ev, 4, 1000));
+    UT_ASSERT_EQUAL(8, ev[0].key);
+    UT_ASSERT(ev[0].events & OS_POLL_OUT);
+
+    UT_ASSERT_EQUAL(0, os_poll_modify(poll, fds[1], 0, 8));
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+
+    close(fds[0]);
+    close(fds[1]);
+    os_poll_delete(poll);
+}
+
+ut_test(add_twice_fails)
+{
+    os_poll_t *poll = os_poll_create();
+    int fds[2];
+
+    UT_ASSERT_EQUAL(0, pipe(fds));
+    UT_ASSERT_EQUAL(0, os_poll_add(poll, fds[0], OS_POLL_IN, 1));
+    UT_ASSERT_EQUAL(-EEXIST, os_poll_add(poll, fds[0], OS_POLL_IN, 1));
+
+    close(fds[0]);
+    close(fds[1]);
+    os_poll_delete(poll);
+}
+
+ut_test(wakeup_before_wait_is_not_lost)
+{
+    os_poll_t *poll = os_poll_create();
+    os_poll_event_t ev[4];
+
+    os_poll_wakeup(poll);
+    os_poll_wakeup(poll);
+
+    /* Both wakeups are collapsed in a single return */
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 5000));
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10));
+
+    os_poll_delete(poll);
+}
+
+static void wakeup_thread(void *arg)
+{
+    os_poll_t *poll = arg;
+
+    os_millisleep(50);
+    os_poll_wakeup(poll);
+}
+
+ut_test(wakeup_from_another_thread)
+{
+    os_poll_t *poll = os_poll_create();
+    os_poll_event_t ev[4];
+    os_thread_t thread;
+    struct timeval before, after, diff;
+
+    os_gettimeofday(&before);
+    UT_ASSERT(os_thread_create(&thread, 0, wakeup_thread, poll));
+
+    UT_ASSERT_EQUAL(0, os_poll_wait(poll, ev, 4, 10000));
+    os_gettimeofday(&after);
+    os_thread_join(thread);
+
+    diff = os_timeval_diff(&after, &before);
+    UT_ASSERT(diff.tv_sec < 5);
+
+    os_poll_delete(poll);
+}
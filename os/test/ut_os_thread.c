@@ -8,6 +8,9 @@
 
 #include <unit_testing.h>
 #include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 #include "os/include/os_compiler.h"
 #include "os/include/os_thread.h"
@@ -305,4 +308,12 @@ ut_test(thread_rwlock_and_atomic)
     os_thread_rwlock_destroy(&rwlock_test.rwlock);
 }
 
+ut_test(current_cpu_is_an_online_cpu)
+{
+    long nb_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+    UT_ASSERT(nb_cpus > 0);
+    UT_ASSERT(os_thread_current_cpu() < nb_cpus);
+}
+
 #endif /* !WIN32 */
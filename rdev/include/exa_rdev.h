@@ -199,6 +199,39 @@ int exa_rdev_make_request_new(rdev_op_t op, void **nbd_private,
 			      int sector_nb, void *buffer,
 			      exa_rdev_handle_t *handle);
 
+/**
+ * Tell the device the buffers IOs will be done from/to, so that they can
+ * be mapped once and for all instead of at each IO.
+ *
+ * The buffers are contiguous: buffer i starts at area + i * buffer_size.
+ * IOs on other buffers are still possible. Backends that cannot make use
+ * of this ignore the call.
+ *
+ * @param handle       The exa_rdev handle describing the disk
+ * @param area         Start of the buffers
+ * @param buffer_size  Size of each buffer
+ * @param nb_buffers   Number of buffers
+ *
+ * @return 0 if successful (or ignored), a negative error code otherwise
+ */
+int exa_rdev_register_buffers(exa_rdev_handle_t *handle, void *area,
+                              size_t buffer_size, int nb_buffers);
+
+/**
+ * Have an event file descriptor (see os_eventfd.h) signalled each time an
+ * IO submitted on the device completes, so that completions can be waited
+ * on along with other events instead of blocking in exa_rdev_reap().
+ *
+ * Must be called before any IO is submitted.
+ *
+ * @param handle  The exa_rdev handle describing the disk
+ * @param efd     Event file descriptor
+ *
+ * @return 0 if successful, -ENOTSUP if the backend cannot signal
+ *         completions, another negative error code otherwise
+ */
+int exa_rdev_set_completion_eventfd(exa_rdev_handle_t *handle, int efd);
+
 /**
  * Returns the last error on the device associate to the handle.
  * This may return -RDEV_ERR_UNKNOWN if no IO was done recently.
@@ -258,6 +291,64 @@ int exa_rdev_make_request(rdev_op_t op, unsigned long long start , int size,
 int exa_rdev_wait_one_request(void **nbd_private,
 			      exa_rdev_handle_t *handle);
 
+/** Max number of requests given to exa_rdev_submit_batch() at once */
+#define EXA_RDEV_BATCH_MAX 64
+
+/** Request submitted with exa_rdev_submit_batch() */
+typedef struct
+{
+    rdev_op_t op;               /**< Operation to carry on data */
+    unsigned long long sector;  /**< Offset on disk to read/write */
+    int sector_nb;              /**< Number of sectors to read/write */
+    void *buffer;               /**< Source/destination buffer */
+    void *nbd_private;          /**< Info given back upon completion */
+} exa_rdev_request_t;
+
+/** Request completed, as returned by exa_rdev_reap() */
+typedef struct
+{
+    void *nbd_private;  /**< Info the request was submitted with */
+    int status;         /**< RDEV_REQUEST_END_OK or RDEV_REQUEST_END_ERROR */
+} exa_rdev_completion_t;
+
+/**
+ * Submit several requests to a device at once.
+ *
+ * The requests are submitted in order, and may be only partly submitted
+ * when the device cannot take more requests: the caller must then reap
+ * some completions with exa_rdev_reap() and submit the remaining ones.
+ *
+ * @param handle   The exa_rdev handle describing the disk
+ * @param reqs     Requests to submit
+ * @param nb_reqs  Number of requests, at most EXA_RDEV_BATCH_MAX
+ *
+ * @return the number of requests submitted (0 if the device cannot take
+ *         more requests for now), or a negative error code if reqs[0]
+ *         could not be submitted (the following ones were not submitted)
+ */
+int exa_rdev_submit_batch(exa_rdev_handle_t *handle,
+                          const exa_rdev_request_t *reqs, int nb_reqs);
+
+/**
+ * Get the completions of requests submitted with exa_rdev_submit_batch().
+ *
+ * Waits until at least min_nr requests are completed or the timeout
+ * expires, and returns at most max_nr completions. Does not wait when
+ * no request is in progress.
+ *
+ * @param[in]  handle       The exa_rdev handle describing the disk
+ * @param[out] completions  Completed requests
+ * @param[in]  min_nr       Number of completions to wait for
+ * @param[in]  max_nr       Size of completions
+ * @param[in]  timeout_ms   Timeout in milliseconds, -1 means infinite
+ *                          (backends that cannot time out wait forever
+ *                          unless it is 0)
+ *
+ * @return the number of completions returned, or a negative error code
+ */
+int exa_rdev_reap(exa_rdev_handle_t *handle, exa_rdev_completion_t *completions,
+                  int min_nr, int max_nr, int timeout_ms);
+
 /**
  * Test if a disk is still usable or not
  *
@@ -0,0 +1,702 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/* Implementation of the rdev API with io_uring.
+ *
+ * The device file is registered with the ring, and so are the buffers given
+ * to exa_rdev_register_buffers(): IOs on these buffers do not need the
+ * pages to be mapped each time.
+ *
+ * The ring may be set up with a kernel thread polling the submission queue
+ * (RDEV_IO_URING_SQPOLL), in which case no system call is needed to submit
+ * IOs, and with polled completions (RDEV_IO_URING_IOPOLL), which need the
+ * device to have polled queues.
+ *
+ * A barrier write is a FUA write (RWF_DSYNC) linked after a cache flush, so
+ * that both the writes completed before and the barrier itself are on disk
+ * once it completes, without waiting for the other IOs in progress.
+ */
+
+#include "rdev/include/exa_rdev.h"
+#include "rdev/src/rdev_perf.h"
+
+#include "common/include/exa_assert.h"
+#include "common/include/exa_error.h"
+#include "os/include/os_mem.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#define RDEV_IO_URING_ENTRIES 128
+
+/* Index of the device in the registered files */
+#define RDEV_IO_URING_FILE_INDEX 0
+
+struct exa_rdev_handle
+{
+    int fd;          /* file descriptor opened on the device */
+    int ring_fd;
+    unsigned features;
+    bool fixed_file; /* whether the device is a registered file */
+
+    /* submission queue */
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_flags;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* completion queue */
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    unsigned cq_entries;
+    struct io_uring_cqe *cqes;
+
+    unsigned nb_cqe_expected; /* completions to come, cache flushes included */
+    size_t io_count;          /* number of outstanding IOs */
+
+    /* registered buffers */
+    char *buf_area;
+    size_t buf_size;
+    int nb_bufs;
+#ifdef WITH_PERF
+    rdev_perfs_t rdev_perfs;
+#endif
+};
+
+/* Tag of the cache flushes preceding barrier writes, that are not reported
+ * to the caller. */
+static char flush_tag;
+#define RDEV_FLUSH_USER_DATA ((__u64)(uintptr_t)&flush_tag)
+
+static rdev_static_op_t init_op = RDEV_STATIC_OP_INVALID;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    int ret = syscall(__NR_io_uring_setup, entries, p);
+    return ret < 0 ? -errno : ret;
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags,
+                              void *arg, size_t argsz)
+{
+    int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      flags, arg, argsz);
+    return ret < 0 ? -errno : ret;
+}
+
+static int sys_io_uring_register(int ring_fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    int ret = syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+    return ret < 0 ? -errno : ret;
+}
+
+int exa_rdev_static_init(rdev_static_op_t op)
+{
+    EXA_ASSERT_VERBOSE(init_op == RDEV_STATIC_OP_INVALID, "static data already initialized");
+
+    EXA_ASSERT_VERBOSE(op == RDEV_STATIC_CREATE || op == RDEV_STATIC_GET,
+                       "invalid static init op: %d", op);
+
+    init_op = op;
+
+    return 0;
+}
+
+void exa_rdev_static_clean(rdev_static_op_t op)
+{
+    /* Initialization not performed, nothing to clean */
+    if (init_op == RDEV_STATIC_OP_INVALID)
+        return;
+
+    EXA_ASSERT_VERBOSE(op == RDEV_STATIC_RELEASE || op == RDEV_STATIC_DELETE,
+               "invalid static clean op: %d", op);
+
+    if (op == RDEV_STATIC_DELETE)
+    {
+        EXA_ASSERT_VERBOSE(init_op == RDEV_STATIC_CREATE,
+                           "deletion of static data by non-owner");
+    }
+    else /* RDEV_STATIC_RELEASE */
+    {
+        EXA_ASSERT_VERBOSE(init_op == RDEV_STATIC_GET,
+                           "release of static data by owner");
+    }
+
+    init_op = RDEV_STATIC_OP_INVALID;
+}
+
+static void ring_unmap(exa_rdev_handle_t *handle)
+{
+    if (handle->sqes != NULL)
+        munmap(handle->sqes, handle->sqes_size);
+    if (handle->cq_ring != NULL)
+        munmap(handle->cq_ring, handle->cq_ring_size);
+    if (handle->sq_ring != NULL)
+        munmap(handle->sq_ring, handle->sq_ring_size);
+}
+
+static void *ring_mmap(int ring_fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static int ring_setup(exa_rdev_handle_t *handle)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+    int ring_fd;
+
+    memset(&p, 0, sizeof(p));
+#ifdef RDEV_IO_URING_IOPOLL
+    p.flags |= IORING_SETUP_IOPOLL;
+#endif
+#ifdef RDEV_IO_URING_SQPOLL
+    p.flags |= IORING_SETUP_SQPOLL;
+    p.sq_thread_idle = 1000; /* ms */
+#endif
+
+    ring_fd = sys_io_uring_setup(RDEV_IO_URING_ENTRIES, &p);
+#ifdef RDEV_IO_URING_SQPOLL
+    /* Polling threads need privileges on kernels older than 5.11 */
+    if (ring_fd == -EPERM)
+    {
+        p.flags &= ~IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = 0;
+        ring_fd = sys_io_uring_setup(RDEV_IO_URING_ENTRIES, &p);
+    }
+#endif
+    if (ring_fd < 0)
+        return ring_fd;
+
+    handle->ring_fd = ring_fd;
+    handle->features = p.features;
+
+    handle->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    handle->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    handle->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    handle->sq_ring = ring_mmap(ring_fd, handle->sq_ring_size, IORING_OFF_SQ_RING);
+    handle->cq_ring = ring_mmap(ring_fd, handle->cq_ring_size, IORING_OFF_CQ_RING);
+    handle->sqes = ring_mmap(ring_fd, handle->sqes_size, IORING_OFF_SQES);
+
+    if (handle->sq_ring == NULL || handle->cq_ring == NULL || handle->sqes == NULL)
+    {
+        ring_unmap(handle);
+        close(ring_fd);
+        return -ENOMEM;
+    }
+
+    sq = handle->sq_ring;
+    handle->sq_head    = (unsigned *)(sq + p.sq_off.head);
+    handle->sq_tail    = (unsigned *)(sq + p.sq_off.tail);
+    handle->sq_mask    = (unsigned *)(sq + p.sq_off.ring_mask);
+    handle->sq_flags   = (unsigned *)(sq + p.sq_off.flags);
+    handle->sq_array   = (unsigned *)(sq + p.sq_off.array);
+    handle->sq_entries = p.sq_entries;
+
+    cq = handle->cq_ring;
+    handle->cq_head    = (unsigned *)(cq + p.cq_off.head);
+    handle->cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    handle->cq_mask    = (unsigned *)(cq + p.cq_off.ring_mask);
+    handle->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    handle->cq_entries = p.cq_entries;
+
+    return 0;
+}
+
+exa_rdev_handle_t *exa_rdev_handle_alloc(const char *path)
+{
+    exa_rdev_handle_t *handle;
+    int fd;
+
+    handle = os_malloc(sizeof(exa_rdev_handle_t));
+    if (handle == NULL)
+	return NULL;
+
+    memset(handle, 0, sizeof(exa_rdev_handle_t));
+
+    handle->fd = open(path, O_RDWR | O_DIRECT);
+    if (handle->fd < 0) {
+	os_free(handle);
+        return NULL;
+    }
+
+    if (ring_setup(handle) != 0) {
+        close(handle->fd);
+	os_free(handle);
+	return NULL;
+    }
+
+    /* Not being able to register the device is not fatal, IOs are just
+     * a bit more expensive. */
+    fd = handle->fd;
+    handle->fixed_file = sys_io_uring_register(handle->ring_fd,
+                                               IORING_REGISTER_FILES, &fd, 1) == 0;
+
+    rdev_perf_init(&handle->rdev_perfs, path);
+
+    return handle;
+}
+
+void __exa_rdev_handle_free(exa_rdev_handle_t *handle)
+{
+    if (handle == NULL)
+        return;
+
+    /* Closing the ring unregisters the files and buffers */
+    ring_unmap(handle);
+    close(handle->ring_fd);
+    close(handle->fd);
+
+    os_free(handle);
+}
+
+int exa_rdev_register_buffers(exa_rdev_handle_t *handle, void *area,
+                              size_t buffer_size, int nb_buffers)
+{
+    struct iovec *iov;
+    int i, err;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(handle->nb_bufs == 0);
+
+    iov = os_malloc(nb_buffers * sizeof(struct iovec));
+    if (iov == NULL)
+        return -RDEV_ERR_NOT_ENOUGH_MEMORY;
+
+    for (i = 0; i < nb_buffers; i++)
+    {
+        iov[i].iov_base = (char *)area + i * buffer_size;
+        iov[i].iov_len = buffer_size;
+    }
+
+    /* The buffers are pinned, which is limited by RLIMIT_MEMLOCK */
+    err = sys_io_uring_register(handle->ring_fd, IORING_REGISTER_BUFFERS,
+                                iov, nb_buffers);
+    os_free(iov);
+
+    if (err != 0)
+        return err;
+
+    handle->buf_area = area;
+    handle->buf_size = buffer_size;
+    handle->nb_bufs = nb_buffers;
+
+    return 0;
+}
+
+int exa_rdev_set_completion_eventfd(exa_rdev_handle_t *handle, int efd)
+{
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(handle->io_count == 0);
+
+    return sys_io_uring_register(handle->ring_fd, IORING_REGISTER_EVENTFD,
+                                 &efd, 1);
+}
+
+/* Index of the registered buffer an IO can be done with, or -1 */
+static int registered_buffer_index(const exa_rdev_handle_t *handle,
+                                   const char *buffer, size_t size)
+{
+    size_t offset;
+
+    if (handle->nb_bufs == 0 || buffer < handle->buf_area)
+        return -1;
+
+    offset = buffer - handle->buf_area;
+    if (offset >= handle->buf_size * handle->nb_bufs
+        || offset % handle->buf_size + size > handle->buf_size)
+        return -1;
+
+    return offset / handle->buf_size;
+}
+
+static struct io_uring_sqe *sqe_prep(exa_rdev_handle_t *handle,
+                                     unsigned tail, __u8 opcode)
+{
+    unsigned idx = tail & *handle->sq_mask;
+    struct io_uring_sqe *sqe = &handle->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    if (handle->fixed_file)
+    {
+        sqe->fd = RDEV_IO_URING_FILE_INDEX;
+        sqe->flags = IOSQE_FIXED_FILE;
+    }
+    else
+        sqe->fd = handle->fd;
+
+    handle->sq_array[idx] = idx;
+
+    return sqe;
+}
+
+/* Number of submission entries needed by a request */
+static unsigned request_sqe_count(const exa_rdev_request_t *req)
+{
+#ifndef RDEV_IO_URING_IOPOLL
+    if (req->op == RDEV_OP_WRITE_BARRIER)
+        return 2;
+#endif
+    return 1;
+}
+
+/* Fill the submission entries of a request, return the new tail */
+static unsigned request_prep(exa_rdev_handle_t *handle, unsigned tail,
+                             const exa_rdev_request_t *req)
+{
+    size_t size = (size_t)req->sector_nb * SECTOR_SIZE;
+    int buf_index = registered_buffer_index(handle, req->buffer, size);
+    struct io_uring_sqe *sqe;
+    __u8 opcode = 0;
+
+    EXA_ASSERT(RDEV_OP_VALID(req->op));
+
+    if (req->op == RDEV_OP_READ)
+        opcode = buf_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    else
+        opcode = buf_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+
+#ifndef RDEV_IO_URING_IOPOLL
+    if (req->op == RDEV_OP_WRITE_BARRIER)
+    {
+        /* Flush the cache before writing, for the writes completed so far
+         * to be on disk. The write is only started once the flush is done,
+         * and fails if the flush fails. */
+        sqe = sqe_prep(handle, tail++, IORING_OP_FSYNC);
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe->user_data = RDEV_FLUSH_USER_DATA;
+    }
+#endif
+
+    sqe = sqe_prep(handle, tail++, opcode);
+    sqe->addr = (__u64)(uintptr_t)req->buffer;
+    sqe->len = size;
+    sqe->off = req->sector * SECTOR_SIZE;
+    sqe->user_data = (__u64)(uintptr_t)req->nbd_private;
+    if (buf_index >= 0)
+        sqe->buf_index = buf_index;
+
+    /* FUA */
+    if (req->op == RDEV_OP_WRITE_BARRIER)
+        sqe->rw_flags = RWF_DSYNC;
+
+    return tail;
+}
+
+/* Make the entries from first_tail to tail available to the kernel, and
+ * return the number of entries it took or a negative error code. The
+ * entries not taken are taken back. */
+static int sq_submit(exa_rdev_handle_t *handle, unsigned first_tail,
+                     unsigned tail)
+{
+    int ret;
+
+    __atomic_store_n(handle->sq_tail, tail, __ATOMIC_RELEASE);
+
+#ifdef RDEV_IO_URING_SQPOLL
+    /* The polling thread takes the entries without any system call, unless
+     * it went to sleep because it was idle. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(handle->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+        sys_io_uring_enter(handle->ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP,
+                           NULL, 0);
+    ret = tail - first_tail;
+#else
+    do {
+        ret = sys_io_uring_enter(handle->ring_fd, tail - first_tail, 0, 0,
+                                 NULL, 0);
+    } while (ret == -EINTR);
+
+    if (ret < 0)
+        __atomic_store_n(handle->sq_tail, first_tail, __ATOMIC_RELEASE);
+    else if ((unsigned)ret < tail - first_tail)
+        __atomic_store_n(handle->sq_tail, first_tail + ret, __ATOMIC_RELEASE);
+#endif
+
+    return ret;
+}
+
+int exa_rdev_submit_batch(exa_rdev_handle_t *handle,
+                          const exa_rdev_request_t *reqs, int nb_reqs)
+{
+    unsigned head, tail, first_tail;
+    unsigned nb_cqe = 0;
+    int i, ret;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(nb_reqs > 0 && nb_reqs <= EXA_RDEV_BATCH_MAX);
+
+    head = __atomic_load_n(handle->sq_head, __ATOMIC_ACQUIRE);
+    first_tail = tail = *handle->sq_tail;
+
+    for (i = 0; i < nb_reqs; i++)
+    {
+        unsigned count = request_sqe_count(&reqs[i]);
+
+        /* Never expect more completions than the completion queue can
+         * hold, they would be lost on old kernels. */
+        if (tail + count - head > handle->sq_entries
+            || handle->nb_cqe_expected + nb_cqe + count > handle->cq_entries)
+            break;
+
+#ifdef RDEV_IO_URING_IOPOLL
+        /* Flushes cannot be polled for, so the flush preceding a barrier
+         * write is done synchronously. */
+        if (reqs[i].op == RDEV_OP_WRITE_BARRIER && fdatasync(handle->fd) != 0)
+        {
+            if (i == 0)
+                return -errno;
+            break;
+        }
+#endif
+
+        tail = request_prep(handle, tail, &reqs[i]);
+        nb_cqe += count;
+    }
+
+    if (i == 0)
+        return 0;
+
+    ret = sq_submit(handle, first_tail, tail);
+    if (ret < 0)
+        return ret;
+
+    if ((unsigned)ret < tail - first_tail)
+    {
+        /* Only the first entries were taken, find the requests they are
+         * made of */
+        unsigned taken = 0;
+        int nb;
+
+        for (nb = 0; nb < i; nb++)
+        {
+            unsigned count = request_sqe_count(&reqs[nb]);
+
+            if (taken + count > (unsigned)ret)
+                break;
+
+            taken += count;
+        }
+
+        /* The flush of a barrier may have been taken without its write,
+         * each entry taken has a completion anyway */
+        nb_cqe = ret;
+        i = nb;
+    }
+
+    handle->nb_cqe_expected += nb_cqe;
+    handle->io_count += i;
+
+    return i;
+}
+
+/* Get the completions available in the completion queue */
+static int cq_drain(exa_rdev_handle_t *handle, exa_rdev_completion_t *completions,
+                    int max_nr)
+{
+    unsigned head = *handle->cq_head;
+    unsigned tail = __atomic_load_n(handle->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+
+    while (head != tail && n < max_nr)
+    {
+        const struct io_uring_cqe *cqe = &handle->cqes[head & *handle->cq_mask];
+
+        head++;
+        handle->nb_cqe_expected--;
+
+        /* The failure of a flush makes the linked write fail */
+        if (cqe->user_data == RDEV_FLUSH_USER_DATA)
+            continue;
+
+        completions[n].nbd_private = (void *)(uintptr_t)cqe->user_data;
+        completions[n].status = cqe->res < 0 ? RDEV_REQUEST_END_ERROR
+                                             : RDEV_REQUEST_END_OK;
+        n++;
+    }
+
+    __atomic_store_n(handle->cq_head, head, __ATOMIC_RELEASE);
+
+    handle->io_count -= n;
+
+    return n;
+}
+
+/* Wait for completions, return -ETIME if the timeout expired */
+static int cq_wait(exa_rdev_handle_t *handle, unsigned min_complete,
+                   int timeout_ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+
+    /* Kernels without EXT_ARG (older than 5.11) cannot time out */
+    if (timeout_ms < 0 || !(handle->features & IORING_FEAT_EXT_ARG))
+        return sys_io_uring_enter(handle->ring_fd, 0, min_complete,
+                                  IORING_ENTER_GETEVENTS, NULL, 0);
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = (__u64)(uintptr_t)&ts;
+
+    return sys_io_uring_enter(handle->ring_fd, 0, min_complete,
+                              IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                              &arg, sizeof(arg));
+}
+
+int exa_rdev_reap(exa_rdev_handle_t *handle, exa_rdev_completion_t *completions,
+                  int min_nr, int max_nr, int timeout_ms)
+{
+    int n = 0;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    if (handle->io_count == 0)
+        return 0;
+
+    if (min_nr > (int)handle->io_count)
+        min_nr = handle->io_count;
+    if (min_nr > max_nr)
+        min_nr = max_nr;
+
+#ifdef RDEV_IO_URING_IOPOLL
+    /* Polled completions only show up when asked for */
+    sys_io_uring_enter(handle->ring_fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+#endif
+
+    n = cq_drain(handle, completions, max_nr);
+
+    while (n < min_nr && timeout_ms != 0)
+    {
+        /* The completions of flushes are waited for too, but they are
+         * always followed by the completion of their write. */
+        int ret = cq_wait(handle, min_nr - n, timeout_ms);
+
+        if (ret == -ETIME)
+            timeout_ms = 0;
+        else if (ret < 0 && ret != -EINTR)
+            return n > 0 ? n : ret;
+
+        n += cq_drain(handle, completions + n, max_nr - n);
+    }
+
+    return n;
+}
+
+int exa_rdev_flush(exa_rdev_handle_t *handle)
+{
+  if (handle == NULL)
+    return -1;
+
+  while (exa_rdev_wait_one_request(NULL, handle) != RDEV_REQUEST_ALL_ENDED)
+	  ;
+
+  return fdatasync(handle->fd) == 0 ? 0 : -errno;
+}
+
+int exa_rdev_make_request_new(rdev_op_t op, void **nbd_private,
+			      unsigned long long sector, int sector_nb,
+			      void *buffer, exa_rdev_handle_t *handle)
+{
+  exa_rdev_request_t req;
+  int ret;
+
+  if (handle == NULL)
+      return -1;
+
+  req.op = op;
+  req.sector = sector;
+  req.sector_nb = sector_nb;
+  req.buffer = buffer;
+  req.nbd_private = *nbd_private;
+
+  ret = exa_rdev_submit_batch(handle, &req, 1);
+  switch (ret) {
+  case 1: /* expected behaviour */
+      return RDEV_REQUEST_NONE_ENDED;
+
+  case 0:
+      return RDEV_REQUEST_NOT_ENOUGH_FREE_REQ;
+
+  default:
+      return RDEV_REQUEST_END_ERROR;
+  }
+}
+
+int exa_rdev_wait_one_request(void **nbd_private, exa_rdev_handle_t *handle)
+{
+    exa_rdev_completion_t completion;
+    int ret;
+
+    if (handle == NULL)
+	return -RDEV_ERR_NOT_OPEN;
+
+    if (!handle->io_count)
+        return RDEV_REQUEST_ALL_ENDED;
+
+    ret = exa_rdev_reap(handle, &completion, 1, 1, -1);
+    if (ret != 1) /* an error occured */
+        return RDEV_REQUEST_END_ERROR;
+
+    if (nbd_private != NULL)
+        *nbd_private = completion.nbd_private;
+
+    return completion.status;
+}
+
+int exa_rdev_get_last_error(const exa_rdev_handle_t *handle)
+{
+    return -RDEV_ERR_UNKNOWN;
+}
+
+int exa_rdev_activate(exa_rdev_handle_t *handle)
+{
+    return 0;
+}
+
+int exa_rdev_deactivate(exa_rdev_handle_t *handle, char *path)
+{
+    return 0;
+}
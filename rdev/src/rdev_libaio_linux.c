@@ -24,6 +24,7 @@ struct exa_rdev_handle
     io_context_t ctx;
     int fd; /* file descriptor opened on the device */
     size_t io_count; /* number of outstanding IOs */
+    int event_fd; /* signalled upon IO completion, or -1 */
 #ifdef WITH_PERF
     rdev_perfs_t rdev_perfs;
 #endif
@@ -83,6 +84,7 @@ exa_rdev_handle_t *exa_rdev_handle_alloc(const char *path)
         return NULL;
     }
     handle->io_count = 0;
+    handle->event_fd = -1;
 
     /* Carful, libaio documentation requires ctx to be set to 0 prior calling
      * io_setup(). */
@@ -122,40 +124,58 @@ int exa_rdev_flush(exa_rdev_handle_t *handle)
 }
 
 
-int exa_rdev_make_request_new(rdev_op_t op, void **nbd_private,
-			      unsigned long long sector, int sector_nb,
-			      void *buffer, exa_rdev_handle_t *handle)
+/* Fill an iocb for an IO on the device */
+static void rdev_prep_iocb(struct iocb *cb, const exa_rdev_handle_t *handle,
+                           rdev_op_t op, unsigned long long sector,
+                           int sector_nb, void *buffer, void *nbd_private)
 {
-  struct iocb cb;
-  struct iocb *cbs[1];
-  int err;
-
-  if (handle == NULL)
-      return -1;
-
-  memset(&cb, 0, sizeof(cb));
-  cb.aio_fildes = handle->fd;
+  memset(cb, 0, sizeof(*cb));
+  cb->aio_fildes = handle->fd;
 
   switch (op) {
   case RDEV_OP_READ:
-       cb.aio_lio_opcode = IO_CMD_PREAD;
+       cb->aio_lio_opcode = IO_CMD_PREAD;
        break;
   case RDEV_OP_WRITE:
   case RDEV_OP_WRITE_BARRIER:
        /* FIXME how to implement FUA (ok here it is barriere, but what should
 	* be here is FUA)? There does not seem to be a FUA interface in libaio */
-       cb.aio_lio_opcode = IO_CMD_PWRITE;
+       cb->aio_lio_opcode = IO_CMD_PWRITE;
        break;
   case RDEV_OP_INVALID:
        EXA_ASSERT(RDEV_OP_VALID(op));
   }
 
-  cb.data = *nbd_private;
+  cb->data = nbd_private;
 
   /* command-specific options */
-  cb.u.c.buf = buffer;
-  cb.u.c.offset = sector * SECTOR_SIZE;
-  cb.u.c.nbytes = sector_nb * SECTOR_SIZE;
+  cb->u.c.buf = buffer;
+  cb->u.c.offset = sector * SECTOR_SIZE;
+  cb->u.c.nbytes = sector_nb * SECTOR_SIZE;
+
+  if (handle->event_fd >= 0)
+      io_set_eventfd(cb, handle->event_fd);
+}
+
+/* Status of a completed IO: res is the number of bytes transferred or a
+ * negative error code */
+static int rdev_event_status(const struct io_event *event)
+{
+    return (long)event->res < 0 ? RDEV_REQUEST_END_ERROR : RDEV_REQUEST_END_OK;
+}
+
+int exa_rdev_make_request_new(rdev_op_t op, void **nbd_private,
+			      unsigned long long sector, int sector_nb,
+			      void *buffer, exa_rdev_handle_t *handle)
+{
+  struct iocb cb;
+  struct iocb *cbs[1];
+  int err;
+
+  if (handle == NULL)
+      return -1;
+
+  rdev_prep_iocb(&cb, handle, op, sector, sector_nb, buffer, *nbd_private);
 
   cbs[0] = &cb;
 
@@ -199,7 +219,107 @@ int exa_rdev_wait_one_request(void **nbd_private, exa_rdev_handle_t *handle)
     if (nbd_private != NULL)
         *nbd_private = event.data;
 
-    return RDEV_REQUEST_END_OK;
+    return rdev_event_status(&event);
+}
+
+int exa_rdev_submit_batch(exa_rdev_handle_t *handle,
+                          const exa_rdev_request_t *reqs, int nb_reqs)
+{
+    struct iocb cb[EXA_RDEV_BATCH_MAX];
+    struct iocb *cbs[EXA_RDEV_BATCH_MAX];
+    int i, ret;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(nb_reqs > 0 && nb_reqs <= EXA_RDEV_BATCH_MAX);
+
+    for (i = 0; i < nb_reqs; i++)
+    {
+        rdev_prep_iocb(&cb[i], handle, reqs[i].op, reqs[i].sector,
+                       reqs[i].sector_nb, reqs[i].buffer, reqs[i].nbd_private);
+        cbs[i] = &cb[i];
+    }
+
+    /* The iocbs are copied by the kernel, they can live on the stack */
+    do {
+        ret = io_submit(handle->ctx, nb_reqs, cbs);
+    } while (ret == -EINTR);
+
+    /* The queue is full, the caller has to reap some completions */
+    if (ret == -EAGAIN)
+        return 0;
+
+    if (ret > 0)
+        handle->io_count += ret;
+
+    return ret;
+}
+
+int exa_rdev_reap(exa_rdev_handle_t *handle, exa_rdev_completion_t *completions,
+                  int min_nr, int max_nr, int timeout_ms)
+{
+    struct io_event events[RDEV_LIBAIO_MAX_REQUEST];
+    struct timespec timeout, *ptimeout = NULL;
+    int i, ret;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    if (handle->io_count == 0)
+        return 0;
+
+    if (max_nr > RDEV_LIBAIO_MAX_REQUEST)
+        max_nr = RDEV_LIBAIO_MAX_REQUEST;
+    if (min_nr > (int)handle->io_count)
+        min_nr = handle->io_count;
+    if (min_nr > max_nr)
+        min_nr = max_nr;
+
+    if (timeout_ms >= 0)
+    {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        ptimeout = &timeout;
+    }
+
+    /* An interrupted wait is retried with the full timeout, which is good
+     * enough as signals are not used to stop the disk threads. */
+    do {
+        ret = io_getevents(handle->ctx, min_nr, max_nr, events, ptimeout);
+    } while (ret == -EINTR);
+
+    if (ret < 0)
+        return ret;
+
+    handle->io_count -= ret;
+
+    for (i = 0; i < ret; i++)
+    {
+        completions[i].nbd_private = events[i].data;
+        completions[i].status = rdev_event_status(&events[i]);
+    }
+
+    return ret;
+}
+
+int exa_rdev_register_buffers(exa_rdev_handle_t *handle, void *area,
+                              size_t buffer_size, int nb_buffers)
+{
+    /* Buffers are mapped at each IO */
+    return 0;
+}
+
+int exa_rdev_set_completion_eventfd(exa_rdev_handle_t *handle, int efd)
+{
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(handle->io_count == 0);
+
+    handle->event_fd = efd;
+
+    return 0;
 }
 
 int exa_rdev_get_last_error(const exa_rdev_handle_t *handle)
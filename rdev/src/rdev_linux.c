@@ -19,6 +19,7 @@
 #include "common/include/exa_names.h"
 #include "common/include/exa_assert.h"
 #include "common/include/exa_constants.h"
+#include "common/include/exa_math.h"
 
 #include "os/include/os_dir.h"
 #include "os/include/os_error.h"
@@ -38,6 +39,9 @@
 struct exa_rdev_handle
 {
     int fd;
+    /* Requests completed while submitting others, not reaped yet */
+    exa_rdev_completion_t completed[EXA_RDEV_BATCH_MAX];
+    int nb_completed;
 #ifdef WITH_PERF
     rdev_perfs_t rdev_perfs;
 #endif
@@ -157,6 +161,7 @@ exa_rdev_handle_t *exa_rdev_handle_alloc(const char *path)
 	os_free(handle);
 	return NULL;
     }
+    handle->nb_completed = 0;
 
     majmin.major = major(sstat.st_rdev);
     majmin.minor = minor(sstat.st_rdev);
@@ -254,6 +259,102 @@ int exa_rdev_wait_one_request(void **nbd_private,
     return err;
 }
 
+/* The module takes requests one at a time, and the submission of a request
+ * may return a completed one, which is kept until reaped. */
+int exa_rdev_submit_batch(exa_rdev_handle_t *handle,
+                          const exa_rdev_request_t *reqs, int nb_reqs)
+{
+    int i;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    EXA_ASSERT(nb_reqs > 0 && nb_reqs <= EXA_RDEV_BATCH_MAX);
+
+    for (i = 0; i < nb_reqs && handle->nb_completed < EXA_RDEV_BATCH_MAX; i++)
+    {
+        void *nbd_private = reqs[i].nbd_private;
+        int ret;
+
+        ret = exa_rdev_make_request_new(reqs[i].op, &nbd_private,
+                                        reqs[i].sector, reqs[i].sector_nb,
+                                        reqs[i].buffer, handle);
+        switch (ret)
+        {
+        case RDEV_REQUEST_NONE_ENDED:
+        case RDEV_REQUEST_ALL_ENDED:
+            break;
+
+        case RDEV_REQUEST_END_OK:
+        case RDEV_REQUEST_END_ERROR:
+            handle->completed[handle->nb_completed].nbd_private = nbd_private;
+            handle->completed[handle->nb_completed].status = ret;
+            handle->nb_completed++;
+            break;
+
+        case RDEV_REQUEST_NOT_ENOUGH_FREE_REQ:
+            return i;
+
+        default:
+            if (i > 0)
+                return i;
+            return ret < 0 ? ret : -RDEV_ERR_UNKNOWN;
+        }
+    }
+
+    return i;
+}
+
+/* The module cannot wait with a timeout: it is only honored when 0 */
+int exa_rdev_reap(exa_rdev_handle_t *handle, exa_rdev_completion_t *completions,
+                  int min_nr, int max_nr, int timeout_ms)
+{
+    int n;
+
+    if (handle == NULL)
+        return -RDEV_ERR_NOT_OPEN;
+
+    n = MIN(handle->nb_completed, max_nr);
+    memcpy(completions, handle->completed, n * sizeof(*completions));
+    handle->nb_completed -= n;
+    memmove(handle->completed, handle->completed + n,
+            handle->nb_completed * sizeof(*completions));
+
+    if (timeout_ms == 0)
+        return n;
+
+    while (n < min_nr && n < max_nr)
+    {
+        void *nbd_private;
+        int ret = exa_rdev_wait_one_request(&nbd_private, handle);
+
+        if (ret == RDEV_REQUEST_ALL_ENDED)
+            break;
+
+        if (ret != RDEV_REQUEST_END_OK && ret != RDEV_REQUEST_END_ERROR)
+            return n > 0 ? n : (ret < 0 ? ret : -RDEV_ERR_UNKNOWN);
+
+        completions[n].nbd_private = nbd_private;
+        completions[n].status = ret;
+        n++;
+    }
+
+    return n;
+}
+
+int exa_rdev_register_buffers(exa_rdev_handle_t *handle, void *area,
+                              size_t buffer_size, int nb_buffers)
+{
+    /* Buffers are mapped at each IO */
+    return 0;
+}
+
+int exa_rdev_set_completion_eventfd(exa_rdev_handle_t *handle, int efd)
+{
+    /* The kernel module only reports completions through its ioctl */
+    return -ENOTSUP;
+}
+
 int exa_rdev_get_last_error(const exa_rdev_handle_t *handle)
 {
     int state = __ioctl_nointr(handle->fd, EXA_RDEV_GET_LAST_ERROR, NULL);
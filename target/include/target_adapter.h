@@ -19,6 +19,7 @@ typedef struct
 {
     size_t iscsi_queue_depth;
     size_t bdev_queue_depth;
+    size_t bdev_threads;
     size_t buffer_size;
     iqn_t target_iqn;
     in_addr_t target_listen_address;
@@ -14,6 +14,7 @@
 #include "common/include/exa_nodeset.h"
 #include "common/include/threadonize.h"
 #include "config/exa_version.h"
+#include "exatrace/include/exatrace.h"
 #include "target/iscsi/include/target_perf.h"
 #include "target/iscsi/include/scsi.h"
 #include "target/iscsi/include/iscsi.h"
@@ -1698,6 +1699,8 @@ static void disk_end_io(int err, void *data)
 			   cmd->scsi_cmd.tag, cmd->status);
     }
 
+    EXATRACE(TARGET_END, cmd, 0, err);
+
     nbd_list_post(&g_cmd_queue, cmd, -1);
 }
 
@@ -2076,6 +2079,7 @@ static void prepare_disk_write(TARGET_CMD_T *cmd,
      * BTW, lum_export_submit_io implements synchronize cache which is NOT
      * equivalent. This fuzzy buggy behaviour deserve to be fixed. */
     fua = false;
+    EXATRACE(TARGET_BEGIN, cmd, 0, len * CONFIG_DISK_BLOCK_LEN_DFLT);
     lum_export_submit_io(lun_data[lun].export,
                          BLOCKDEVICE_IO_WRITE, fua,
                          sector,
@@ -2109,6 +2113,7 @@ static void prepare_disk_read(TARGET_CMD_T *cmd,
     ISCSI_TARGET_PERF_MAKE_READ_REQUEST(
         cmd, len * CONFIG_DISK_BLOCK_LEN_DFLT / 1024.);
 
+    EXATRACE(TARGET_BEGIN, cmd, 0, num_bytes);
     lum_export_submit_io(lun_data[lun].export,
                          BLOCKDEVICE_IO_READ, false,
                          sector,
@@ -22,13 +22,26 @@
 #define BD_IOCTL_SETSIZE        0x38
 #define BD_IOCTL_IS_INUSE       0x39
 
+/*
+ * A barrillet queue is a ring of request indexes with one producer and one
+ * consumer, in the memory shared by the kernel and the user process. The
+ * consumer sets *need_wakeup before sleeping and then checks the ring again;
+ * the producer only wakes the consumer up (with an ioctl from the user
+ * process) when it finds *need_wakeup set after adding elements. Thus one
+ * wakeup carries all the elements added meanwhile, and a busy consumer is
+ * never woken up.
+ */
 struct bd_barrillet_queue
 {
     int *last_index_add;
     int *last_index_read_plus_one;
     int *next_elt;
+    int *need_wakeup;
 };
 
+/** Number of ints of the two barrillet queues after the bd_user_queue array */
+#define BD_BARRILLET_INTS(max_queue)  (2 * ((max_queue) + 2) + 2)
+
 struct bd_init
 {
     int   bd_buffer_size;
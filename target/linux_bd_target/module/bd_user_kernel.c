@@ -29,7 +29,6 @@ struct bd_event
     struct semaphore       bd_event_sem;     /**< Used to up/down a semaphore if necessary */
     bool                   has_pending_event; /**< Used to say if a new event is pending */
     bool                   exiting; /**< Used to say if we waiting on the semaphore */
-    bool                   wait_for_new_event; /**< Used to say if we waiting on the semaphore */
     unsigned long          bd_type;          /**< type of waiting Event */
     struct bd_event_msg   *bd_msg;
 };
@@ -87,6 +86,8 @@ void bd_wakeup(struct bd_event *bd_event)
         return;
     }
 
+    bd_event->bd_type |= BD_EVENT_POST;
+
     /* if not signaled yet for pending event, set the flag and up the semaphore */
     if (!bd_event->has_pending_event)
     {
@@ -157,7 +158,7 @@ void bd_new_event_msg_wait_processed(struct bd_event *bd_event,
                                      struct bd_event_msg *msg)
 {
     unsigned long flags;
-    bool someone_waits;
+    bool signaled;
 
     init_completion(&msg->bd_event_completion);
 
@@ -172,13 +173,14 @@ void bd_new_event_msg_wait_processed(struct bd_event *bd_event,
 
     bd_event->bd_type = bd_event->bd_type | msg->bd_type;
 
-    someone_waits = bd_event->wait_for_new_event && !bd_event->has_pending_event;
+    /* As in bd_wakeup(), the semaphore is up once per pending event */
+    signaled = bd_event->has_pending_event;
 
     bd_event->has_pending_event = true;
     msg->next = bd_event->bd_msg;
     bd_event->bd_msg = msg;
 
-    if (someone_waits)
+    if (!signaled)
         up(&bd_event->bd_event_sem);
 
     spin_unlock_irqrestore(&bd_event->bd_event_sl, flags);
@@ -236,7 +238,6 @@ static struct bd_event *bd_event_init(void)
         return NULL;
 
     bd_event->exiting = false; 
-    bd_event->wait_for_new_event = false; /* no BdWaitEvent() waiting for an event */
     bd_event->has_pending_event = false;     /* no other event posted */
     bd_event->bd_type = 0;
     bd_event->bd_msg = NULL;
@@ -301,8 +302,14 @@ long bd_post_new_rq(struct bd_session *session, struct bd_request *req)
     *session->bd_new_request.last_index_add =
         (*session->bd_new_request.last_index_add + 1) % session->bd_max_queue;
 
-    /* one new request, so up the semaphore to call the user process */
-    bd_wakeup(session->bd_new_rq);
+    /* one new request, so up the semaphore to call the user process if it
+     * is waiting: otherwise it will find the request by itself */
+    mb();
+    if (*session->bd_new_request.need_wakeup)
+    {
+        *session->bd_new_request.need_wakeup = 0;
+        bd_wakeup(session->bd_new_rq);
+    }
     return 0;
 }
 
@@ -365,6 +372,30 @@ static void bd_ack_rq(struct bd_session *session)
 }
 
 
+/**
+ * Tell the user process that the ack thread is going to sleep, so that the
+ * next acks are signaled with BD_IOCTL_SEM_POST.
+ *
+ * @param session target session
+ *
+ * @return true if there is no ack pending, false if acks were posted
+ *         meanwhile and must be handled before sleeping
+ */
+static bool bd_ack_rq_arm_wakeup(struct bd_session *session)
+{
+    struct bd_barrillet_queue *bd_ack_req = &session->bd_ack_request;
+
+    *bd_ack_req->need_wakeup = 1;
+    mb();
+
+    if (bd_ack_req->next_elt[*bd_ack_req->last_index_read_plus_one] == -1)
+        return true;
+
+    *bd_ack_req->need_wakeup = 0;
+    return false;
+}
+
+
 /**
  *  used to end all pending request mapped in user mode
  * @param session target session
@@ -480,8 +511,10 @@ static int bd_ack_rq_thread(void *arg)
 
         if ((type & BD_EVENT_POST) != 0)
         {
-            bd_ack_rq(session); /* wait for something and ack all user finished request */
-            bd_flush_q(session);     /* add in user space as lot as we can the pending request */
+            do {
+                bd_ack_rq(session); /* wait for something and ack all user finished request */
+                bd_flush_q(session);     /* add in user space as lot as we can the pending request */
+            } while (!bd_ack_rq_arm_wakeup(session));
         }
 
         while (msg != NULL)
@@ -595,11 +628,11 @@ struct bd_session *bd_launch_session(struct bd_init *init)
     session->bd_page_size = init->bd_max_queue * sizeof(struct bd_kernel_queue);
     if (session->bd_page_size < init->bd_max_queue *
         sizeof(struct bd_user_queue) +
-        (init->bd_max_queue + 2) * 2 * sizeof(int))
+        BD_BARRILLET_INTS(init->bd_max_queue) * sizeof(int))
     {
         session->bd_page_size = init->bd_max_queue *
                                 sizeof(struct bd_user_queue) +
-                                (init->bd_max_queue + 2) * 2 * sizeof(int);
+                                BD_BARRILLET_INTS(init->bd_max_queue) * sizeof(int);
     }
 
     /* If page_size not alligned, align it */
@@ -653,6 +686,10 @@ struct bd_session *bd_launch_session(struct bd_init *init)
  * n+2+session->bd_max_queue+2..
  *  n+2+session->bd_max_queue+2+session->bd_max_queue-1 session->bd_ack_request.next_elt
  *
+ * Wakeup flags
+ * n+2+2*session->bd_max_queue+2    session->bd_new_request.need_wakeup
+ * n+2+2*session->bd_max_queue+3    session->bd_ack_request.need_wakeup
+ *
  * each barillet have session->bd_max_queue element and there are a maximum of session->bd_max_queue-2 new elements
  * because there are only session->bd_max_queue in bd_user_queue and bd_kernel_queue maped in user and the element
  * 0 and 1 of these two queue is reserved.
@@ -661,11 +698,16 @@ struct bd_session *bd_launch_session(struct bd_init *init)
  * Adding :
  *   next_elt[last_index_add] = elt_to_send
  *   last_index_add++
+ *   if need_wakeup then
+ *        need_wakeup = 0
+ *        wake up the receiver
  *
  * Removing
  *   elt_received = next_elt[last_read_plus_one]
  *   if elt_received == -1 then
  *        nothing received
+ *        need_wakeup = 1
+ *        check again before sleeping
  *   else
  *        received : elt_received
  *        next_elt[last_read_plus_one] = -1
@@ -684,11 +726,17 @@ struct bd_session *bd_launch_session(struct bd_init *init)
         session->bd_new_request.last_index_add + 2 + session->bd_max_queue + 1;
     session->bd_ack_request.next_elt = session->bd_new_request.last_index_add +
                                        2 + session->bd_max_queue + 2;
+    session->bd_new_request.need_wakeup = session->bd_ack_request.next_elt +
+                                          session->bd_max_queue;
+    session->bd_ack_request.need_wakeup = session->bd_new_request.need_wakeup + 1;
 
     *session->bd_new_request.last_index_read_plus_one = 0;
     *session->bd_ack_request.last_index_read_plus_one = 0,
     *session->bd_new_request.last_index_add = 0;
     *session->bd_ack_request.last_index_add = 0;
+    /* The user process did not wait yet, the ack thread is about to */
+    *session->bd_new_request.need_wakeup = 0;
+    *session->bd_ack_request.need_wakeup = 1;
 
     for (i = 0; i < session->bd_max_queue; i++)
     {
@@ -9,31 +9,39 @@
 #include "target/include/target_adapter.h"
 #include "lum/export/include/executive_export.h"
 #include "target/linux_bd_target/include/bd_user_perf.h"
+#include "target/linux_bd_target/src/bdev_node.h"
 
 #include "common/include/exa_error.h"
+#include "common/include/exa_math.h"
 #include "common/include/exa_names.h"
 #include "common/include/threadonize.h"
 
+#include "exatrace/include/exatrace.h"
+
 #include "log/include/log.h"
 
-#include "os/include/os_dir.h"
 #include "os/include/os_error.h"
 #include "os/include/os_file.h"
 #include "os/include/os_kmod.h"
 #include "os/include/os_mem.h"
-#include "os/include/strlcpy.h"
 #include "os/include/os_stdio.h"
 #include "os/include/os_thread.h"
+#include "os/include/os_time.h"
 
 #include <sys/mman.h> /* mmap */
-#include <linux/fs.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
-#include <sys/sysmacros.h>
 
 static volatile bool bd_target_run;
 
+/** Maximum number of requests a submission thread takes at once */
+#define BD_SUBMIT_BATCH  8
+
+/** Bounds of the time spent polling for new requests before sleeping */
+#define BD_POLL_MIN_US   2
+#define BD_POLL_MAX_US   64
+
 struct tab_session
 {
     /* User structure pointer get by kernel mmap This structure must be read only */
@@ -52,6 +60,14 @@ struct tab_session
 
     struct bd_barrillet_queue bd_ack_request;
     struct bd_barrillet_queue bd_new_request;
+
+    /* The barrillet queues have a single consumer and a single producer:
+     * these locks serialize the submission threads and the completions */
+    os_thread_mutex_t new_request_lock;
+    os_thread_mutex_t ack_request_lock;
+
+    /* Current time spent polling for new requests, in microseconds */
+    unsigned int poll_us;
 };
 
 static struct
@@ -61,9 +77,8 @@ static struct
     os_thread_mutex_t lock;
 } private_data;
 
-/* we use a false mutex to force a memory barrier */
-static os_thread_mutex_t fake_mutex = PTHREAD_MUTEX_INITIALIZER;
-#define MB() os_thread_mutex_trylock(&fake_mutex)
+/* Full memory barrier, the kernel reads and writes the queues concurrently */
+#define MB() __sync_synchronize()
 
 #define LAST_MINOR  (MAX_BD_MINOR - 1)
 
@@ -115,84 +130,9 @@ static void export_bdev_release_minor(int minor)
     minors2export[minor] = NULL;
 }
 
-/**
- * Create an UNIX block device path under /dev associated to a group:volume.
- *
- * @param[in]   path    Path of the device in /dev
- * @param[in]   major
- * @param[in]   minor
- *
- * @return EXA_SUCCESS if successful, negative error otherwise.
- */
-static int export_bdev_create(const char *path, int major, int minor)
-{
-    char _path[EXA_MAXSIZE_LINE + 1];
-    char *dir;
-    mode_t mode = S_IFBLK | S_IRUSR | S_IWUSR;
-    struct stat st;
-    int err;
-
-    strlcpy(_path, path, sizeof(_path));
-
-    dir = os_dirname(_path);
-    err = os_dir_create_recursive(dir);
-    if (err)
-        return err;
-
-    /* An old device may be left by Exanodes when it crashes.
-       As the major/minor may change we delete and recreate it.
-       FIXME: we should also test if another volume has the same maj/min
-     */
-    if (stat(path, &st) == 0)
-        unlink(path);
-
-    if (mknod(path, mode, makedev(major, minor)) == -1)
-    {
-        exalog_error("Cannot create device '%s' with major,minor %d,%d: %s (%d)",
-                     path, major, minor, os_strerror(errno), -errno);
-        return -errno;
-    }
-
-    return EXA_SUCCESS;
-}
-
-/** Remove an UNIX block device path under /dev in the form of group/volume.
- *
- * @param[in] path  dev entry name
- *
- * @return          EXA_SUCCESS if successful, negative error otherwise.
- */
-static int export_bdev_delete(const char *path)
-{
-    int err;
-    char _path[EXA_MAXSIZE_LINE + 1];
-    char *dir;
-
-    if (unlink(path) == -1 && errno != ENOENT)
-    {
-        exalog_error("Cannot remove device '%s': %s (%d)", path,
-                     os_strerror(errno), -errno);
-        return -errno;
-    }
-
-    strlcpy(_path, path, sizeof(_path));
-
-    dir = os_dirname(_path);
-
-    /* If the group directory is empty we also remove it */
-    err = os_dir_remove(dir);
-    if(err != 0 && err != -ENOTEMPTY)
-    {
-        exalog_error("Cannot remove directory '%s': %s (%d)", dir,
-                     os_strerror(errno), -errno);
-        return -errno;
-    }
-
-    return EXA_SUCCESS;
-}
-
 static struct bd_init init;
-static os_thread_t linux_blockdevice_io_thread;
+static os_thread_t submit_threads[BDEV_TARGET_MAX_THREADS];
+static unsigned int nb_submit_threads;
 
 static bool checknum(struct tab_session *session, int num)
 {
@@ -216,16 +156,25 @@ static bool checknum(struct tab_session *session, int num)
  */
 static int __bdend(struct tab_session *session)
 {
+    unsigned int i;
+
     bd_target_run = false;
-    /* Wake __bdget_new_request */
+    /* Wake the thread waiting in __bdget_new_requests(), the others wait
+     * for the new_request_lock and will see bd_target_run */
     __ioctl_nointr(session->bd_fd, BD_IOCTL_CLEANUP, 0);
-    os_thread_join(linux_blockdevice_io_thread);
+    for (i = 0; i < nb_submit_threads; i++)
+        os_thread_join(submit_threads[i]);
+    nb_submit_threads = 0;
 
     munmap(session->bd_kernel_queue, 2 * session->bd_page_size);
     munmap(session->bd_user_queue,   3 * session->bd_page_size);
 
     close(session->bd_fd);
 
+    os_thread_mutex_destroy(&session->new_request_lock);
+    os_thread_mutex_destroy(&session->ack_request_lock);
+    os_thread_rwlock_destroy(&session->change_state);
+
     os_aligned_free(init.buffer);
     os_free(session);
 
@@ -315,7 +264,13 @@ static struct tab_session *__bdinit(int *major, int bd_buffer_size,
                                        bd_max_queue + 1;
     ack_rq->next_elt = new_rq->last_index_add + 2 + bd_max_queue + 2;
 
+    new_rq->need_wakeup = ack_rq->next_elt + bd_max_queue;
+    ack_rq->need_wakeup = new_rq->need_wakeup + 1;
+
     os_thread_rwlock_init(&session->change_state);
+    os_thread_mutex_init(&session->new_request_lock);
+    os_thread_mutex_init(&session->ack_request_lock);
+    session->poll_us = BD_POLL_MIN_US;
 
     return session;
 }
@@ -387,49 +342,127 @@ static int __bdremove_minor(struct tab_session *session, int minor)
     return ret;
 }
 
+/* Whether the kernel posted a request not taken yet. This is only a hint as
+ * it is read without the change_state lock. */
+static bool __bdhas_new_request(const struct tab_session *session)
+{
+    const volatile int *next_elt = session->bd_new_request.next_elt;
+
+    return next_elt[*(volatile int *)session->bd_new_request.last_index_read_plus_one] != -1;
+}
+
 /**
- * Get a new request sent to this session by the kernel
+ * Take the requests posted by the kernel. Must be called with the
+ * new_request_lock and the change_state lock held.
+ *
  * @param session target session
- * @param[out] queue containing info on the request (number, size of data, ...)
- * @param[out] Buffer buffer to store data
- * @return 0 success, -1 if cannot find a new request.
+ * @param[out] queue_indexes indexes of the requests taken
+ * @param max maximum number of requests to take
+ *
+ * @return the number of requests taken
  */
-static bool __bdget_new_request(struct tab_session *session, long *queue_index)
+static int __bdtake_new_requests(struct tab_session *session,
+                                 long *queue_indexes, int max)
 {
-    /* Li state for last i ! */
-    int li = -1;
+    struct bd_barrillet_queue *new_rq = &session->bd_new_request;
+    int nb = 0;
 
-    while (li == -1 && bd_target_run)
+    while (nb < max)
     {
-	os_thread_rwlock_rdlock(&session->change_state);
-
-	li = session->bd_new_request.next_elt[*session->bd_new_request.
-					      last_index_read_plus_one];
-	if (li == -1)
-	{
-	    os_thread_rwlock_unlock(&session->change_state);
-	    if (__ioctl_nointr(session->bd_fd, BD_IOCTL_SEM_WAIT, 0) != 0)
-		return false;
-	}
+        int *lirpo = new_rq->last_index_read_plus_one;
+        int li = ((volatile int *)new_rq->next_elt)[*lirpo];
+
+        if (li == -1)
+            break;
+
+        new_rq->next_elt[*lirpo] = -1;
+        MB();
+        *lirpo = (*lirpo + 1) % session->bd_max_queue;
+
+        queue_indexes[nb++] = li;
     }
 
-    if (!bd_target_run)
+    return nb;
+}
+
+/**
+ * Spin a while for a new request before going to sleep, as waking up costs
+ * more than the delay between two requests under load. The time spent
+ * polling doubles when a request came and halves otherwise, so that an idle
+ * session hardly polls.
+ *
+ * @param session target session
+ *
+ * @return true if a request came
+ */
+static bool __bdpoll_new_request(struct tab_session *session)
+{
+    struct timespec start, now;
+    uint64_t elapsed_us;
+
+    os_get_monotonic_time(&start);
+    do
     {
-	os_thread_rwlock_unlock(&session->change_state);
-	return false;
-    }
+        if (__bdhas_new_request(session))
+        {
+            session->poll_us = MIN(2 * session->poll_us, BD_POLL_MAX_US);
+            return true;
+        }
 
-    session->bd_new_request.next_elt[*session->bd_new_request.
-                                     last_index_read_plus_one] = -1;
-    MB();
-    *session->bd_new_request.last_index_read_plus_one =
-        (*session->bd_new_request.last_index_read_plus_one +
-         1) % session->bd_max_queue;
+        os_get_monotonic_time(&now);
+        elapsed_us = (now.tv_sec - start.tv_sec) * 1000000
+                     + now.tv_nsec / 1000 - start.tv_nsec / 1000;
+    } while (elapsed_us < session->poll_us && bd_target_run);
 
-    *queue_index = li;
-    os_thread_rwlock_unlock(&session->change_state);
+    session->poll_us = MAX(session->poll_us / 2, BD_POLL_MIN_US);
 
-    return true;
+    return false;
+}
+
+/**
+ * Get new requests sent to this session by the kernel, waiting for one if
+ * there is none. Only one thread at a time waits for the kernel, the other
+ * ones wait for it to get requests.
+ *
+ * @param session target session
+ * @param[out] queue_indexes indexes of the requests in the queues
+ * @param max maximum number of requests to get
+ *
+ * @return the number of requests, 0 if cannot find a new request.
+ */
+static int __bdget_new_requests(struct tab_session *session,
+                                long *queue_indexes, int max)
+{
+    int nb = 0;
+
+    os_thread_mutex_lock(&session->new_request_lock);
+
+    while (nb == 0 && bd_target_run)
+    {
+        os_thread_rwlock_rdlock(&session->change_state);
+        nb = __bdtake_new_requests(session, queue_indexes, max);
+        os_thread_rwlock_unlock(&session->change_state);
+
+        if (nb > 0 || __bdpoll_new_request(session))
+            continue;
+
+        /* Tell the kernel we are going to sleep, then check again as a
+         * request posted before would not wake us up */
+        *session->bd_new_request.need_wakeup = 1;
+        MB();
+        if (__bdhas_new_request(session))
+        {
+            *session->bd_new_request.need_wakeup = 0;
+            continue;
+        }
+
+        if (__ioctl_nointr(session->bd_fd, BD_IOCTL_SEM_WAIT, 0) != 0)
+            break;
+    }
+
+    os_thread_mutex_unlock(&session->new_request_lock);
+
+    return nb;
 }
 
 /**
@@ -443,23 +476,39 @@ static bool __bdget_new_request(struct tab_session *session, long *queue_index)
 static inline void __bdend_request(struct tab_session *session,
                                    int num, int status)
 {
+    struct bd_barrillet_queue *ack_rq = &session->bd_ack_request;
+    bool wakeup;
+
     os_thread_rwlock_rdlock(&session->change_state);
 
     EXA_ASSERT(checknum(session, num));
 
     session->bd_user_queue[num].bd_result = status;
+    EXATRACE(TARGET_END, num, 0, status);
     BDEV_TARGET_PERF_END_REQUEST(session->bd_kernel_queue[num].bd_op,
                                  &session->bd_user_queue[num]);
+
+    os_thread_mutex_lock(&session->ack_request_lock);
+
     MB();
-    session->bd_ack_request.next_elt[*session->bd_ack_request.last_index_add] = num;
-    *session->bd_ack_request.last_index_add =
-        (*session->bd_ack_request.last_index_add + 1) % session->bd_max_queue;
+    ack_rq->next_elt[*ack_rq->last_index_add] = num;
+    *ack_rq->last_index_add = (*ack_rq->last_index_add + 1) % session->bd_max_queue;
+
+    /* The kernel thread only needs a wakeup if it is going to sleep: while
+     * it is awake, it acks all the requests ended meanwhile */
+    MB();
+    wakeup = *(volatile int *)ack_rq->need_wakeup != 0;
+    if (wakeup)
+        *ack_rq->need_wakeup = 0;
+
+    os_thread_mutex_unlock(&session->ack_request_lock);
 
     os_thread_rwlock_unlock(&session->change_state);
 
     exalog_debug("bd_user : will end %d request with status %d\n", num, status);
 
-    __ioctl_nointr(session->bd_fd, BD_IOCTL_SEM_POST, 0); /* 1 or 2 */
+    if (wakeup)
+        __ioctl_nointr(session->bd_fd, BD_IOCTL_SEM_POST, 0);
 }
 
 static int adapter_static_init(exa_nodeid_t node_id /* unused */)
@@ -502,7 +551,21 @@ static int adapter_init(const lum_init_params_t *params)
 
     bd_target_run = true;
 
-    exathread_create(&linux_blockdevice_io_thread, 8192, thread_submit_io, NULL);
+    nb_submit_threads = 0;
+    while (nb_submit_threads < MAX(MIN(params->bdev_threads,
+                                       BDEV_TARGET_MAX_THREADS), 1))
+    {
+        if (!exathread_create(&submit_threads[nb_submit_threads], 8192,
+                              thread_submit_io, NULL))
+            break;
+        nb_submit_threads++;
+    }
+
+    if (nb_submit_threads == 0)
+    {
+        __bdend(session);
+        return -ENOMEM;
+    }
 
     bdev_init_done = true;
 
@@ -549,7 +612,7 @@ static int adapter_signal_new_export(lum_export_t *lum_export, uint64_t size)
     __bdnew_minor(private_data.session, minor, 0, "Not Used", readonly);
     __bdminor_set_size(private_data.session, minor, size);
 
-    err = export_bdev_create(export_bdev_get_path(export),
+    err = bdev_node_create(export_bdev_get_path(export),
                              private_data.major, minor);
     if (err != EXA_SUCCESS)
     {
@@ -628,7 +691,7 @@ static int adapter_signal_remove_export(const lum_export_t *export)
 
     desc = lum_export_get_desc(export);
 
-    return export_bdev_delete(export_bdev_get_path(desc));
+    return bdev_node_delete(export_bdev_get_path(desc));
 }
 
 static void disk_end_io(int err, void *data)
@@ -639,93 +702,55 @@ static void disk_end_io(int err, void *data)
     __bdend_request(session, req_num, err);
 }
 
-static void thread_submit_io(void *arg)
+static void submit_request(struct tab_session *session, long queue_index)
 {
-    while (bd_target_run)
-    {
-        struct bd_kernel_queue *kernel_q;
-        struct bd_user_queue *user_q;
-        long queue_index;
-
-        blockdevice_io_type_t bio_type;
-        bool flush_cache;
+    struct bd_kernel_queue *kernel_q = &session->bd_kernel_queue[queue_index];
+    struct bd_user_queue *user_q = &session->bd_user_queue[queue_index];
+    blockdevice_io_type_t bio_type;
+    bool flush_cache;
 
-        if (!__bdget_new_request(private_data.session, &queue_index))
-	    continue;
+    if (kernel_q->bd_op == 0) /* FIXME: We should use a define (maybe READ) instead of 0 */
+        bio_type = BLOCKDEVICE_IO_READ;
+    else
+        bio_type = BLOCKDEVICE_IO_WRITE;
 
-        /* FIXME the lock is taken after the while loop... quite strange... */
-        os_thread_mutex_lock(&private_data.lock);
+    flush_cache = (user_q->bd_info & BD_INFO_BARRIER) != 0;
 
-        user_q   = &private_data.session->bd_user_queue[queue_index];
-        kernel_q = &private_data.session->bd_kernel_queue[queue_index];
+    EXATRACE(TARGET_BEGIN, queue_index, 0, kernel_q->bd_size_in_sector << 9);
 
-        os_thread_mutex_unlock(&private_data.lock);
+    lum_export_submit_io(minors2export[kernel_q->bd_minor],
+                         bio_type, flush_cache,
+                         kernel_q->bd_blk_num,
+                         kernel_q->bd_size_in_sector << 9,
+                         kernel_q->bd_buf_user,
+                         (void *)queue_index, disk_end_io);
 
-        if (kernel_q->bd_op == 0) /* FIXME: We should use a define (maybe READ) instead of 0 */
-            bio_type = BLOCKDEVICE_IO_READ;
-        else
-            bio_type = BLOCKDEVICE_IO_WRITE;
-
-        flush_cache = (user_q->bd_info & BD_INFO_BARRIER) != 0;
-
-        /* FIXME The lock is relesaed but private data is still accessed
-         *        Is this really what is expected ? */
-        lum_export_submit_io(minors2export[kernel_q->bd_minor],
-                             bio_type, flush_cache,
-                             kernel_q->bd_blk_num,
-                             kernel_q->bd_size_in_sector << 9,
-                             kernel_q->bd_buf_user,
-                             (void *)queue_index, disk_end_io);
-
-        BDEV_TARGET_PERF_MAKE_REQUEST(kernel_q->bd_op, user_q,
-                                      (kernel_q->bd_size_in_sector << 9) / 1024);
-    }
+    BDEV_TARGET_PERF_MAKE_REQUEST(kernel_q->bd_op, user_q,
+                                  (kernel_q->bd_size_in_sector << 9) / 1024);
 }
 
-static int __check_device(const char *devpath)
+static void thread_submit_io(void *arg)
 {
-    struct stat info;
+    /* The session is only freed once all the submission threads are joined */
+    struct tab_session *session = private_data.session;
 
-    if (stat(devpath, &info) < 0)
-        return -errno;
+    while (bd_target_run)
+    {
+        long queue_indexes[BD_SUBMIT_BATCH];
+        int nb, i;
 
-    if (!S_ISBLK(info.st_mode))
-        return -EXA_ERR_NOT_BLOCK_DEV;
+        nb = __bdget_new_requests(session, queue_indexes, BD_SUBMIT_BATCH);
 
-    return EXA_SUCCESS;
+        for (i = 0; i < nb; i++)
+            submit_request(session, queue_indexes[i]);
+    }
 }
 
 static int adapter_set_readahead(const lum_export_t *lum_export, uint32_t readahead)
 {
     export_t *desc = lum_export_get_desc(lum_export);
-    const char *path;
-    unsigned long readahead_sectors;
-    int fd;
-    int ret;
-
-    if (readahead > UINT32_MAX / 2)
-        return -ERANGE;
-
-    readahead_sectors = readahead * 2;
-
-    path = export_bdev_get_path(desc);
 
-    ret = __check_device(path);
-    if (ret != EXA_SUCCESS)
-        return ret;
-
-    if ((fd = open(path, O_RDONLY)) == -1)
-        return -errno;
-
-    if (__ioctl_nointr(fd, BLKRASET, readahead_sectors) == -1)
-    {
-        close(fd);
-        return -errno;
-    }
-
-    close(fd);
-
-    return EXA_SUCCESS;
+    return bdev_node_set_readahead(export_bdev_get_path(desc), readahead);
 }
 
 static void adapter_suspend(void)
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "target/linux_bd_target/src/bdev_node.h"
+
+#include "common/include/exa_constants.h"
+#include "common/include/exa_error.h"
+
+#include "log/include/log.h"
+
+#include "os/include/os_dir.h"
+#include "os/include/os_error.h"
+#include "os/include/os_file.h"
+#include "os/include/strlcpy.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+int bdev_node_create(const char *path, int major, int minor)
+{
+    char _path[EXA_MAXSIZE_LINE + 1];
+    char *dir;
+    mode_t mode = S_IFBLK | S_IRUSR | S_IWUSR;
+    struct stat st;
+    int err;
+
+    strlcpy(_path, path, sizeof(_path));
+
+    dir = os_dirname(_path);
+    err = os_dir_create_recursive(dir);
+    if (err)
+        return err;
+
+    /* An old device may be left by Exanodes when it crashes.
+       As the major/minor may change we delete and recreate it.
+       FIXME: we should also test if another volume has the same maj/min
+     */
+    if (stat(path, &st) == 0)
+        unlink(path);
+
+    if (mknod(path, mode, makedev(major, minor)) == -1)
+    {
+        exalog_error("Cannot create device '%s' with major,minor %d,%d: %s (%d)",
+                     path, major, minor, os_strerror(errno), -errno);
+        return -errno;
+    }
+
+    return EXA_SUCCESS;
+}
+
+int bdev_node_delete(const char *path)
+{
+    int err;
+    char _path[EXA_MAXSIZE_LINE + 1];
+    char *dir;
+
+    if (unlink(path) == -1 && errno != ENOENT)
+    {
+        exalog_error("Cannot remove device '%s': %s (%d)", path,
+                     os_strerror(errno), -errno);
+        return -errno;
+    }
+
+    strlcpy(_path, path, sizeof(_path));
+
+    dir = os_dirname(_path);
+
+    /* If the group directory is empty we also remove it */
+    err = os_dir_remove(dir);
+    if(err != 0 && err != -ENOTEMPTY)
+    {
+        exalog_error("Cannot remove directory '%s': %s (%d)", dir,
+                     os_strerror(errno), -errno);
+        return -errno;
+    }
+
+    return EXA_SUCCESS;
+}
+
+static int __check_device(const char *devpath)
+{
+    struct stat info;
+
+    if (stat(devpath, &info) < 0)
+        return -errno;
+
+    if (!S_ISBLK(info.st_mode))
+        return -EXA_ERR_NOT_BLOCK_DEV;
+
+    return EXA_SUCCESS;
+}
+
+int bdev_node_set_readahead(const char *path, uint32_t readahead)
+{
+    unsigned long readahead_sectors;
+    int fd;
+    int ret;
+
+    if (readahead > UINT32_MAX / 2)
+        return -ERANGE;
+
+    readahead_sectors = readahead * 2;
+
+    ret = __check_device(path);
+    if (ret != EXA_SUCCESS)
+        return ret;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return -errno;
+
+    if (ioctl(fd, BLKRASET, readahead_sectors) == -1)
+    {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    close(fd);
+
+    return EXA_SUCCESS;
+}
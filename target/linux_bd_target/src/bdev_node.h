@@ -0,0 +1,46 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __BDEV_NODE_H__
+#define __BDEV_NODE_H__
+
+#include "os/include/os_inttypes.h"
+
+/* Block device nodes of the bdev exports, shared by the bdev target
+ * adapters */
+
+/**
+ * Create an UNIX block device path under /dev associated to a group:volume.
+ *
+ * @param[in]   path    Path of the device in /dev
+ * @param[in]   major
+ * @param[in]   minor
+ *
+ * @return EXA_SUCCESS if successful, negative error otherwise.
+ */
+int bdev_node_create(const char *path, int major, int minor);
+
+/** Remove an UNIX block device path under /dev in the form of group/volume.
+ *
+ * @param[in] path  dev entry name
+ *
+ * @return          EXA_SUCCESS if successful, negative error otherwise.
+ */
+int bdev_node_delete(const char *path);
+
+/**
+ * Set the readahead of a block device.
+ *
+ * @param[in] path       Path of the device in /dev
+ * @param[in] readahead  Readahead in KiB
+ *
+ * @return EXA_SUCCESS if successful, negative error otherwise.
+ */
+int bdev_node_set_readahead(const char *path, uint32_t readahead);
+
+#endif /* __BDEV_NODE_H__ */
@@ -0,0 +1,1026 @@
+/*
+ * Copyright 2002, 2009 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/* Implementation of the bdev target adapter with ublk, the userspace block
+ * device driver of Linux (ublk_drv): no out-of-tree module is needed.
+ *
+ * Each bdev export is a ublk device with bdev_target_threads hardware
+ * queues of bdev_target_queue_depth requests. Each queue is served by a
+ * thread of its own, with its own io_uring on the ublk character device:
+ * the thread fetches the requests of the queue (UBLK_IO_FETCH_REQ), hands
+ * them to the LUM export, and commits their result along with the fetch of
+ * the next request of the same tag (UBLK_IO_COMMIT_AND_FETCH_REQ).
+ *
+ * The commands of a queue must be issued by its thread, while IOs end in
+ * other threads: ended IOs are posted on a lock-free list which signals an
+ * eventfd read by the ring of the queue.
+ *
+ * The kernel copies the data between the block requests and a buffer per
+ * tag, as exa_bd does. The zero copy of ublk only lends the pages of the
+ * requests to the IOs of the ring of the queue, which the LUM exports do not
+ * use.
+ *
+ * Devices are administered through /dev/ublk-control, with a ring of its
+ * own as control commands need 128 bytes entries.
+ */
+
+#include "target/include/target_adapter.h"
+#include "lum/export/include/executive_export.h"
+#include "target/linux_bd_target/src/bdev_node.h"
+
+#include "common/include/exa_constants.h"
+#include "common/include/exa_error.h"
+#include "common/include/exa_math.h"
+#include "common/include/exa_nbd_list.h"
+#include "common/include/threadonize.h"
+
+#include "exatrace/include/exatrace.h"
+
+#include "log/include/log.h"
+
+#include "os/include/os_error.h"
+#include "os/include/os_eventfd.h"
+#include "os/include/os_kmod.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_semaphore.h"
+#include "os/include/os_stdio.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+#include <linux/ublk_cmd.h>
+
+#define UBLK_MODULE_NAME    "ublk_drv"
+#define UBLK_CONTROL_PATH   "/dev/ublk-control"
+
+/** Size of the buffer of a tag, which bounds the size of the requests */
+#define UBLK_IO_BUF_SIZE    (128 * 1024)
+
+/** Number of entries of the control ring, commands are sent one by one */
+#define UBLK_CONTROL_ENTRIES  4
+
+/** Time given to udev to create the character device of a new device */
+#define UBLK_CDEV_WAIT_MS   1000
+
+/** User data of the read of the eventfd of a queue, tags being smaller */
+#define UBLK_EVENTFD_USER_DATA  ((__u64)-1)
+
+typedef struct
+{
+    int fd;
+    size_t sqe_size;
+
+    /* submission queue */
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    char *sqes;
+    size_t sqes_size;
+    unsigned sqe_tail;  /* tail of the entries prepared, not yet submitted */
+
+    /* completion queue */
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+} ublk_ring_t;
+
+typedef struct ublk_queue ublk_queue_t;
+typedef struct ublk_dev ublk_dev_t;
+
+/** IO of a request handed to the LUM export */
+typedef struct
+{
+    ublk_queue_t *queue;
+    int tag;
+    int result;     /* size done, or negative error code */
+} ublk_io_t;
+
+struct ublk_queue
+{
+    ublk_dev_t *dev;
+    unsigned q_id;
+    os_thread_t thread;
+    ublk_ring_t ring;
+
+    /* Descriptors of the requests, written by the kernel */
+    const struct ublksrv_io_desc *iods;
+    size_t iods_size;
+    /* Buffer of each tag */
+    char *bufs;
+
+    struct nbd_root_list ios;
+    struct nbd_list ended;      /* IOs ended, to commit */
+    int efd;                    /* signalled when an IO is posted on 'ended' */
+    uint64_t efd_count;
+
+    unsigned nb_cmds;   /* fetch commands in the ring */
+    unsigned nb_ios;    /* IOs in progress in the export */
+
+    os_sem_t started;   /* posted once the first fetches are submitted */
+    int err;
+};
+
+struct ublk_dev
+{
+    lum_export_t *export;
+    int dev_id;
+    int cdev_fd;
+    unsigned nr_queues;
+    unsigned queue_depth;
+    unsigned nb_started;    /* queues whose thread is running */
+    ublk_queue_t queues[BDEV_TARGET_MAX_THREADS];
+};
+
+static struct
+{
+    int fd;
+    ublk_ring_t ring;
+    os_thread_mutex_t lock;  /* serializes the control commands */
+    unsigned nr_queues;
+    unsigned queue_depth;
+} ublk;
+
+static ublk_dev_t *devs[NBMAX_STARTED_VOLUMES];
+
+static bool ublk_init_done = false;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    int ret = syscall(__NR_io_uring_setup, entries, p);
+    return ret < 0 ? -errno : ret;
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags)
+{
+    int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      flags, NULL, 0);
+    return ret < 0 ? -errno : ret;
+}
+
+static void *ring_mmap(int ring_fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static void ring_cleanup(ublk_ring_t *ring)
+{
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != NULL)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != NULL)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int ring_setup(ublk_ring_t *ring, unsigned entries, unsigned flags)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+
+    ring->fd = sys_io_uring_setup(entries, &p);
+    if (ring->fd < 0)
+        return ring->fd;
+
+    ring->sqe_size = flags & IORING_SETUP_SQE128 ? 2 * sizeof(struct io_uring_sqe)
+                                                 : sizeof(struct io_uring_sqe);
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = p.sq_entries * ring->sqe_size;
+
+    ring->sq_ring = ring_mmap(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    ring->cq_ring = ring_mmap(ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    ring->sqes = ring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+
+    if (ring->sq_ring == NULL || ring->cq_ring == NULL || ring->sqes == NULL)
+    {
+        ring_cleanup(ring);
+        return -ENOMEM;
+    }
+
+    sq = ring->sq_ring;
+    ring->sq_head    = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail    = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask    = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array   = (unsigned *)(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+    ring->sqe_tail   = *ring->sq_tail;
+
+    cq = ring->cq_ring;
+    ring->cq_head    = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask    = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+/* Get a submission entry, to be submitted by the next ring_enter(). Rings
+ * are sized for all the commands they may hold at once. */
+static struct io_uring_sqe *ring_get_sqe(ublk_ring_t *ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned idx = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe;
+
+    EXA_ASSERT(ring->sqe_tail - head < ring->sq_entries);
+
+    sqe = (struct io_uring_sqe *)(ring->sqes + idx * ring->sqe_size);
+    memset(sqe, 0, ring->sqe_size);
+    ring->sq_array[idx] = idx;
+    ring->sqe_tail++;
+
+    return sqe;
+}
+
+/* Submit the entries prepared and wait for min_complete completions */
+static int ring_enter(ublk_ring_t *ring, unsigned min_complete)
+{
+    int ret;
+
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    /* Nothing is submitted when interrupted */
+    do {
+        unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+        ret = sys_io_uring_enter(ring->fd, ring->sqe_tail - head, min_complete,
+                                 min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret == -EINTR);
+
+    return ret < 0 ? ret : 0;
+}
+
+static struct io_uring_cqe *ring_peek_cqe(ublk_ring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+static void ring_cqe_seen(ublk_ring_t *ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Send a command to the ublk driver and wait for its result.
+ *
+ * @param op      UBLK_CMD_*
+ * @param dev_id  Device the command is about, -1 to have a new one
+ * @param data    Inline data of the command
+ * @param buf     Buffer of the command, or NULL
+ * @param len     Size of buf
+ *
+ * @return 0 or a negative error code
+ */
+static int ublk_ctrl_cmd(unsigned op, int dev_id, uint64_t data,
+                         void *buf, size_t len)
+{
+    struct ublksrv_ctrl_cmd *cmd;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    int ret;
+
+    os_thread_mutex_lock(&ublk.lock);
+
+    sqe = ring_get_sqe(&ublk.ring);
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = ublk.fd;
+    sqe->cmd_op = op;
+
+    cmd = (struct ublksrv_ctrl_cmd *)sqe->cmd;
+    cmd->dev_id = dev_id;
+    cmd->queue_id = (__u16)-1;
+    cmd->addr = (__u64)(uintptr_t)buf;
+    cmd->len = len;
+    cmd->data[0] = data;
+
+    ret = ring_enter(&ublk.ring, 1);
+    if (ret == 0)
+    {
+        cqe = ring_peek_cqe(&ublk.ring);
+        EXA_ASSERT(cqe != NULL);
+        ret = cqe->res < 0 ? cqe->res : 0;
+        ring_cqe_seen(&ublk.ring);
+    }
+
+    os_thread_mutex_unlock(&ublk.lock);
+
+    return ret;
+}
+
+static void queue_prep_cmd(ublk_queue_t *q, unsigned op, int tag, int result)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&q->ring);
+    struct ublksrv_io_cmd *cmd = (struct ublksrv_io_cmd *)sqe->cmd;
+
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = q->dev->cdev_fd;
+    sqe->cmd_op = op;
+    sqe->user_data = tag;
+
+    cmd->q_id = q->q_id;
+    cmd->tag = tag;
+    cmd->result = result;
+    cmd->addr = (__u64)(uintptr_t)(q->bufs + (size_t)tag * UBLK_IO_BUF_SIZE);
+
+    q->nb_cmds++;
+}
+
+static void queue_prep_eventfd_read(ublk_queue_t *q)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&q->ring);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = q->efd;
+    sqe->addr = (__u64)(uintptr_t)&q->efd_count;
+    sqe->len = sizeof(q->efd_count);
+    sqe->user_data = UBLK_EVENTFD_USER_DATA;
+}
+
+static void ublk_end_io(int err, void *data)
+{
+    ublk_io_t *io = data;
+
+    if (err != 0)
+        io->result = err < 0 ? err : -EIO;
+
+    EXATRACE(TARGET_END, io, 0, err);
+
+    nbd_list_post(&io->queue->ended, io, -1);
+}
+
+static void queue_handle_request(ublk_queue_t *q, int tag)
+{
+    const struct ublksrv_io_desc *iod = &q->iods[tag];
+    char *buf = q->bufs + (size_t)tag * UBLK_IO_BUF_SIZE;
+    lum_export_t *export = q->dev->export;
+    ublk_io_t *io;
+
+    /* There are as many IOs as tags */
+    io = nbd_list_remove(&q->ios.free, NULL, LISTNOWAIT);
+    EXA_ASSERT(io != NULL);
+
+    io->queue = q;
+    io->tag = tag;
+    io->result = iod->nr_sectors << 9;
+    q->nb_ios++;
+
+    EXATRACE(TARGET_BEGIN, io, 0, io->result);
+
+    switch (ublksrv_get_op(iod))
+    {
+    case UBLK_IO_OP_READ:
+        lum_export_submit_io(export, BLOCKDEVICE_IO_READ, false,
+                             iod->start_sector, io->result, buf,
+                             io, ublk_end_io);
+        break;
+
+    case UBLK_IO_OP_WRITE:
+        lum_export_submit_io(export, BLOCKDEVICE_IO_WRITE, false,
+                             iod->start_sector, io->result, buf,
+                             io, ublk_end_io);
+        break;
+
+    case UBLK_IO_OP_FLUSH:
+        /* An empty barrier, as exa_bd sends for a cache flush */
+        lum_export_submit_io(export, BLOCKDEVICE_IO_WRITE, true,
+                             iod->start_sector, 0, buf,
+                             io, ublk_end_io);
+        break;
+
+    default:
+        ublk_end_io(-EOPNOTSUPP, io);
+        break;
+    }
+}
+
+/* Commit the IOs ended, the next requests of their tags being fetched */
+static void queue_commit_ended(ublk_queue_t *q)
+{
+    ublk_io_t *io;
+
+    while ((io = nbd_list_remove(&q->ended, NULL, LISTNOWAIT)) != NULL)
+    {
+        queue_prep_cmd(q, UBLK_IO_COMMIT_AND_FETCH_REQ, io->tag, io->result);
+        nbd_list_post(&q->ios.free, io, -1);
+        q->nb_ios--;
+    }
+}
+
+static void ublk_queue_thread(void *data)
+{
+    ublk_queue_t *q = data;
+    unsigned tag;
+
+    /* The kernel gives the requests of a queue to the thread which fetched
+     * them first */
+    for (tag = 0; tag < q->dev->queue_depth; tag++)
+        queue_prep_cmd(q, UBLK_IO_FETCH_REQ, tag, 0);
+    queue_prep_eventfd_read(q);
+
+    q->err = ring_enter(&q->ring, 0);
+    os_sem_post(&q->started);
+    if (q->err != 0)
+        return;
+
+    /* The pending fetches are aborted when the device is stopped, once
+     * all its requests are committed */
+    while (q->nb_cmds > 0 || q->nb_ios > 0)
+    {
+        struct io_uring_cqe *cqe;
+        int err;
+
+        err = ring_enter(&q->ring, 1);
+        if (err != 0)
+        {
+            exalog_error("ublk device %d queue %u: cannot wait for requests: %s (%d)",
+                         q->dev->dev_id, q->q_id, exa_error_msg(err), err);
+            break;
+        }
+
+        while ((cqe = ring_peek_cqe(&q->ring)) != NULL)
+        {
+            __u64 user_data = cqe->user_data;
+            int res = cqe->res;
+
+            ring_cqe_seen(&q->ring);
+
+            if (user_data == UBLK_EVENTFD_USER_DATA)
+            {
+                queue_commit_ended(q);
+                queue_prep_eventfd_read(q);
+                continue;
+            }
+
+            q->nb_cmds--;
+
+            if (res == UBLK_IO_RES_OK)
+                queue_handle_request(q, user_data);
+            else if (res != UBLK_IO_RES_ABORT)
+                exalog_error("ublk device %d queue %u: fetch of tag %d failed: %s (%d)",
+                             q->dev->dev_id, q->q_id, (int)user_data,
+                             exa_error_msg(res), res);
+        }
+    }
+}
+
+static void ublk_queue_cleanup(ublk_queue_t *q)
+{
+    ring_cleanup(&q->ring);
+
+    if (q->efd >= 0)
+    {
+        nbd_close_list(&q->ended);
+        nbd_close_root(&q->ios);
+        os_eventfd_close(q->efd);
+    }
+
+    if (q->bufs != NULL)
+        os_aligned_free(q->bufs);
+
+    if (q->iods != NULL)
+        munmap((void *)q->iods, q->iods_size);
+
+    os_sem_destroy(&q->started);
+}
+
+static int ublk_queue_start(ublk_dev_t *dev, unsigned q_id)
+{
+    ublk_queue_t *q = &dev->queues[q_id];
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t iods_max_size;
+    void *iods;
+    int err;
+
+    memset(q, 0, sizeof(*q));
+    q->dev = dev;
+    q->q_id = q_id;
+    q->ring.fd = -1;
+    q->efd = -1;
+    os_sem_init(&q->started, 0);
+
+    /* The descriptors of the queues are mapped from the character device,
+     * with room for the largest queue depth for each */
+    q->iods_size = ALIGN_SUP(dev->queue_depth * sizeof(struct ublksrv_io_desc),
+                             page_size, size_t);
+    iods_max_size = ALIGN_SUP(UBLK_MAX_QUEUE_DEPTH * sizeof(struct ublksrv_io_desc),
+                              page_size, size_t);
+
+    iods = mmap(NULL, q->iods_size, PROT_READ, MAP_SHARED | MAP_POPULATE,
+                dev->cdev_fd, UBLKSRV_CMD_BUF_OFFSET + q_id * iods_max_size);
+    if (iods == MAP_FAILED)
+    {
+        err = -errno;
+        goto failed;
+    }
+    q->iods = iods;
+
+    q->bufs = os_aligned_malloc((size_t)dev->queue_depth * UBLK_IO_BUF_SIZE,
+                                page_size, NULL);
+    if (q->bufs == NULL)
+    {
+        err = -ENOMEM;
+        goto failed;
+    }
+
+    q->efd = os_eventfd_create();
+    if (q->efd < 0)
+    {
+        err = q->efd;
+        goto failed;
+    }
+
+    if (nbd_init_root(dev->queue_depth, sizeof(ublk_io_t), &q->ios) < 0)
+    {
+        os_eventfd_close(q->efd);
+        q->efd = -1;
+        err = -ENOMEM;
+        goto failed;
+    }
+    nbd_init_list(&q->ios, &q->ended);
+    nbd_list_set_mpsc(&q->ended);
+    nbd_list_set_notify_fd(&q->ended, q->efd);
+
+    /* A fetch per tag, and the read of the eventfd */
+    err = ring_setup(&q->ring, dev->queue_depth + 1, 0);
+    if (err != 0)
+        goto failed;
+
+    if (!exathread_create(&q->thread, 8192, ublk_queue_thread, q))
+    {
+        err = -ENOMEM;
+        goto failed;
+    }
+
+    os_sem_wait(&q->started);
+    dev->nb_started++;
+
+    /* The thread exits at once if it could not fetch the requests */
+    return q->err;
+
+failed:
+    ublk_queue_cleanup(q);
+    return err;
+}
+
+static void ublk_queue_stop(ublk_queue_t *q)
+{
+    os_thread_join(q->thread);
+    ublk_queue_cleanup(q);
+}
+
+static int ublk_cdev_open(int dev_id)
+{
+    char path[64];
+    unsigned waited_ms = 0;
+    int fd;
+
+    os_snprintf(path, sizeof(path), "/dev/ublkc%d", dev_id);
+
+    /* The character device is created by udev */
+    while ((fd = open(path, O_RDWR)) < 0 && errno == ENOENT
+           && waited_ms < UBLK_CDEV_WAIT_MS)
+    {
+        os_millisleep(10);
+        waited_ms += 10;
+    }
+
+    if (fd < 0)
+    {
+        exalog_error("Cannot open '%s': %s (%d)", path, os_strerror(errno),
+                     -errno);
+        return -errno;
+    }
+
+    return fd;
+}
+
+/* Get the device number of the block device of a ublk device */
+static int ublk_bdev_get_devno(int dev_id, int *major, int *minor)
+{
+    char path[64];
+    FILE *file;
+    int ret;
+
+    os_snprintf(path, sizeof(path), "/sys/block/ublkb%d/dev", dev_id);
+
+    file = fopen(path, "r");
+    if (file == NULL)
+        return -errno;
+
+    ret = fscanf(file, "%d:%d", major, minor);
+    fclose(file);
+
+    return ret == 2 ? EXA_SUCCESS : -EINVAL;
+}
+
+/**
+ * Stop and delete a ublk device. The device may be partly set up.
+ */
+static void ublk_dev_destroy(ublk_dev_t *dev)
+{
+    unsigned q_id;
+    int err;
+
+    /* Stopping the device waits for its requests to be committed, then
+     * aborts the fetches, so that the queue threads exit */
+    err = ublk_ctrl_cmd(UBLK_CMD_STOP_DEV, dev->dev_id, 0, NULL, 0);
+    if (err != 0)
+        exalog_error("Cannot stop ublk device %d: %s (%d)", dev->dev_id,
+                     exa_error_msg(err), err);
+
+    for (q_id = 0; q_id < dev->nb_started; q_id++)
+        ublk_queue_stop(&dev->queues[q_id]);
+
+    /* The device is only deleted once its character device is closed */
+    if (dev->cdev_fd >= 0)
+        close(dev->cdev_fd);
+
+    err = ublk_ctrl_cmd(UBLK_CMD_DEL_DEV, dev->dev_id, 0, NULL, 0);
+    if (err != 0)
+        exalog_error("Cannot delete ublk device %d: %s (%d)", dev->dev_id,
+                     exa_error_msg(err), err);
+
+    os_free(dev);
+}
+
+/**
+ * Create and start a ublk device.
+ *
+ * @param[in]  export          Export of the device
+ * @param[in]  size_in_sector  Size of the device
+ * @param[in]  readonly        Whether the device is read only
+ * @param[out] dev             Device created
+ *
+ * @return EXA_SUCCESS or a negative error code
+ */
+static int ublk_dev_create(lum_export_t *export, uint64_t size_in_sector,
+                           bool readonly, ublk_dev_t **dev)
+{
+    struct ublksrv_ctrl_dev_info info;
+    struct ublk_params params;
+    ublk_dev_t *new_dev;
+    unsigned q_id;
+    int err;
+
+    memset(&info, 0, sizeof(info));
+    info.nr_hw_queues     = ublk.nr_queues;
+    info.queue_depth      = ublk.queue_depth;
+    info.max_io_buf_bytes = UBLK_IO_BUF_SIZE;
+    info.dev_id           = -1;
+    info.ublksrv_pid      = getpid();
+
+    err = ublk_ctrl_cmd(UBLK_CMD_ADD_DEV, -1, 0, &info, sizeof(info));
+    if (err != 0)
+    {
+        exalog_error("Cannot add ublk device: %s (%d)", exa_error_msg(err), err);
+        return err;
+    }
+
+    new_dev = os_malloc(sizeof(ublk_dev_t));
+    if (new_dev == NULL)
+    {
+        ublk_ctrl_cmd(UBLK_CMD_DEL_DEV, info.dev_id, 0, NULL, 0);
+        return -ENOMEM;
+    }
+
+    new_dev->export      = export;
+    new_dev->dev_id      = info.dev_id;
+    new_dev->cdev_fd     = -1;
+    new_dev->nr_queues   = info.nr_hw_queues;
+    new_dev->queue_depth = info.queue_depth;
+    new_dev->nb_started  = 0;
+
+    /* The writes are cached by the disks: the kernel sends cache flushes
+     * and emulates FUA with them */
+    memset(&params, 0, sizeof(params));
+    params.len                     = sizeof(params);
+    params.types                   = UBLK_PARAM_TYPE_BASIC;
+    params.basic.attrs             = UBLK_ATTR_VOLATILE_CACHE;
+    if (readonly)
+        params.basic.attrs        |= UBLK_ATTR_READ_ONLY;
+    params.basic.logical_bs_shift  = 9;
+    params.basic.physical_bs_shift = 12;
+    params.basic.io_min_shift      = 9;
+    params.basic.io_opt_shift      = 12;
+    params.basic.max_sectors       = UBLK_IO_BUF_SIZE >> 9;
+    params.basic.dev_sectors       = size_in_sector;
+
+    err = ublk_ctrl_cmd(UBLK_CMD_SET_PARAMS, new_dev->dev_id, 0,
+                        &params, sizeof(params));
+    if (err != 0)
+    {
+        exalog_error("Cannot set the parameters of ublk device %d: %s (%d)",
+                     new_dev->dev_id, exa_error_msg(err), err);
+        goto failed;
+    }
+
+    new_dev->cdev_fd = ublk_cdev_open(new_dev->dev_id);
+    if (new_dev->cdev_fd < 0)
+    {
+        err = new_dev->cdev_fd;
+        goto failed;
+    }
+
+    for (q_id = 0; q_id < new_dev->nr_queues; q_id++)
+    {
+        err = ublk_queue_start(new_dev, q_id);
+        if (err != 0)
+        {
+            exalog_error("Cannot start queue %u of ublk device %d: %s (%d)",
+                         q_id, new_dev->dev_id, exa_error_msg(err), err);
+            goto failed;
+        }
+    }
+
+    /* Returns once all the queues fetched their requests */
+    err = ublk_ctrl_cmd(UBLK_CMD_START_DEV, new_dev->dev_id, getpid(), NULL, 0);
+    if (err != 0)
+    {
+        exalog_error("Cannot start ublk device %d: %s (%d)", new_dev->dev_id,
+                     exa_error_msg(err), err);
+        goto failed;
+    }
+
+    *dev = new_dev;
+
+    return EXA_SUCCESS;
+
+failed:
+    ublk_dev_destroy(new_dev);
+    return err;
+}
+
+static int export_ublk_free_slot(void)
+{
+    int slot;
+
+    for (slot = 0; slot < NBMAX_STARTED_VOLUMES; slot++)
+        if (devs[slot] == NULL)
+            return slot;
+
+    return -1;
+}
+
+static int export_ublk_find_slot(const lum_export_t *export)
+{
+    int slot;
+
+    for (slot = 0; slot < NBMAX_STARTED_VOLUMES; slot++)
+        if (devs[slot] != NULL && devs[slot]->export == export)
+            return slot;
+
+    return -1;
+}
+
+static int adapter_static_init(exa_nodeid_t node_id /* unused */)
+{
+    int err;
+
+    err = os_kmod_load(UBLK_MODULE_NAME);
+    if (err != 0)
+        exalog_error("Failed to load kernel module '%s'", UBLK_MODULE_NAME);
+
+    return err;
+}
+
+static int adapter_static_cleanup(void)
+{
+    /* ublk_drv is not ours, other programs may be using it */
+    return 0;
+}
+
+static int adapter_init(const lum_init_params_t *params)
+{
+    int err;
+
+    ublk_init_done = false;
+
+    ublk.nr_queues = MAX(MIN(params->bdev_threads, BDEV_TARGET_MAX_THREADS), 1);
+    ublk.queue_depth = MAX(MIN(params->bdev_queue_depth, UBLK_MAX_QUEUE_DEPTH), 1);
+
+    ublk.fd = open(UBLK_CONTROL_PATH, O_RDWR);
+    if (ublk.fd < 0)
+    {
+        err = -errno;
+        exalog_error("Cannot open '%s': %s (%d)", UBLK_CONTROL_PATH,
+                     os_strerror(errno), err);
+        return err;
+    }
+
+    err = ring_setup(&ublk.ring, UBLK_CONTROL_ENTRIES, IORING_SETUP_SQE128);
+    if (err != 0)
+    {
+        exalog_error("Cannot set up the ublk control ring: %s (%d)",
+                     exa_error_msg(err), err);
+        close(ublk.fd);
+        return err;
+    }
+
+    os_thread_mutex_init(&ublk.lock);
+
+    ublk_init_done = true;
+
+    return EXA_SUCCESS;
+}
+
+static int adapter_cleanup(void)
+{
+    int slot;
+
+    if (!ublk_init_done)
+        return 0;
+
+    /* Unlike the devices of exa_bd, ublk devices outlive the session */
+    for (slot = 0; slot < NBMAX_STARTED_VOLUMES; slot++)
+        if (devs[slot] != NULL)
+        {
+            ublk_dev_destroy(devs[slot]);
+            devs[slot] = NULL;
+        }
+
+    ring_cleanup(&ublk.ring);
+    close(ublk.fd);
+    os_thread_mutex_destroy(&ublk.lock);
+
+    ublk_init_done = false;
+
+    return 0;
+}
+
+static int adapter_signal_new_export(lum_export_t *lum_export, uint64_t size)
+{
+    export_t *export;
+    ublk_dev_t *dev;
+    int slot, major, minor, err;
+
+    EXA_ASSERT(lum_export != NULL);
+
+    export = lum_export_get_desc(lum_export);
+    EXA_ASSERT(export_get_type(export) == EXPORT_BDEV);
+
+    slot = export_ublk_free_slot();
+    if (slot == -1)
+        return -NBD_ERR_CANT_GET_MINOR;
+
+    err = ublk_dev_create(lum_export, size, export_is_readonly(export), &dev);
+    if (err != EXA_SUCCESS)
+        return err;
+
+    err = ublk_bdev_get_devno(dev->dev_id, &major, &minor);
+    if (err == EXA_SUCCESS)
+        err = bdev_node_create(export_bdev_get_path(export), major, minor);
+
+    if (err != EXA_SUCCESS)
+    {
+        exalog_error("Cannot create the device of ublk device %d: %s (%d)",
+                     dev->dev_id, exa_error_msg(err), err);
+        ublk_dev_destroy(dev);
+        return err;
+    }
+
+    devs[slot] = dev;
+
+    return EXA_SUCCESS;
+}
+
+static int adapter_signal_export_update_iqn_filters(const lum_export_t *lum_export)
+{
+    EXA_ASSERT_VERBOSE(false, "The IQN filters are irrelevant in bdev.");
+
+    return EXA_SUCCESS;
+}
+
+static void adapter_export_set_size(lum_export_t *export, uint64_t size_in_sector)
+{
+    int slot = export_ublk_find_slot(export);
+
+    EXA_ASSERT(slot != -1);
+
+    /* The parameters of a started ublk device cannot be changed */
+    exalog_error("Cannot resize ublk device %d to %"PRIu64" sectors",
+                 devs[slot]->dev_id, size_in_sector);
+}
+
+/**
+ * Test if an export is in use
+ * @param export:   the export to test
+ * return EXPORT_IN_USE if in use EXPORT_NOT_IN_USE else.
+ */
+static lum_export_inuse_t adapter_export_get_inuse(const lum_export_t *export)
+{
+    const char *path = export_bdev_get_path(lum_export_get_desc(export));
+    int fd;
+
+    /* ublk does not tell how many times a device is open: a device is in
+     * use if it is held exclusively (mounted, used by md or dm...) */
+    fd = open(path, O_RDONLY | O_EXCL);
+    if (fd < 0)
+        return errno == EBUSY ? EXPORT_IN_USE : EXPORT_NOT_IN_USE;
+
+    close(fd);
+
+    return EXPORT_NOT_IN_USE;
+}
+
+static int adapter_signal_remove_export(const lum_export_t *export)
+{
+    export_t *desc;
+    int slot;
+
+    EXA_ASSERT(export != NULL);
+
+    if (adapter_export_get_inuse(export) == EXPORT_IN_USE)
+        return -VRT_ERR_VOLUME_IS_IN_USE;
+
+    slot = export_ublk_find_slot(export);
+    if (slot == -1)
+        return -ENOENT;
+
+    ublk_dev_destroy(devs[slot]);
+    devs[slot] = NULL;
+
+    desc = lum_export_get_desc(export);
+
+    return bdev_node_delete(export_bdev_get_path(desc));
+}
+
+static int adapter_set_readahead(const lum_export_t *lum_export, uint32_t readahead)
+{
+    export_t *desc = lum_export_get_desc(lum_export);
+
+    return bdev_node_set_readahead(export_bdev_get_path(desc), readahead);
+}
+
+static void adapter_suspend(void)
+{
+    /* Nothing to do here, for now */
+}
+
+static void adapter_resume(void)
+{
+    /* Nothing to do here, for now */
+}
+
+static target_adapter_t target_adapter =
+{
+    .static_init                      = adapter_static_init,
+    .static_cleanup                   = adapter_static_cleanup,
+    .init                             = adapter_init,
+    .cleanup                          = adapter_cleanup,
+    .signal_new_export                = adapter_signal_new_export,
+    .signal_remove_export             = adapter_signal_remove_export,
+    .signal_export_update_iqn_filters = adapter_signal_export_update_iqn_filters,
+    .export_set_size                  = adapter_export_set_size,
+    .export_get_inuse                 = adapter_export_get_inuse,
+    .set_readahead                    = adapter_set_readahead,
+    .suspend                          = adapter_suspend,
+    .resume                           = adapter_resume,
+    .set_mship                        = NULL,
+    .set_peers                        = NULL,
+    .set_addresses                    = NULL,
+    .start_target                     = NULL,
+    .stop_target                      = NULL
+};
+
+const target_adapter_t * get_bdev_adapter(void)
+{
+    return &target_adapter;
+}
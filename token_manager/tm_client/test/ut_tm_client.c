@@ -10,7 +10,7 @@
 
 #include "token_manager/tm_client/include/tm_client.h"
 #include "token_manager/tm_server/src/token_manager.h" /* for token_manager_data_t */
-#include "token_manager/tm_server/include/tm_server.h" /* for TM_TOKENS_MAX */
+#include "token_manager/tm_server/include/tm_file.h" /* for TM_TOKENS_JOURNAL_SUFFIX */
 #include "token_manager/tm_server/include/token_msg.h"
 
 #include "os/include/os_process.h"
@@ -18,7 +18,9 @@
 #include "os/include/os_thread.h"
 #include "os/include/os_time.h"
 
-#define NUM_TEST_CLUSTERS  TM_TOKENS_MAX
+#include <sys/stat.h>
+
+#define NUM_TEST_CLUSTERS  16
 
 typedef struct
 {
@@ -31,8 +33,10 @@ static token_manager_t *user_tm;
 
 #ifdef WIN32
 static char *test_tokens_file = "C:\\tokens";
+static char *test_journal_file = "C:\\tokens" TM_TOKENS_JOURNAL_SUFFIX;
 #else
 static char *test_tokens_file = "/tmp/tokens";
+static char *test_journal_file = "/tmp/tokens" TM_TOKENS_JOURNAL_SUFFIX;
 #endif
 static token_manager_data_t data;
 static os_thread_t server_thread = 0;
@@ -50,7 +54,10 @@ ut_setup()
 
     os_random_init();
     unlink(test_tokens_file);
+    unlink(test_journal_file);
     data.file = test_tokens_file;
+    /* Two nodes per cluster */
+    data.max_connections = 2 * NUM_TEST_CLUSTERS;
 
     /* We generate two random ports as when two instances of this UT are run at
      * the same time, one can block the other as they try to open the same port.
@@ -110,6 +117,7 @@ ut_cleanup()
     token_manager_thread_stop();
     os_thread_join(server_thread);
     unlink(test_tokens_file);
+    unlink(test_journal_file);
 
     os_random_cleanup();
 }
@@ -265,7 +273,21 @@ ut_test(in_all_clusters_nodes_alternatively_acquire_their_token)
         UT_ASSERT_EQUAL(0, __REQUEST(&clusters[i], 1));
 }
 
-ut_test(when_max_tokens_exceeded_client_is_rejected)
+ut_test(tokens_are_persisted_in_the_journal)
+{
+    struct stat st;
+    int i;
+
+    for (i = 0; i < NUM_TEST_CLUSTERS; i++)
+        UT_ASSERT_EQUAL(0, __REQUEST(&clusters[i], 0));
+
+    /* The first change saves the tokens, the next ones are journaled */
+    UT_ASSERT_EQUAL(0, stat(test_tokens_file, &st));
+    UT_ASSERT_EQUAL(0, stat(test_journal_file, &st));
+    UT_ASSERT(st.st_size > 0);
+}
+
+ut_test(when_max_connections_exceeded_client_is_rejected)
 {
     test_cluster_t one_too_many;
 
@@ -14,18 +14,29 @@
 #include "token_manager/tm_server/src/tm_token.h"
 #include "os/include/os_inttypes.h"
 
+#include <stdio.h>
+
 typedef enum
 {
-    TM_TOKENS_FILE_FORMAT_VERSION_1 = 1
+    TM_TOKENS_FILE_FORMAT_VERSION_1 = 1,
+    TM_TOKENS_FILE_FORMAT_VERSION_2 = 2   /**< Adds the generation */
 } tm_tokens_file_version_t;
 
 #define TM_TOKENS_FILE_MAGIC_NUMBER     0xabdd4456bdef5764
 
-#define TM_TOKENS_FILE_FORMAT_VERSION   TM_TOKENS_FILE_FORMAT_VERSION_1
+#define TM_TOKENS_FILE_FORMAT_VERSION   TM_TOKENS_FILE_FORMAT_VERSION_2
 
 #define TM_TOKENS_FILE_FORMAT_VERSION_IS_VALID(version) \
         ((version) > 0 && (version) <= TM_TOKENS_FILE_FORMAT_VERSION)
 
+/** Suffix appended to the name of a token file to get its journal */
+#define TM_TOKENS_JOURNAL_SUFFIX        ".journal"
+
+#define TM_TOKENS_JOURNAL_MAGIC_NUMBER  0x6a6f75726e616c31
+
+/** Magic number of each journal record */
+#define TM_TOKENS_JOURNAL_RECORD_MAGIC  0x7265636f
+
 /* FIXME Made mandatory that count contains as input the size of the tokens array*/
 /**
  * Load all tokens from a token file.
@@ -33,14 +44,17 @@ typedef enum
  * NOTE: If the file isn't existing, it is considered normal
  * and zero tokens are loaded.
  *
- * @param[in]     filename  File to load the tokens from
- * @param[out]    tokens    Tokens loaded
- * @param[in,out] count     Input: max number of tokens storable in 'tokens',
- *                          output: tokens loaded
+ * @param[in]     filename    File to load the tokens from
+ * @param[out]    tokens      Tokens loaded
+ * @param[in,out] count       Input: max number of tokens storable in 'tokens',
+ *                            output: tokens loaded
+ * @param[out]    generation  Generation of the file, 0 if there is no file
+ *                            or if it has none (version 1)
  *
  * @return 0 if successful, a negative error code otherwise
  */
-int tm_file_load(const char *filename, token_t *tokens, uint64_t *count);
+int tm_file_load(const char *filename, token_t *tokens, uint64_t *count,
+                 uint64_t *generation);
 
 /**
  * Save tokens to a token file.
@@ -51,13 +65,89 @@ int tm_file_load(const char *filename, token_t *tokens, uint64_t *count);
  * NOTE: The directory where the file is saved is created if it
  * doesn't exist.
  *
- * @param[in] filename  File to save the tokens to
- * @param[in] tokens    Tokens to save
- * @param[in] count     Number of tokens
+ * @param[in] filename    File to save the tokens to
+ * @param[in] tokens      Tokens to save
+ * @param[in] count       Number of tokens
+ * @param[in] generation  Generation of the file, which its journal must have
+ *                        to be replayed over it
  *
  * @return 0 if successful, a negative error code otherwise
  */
 int tm_file_save(const char *filename, const token_t *tokens,
-                 uint64_t count);
+                 uint64_t count, uint64_t generation);
+
+/**
+ * Create the journal of a token file, replacing the existing one if any.
+ *
+ * The journal records the changes made to the tokens since the token file
+ * was last saved. It starts empty.
+ *
+ * @param[in]  filename    Token file the journal belongs to
+ * @param[in]  generation  Generation of the token file (0 if there is none)
+ * @param[out] journal     Journal opened for appending
+ *
+ * @return 0 if successful, a negative error code otherwise
+ */
+int tm_file_journal_create(const char *filename, uint64_t generation,
+                           FILE **journal);
+
+/**
+ * Append the state of a token to a journal.
+ *
+ * A token whose holder is EXA_NODEID_NONE has been released. Records are
+ * flushed before returning. After a failure, the journal must not be
+ * appended to anymore as it may end with a partial record.
+ *
+ * @param[in] journal  Journal
+ * @param[in] token    Token to record
+ *
+ * @return 0 if successful, a negative error code otherwise
+ */
+int tm_file_journal_append(FILE *journal, const token_t *token);
+
+/**
+ * Close a journal.
+ *
+ * @param[in] journal  Journal to close
+ *
+ * @return 0 if successful, a negative error code otherwise
+ */
+int tm_file_journal_close(FILE *journal);
+
+/**
+ * Remove the journal of a token file.
+ *
+ * @param[in] filename  Token file the journal belongs to
+ *
+ * @return 0 if successful or if there is no journal, a negative error
+ *         code otherwise
+ */
+int tm_file_journal_remove(const char *filename);
+
+/**
+ * Replay the journal of a token file.
+ *
+ * The records are given in the order they were appended. As each of them is
+ * the whole state of a token, replaying a journal over a token file saved
+ * after some of its records were appended gives the same tokens. A missing
+ * journal is empty, and a partial record at the end of the journal (the
+ * server died while appending it) ends the replay.
+ *
+ * A journal whose generation is not the one of the token file was left
+ * over by a save that died before creating the new journal: its records
+ * are older than the token file and are not replayed.
+ *
+ * @param[in]     filename    Token file the journal belongs to
+ * @param[in,out] generation  Input: generation of the token file, output:
+ *                            generation of the journal if it has a header
+ * @param[in]     apply       Function called for each record
+ * @param[in]     arg         Argument given to apply
+ *
+ * @return the number of records replayed if successful, a negative error
+ *         code otherwise
+ */
+int tm_file_journal_replay(const char *filename, uint64_t *generation,
+                           void (*apply)(const token_t *token, void *arg),
+                           void *arg);
 
 #endif /* TM_FILE_H */
@@ -10,7 +10,7 @@
 #define TOKEN_SERVER_H
 
 /** Maximum number of tokens managed by the Token Manager */
-#define TM_TOKENS_MAX 16
+#define TM_TOKENS_MAX 65536
 
 #endif /* TOKEN_SERVER_H */
 
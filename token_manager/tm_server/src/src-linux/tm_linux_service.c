@@ -16,6 +16,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/resource.h>
 
 #define DEFAULT_TOKEN_FILE  "/tmp/" TOKEN_MANAGER_DEFAULT_TOKEN_FILE
 
@@ -69,6 +70,20 @@ static int install_sighandler(void)
     return r;
 }
 
+/* Each node of a cluster keeps a connection open: allow as many descriptors
+   as the system lets us. Failing is not fatal, connections will just be
+   refused earlier. */
+static void raise_fd_limit(void)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == rl.rlim_max)
+        return;
+
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
 int main(int argc, char *argv[])
 {
     token_manager_data_t data;
@@ -102,6 +117,7 @@ int main(int argc, char *argv[])
     }
 
     data.debug = getenv(TOKEN_MANAGER_DEBUG) != NULL;
+    data.max_connections = 0; /* use default limit */
 
     if (data.logfile != NULL)
     {
@@ -130,6 +146,8 @@ int main(int argc, char *argv[])
     if (install_sighandler() != 0)
         return 1;
 
+    raise_fd_limit();
+
     token_manager_thread(&data);
 
     return data.result;
@@ -135,9 +135,10 @@ static int write_token(FILE *f, const token_t *token)
     return __file_write(f, token, sizeof(*token));
 }
 
-/* As of version 1, tokens file format is :
+/* As of version 2, tokens file format is :
  * TM_TOKENS_FILE_MAGIC_NUMBER
  * TM_TOKENS_FILE_FORMAT_VERSION
+ * generation (not in version 1)
  * num_tokens
  * token[0]
  * token[...]
@@ -147,7 +148,8 @@ static int write_token(FILE *f, const token_t *token)
  * Stuff between the format version and the ending magic number
  * can be changed when incrementing format version.
  */
-int tm_file_load(const char *filename, token_t *tokens, uint64_t *count)
+int tm_file_load(const char *filename, token_t *tokens, uint64_t *count,
+                 uint64_t *generation)
 {
     FILE *f;
     token_t tok;
@@ -158,6 +160,9 @@ int tm_file_load(const char *filename, token_t *tokens, uint64_t *count)
 
     OS_ASSERT(filename != NULL);
     OS_ASSERT(*count > 0);
+    OS_ASSERT(generation != NULL);
+
+    *generation = 0;
 
     /* Open file */
     do
@@ -203,6 +208,17 @@ int tm_file_load(const char *filename, token_t *tokens, uint64_t *count)
         goto out_err_read;
     }
 
+    /* Read the generation */
+    if (file_version >= TM_TOKENS_FILE_FORMAT_VERSION_2)
+    {
+        r = read_number(f, generation);
+        if (r != 1)
+        {
+            result = -errno;
+            goto out_err_read;
+        }
+    }
+
     /* Read number of tokens to load */
     r = read_number(f, &num_tokens_in_file);
     if (r != 1)
@@ -261,7 +277,8 @@ out_err_read:
     return result;
 }
 
-int tm_file_save(const char *filename, const token_t *tokens, uint64_t count)
+int tm_file_save(const char *filename, const token_t *tokens, uint64_t count,
+                 uint64_t generation)
 {
     FILE *f;
     int i, r = 0;
@@ -275,7 +292,7 @@ int tm_file_save(const char *filename, const token_t *tokens, uint64_t count)
     uint64_t non_zero_count;
 
     OS_ASSERT(filename != NULL);
-    OS_ASSERT(tokens != NULL);
+    OS_ASSERT(tokens != NULL || count == 0);
 
     non_zero_count = 0;
     for (i = 0; i < count; i++)
@@ -331,6 +348,13 @@ int tm_file_save(const char *filename, const token_t *tokens, uint64_t count)
         goto out_err_write;
     }
 
+    r = write_number(f, generation);
+    if (r != 1)
+    {
+        write_error = -errno;
+        goto out_err_write;
+    }
+
     r = write_number(f, non_zero_count);
     if (r != 1)
     {
@@ -394,3 +418,206 @@ free_tempfile:
     return r;
 }
 
+/* As of version 2, the journal of a tokens file is :
+ * TM_TOKENS_JOURNAL_MAGIC_NUMBER
+ * TM_TOKENS_FILE_FORMAT_VERSION
+ * generation of the tokens file (not in version 1)
+ * record[0]
+ * record[...]
+ *
+ * The records are appended until the journal is recreated empty, and there
+ * is no end marker: the journal ends with the last complete record.
+ */
+typedef struct
+{
+    uint32_t magic;     /**< TM_TOKENS_JOURNAL_RECORD_MAGIC */
+    uint32_t unused;
+    token_t token;      /**< State of the token */
+} journal_record_t;
+
+/**
+ * Get the path of the journal of a token file.
+ *
+ * @param[in]  filename  The token file
+ * @param[out] path      The journal path, OS_PATH_MAX long
+ *
+ * @return 0 if successful, -ENAMETOOLONG otherwise
+ */
+static int journal_path(const char *filename, char *path)
+{
+    if (os_snprintf(path, OS_PATH_MAX, "%s" TM_TOKENS_JOURNAL_SUFFIX, filename)
+        >= OS_PATH_MAX)
+        return -ENAMETOOLONG;
+
+    return 0;
+}
+
+int tm_file_journal_create(const char *filename, uint64_t generation,
+                           FILE **journal)
+{
+    FILE *f;
+    int r;
+    char path[OS_PATH_MAX];
+    char dirpath[OS_PATH_MAX];
+
+    OS_ASSERT(filename != NULL);
+    OS_ASSERT(journal != NULL);
+
+    r = journal_path(filename, path);
+    if (r != 0)
+        return r;
+
+    os_strlcpy(dirpath, filename, sizeof(dirpath));
+    r = os_dir_create_recursive(os_dirname(dirpath));
+    if (r != 0)
+        return -r;
+
+    do
+        f = fopen(path, "wb");
+    while (f == NULL && errno == EINTR);
+
+    if (f == NULL)
+        return -errno;
+
+    if (write_number(f, TM_TOKENS_JOURNAL_MAGIC_NUMBER) != 1
+        || write_version(f, TM_TOKENS_FILE_FORMAT_VERSION) != 1
+        || write_number(f, generation) != 1
+        || fflush(f) != 0)
+    {
+        r = -errno;
+        fclose(f);
+        return r;
+    }
+
+    *journal = f;
+
+    return 0;
+}
+
+int tm_file_journal_append(FILE *journal, const token_t *token)
+{
+    journal_record_t record;
+
+    OS_ASSERT(journal != NULL);
+    OS_ASSERT(token != NULL);
+
+    memset(&record, 0, sizeof(record));
+    record.magic = TM_TOKENS_JOURNAL_RECORD_MAGIC;
+    memcpy(&record.token, token, sizeof(record.token));
+
+    if (__file_write(journal, &record, sizeof(record)) != 1)
+        return -errno;
+
+    if (fflush(journal) != 0)
+        return -errno;
+
+    return 0;
+}
+
+int tm_file_journal_close(FILE *journal)
+{
+    int r;
+
+    OS_ASSERT(journal != NULL);
+
+    do
+        r = fclose(journal);
+    while (r != 0 && errno == EINTR);
+
+    return r == 0 ? 0 : -errno;
+}
+
+int tm_file_journal_remove(const char *filename)
+{
+    char path[OS_PATH_MAX];
+    int r;
+
+    OS_ASSERT(filename != NULL);
+
+    r = journal_path(filename, path);
+    if (r != 0)
+        return r;
+
+    if (unlink(path) == 0 || errno == ENOENT)
+        return 0;
+
+    return -errno;
+}
+
+int tm_file_journal_replay(const char *filename, uint64_t *generation,
+                           void (*apply)(const token_t *token, void *arg),
+                           void *arg)
+{
+    FILE *f;
+    int r, result;
+    char path[OS_PATH_MAX];
+    uint64_t magic;
+    uint64_t journal_generation = 0;
+    tm_tokens_file_version_t file_version;
+    journal_record_t record;
+
+    OS_ASSERT(filename != NULL);
+    OS_ASSERT(generation != NULL);
+    OS_ASSERT(apply != NULL);
+
+    r = journal_path(filename, path);
+    if (r != 0)
+        return r;
+
+    do
+        f = fopen(path, "rb");
+    while (f == NULL && errno == EINTR);
+
+    /* No journal: nothing changed since the token file was saved */
+    if (f == NULL && errno == ENOENT)
+        return 0;
+
+    if (f == NULL)
+        return -errno;
+
+    /* A journal without a complete header was being created: it is empty */
+    result = 0;
+    if (read_number(f, &magic) != 1)
+        goto out;
+
+    if (magic != TM_TOKENS_JOURNAL_MAGIC_NUMBER)
+    {
+        result = -TM_ERR_WRONG_FILE_MAGIC;
+        goto out;
+    }
+
+    if (read_version(f, &file_version) != 1)
+        goto out;
+
+    if (!TM_TOKENS_FILE_FORMAT_VERSION_IS_VALID(file_version))
+    {
+        result = -TM_ERR_WRONG_FILE_FORMAT_VERSION;
+        goto out;
+    }
+
+    if (file_version >= TM_TOKENS_FILE_FORMAT_VERSION_2
+        && read_number(f, &journal_generation) != 1)
+        goto out;
+
+    /* The token file was saved again after this journal was created, but
+     * the new journal was never created: the records are all stale */
+    if (journal_generation != *generation)
+    {
+        *generation = journal_generation;
+        goto out;
+    }
+
+    while (__file_read(f, &record, sizeof(record)) == 1
+           && record.magic == TM_TOKENS_JOURNAL_RECORD_MAGIC)
+    {
+        apply(&record.token, arg);
+        result++;
+    }
+
+    if (ferror(f))
+        result = -EIO;
+
+out:
+    fclose(f);
+    return result;
+}
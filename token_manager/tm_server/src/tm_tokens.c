@@ -14,6 +14,7 @@
 #include "token_manager/tm_server/src/tm_err.h"
 
 #include "common/include/exa_constants.h"
+#include "common/include/exa_math.h"
 
 #include "os/include/os_assert.h"
 #include "os/include/os_error.h"
@@ -27,9 +28,34 @@
 #include <stdlib.h>
 #include <string.h>  /* for memcpy() */
 
-static token_t tokens[TM_TOKENS_MAX];
+/* Tokens are kept in a hash table with open addressing and linear probing.
+ * A slot whose uuid is zero is free. The table is grown so that it is at
+ * most half full, which keeps probe sequences short: with TM_TOKENS_MAX
+ * tokens, it has 2 * TM_TOKENS_MAX slots. */
+#define TABLE_MIN_SIZE  64
+
+static token_t *table = NULL;   /**< Slots, NULL until a token is added */
+static uint32_t table_size = 0; /**< Number of slots, a power of two */
 static uint64_t num_tokens = 0;
 
+/* The journal receives the changes made since the tokens were last saved.
+ * Once it holds more records than twice the number of tokens (and at least
+ * JOURNAL_MIN_RECORDS), the tokens are saved again and the journal is
+ * emptied, so that its size stays proportional to the number of tokens. */
+#define JOURNAL_MIN_RECORDS  1024
+
+static FILE *journal = NULL;             /**< Open journal, if any */
+static char journal_file[OS_PATH_MAX];   /**< Token file of the journal */
+static uint64_t journal_records = 0;     /**< Records in the journal */
+
+/* Each save of the token file gets a new generation, which its journal
+ * has too: a journal left over by a save that died before creating the new
+ * one has a different generation and is not replayed. Generations only
+ * grow, past the one of a stale journal found when loading too, so that a
+ * stale journal never matches a later token file. No token file is
+ * generation 0. */
+static uint64_t generation = 0;          /**< Last generation given */
+
 static void __reset_token(token_t *token)
 {
     uuid_zero(&token->uuid);
@@ -37,16 +63,76 @@ static void __reset_token(token_t *token)
     os_strlcpy(token->holder_addr, "", sizeof(token->holder_addr));
 }
 
-static void __reset_all(void)
+static uint32_t __hash(const exa_uuid_t *uuid)
+{
+    uint64_t h;
+
+    h = ((uint64_t)uuid->id[0] << 32 | uuid->id[1])
+        ^ ((uint64_t)uuid->id[2] << 32 | uuid->id[3]);
+
+    return (h * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+/**
+ * Find the slot of a token, or the free slot where it would be added.
+ */
+static token_t *__lookup(token_t *slots, uint32_t size, const exa_uuid_t *uuid)
+{
+    uint32_t mask = size - 1;
+    uint32_t i = __hash(uuid) & mask;
+
+    while (!uuid_is_zero(&slots[i].uuid) && !uuid_is_equal(&slots[i].uuid, uuid))
+        i = (i + 1) & mask;
+
+    return &slots[i];
+}
+
+static int __resize(uint32_t size)
 {
-    int i;
+    token_t *slots;
+    uint32_t i;
 
-    for (i = 0; i < TM_TOKENS_MAX; i++)
-        __reset_token(&tokens[i]);
+    slots = os_malloc(size * sizeof(token_t));
+    if (slots == NULL)
+        return -ENOMEM;
 
+    for (i = 0; i < size; i++)
+        __reset_token(&slots[i]);
+
+    for (i = 0; i < table_size; i++)
+        if (!uuid_is_zero(&table[i].uuid))
+            memcpy(__lookup(slots, size, &table[i].uuid), &table[i],
+                   sizeof(token_t));
+
+    if (table != NULL)
+        os_free(table);
+
+    table = slots;
+    table_size = size;
+
+    return 0;
+}
+
+static void __reset_all(void)
+{
+    if (table != NULL)
+        os_free(table);
+
+    table = NULL;
+    table_size = 0;
     num_tokens = 0;
 }
 
+static void __journal_close(void)
+{
+    if (journal == NULL)
+        return;
+
+    tm_file_journal_close(journal);
+    journal = NULL;
+    journal_records = 0;
+}
+
 void tm_tokens_init(void)
 {
     __reset_all();
@@ -54,25 +140,24 @@ void tm_tokens_init(void)
 
 void tm_tokens_cleanup(void)
 {
+    __journal_close();
     __reset_all();
 }
 
 static token_t *__add_token(const exa_uuid_t *uuid)
 {
     token_t *t;
-    int i;
 
-    for (i = 0; i < TM_TOKENS_MAX; i++)
-    {
-        OS_ASSERT(!uuid_is_equal(&tokens[i].uuid, uuid));
-        if (uuid_is_zero(&tokens[i].uuid))
-            break;
-    }
+    if (num_tokens >= TM_TOKENS_MAX)
+        return NULL;
 
-    if (i >= TM_TOKENS_MAX)
+    if ((num_tokens + 1) * 2 > table_size
+        && __resize(table_size == 0 ? TABLE_MIN_SIZE : table_size * 2) != 0)
         return NULL;
 
-    t = &tokens[i];
+    t = __lookup(table, table_size, uuid);
+    OS_ASSERT(uuid_is_zero(&t->uuid));
+
     uuid_copy(&t->uuid, uuid);
     t->holder = EXA_NODEID_NONE;
     os_strlcpy(t->holder_addr, "", sizeof(t->holder_addr));
@@ -84,13 +169,48 @@ static token_t *__add_token(const exa_uuid_t *uuid)
 
 static token_t *__find_token(const exa_uuid_t *uuid)
 {
-    int i;
+    token_t *t;
+
+    if (table == NULL)
+        return NULL;
+
+    t = __lookup(table, table_size, uuid);
+
+    return uuid_is_zero(&t->uuid) ? NULL : t;
+}
+
+/**
+ * Remove a token from the table.
+ *
+ * The tokens following it in its probe sequence are shifted back so that
+ * no lookup goes through a free slot before reaching its token.
+ */
+static void __remove_token(token_t *t)
+{
+    uint32_t mask = table_size - 1;
+    uint32_t hole = t - table;
+    uint32_t i = hole;
+
+    while (true)
+    {
+        uint32_t home;
 
-    for (i = 0; i < TM_TOKENS_MAX; i++)
-        if (uuid_is_equal(&tokens[i].uuid, uuid))
-            return &tokens[i];
+        i = (i + 1) & mask;
+        if (uuid_is_zero(&table[i].uuid))
+            break;
+
+        /* The token can fill the hole unless its home slot lies between
+           the hole and itself */
+        home = __hash(&table[i].uuid) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            memcpy(&table[hole], &table[i], sizeof(token_t));
+            hole = i;
+        }
+    }
 
-    return NULL;
+    __reset_token(&table[hole]);
+    num_tokens--;
 }
 
 int tm_tokens_set_holder(const exa_uuid_t *uuid, exa_nodeid_t node_id,
@@ -105,9 +225,12 @@ int tm_tokens_set_holder(const exa_uuid_t *uuid, exa_nodeid_t node_id,
     t = __find_token(uuid);
     if (t == NULL)
     {
+        if (num_tokens >= TM_TOKENS_MAX)
+            return -TM_ERR_TOO_MANY_TOKENS;
+
         t = __add_token(uuid);
         if (t == NULL)
-            return -TM_ERR_TOO_MANY_TOKENS;
+            return -ENOMEM;
     }
 
     if (t->holder != EXA_NODEID_NONE && t->holder != node_id)
@@ -147,8 +270,7 @@ int tm_tokens_release(const exa_uuid_t *uuid, exa_nodeid_t node_id)
     if (t->holder != node_id)
         return -TM_ERR_NOT_HOLDER;
 
-    __reset_token(t);
-    num_tokens--;
+    __remove_token(t);
 
     return 0;
 }
@@ -161,10 +283,7 @@ void tm_tokens_force_release(const exa_uuid_t *uuid)
 
     t = __find_token(uuid);
     if (t != NULL)
-    {
-        __reset_token(t);
-        num_tokens--;
-    }
+        __remove_token(t);
 }
 
 uint64_t tm_tokens_count(void)
@@ -172,20 +291,159 @@ uint64_t tm_tokens_count(void)
     return num_tokens;
 }
 
+void tm_tokens_for_each(void (*fn)(const token_t *token, void *arg), void *arg)
+{
+    uint32_t i;
+
+    OS_ASSERT(fn != NULL);
+
+    for (i = 0; i < table_size; i++)
+        if (!uuid_is_zero(&table[i].uuid))
+            fn(&table[i], arg);
+}
+
+/**
+ * Set the state of a token as loaded from a token file or its journal.
+ *
+ * @param[in]     token  State of the token, released if it has no holder
+ * @param[in,out] arg    Error (int), set upon failure
+ */
+static void __apply(const token_t *token, void *arg)
+{
+    int *err = arg;
+    token_t *t;
+
+    if (*err != 0 || uuid_is_zero(&token->uuid))
+        return;
+
+    t = __find_token(&token->uuid);
+
+    if (token->holder == EXA_NODEID_NONE)
+    {
+        if (t != NULL)
+            __remove_token(t);
+        return;
+    }
+
+    if (t == NULL)
+    {
+        if (num_tokens >= TM_TOKENS_MAX)
+        {
+            *err = -TM_ERR_TOO_MANY_TOKENS;
+            return;
+        }
+
+        t = __add_token(&token->uuid);
+        if (t == NULL)
+        {
+            *err = -ENOMEM;
+            return;
+        }
+    }
+
+    t->holder = token->holder;
+    os_strlcpy(t->holder_addr, token->holder_addr, sizeof(t->holder_addr));
+}
+
 int tm_tokens_load(const char *filename)
 {
-    uint64_t n = TM_TOKENS_MAX;
+    token_t *loaded;
+    uint64_t i, n = TM_TOKENS_MAX;
+    uint64_t file_generation, journal_generation;
+    int err;
+
+    /* The journal, if any, doesn't match the tokens anymore */
+    __journal_close();
+    __reset_all();
+
+    loaded = os_malloc(TM_TOKENS_MAX * sizeof(token_t));
+    if (loaded == NULL)
+        return -ENOMEM;
+
+    err = tm_file_load(filename, loaded, &n, &file_generation);
+    for (i = 0; err == 0 && i < n; i++)
+        __apply(&loaded[i], &err);
+
+    os_free(loaded);
+
+    if (err == 0)
+    {
+        int r;
+
+        journal_generation = file_generation;
+        r = tm_file_journal_replay(filename, &journal_generation, __apply, &err);
+        if (r < 0 && err == 0)
+            err = r;
+
+        generation = MAX(generation, MAX(file_generation, journal_generation));
+    }
+
+    if (err != 0)
+        __reset_all();
+
+    return err;
+}
+
+int tm_tokens_save(const char *filename)
+{
+    uint64_t file_generation;
     int err;
 
-    err = tm_file_load(filename, tokens, &n);
+    __journal_close();
+
+    /* Without tokens, the file is removed */
+    file_generation = num_tokens > 0 ? ++generation : 0;
+
+    err = tm_file_save(filename, table, table_size, file_generation);
     if (err != 0)
         return err;
 
-    num_tokens = n;
+    err = tm_file_journal_create(filename, file_generation, &journal);
+    if (err != 0)
+    {
+        /* The tokens are saved, only the journal must not be replayed over
+           them. Changes will be persisted by saving all tokens until a
+           journal can be created. */
+        journal = NULL;
+        return tm_file_journal_remove(filename);
+    }
+
+    os_strlcpy(journal_file, filename, sizeof(journal_file));
+
     return 0;
 }
 
-int tm_tokens_save(const char *filename)
+int tm_tokens_persist(const char *filename, const exa_uuid_t *uuid)
 {
-    return tm_file_save(filename, tokens, TM_TOKENS_MAX);
+    token_t released;
+    const token_t *t;
+    int err;
+
+    OS_ASSERT(filename != NULL);
+    OS_ASSERT(uuid != NULL && !uuid_is_zero(uuid));
+
+    if (journal == NULL || strcmp(journal_file, filename) != 0
+        || journal_records >= MAX(JOURNAL_MIN_RECORDS, 2 * num_tokens))
+        return tm_tokens_save(filename);
+
+    t = __find_token(uuid);
+    if (t == NULL)
+    {
+        __reset_token(&released);
+        uuid_copy(&released.uuid, uuid);
+        t = &released;
+    }
+
+    err = tm_file_journal_append(journal, t);
+    if (err != 0)
+    {
+        /* The journal may end with a partial record, which would hide any
+           record appended after it: the next change saves all tokens */
+        __journal_close();
+        return err;
+    }
+
+    journal_records++;
+
+    return 0;
 }
@@ -9,6 +9,8 @@
 #ifndef TM_TOKENS_H
 #define TM_TOKENS_H
 
+#include "token_manager/tm_server/src/tm_token.h"
+
 #include "common/include/exa_nodeset.h"
 #include "common/include/uuid.h"
 
@@ -82,9 +84,22 @@ void tm_tokens_force_release(const exa_uuid_t *uuid);
  */
 uint64_t tm_tokens_count(void);
 
+/**
+ * Call a function on each token.
+ *
+ * The tokens are in no particular order and must not be changed by fn.
+ *
+ * @param[in] fn   Function to call
+ * @param[in] arg  Argument given to fn
+ */
+void tm_tokens_for_each(void (*fn)(const token_t *token, void *arg), void *arg);
+
 /**
  * Load all tokens.
  *
+ * The tokens are read from the file, then the changes recorded in its
+ * journal are replayed.
+ *
  * NOTE: If the file isn't existing, it is considered normal
  * and zero tokens are loaded.
  *
@@ -97,6 +112,9 @@ int tm_tokens_load(const char *filename);
 /**
  * Save all tokens.
  *
+ * The journal of the file is emptied, and changes can then be persisted
+ * in it with tm_tokens_persist().
+ *
  * NOTE: If there are zero tokens to save, the file is unlinked
  * instead of being written empty.
  *
@@ -109,4 +127,18 @@ int tm_tokens_load(const char *filename);
  */
 int tm_tokens_save(const char *filename);
 
+/**
+ * Persist the change of a token.
+ *
+ * The state of the token is appended to the journal of the file, unless
+ * the journal has grown large compared to the number of tokens, in which
+ * case all tokens are saved and the journal is emptied.
+ *
+ * @param[in] filename  File the tokens are saved to
+ * @param[in] uuid      UUID of the token that changed
+ *
+ * @return 0 if successful, a negative error code otherwise
+ */
+int tm_tokens_persist(const char *filename, const exa_uuid_t *uuid);
+
 #endif /* TM_TOKENS_H */
@@ -23,22 +23,29 @@
 #include "os/include/os_inttypes.h"
 #include "os/include/os_mem.h"
 #include "os/include/os_network.h"
+#include "os/include/os_poll.h"
 #include "os/include/os_time.h"
 #include "os/include/os_string.h"
 
 #include <stdarg.h>
 
-/* Max number of connections. (One token per cluster and we assume 2-node
-   clusters hence 2 connections per token.) */
-#define MAX_NORMAL_CONNECTIONS (TM_TOKENS_MAX * 2)
-
-/* The +1 is for the privileged socket */
-#define MAX_TOTAL_CONNECTIONS (MAX_NORMAL_CONNECTIONS + 1)
+/* Default max number of regular connections. (One token per cluster and we
+   assume 2-node clusters hence 2 connections per token.) */
+#define DEFAULT_MAX_CONNECTIONS  (TM_TOKENS_MAX * 2)
 
 #define CONNECTION_NONE          -1
 #define PRIVILEGED_CONNECTION    0
 #define FIRST_NORMAL_CONNECTION  1
 
+/* Keys of the sockets watched for events. The key of a connection is its
+   id offset by POLL_KEY_FIRST_CONNECTION. */
+#define POLL_KEY_LISTEN            0
+#define POLL_KEY_LISTEN_PRIV       1
+#define POLL_KEY_FIRST_CONNECTION  2
+
+/** Max number of events handled per wait */
+#define POLL_MAX_EVENTS  64
+
 /** Whether to keep running */
 static bool tm_server_run = true;
 
@@ -49,11 +56,18 @@ typedef struct
 {
     int sock;
     os_net_addr_str_t ip_addr;
+    int next_free;                   /**< Next free connection id */
 } connect_info_t;
 
-static fd_set setSocks;                         /**< Set of connected clients */
-static connect_info_t connectlist[MAX_TOTAL_CONNECTIONS];  /**< Connected
-                                                             * client info */
+static os_poll_t *poll_set = NULL;          /**< Watched sockets */
+
+/* Connected client info, indexed by connection id. The array is grown as
+   clients connect and the ids of closed connections are reused. */
+static connect_info_t *connectlist = NULL;
+static int connectlist_size = 0;            /**< Number of connection ids */
+static int first_free = CONNECTION_NONE;    /**< First free normal id */
+static int num_connections = 0;             /**< Open normal connections */
+static int max_connections;                 /**< Max normal connections */
 
 /** File where tokens are persisted */
 static char tokens_file[OS_PATH_MAX];
@@ -209,6 +223,39 @@ static int create_listen_socket(uint16_t port, bool local)
     return sd;
 }
 
+/**
+ * Double the number of connection ids.
+ *
+ * @return 0 if successful, -ENOMEM otherwise
+ */
+static int grow_connectlist(void)
+{
+    connect_info_t *list;
+    int size = connectlist_size * 2;
+    int i;
+
+    list = os_malloc(size * sizeof(connect_info_t));
+    if (list == NULL)
+        return -ENOMEM;
+
+    memcpy(list, connectlist, connectlist_size * sizeof(connect_info_t));
+
+    /* Chain the new ids before the free ones, lowest first */
+    for (i = size - 1; i >= connectlist_size; i--)
+    {
+        list[i].sock = CONNECTION_NONE;
+        os_strlcpy(list[i].ip_addr, "", sizeof(list[i].ip_addr));
+        list[i].next_free = first_free;
+        first_free = i;
+    }
+
+    os_free(connectlist);
+    connectlist = list;
+    connectlist_size = size;
+
+    return 0;
+}
+
 /**
  * Add a socket connection to global connection array
  *
@@ -220,34 +267,47 @@ static int create_listen_socket(uint16_t port, bool local)
  */
 static int add_connection(int sock, const os_net_addr_str_t ip_addr, bool priv)
 {
-    int i;
+    int conn_id;
+    int err;
 
-    if (!priv)
+    if (priv)
     {
-        /* Search free slot in connection array */
-        for (i = FIRST_NORMAL_CONNECTION; i <= MAX_NORMAL_CONNECTIONS; i++)
-            if (connectlist[i].sock == CONNECTION_NONE)
-            {
-                connectlist[i].sock = sock;
-                os_strlcpy(connectlist[i].ip_addr, ip_addr,
-                           sizeof(connectlist[i].ip_addr));
-                FD_SET(sock, &setSocks);
-                return i;
-            }
+        if (connectlist[PRIVILEGED_CONNECTION].sock != CONNECTION_NONE)
+            return -ENOMEM;
+
+        conn_id = PRIVILEGED_CONNECTION;
     }
     else
     {
-        if (connectlist[PRIVILEGED_CONNECTION].sock == CONNECTION_NONE)
-        {
-            connectlist[PRIVILEGED_CONNECTION].sock = sock;
-            os_strlcpy(connectlist[PRIVILEGED_CONNECTION].ip_addr, ip_addr,
-                       sizeof(connectlist[PRIVILEGED_CONNECTION].ip_addr));
-            FD_SET(sock, &setSocks);
-            return PRIVILEGED_CONNECTION;
-        }
+        if (num_connections >= max_connections)
+            return -ENOMEM;
+
+        if (first_free == CONNECTION_NONE && grow_connectlist() != 0)
+            return -ENOMEM;
+
+        conn_id = first_free;
     }
 
-    return -ENOMEM;
+    err = os_poll_add(poll_set, sock, OS_POLL_IN,
+                      conn_id + POLL_KEY_FIRST_CONNECTION);
+    if (err != 0)
+    {
+        __error("Failed watching socket %d: %s (%d)", sock,
+                os_strerror(-err), err);
+        return -ENOMEM;
+    }
+
+    if (!priv)
+    {
+        first_free = connectlist[conn_id].next_free;
+        num_connections++;
+    }
+
+    connectlist[conn_id].sock = sock;
+    os_strlcpy(connectlist[conn_id].ip_addr, ip_addr,
+               sizeof(connectlist[conn_id].ip_addr));
+
+    return conn_id;
 }
 
 /**
@@ -258,11 +318,18 @@ static int add_connection(int sock, const os_net_addr_str_t ip_addr, bool priv)
  */
 static void close_connection(int conn_id)
 {
-    FD_CLR(connectlist[conn_id].sock, &setSocks);
+    os_poll_remove(poll_set, connectlist[conn_id].sock);
     __close_socket(connectlist[conn_id].sock);
     connectlist[conn_id].sock = CONNECTION_NONE;
     os_strlcpy(connectlist[conn_id].ip_addr, "",
                sizeof(connectlist[conn_id].ip_addr));
+
+    if (conn_id != PRIVILEGED_CONNECTION)
+    {
+        connectlist[conn_id].next_free = first_free;
+        first_free = conn_id;
+        num_connections--;
+    }
 }
 
 /**
@@ -483,7 +550,7 @@ static int process_request(int conn_id, const token_request_msg_t *request,
         return 0;
     }
 
-    err = tm_tokens_save(tokens_file);
+    err = tm_tokens_persist(tokens_file, &uuid);
     if (err < 0)
     {
         __error("Failed saving tokens to '%s': %s (%d)", tokens_file,
@@ -599,26 +666,28 @@ failed:
 
 static void check_tcp_connection(void)
 {
-    static struct timeval timeout = { .tv_sec = 5, .tv_usec = 0 };
-    fd_set sock_set = setSocks;
-    int conn_id;
+    os_poll_event_t events[POLL_MAX_EVENTS];
+    int i, n;
 
-    if (os_select(FD_SETSIZE, &sock_set, NULL,  NULL, &timeout) <= 0)
-        return;
+    n = os_poll_wait(poll_set, events, POLL_MAX_EVENTS, 5000);
 
-    /* Check working sockets */
-    for (conn_id = 0; conn_id < MAX_TOTAL_CONNECTIONS; ++conn_id)
+    for (i = 0; i < n; i++)
     {
-        int sock = connectlist[conn_id].sock;
-        if (sock >= 0 && FD_ISSET(sock, &sock_set))
-            handle_request(conn_id);
-    }
+        switch (events[i].key)
+        {
+        case POLL_KEY_LISTEN:
+            accept_new_client(listen_socket, false);
+            break;
 
-    if (FD_ISSET(listen_socket, &sock_set))
-        accept_new_client(listen_socket, false);
+        case POLL_KEY_LISTEN_PRIV:
+            accept_new_client(listen_priv_socket, true);
+            break;
 
-    if (FD_ISSET(listen_priv_socket, &sock_set))
-        accept_new_client(listen_priv_socket, true);
+        default:
+            handle_request(events[i].key - POLL_KEY_FIRST_CONNECTION);
+            break;
+        }
+    }
 }
 
 void token_manager_thread_stop(void)
@@ -659,12 +728,29 @@ void token_manager_thread(void *data)
         return;
     }
 
-    for (i = 0; i < MAX_TOTAL_CONNECTIONS; i++)
+    max_connections = res->max_connections > 0 ? res->max_connections
+                                                : DEFAULT_MAX_CONNECTIONS;
+
+    /* The privileged connection and the first normal one */
+    connectlist = os_malloc(2 * sizeof(connect_info_t));
+    poll_set = os_poll_create();
+    if (connectlist == NULL || poll_set == NULL)
+    {
+        __error("Failed allocating connections");
+        res->result = 1;
+        goto done;
+    }
+
+    for (i = 0; i < 2; i++)
     {
         connectlist[i].sock = CONNECTION_NONE;
         os_strlcpy(connectlist[i].ip_addr, "",
                    sizeof(connectlist[i].ip_addr));
+        connectlist[i].next_free = CONNECTION_NONE;
     }
+    connectlist_size = 2;
+    first_free = FIRST_NORMAL_CONNECTION;
+    num_connections = 0;
 
     listen_socket = create_listen_socket(port, false);
     if (listen_socket < 0)
@@ -680,9 +766,14 @@ void token_manager_thread(void *data)
         goto done;
     }
 
-    FD_ZERO(&setSocks);
-    FD_SET(listen_socket, &setSocks);
-    FD_SET(listen_priv_socket, &setSocks);
+    if (os_poll_add(poll_set, listen_socket, OS_POLL_IN, POLL_KEY_LISTEN) != 0
+        || os_poll_add(poll_set, listen_priv_socket, OS_POLL_IN,
+                       POLL_KEY_LISTEN_PRIV) != 0)
+    {
+        __error("Failed watching listen sockets");
+        res->result = 1;
+        goto done;
+    }
 
     tm_tokens_init();
 
@@ -708,14 +799,23 @@ done:
 
     if (listen_socket >= 0)
         __close_socket(listen_socket);
+    listen_socket = -1;
 
     if (listen_priv_socket >= 0)
         __close_socket(listen_priv_socket);
+    listen_priv_socket = -1;
 
-    for (i = 0; i < MAX_TOTAL_CONNECTIONS; i++)
+    for (i = 0; i < connectlist_size; i++)
         if (connectlist[i].sock != CONNECTION_NONE)
             close_connection(i);
 
+    if (connectlist != NULL)
+        os_free(connectlist);
+    connectlist_size = 0;
+
+    os_poll_delete(poll_set);
+    poll_set = NULL;
+
     os_net_cleanup();
 
     token_manager_close_log();
@@ -28,6 +28,8 @@ typedef struct
     const char *logfile;  /**< Log file */
     uint16_t port;        /**< Port for clients */
     uint16_t priv_port;   /**< Privileged port (for administration) */
+    int max_connections;  /**< Max number of regular clients, 0 for the
+                               default (two per token) */
     bool debug;           /**< Whether debugging is enabled */
     int result;           /**< Result (exit code) of the Token Manager */
 } token_manager_data_t;
@@ -53,15 +53,16 @@ ut_test(saving_and_reading_no_tokens)
 {
     struct stat st;
     uint64_t count;
+    uint64_t generation;
 
-    UT_ASSERT_EQUAL(0, tm_file_save(TOKEN_FILE, tokens, 0));
+    UT_ASSERT_EQUAL(0, tm_file_save(TOKEN_FILE, tokens, 0, 1));
 
     /* Check file is gone */
     UT_ASSERT_EQUAL(-1, stat(TOKEN_FILE, &st));
     UT_ASSERT_EQUAL(ENOENT, errno);
 
     count = N_TOKENS;
-    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens, &count));
+    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens, &count, &generation));
     UT_ASSERT_EQUAL(0, count);
 }
 
@@ -69,20 +70,22 @@ ut_test(saving_and_reading_one_token)
 {
     token_t tokens2[N_TOKENS];
     uint64_t count;
+    uint64_t generation;
     struct stat st;
 
     UT_ASSERT(uuid_scan(TOKEN_UUID, &tokens[0].uuid) == 0);
     tokens[0].holder = NODE_1;
 
-    UT_ASSERT_EQUAL(0, tm_file_save(TOKEN_FILE, tokens, N_TOKENS));
+    UT_ASSERT_EQUAL(0, tm_file_save(TOKEN_FILE, tokens, N_TOKENS, 7));
 
     /* Check file is non-empty */
     UT_ASSERT_EQUAL(0, stat(TOKEN_FILE, &st));
     UT_ASSERT(st.st_size > 0);
 
     count = N_TOKENS;
-    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens2, &count));
+    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens2, &count, &generation));
     UT_ASSERT_EQUAL(1, count);
+    UT_ASSERT_EQUAL(7, generation);
 
     UT_ASSERT(uuid_is_equal(&tokens2[0].uuid, &tokens[0].uuid));
     UT_ASSERT(tokens2[0].holder == NODE_1);
@@ -91,12 +94,14 @@ ut_test(saving_and_reading_one_token)
 ut_test(reading_from_unexisting_file_reads_zero_tokens)
 {
     uint64_t count;
+    uint64_t generation;
 
     unlink(UNEXISTING_FILE);
 
     count = N_TOKENS;
-    UT_ASSERT_EQUAL(0, tm_file_load(UNEXISTING_FILE, tokens, &count));
+    UT_ASSERT_EQUAL(0, tm_file_load(UNEXISTING_FILE, tokens, &count, &generation));
     UT_ASSERT_EQUAL(0, count);
+    UT_ASSERT_EQUAL(0, generation);
 }
 
 ut_test(saving_to_unexisting_path_creates_path_and_succeeds)
@@ -112,6 +117,7 @@ ut_test(saving_to_unexisting_path_creates_path_and_succeeds)
 
     token_t tokens2[N_TOKENS];
     uint64_t count;
+    uint64_t generation;
 
     UT_ASSERT(uuid_scan(TOKEN_UUID, &tokens[0].uuid) == 0);
     tokens[0].holder = NODE_1;
@@ -119,17 +125,19 @@ ut_test(saving_to_unexisting_path_creates_path_and_succeeds)
     /* Ensure the path does not exist by deleting the whole tree */
     UT_ASSERT_EQUAL(0, os_dir_remove_tree(UNEXISTENT_ROOT));
 
-    UT_ASSERT_EQUAL(0, tm_file_save(UNEXISTENT_PATH, tokens, N_TOKENS));
+    UT_ASSERT_EQUAL(0, tm_file_save(UNEXISTENT_PATH, tokens, N_TOKENS, 1));
 
     /* Check the file was saved indeed */
     count = N_TOKENS;
-    UT_ASSERT_EQUAL(0, tm_file_load(UNEXISTENT_PATH, tokens2, &count));
+    UT_ASSERT_EQUAL(0, tm_file_load(UNEXISTENT_PATH, tokens2, &count, &generation));
 
     os_dir_remove_tree(UNEXISTENT_ROOT);
 }
 
 /* This function writes a broken token file consisting of:
  *   - start_magic
+ *   - file_version
+ *   - generation (for version 2)
  *   - tok_num
  *   - (zero tokens, even if tok_num != 0)
  *   - end_magic
@@ -160,6 +168,19 @@ static int break_file(const char *filename, uint64_t start_magic,
         return r;
     }
 
+    if (file_version == TM_TOKENS_FILE_FORMAT_VERSION_2)
+    {
+        uint64_t generation = 1;
+
+        r = fwrite(&generation, sizeof(generation), 1, f);
+        if (r != 1)
+        {
+            r = -errno;
+            fclose(f);
+            return r;
+        }
+    }
+
     r = fwrite(&tok_num, sizeof(tok_num), 1, f);
     if (r != 1)
     {
@@ -187,6 +208,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 {
     uint64_t wrong_magic = 0x1234123412341234;
     uint64_t count;
+    uint64_t generation;
 
     /* Manually write a good file */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -196,7 +218,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
                                   TM_TOKENS_FILE_MAGIC_NUMBER));
 
     count = N_TOKENS;
-    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens, &count));
+    UT_ASSERT_EQUAL(0, tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 
     /* Manually write a file with broken start magic */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -207,7 +229,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 
     count = N_TOKENS;
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_MAGIC,
-                    tm_file_load(TOKEN_FILE, tokens, &count));
+                    tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 
     /* Manually write a file with broken end magic */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -218,7 +240,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 
     count = N_TOKENS;
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_MAGIC,
-                    tm_file_load(TOKEN_FILE, tokens, &count));
+                    tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 
     /* Manually write a file with wrong token count */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -229,7 +251,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 
     count = N_TOKENS;
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_TOKENS_NUMBER,
-                    tm_file_load(TOKEN_FILE, tokens, &count));
+                    tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 
     /* Manually write a file with negative version */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -240,7 +262,7 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 
     count = N_TOKENS;
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_FORMAT_VERSION,
-                    tm_file_load(TOKEN_FILE, tokens, &count));
+                    tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 
     /* Manually write a file with a too big version */
     UT_ASSERT_EQUAL(0, break_file(TOKEN_FILE,
@@ -251,5 +273,5 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
 
     count = N_TOKENS;
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_FORMAT_VERSION,
-                    tm_file_load(TOKEN_FILE, tokens, &count));
+                    tm_file_load(TOKEN_FILE, tokens, &count, &generation));
 }
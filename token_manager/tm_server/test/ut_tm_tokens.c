@@ -21,6 +21,7 @@
 #include "os/include/os_file.h"
 
 #include <sys/stat.h>
+#include <unistd.h>
 
 #define TOKEN_UUID  "12345678:12345678:12345678:12345678"
 
@@ -120,6 +121,37 @@ ut_test(setting_too_many_tokens_returns_TOO_MANY_TOKENS)
     UT_ASSERT_EQUAL(TM_TOKENS_MAX, tm_tokens_count());
 }
 
+ut_test(released_tokens_dont_hide_other_tokens)
+{
+    exa_uuid_t uuids[1000];
+    exa_nodeid_t holders[1000];
+    exa_nodeid_t holder_id;
+    int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        os_get_random_bytes(&uuids[i], sizeof(uuids[i]));
+        holders[i] = i % 2 ? NODE_1 : NODE_2;
+        UT_ASSERT_EQUAL(0, __set_holder(&uuids[i], holders[i]));
+    }
+
+    /* Release every third token */
+    for (i = 0; i < 1000; i += 3)
+        UT_ASSERT_EQUAL(0, tm_tokens_release(&uuids[i], holders[i]));
+
+    for (i = 0; i < 1000; i++)
+        if (i % 3 == 0)
+            UT_ASSERT_EQUAL(-TM_ERR_NO_SUCH_TOKEN,
+                            tm_tokens_get_holder(&uuids[i], &holder_id));
+        else
+        {
+            UT_ASSERT_EQUAL(0, tm_tokens_get_holder(&uuids[i], &holder_id));
+            UT_ASSERT_EQUAL(holders[i], holder_id);
+        }
+
+    UT_ASSERT_EQUAL(1000 - 334, tm_tokens_count());
+}
+
 UT_SECTION(getting)
 
 ut_setup()
@@ -209,6 +241,7 @@ ut_test(force_releasing_token_always_succeeds)
 UT_SECTION(saving_and_loading)
 
 #define TOKEN_FILE  "__tokens__"
+#define JOURNAL_FILE  TOKEN_FILE TM_TOKENS_JOURNAL_SUFFIX
 #define UNEXISTING_FILE  "__not_there__"
 
 ut_setup()
@@ -217,13 +250,16 @@ ut_setup()
     tm_tokens_init();
 
     unlink(TOKEN_FILE);
+    unlink(JOURNAL_FILE);
 }
 
 ut_cleanup()
 {
+    tm_tokens_cleanup();
+
     unlink(TOKEN_FILE);
+    unlink(JOURNAL_FILE);
 
-    tm_tokens_cleanup();
     os_random_cleanup();
 }
 
@@ -302,6 +338,8 @@ ut_test(saving_to_unexisting_path_creates_path_and_succeeds)
 
 /* This function writes a broken token file consisting of:
  * start_magic
+ * file_version
+ * generation (for version 2)
  * tok_num
  * (zero tokens, even if tok_num != 0)
  * end_magic
@@ -332,6 +370,19 @@ static int break_file(const char *filename, uint64_t start_magic,
         return r;
     }
 
+    if (file_version == TM_TOKENS_FILE_FORMAT_VERSION_2)
+    {
+        uint64_t generation = 1;
+
+        r = fwrite(&generation, sizeof(generation), 1, f);
+        if (r != 1)
+        {
+            r = -errno;
+            fclose(f);
+            return r;
+        }
+    }
+
     r = fwrite(&tok_num, sizeof(tok_num), 1, f);
     if (r != 1)
     {
@@ -410,3 +461,150 @@ ut_test(saving_with_wrong_contents_makes_reading_fail)
     UT_ASSERT_EQUAL(-TM_ERR_WRONG_FILE_FORMAT_VERSION, tm_tokens_load(TOKEN_FILE));
     UT_ASSERT_EQUAL(0, tm_tokens_count());
 }
+
+ut_test(persisted_changes_are_replayed_on_load)
+{
+    exa_uuid_t uuids[3];
+    exa_nodeid_t holder_id;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        os_get_random_bytes(&uuids[i], sizeof(uuids[i]));
+        UT_ASSERT_EQUAL(0, __set_holder(&uuids[i], NODE_1));
+        UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuids[i]));
+    }
+
+    UT_ASSERT_EQUAL(0, tm_tokens_release(&uuids[1], NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuids[1]));
+
+    tm_tokens_cleanup();
+
+    UT_ASSERT_EQUAL(0, tm_tokens_load(TOKEN_FILE));
+    UT_ASSERT_EQUAL(2, tm_tokens_count());
+    UT_ASSERT(tm_tokens_get_holder(&uuids[0], &holder_id) == 0 && holder_id == NODE_1);
+    UT_ASSERT_EQUAL(-TM_ERR_NO_SUCH_TOKEN, tm_tokens_get_holder(&uuids[1], &holder_id));
+    UT_ASSERT(tm_tokens_get_holder(&uuids[2], &holder_id) == 0 && holder_id == NODE_1);
+}
+
+ut_test(saving_empties_the_journal)
+{
+    exa_uuid_t uuid;
+    struct stat before, after;
+
+    UT_ASSERT(uuid_scan(TOKEN_UUID, &uuid) == 0);
+
+    UT_ASSERT_EQUAL(0, tm_tokens_save(TOKEN_FILE));
+    UT_ASSERT_EQUAL(0, stat(JOURNAL_FILE, &before));
+
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+    UT_ASSERT_EQUAL(0, stat(JOURNAL_FILE, &after));
+    UT_ASSERT(after.st_size > before.st_size);
+
+    UT_ASSERT_EQUAL(0, tm_tokens_save(TOKEN_FILE));
+    UT_ASSERT_EQUAL(0, stat(JOURNAL_FILE, &after));
+    UT_ASSERT_EQUAL(before.st_size, after.st_size);
+}
+
+ut_test(journal_is_compacted)
+{
+    exa_uuid_t uuid;
+    exa_nodeid_t holder_id;
+    struct stat st;
+    int i;
+
+    UT_ASSERT(uuid_scan(TOKEN_UUID, &uuid) == 0);
+
+    for (i = 0; i < 10000; i++)
+    {
+        exa_nodeid_t node = i % 2 ? NODE_1 : NODE_2;
+
+        UT_ASSERT_EQUAL(0, __set_holder(&uuid, node));
+        UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+        if (i < 9999)
+        {
+            UT_ASSERT_EQUAL(0, tm_tokens_release(&uuid, node));
+            UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+        }
+    }
+
+    /* 20000 changes, but no more than a few thousand records */
+    UT_ASSERT_EQUAL(0, stat(JOURNAL_FILE, &st));
+    UT_ASSERT(st.st_size < 2048 * sizeof(token_t));
+
+    tm_tokens_cleanup();
+
+    UT_ASSERT_EQUAL(0, tm_tokens_load(TOKEN_FILE));
+    UT_ASSERT_EQUAL(1, tm_tokens_count());
+    UT_ASSERT(tm_tokens_get_holder(&uuid, &holder_id) == 0 && holder_id == NODE_1);
+}
+
+ut_test(partial_record_at_end_of_journal_is_ignored)
+{
+    exa_uuid_t uuid;
+    exa_nodeid_t holder_id;
+    FILE *f;
+
+    UT_ASSERT(uuid_scan(TOKEN_UUID, &uuid) == 0);
+
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+    UT_ASSERT_EQUAL(0, tm_tokens_release(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_2));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+
+    tm_tokens_cleanup();
+
+    /* Cut the last record in the middle */
+    f = fopen(JOURNAL_FILE, "rb+");
+    UT_ASSERT(f != NULL);
+    UT_ASSERT_EQUAL(0, fseek(f, 0, SEEK_END));
+    UT_ASSERT_EQUAL(0, ftruncate(fileno(f), ftell(f) - 10));
+    fclose(f);
+
+    /* The token remains released */
+    UT_ASSERT_EQUAL(0, tm_tokens_load(TOKEN_FILE));
+    UT_ASSERT_EQUAL(0, tm_tokens_count());
+    UT_ASSERT_EQUAL(-TM_ERR_NO_SUCH_TOKEN, tm_tokens_get_holder(&uuid, &holder_id));
+}
+
+ut_test(journal_of_a_previous_save_is_not_replayed)
+{
+    exa_uuid_t uuid;
+    exa_nodeid_t holder_id;
+    char stale[4096];
+    size_t size;
+    FILE *f;
+
+    UT_ASSERT(uuid_scan(TOKEN_UUID, &uuid) == 0);
+
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_save(TOKEN_FILE));
+    UT_ASSERT_EQUAL(0, tm_tokens_release(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_2));
+    UT_ASSERT_EQUAL(0, tm_tokens_persist(TOKEN_FILE, &uuid));
+
+    f = fopen(JOURNAL_FILE, "rb");
+    UT_ASSERT(f != NULL);
+    size = fread(stale, 1, sizeof(stale), f);
+    fclose(f);
+
+    UT_ASSERT_EQUAL(0, tm_tokens_release(&uuid, NODE_2));
+    UT_ASSERT_EQUAL(0, __set_holder(&uuid, NODE_1));
+    UT_ASSERT_EQUAL(0, tm_tokens_save(TOKEN_FILE));
+
+    tm_tokens_cleanup();
+
+    /* The save died before creating its journal */
+    f = fopen(JOURNAL_FILE, "wb");
+    UT_ASSERT(f != NULL);
+    UT_ASSERT_EQUAL(size, fwrite(stale, 1, size, f));
+    fclose(f);
+
+    UT_ASSERT_EQUAL(0, tm_tokens_load(TOKEN_FILE));
+    UT_ASSERT_EQUAL(1, tm_tokens_count());
+    UT_ASSERT(tm_tokens_get_holder(&uuid, &holder_id) == 0 && holder_id == NODE_1);
+}
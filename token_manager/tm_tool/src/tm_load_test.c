@@ -0,0 +1,435 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/*
+ * Load test of a token manager: simulates many two-node clusters, each node
+ * keeping its own connection open as admind does. In each round, the nodes
+ * of every cluster take their token in turn, the other node being denied
+ * it. The throughput and latency percentiles of each kind of request are
+ * reported.
+ *
+ * Each simulated node needs a socket on both sides, so the limit on open
+ * files (ulimit -n) of this program and of the token manager must allow
+ * twice the number of clusters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "token_manager/tm_client/include/tm_client.h"
+#include "token_manager/tm_server/include/token_msg.h"
+
+#include "common/include/exa_conversion.h"
+#include "common/include/exa_error.h"
+
+#include "os/include/os_error.h"
+#include "os/include/os_getopt.h"
+#include "os/include/os_inttypes.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_network.h"
+#include "os/include/os_random.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+#define MAX_THREADS  64
+
+typedef enum
+{
+    OP_ACQUIRE,
+    OP_DENIED,
+    OP_RELEASE,
+#define OP__FIRST  OP_ACQUIRE
+#define OP__LAST   OP_RELEASE
+} op_t;
+
+#define OP_COUNT  (OP__LAST - OP__FIRST + 1)
+
+static const char *op_names[OP_COUNT] = { "acquire", "denied", "release" };
+
+typedef struct
+{
+    exa_uuid_t uuid;
+    token_manager_t *tms[2];
+} cluster_t;
+
+/** Latencies of the requests of a kind done by a thread, in microseconds */
+typedef struct
+{
+    uint32_t *us;
+    size_t count;
+    size_t alloc;
+} latencies_t;
+
+typedef struct
+{
+    os_thread_t tid;
+    cluster_t *clusters;
+    unsigned int nb_clusters;
+    latencies_t lat[OP_COUNT];
+    int err;
+} load_thread_t;
+
+/** Name of this program */
+static const char *program = NULL;
+
+static unsigned int nb_rounds = 10;
+
+static void usage(void)
+{
+    printf("Usage: %s [OPTIONS] [ADDRESS]\n"
+           "Load the token manager at ADDRESS (default 127.0.0.1) with\n"
+           "simulated two-node clusters.\n"
+           "  -c, --clusters  Number of clusters (default 1000)\n"
+           "  -p, --port      Port of the token manager (default %d)\n"
+           "  -r, --rounds    Number of rounds (default 10)\n"
+           "  -t, --threads   Number of threads sending requests (default 4)\n"
+           "  -h, --help      Display this help and exit\n",
+           program, TOKEN_MANAGER_DEFAULT_PORT);
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int latencies_add(latencies_t *lat, uint64_t us)
+{
+    if (lat->count == lat->alloc)
+    {
+        size_t alloc = lat->alloc == 0 ? 4096 : 2 * lat->alloc;
+        uint32_t *grown = os_realloc(lat->us, alloc * sizeof(*lat->us));
+
+        if (grown == NULL)
+            return -ENOMEM;
+
+        lat->us = grown;
+        lat->alloc = alloc;
+    }
+
+    lat->us[lat->count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+
+    return 0;
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Send a request on behalf of a node and check its result.
+ *
+ * @return 0 if the token manager gave the expected answer, a negative
+ *         error code otherwise
+ */
+static int timed_request(load_thread_t *thread, cluster_t *c,
+                         exa_nodeid_t node, op_t op)
+{
+    uint64_t begin = now_us();
+    int err;
+
+    if (op == OP_RELEASE)
+        err = tm_release_token(c->tms[node], &c->uuid, node);
+    else
+        err = tm_request_token(c->tms[node], &c->uuid, node);
+
+    /* A denied request is answered with -ENOENT */
+    if (op == OP_DENIED)
+        err = err == -ENOENT ? 0 : err == 0 ? -EEXIST : err;
+
+    if (err != 0)
+    {
+        fprintf(stderr, "%s of token "UUID_FMT" by node %"PRInodeid
+                " failed: %s\n", op_names[op], UUID_VAL(&c->uuid), node,
+                exa_error_msg(err));
+        return err;
+    }
+
+    return latencies_add(&thread->lat[op], now_us() - begin);
+}
+
+static void load_thread(void *data)
+{
+    load_thread_t *thread = data;
+    unsigned int round, i;
+
+    for (round = 0; round < nb_rounds; round++)
+        for (i = 0; i < thread->nb_clusters; i++)
+        {
+            cluster_t *c = &thread->clusters[i];
+            exa_nodeid_t first = round % 2, second = 1 - first;
+
+            thread->err = timed_request(thread, c, first, OP_ACQUIRE);
+            if (thread->err == 0)
+                thread->err = timed_request(thread, c, second, OP_DENIED);
+            if (thread->err == 0)
+                thread->err = timed_request(thread, c, first, OP_RELEASE);
+            if (thread->err != 0)
+                return;
+        }
+}
+
+static void report(load_thread_t *threads, unsigned int nb_threads,
+                   op_t op, uint64_t elapsed_us)
+{
+    latencies_t all = { NULL, 0, 0 };
+    uint64_t sum = 0;
+    unsigned int i;
+    size_t j;
+
+    for (i = 0; i < nb_threads; i++)
+        for (j = 0; j < threads[i].lat[op].count; j++)
+        {
+            if (latencies_add(&all, threads[i].lat[op].us[j]) != 0)
+            {
+                fprintf(stderr, "out of memory\n");
+                os_free(all.us);
+                return;
+            }
+            sum += threads[i].lat[op].us[j];
+        }
+
+    if (all.count == 0)
+        return;
+
+    qsort(all.us, all.count, sizeof(*all.us), compare_us);
+
+    printf("%-8s: %8.0f req/s, latency (us) avg %"PRIu64", p50 %u, p99 %u,"
+           " p99.9 %u, max %u\n", op_names[op],
+           all.count * 1000000.0 / elapsed_us, sum / all.count,
+           all.us[all.count / 2], all.us[all.count * 99 / 100],
+           all.us[all.count * 999 / 1000], all.us[all.count - 1]);
+
+    os_free(all.us);
+}
+
+/* Each simulated node has its own socket: allow as many descriptors as the
+   system lets us */
+static void raise_fd_limit(void)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == rl.rlim_max)
+        return;
+
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static int connect_clusters(cluster_t *clusters, unsigned int nb_clusters,
+                            const char *address, uint16_t port)
+{
+    unsigned int i;
+    int node, err;
+
+    for (i = 0; i < nb_clusters; i++)
+    {
+        os_get_random_bytes(&clusters[i].uuid, sizeof(clusters[i].uuid));
+
+        for (node = 0; node < 2; node++)
+        {
+            err = tm_init(&clusters[i].tms[node], address, port);
+            if (err == 0)
+                err = tm_connect(clusters[i].tms[node]);
+            if (err != 0)
+            {
+                fprintf(stderr, "connection %u to %s:%"PRIu16" failed: %s\n",
+                        2 * i + node + 1, address, port, exa_error_msg(err));
+                return err;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int run_load(const char *address, uint16_t port,
+                    unsigned int nb_clusters, unsigned int nb_threads)
+{
+    load_thread_t threads[MAX_THREADS];
+    cluster_t *clusters;
+    unsigned int started = 0, i;
+    uint64_t begin, elapsed;
+    int err;
+    op_t op;
+
+    clusters = os_malloc(nb_clusters * sizeof(cluster_t));
+    if (clusters == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return -ENOMEM;
+    }
+    memset(clusters, 0, nb_clusters * sizeof(cluster_t));
+
+    begin = now_us();
+    err = connect_clusters(clusters, nb_clusters, address, port);
+    if (err == 0)
+        printf("%u clusters connected in %"PRIu64" ms\n", nb_clusters,
+               (now_us() - begin) / 1000);
+
+    memset(threads, 0, sizeof(threads));
+
+    begin = now_us();
+    for (i = 0; err == 0 && i < nb_threads; i++)
+    {
+        load_thread_t *thread = &threads[i];
+        unsigned int first = nb_clusters * i / nb_threads;
+
+        thread->clusters = &clusters[first];
+        thread->nb_clusters = nb_clusters * (i + 1) / nb_threads - first;
+
+        if (!os_thread_create(&thread->tid, 0, load_thread, thread))
+        {
+            fprintf(stderr, "cannot create thread\n");
+            err = -ENOMEM;
+            break;
+        }
+        started++;
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        os_thread_join(threads[i].tid);
+        if (threads[i].err != 0 && err == 0)
+            err = threads[i].err;
+    }
+    elapsed = now_us() - begin;
+
+    if (err == 0)
+    {
+        printf("%u clusters, %u rounds, %u threads, %"PRIu64" ms\n",
+               nb_clusters, nb_rounds, nb_threads, elapsed / 1000);
+        for (op = OP__FIRST; op <= OP__LAST; op++)
+            report(threads, started, op, elapsed);
+    }
+
+    for (i = 0; i < started; i++)
+        for (op = OP__FIRST; op <= OP__LAST; op++)
+            os_free(threads[i].lat[op].us);
+
+    for (i = 0; i < nb_clusters; i++)
+    {
+        int node;
+
+        for (node = 0; node < 2; node++)
+            if (clusters[i].tms[node] != NULL)
+            {
+                tm_disconnect(clusters[i].tms[node]);
+                tm_free(&clusters[i].tms[node]);
+            }
+    }
+
+    os_free(clusters);
+
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_opts[] =
+    {
+        { "clusters", required_argument, NULL, 'c' },
+        { "port",     required_argument, NULL, 'p' },
+        { "rounds",   required_argument, NULL, 'r' },
+        { "threads",  required_argument, NULL, 't' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL,       0,                 NULL, 0   }
+    };
+    unsigned int nb_clusters = 1000, nb_threads = 4;
+    uint16_t port = TOKEN_MANAGER_DEFAULT_PORT;
+    const char *address = "127.0.0.1";
+    int c, err;
+
+    program = argv[0];
+
+    while ((c = os_getopt_long(argc, argv, "c:p:r:t:h", long_opts, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            if (to_uint(optarg, &nb_clusters) != EXA_SUCCESS
+                || nb_clusters == 0)
+            {
+                fprintf(stderr, "invalid number of clusters: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'p':
+            if (to_uint16(optarg, &port) != EXA_SUCCESS)
+            {
+                fprintf(stderr, "invalid port: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'r':
+            if (to_uint(optarg, &nb_rounds) != EXA_SUCCESS)
+            {
+                fprintf(stderr, "invalid number of rounds: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 't':
+            if (to_uint(optarg, &nb_threads) != EXA_SUCCESS
+                || nb_threads == 0 || nb_threads > MAX_THREADS)
+            {
+                fprintf(stderr, "invalid number of threads: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind < argc)
+        address = argv[optind++];
+
+    if (optind < argc)
+    {
+        usage();
+        return 1;
+    }
+
+    if (nb_threads > nb_clusters)
+        nb_threads = nb_clusters;
+
+    raise_fd_limit();
+
+    err = os_net_init();
+    if (err != 0)
+    {
+        fprintf(stderr, "cannot initialize network: %s\n", exa_error_msg(err));
+        return 1;
+    }
+
+    os_random_init();
+
+    err = run_load(address, port, nb_clusters, nb_threads);
+
+    os_random_cleanup();
+    os_net_cleanup();
+
+    return err == 0 ? 0 : 1;
+}
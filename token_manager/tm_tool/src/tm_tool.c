@@ -8,8 +8,7 @@
 
 #include "token_manager/tm_client/include/tm_client.h"
 #include "token_manager/tm_server/include/token_msg.h"
-#include "token_manager/tm_server/include/tm_file.h"
-#include "token_manager/tm_server/include/tm_server.h"
+#include "token_manager/tm_server/src/tm_tokens.h"
 
 #include "common/include/exa_conversion.h"
 
@@ -104,25 +103,29 @@ done:
     return err;
 }
 
+static void print_token(const token_t *t, void *arg)
+{
+    printf("    "UUID_FMT" held by node %"PRInodeid" (%s)\n", UUID_VAL(&t->uuid), t->holder, t->holder_addr);
+}
+
 static int dump_tokens(const char *token_file)
 {
-    int i, err = 0;
-    uint64_t num_tok = TM_TOKENS_MAX;
-    token_t toks[TM_TOKENS_MAX];
+    uint64_t num_tok;
+    int err;
 
-    err = tm_file_load(token_file, toks, &num_tok);
+    /* Also replays the journal of the token file */
+    err = tm_tokens_load(token_file);
     if (err < 0)
     {
         fprintf(stderr, "Invalid token file: '%s'", token_file);
         return err;
     }
 
+    num_tok = tm_tokens_count();
     printf("%"PRIu64" %s currently held.\n", num_tok, num_tok > 1 ? "tokens" : "token");
-    for (i = 0; i < num_tok; i++)
-    {
-        const token_t *t = &toks[i];
-        printf("    "UUID_FMT" held by node %"PRInodeid" (%s)\n", UUID_VAL(&t->uuid), t->holder, t->holder_addr);
-    }
+    tm_tokens_for_each(print_token, NULL);
+
+    tm_tokens_cleanup();
 
     return 0;
 }
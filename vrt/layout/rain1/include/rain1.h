@@ -9,8 +9,53 @@
 #ifndef __RAIN1_H__
 #define __RAIN1_H__
 
+/** How the replica a read is done from is chosen */
+typedef enum
+{
+    RAIN1_READ_POLICY_FIRST,             /**< First readable replica */
+    RAIN1_READ_POLICY_ROUND_ROBIN,       /**< Each replica in turn */
+    RAIN1_READ_POLICY_LEAST_OUTSTANDING, /**< Replica expected to answer first */
+    RAIN1_READ_POLICY_LOCAL              /**< Local replica if any */
+} rain1_read_policy_t;
+
+#define RAIN1_READ_POLICY__FIRST  RAIN1_READ_POLICY_FIRST
+#define RAIN1_READ_POLICY__LAST   RAIN1_READ_POLICY_LOCAL
+
+#define RAIN1_READ_POLICY_IS_VALID(p) \
+    ((p) >= RAIN1_READ_POLICY__FIRST && (p) <= RAIN1_READ_POLICY__LAST)
+
+/**
+ * Get a read policy from its name ("first", "round_robin",
+ * "least_outstanding" or "local").
+ *
+ * @param[in]  str     Name of the policy
+ * @param[out] policy  Policy
+ *
+ * @return EXA_SUCCESS or -EINVAL if the name is not a policy
+ */
+int rain1_read_policy_from_str(const char *str, rain1_read_policy_t *policy);
+
+/**
+ * Initialize the rain1 layout.
+ *
+ * @param[in] rebuilding_slowdown_ms           Rebuilding slowdown
+ * @param[in] degraded_rebuilding_slowdown_ms  Rebuilding slowdown when degraded
+ * @param[in] read_policy                      Replica reads are done from
+ * @param[in] dzone_retention_s                Seconds a dirty zone stays marked
+ *                                             on disk after its last write, 0
+ *                                             to disable, -1 for the default
+ * @param[in] sync_latency_target_ms           p99 latency of the foreground
+ *                                             IOs the rebuild and resync
+ *                                             adapt their speed to, 0 to
+ *                                             use the fixed slowdowns
+ *
+ * @return EXA_SUCCESS or a negative error code
+ */
 int rain1_init(int rebuilding_slowdown_ms,
-               int degraded_rebuilding_slowdown_ms);
+               int degraded_rebuilding_slowdown_ms,
+               rain1_read_policy_t read_policy,
+               int dzone_retention_s,
+               int sync_latency_target_ms);
 
 void rain1_cleanup(void);
 #endif
@@ -13,6 +13,7 @@
 #include "vrt/virtualiseur/include/vrt_nodes.h"
 
 #include "vrt/layout/rain1/src/lay_rain1_check.h"
+#include "vrt/layout/rain1/src/lay_rain1_desync_info.h"
 #include "vrt/layout/rain1/src/lay_rain1_striping.h"
 
 #include "os/include/os_error.h"
@@ -238,8 +239,15 @@ static int rain1_group_reset_slot(rain1_group_t *lg,
     uint64_t logical_slot_size = rain1_group_get_slot_data_size(lg);
     unsigned int sector_offset;
     unsigned int i;
+    slot_desync_info_t *block = subspace->slots[slot_index]->private;
     int ret = EXA_SUCCESS;
 
+    /* The data is written bypassing the dirty zones: tag them all as
+     * written, so that a rebuild copies them */
+    os_thread_mutex_lock(&block->lock);
+    slot_desync_info_set_all_written(block, lg->sync_tag);
+    os_thread_mutex_unlock(&block->lock);
+
     for (i = 0; i < CHECK_NB_JOBS; i++)
     {
         ret = job_init(&jobs[i], SECTORS_TO_BYTES(nb_sectors_per_block));
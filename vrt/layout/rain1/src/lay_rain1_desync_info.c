@@ -11,7 +11,30 @@
 #include "vrt/virtualiseur/include/vrt_request.h"
 #include "common/include/exa_math.h"
 
+#include "os/include/os_atomic.h"
 #include "os/include/os_mem.h"
+#include "os/include/os_time.h"
+
+#include <string.h>
+
+static int dzone_retention_s = RAIN1_DEFAULT_DZONE_RETENTION_S;
+
+/** Number of dirty zones retained on the node */
+static os_atomic_t nb_retained_dzones = { 0 };
+
+void rain1_set_dzone_retention(int retention_s)
+{
+    dzone_retention_s = retention_s < 0 ? RAIN1_DEFAULT_DZONE_RETENTION_S
+                                        : retention_s;
+}
+
+static uint32_t now_s(void)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+    return (uint32_t)now.tv_sec;
+}
 
 void dzone_metadata_block_init(desync_info_t *metadatas,
                                sync_tag_t uptodate_tag)
@@ -45,11 +68,152 @@ void dzone_metadata_block_merge(desync_info_t *merged_metadatas,
 bool desync_info_is_valid(const desync_info_t *desync_info,
                           sync_tag_t current_sync_tag)
 {
-    return desync_info->write_pending_counter <= vrt_get_max_requests()
+    /* A retained dirty zone counts one more than the requests */
+    return desync_info->write_pending_counter <= vrt_get_max_requests() + 1
         && sync_tags_are_comparable(desync_info->sync_tag, current_sync_tag)
         && !sync_tag_is_greater(desync_info->sync_tag, current_sync_tag);
 }
 
+bool slot_desync_info_dzone_is_marked(const slot_desync_info_t *block,
+                                      unsigned int dzone,
+                                      sync_tag_t current_sync_tag)
+{
+    const desync_info_t *in_mem = &block->in_memory_metadata[dzone];
+    const desync_info_t *on_disk = &block->on_disk_metadata[dzone];
+
+    return in_mem->write_pending_counter > 0
+        && on_disk->write_pending_counter > 0
+        && sync_tag_is_equal(in_mem->sync_tag, current_sync_tag)
+        && sync_tag_is_equal(on_disk->sync_tag, current_sync_tag);
+}
+
+/**
+ * Take a slot of the retention budget.
+ *
+ * @return true if there was one left
+ */
+static bool retention_budget_take(void)
+{
+    os_atomic_inc(&nb_retained_dzones);
+
+    if (os_atomic_read(&nb_retained_dzones) > RAIN1_MAX_RETAINED_DZONES)
+    {
+        os_atomic_dec(&nb_retained_dzones);
+        return false;
+    }
+
+    return true;
+}
+
+void slot_desync_info_write_end(slot_desync_info_t *block, unsigned int dzone)
+{
+    desync_info_t *in_mem = &block->in_memory_metadata[dzone];
+
+    EXA_ASSERT(in_mem->write_pending_counter > 0);
+    in_mem->write_pending_counter--;
+
+    if (dzone_retention_s == 0)
+    {
+        if (in_mem->write_pending_counter == 0)
+            block->flush_needed = true;
+        return;
+    }
+
+    block->last_write_s[dzone] = now_s();
+
+    if (in_mem->write_pending_counter > 0)
+        return;
+
+    /* The dirty zone is still marked on disk: keep it so by holding its
+     * counter, the next write won't have to mark it again. */
+    EXA_ASSERT(!block->retained[dzone]);
+    if (retention_budget_take())
+    {
+        in_mem->write_pending_counter = 1;
+        block->retained[dzone] = true;
+        block->nb_retained++;
+    }
+    else
+        block->flush_needed = true;
+}
+
+void slot_desync_info_release(slot_desync_info_t *block, bool all)
+{
+    uint32_t now;
+    unsigned int dzone;
+
+    if (block->nb_retained == 0)
+        return;
+
+    now = now_s();
+
+    for (dzone = 0; dzone < DZONE_PER_METADATA_BLOCK; dzone++)
+    {
+        desync_info_t *in_mem = &block->in_memory_metadata[dzone];
+
+        if (!block->retained[dzone])
+            continue;
+
+        if (!all && now - block->last_write_s[dzone] < (uint32_t)dzone_retention_s)
+            continue;
+
+        EXA_ASSERT(in_mem->write_pending_counter > 0);
+        in_mem->write_pending_counter--;
+        if (in_mem->write_pending_counter == 0)
+            block->flush_needed = true;
+
+        block->retained[dzone] = false;
+        block->nb_retained--;
+        os_atomic_dec(&nb_retained_dzones);
+    }
+}
+
+bool slot_desync_info_load_unwritten(slot_desync_info_t *block,
+                                     const desync_info_t *on_disk)
+{
+    unsigned int dzone;
+
+    if (block->ongoing_flush)
+        return false;
+
+    for (dzone = 0; dzone < DZONE_PER_METADATA_BLOCK; dzone++)
+    {
+        desync_info_t *in_mem = &block->in_memory_metadata[dzone];
+
+        if (on_disk[dzone].sync_tag != SYNC_TAG_BLANK
+            || block->written[dzone] || in_mem->write_pending_counter > 0
+            || block->on_disk_metadata[dzone].write_pending_counter > 0)
+            continue;
+
+        /* Both versions, so that it doesn't need a flush by itself */
+        in_mem->sync_tag = SYNC_TAG_BLANK;
+        block->on_disk_metadata[dzone].sync_tag = SYNC_TAG_BLANK;
+    }
+
+    block->unwritten_known = true;
+
+    return true;
+}
+
+void slot_desync_info_set_all_written(slot_desync_info_t *block,
+                                      sync_tag_t sync_tag)
+{
+    unsigned int dzone;
+
+    for (dzone = 0; dzone < DZONE_PER_METADATA_BLOCK; dzone++)
+    {
+        desync_info_t *in_mem = &block->in_memory_metadata[dzone];
+
+        block->written[dzone] = true;
+
+        if (!sync_tag_is_equal(in_mem->sync_tag, sync_tag))
+        {
+            in_mem->sync_tag = sync_tag_max(sync_tag, in_mem->sync_tag);
+            block->flush_needed = true;
+        }
+    }
+}
+
 slot_desync_info_t *slot_desync_info_alloc(sync_tag_t sync_tag)
 {
     slot_desync_info_t *block = os_malloc(sizeof(slot_desync_info_t));
@@ -65,6 +229,13 @@ slot_desync_info_t *slot_desync_info_alloc(sync_tag_t sync_tag)
     INIT_LIST_HEAD(&block->wait_avail_list);
     INIT_LIST_HEAD(&block->wait_write_list);
 
+    memset(block->retained, 0, sizeof(block->retained));
+    memset(block->last_write_s, 0, sizeof(block->last_write_s));
+    block->nb_retained = 0;
+
+    block->unwritten_known = false;
+    memset(block->written, 0, sizeof(block->written));
+
     /* FIXME: I think that the meta-data should be read from the disk and
      * not initialized.
      * At least it would be simpler to aprehend the side effects... */
@@ -79,6 +250,8 @@ void __slot_desync_info_free(slot_desync_info_t *block)
     if (block == NULL)
         return;
 
+    slot_desync_info_release(block, true);
+
     os_thread_mutex_destroy(&block->lock);
     os_free(block);
 }
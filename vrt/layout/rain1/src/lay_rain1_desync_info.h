@@ -75,8 +75,49 @@ typedef struct
         write to go further */
     struct list_head wait_write_list;
 
+    /** Whether the dirty zone is retained, i.e. its write pending counter
+        holds one more than the writes pending so that it stays marked on
+        disk after its last write (see slot_desync_info_write_end()) */
+    bool retained[DZONE_PER_METADATA_BLOCK];
+
+    /** Monotonic time (in seconds) the last write on the dirty zone ended */
+    uint32_t last_write_s[DZONE_PER_METADATA_BLOCK];
+
+    /** Number of dirty zones retained */
+    unsigned int nb_retained;
+
+    /** Whether the dirty zones never written by the node are known, from
+        its metadata block on disk. Until then, the dirty zones are all
+        tagged as written (see slot_desync_info_load_unwritten()) */
+    bool unwritten_known;
+
+    /** Whether the dirty zone was written since the block was allocated */
+    bool written[DZONE_PER_METADATA_BLOCK];
+
 } slot_desync_info_t;
 
+/**
+ * Default number of seconds a dirty zone stays marked on disk after its
+ * last write.
+ */
+#define RAIN1_DEFAULT_DZONE_RETENTION_S  30
+
+/**
+ * Maximum number of dirty zones retained at once on the node, all groups
+ * together. It bounds the amount of data resynchronized after a crash
+ * because of the retention.
+ */
+#define RAIN1_MAX_RETAINED_DZONES  1024
+
+/**
+ * Set how long a dirty zone stays marked on disk after its last write,
+ * so that the next writes on a zone being written often do not need to
+ * mark it again.
+ *
+ * @param[in] retention_s  Number of seconds, 0 to disable the retention
+ */
+void rain1_set_dzone_retention(int retention_s);
+
 
 /**
  * Test if the desync information is valid
@@ -95,6 +136,82 @@ void dzone_metadata_block_merge(desync_info_t *merged_metadatas,
 void dzone_metadata_block_init(desync_info_t *metadatas,
                                sync_tag_t uptodate_tag);
 
+/**
+ * Test if a dirty zone is marked as being written, with the current
+ * synchronization tag, both in memory and on disk. A write on such a dirty
+ * zone does not need to wait for the metadata block, even if it is being
+ * flushed: the in-memory version can't go from unmarked to marked during a
+ * flush, so the version being written marks it too.
+ *
+ * Must be called with the lock of the block held.
+ *
+ * @param[in] block             The metadata block
+ * @param[in] dzone             Index of the dirty zone in the block
+ * @param[in] current_sync_tag  The current synchronization tag
+ *
+ * @return true or false
+ */
+bool slot_desync_info_dzone_is_marked(const slot_desync_info_t *block,
+                                      unsigned int dzone,
+                                      sync_tag_t current_sync_tag);
+
+/**
+ * Account the end of a write on a dirty zone. When it was the last write
+ * pending, the dirty zone is retained if the retention is enabled and the
+ * retention budget allows it, otherwise the block needs to be flushed.
+ *
+ * Must be called with the lock of the block held.
+ *
+ * @param[inout] block  The metadata block
+ * @param[in]    dzone  Index of the dirty zone in the block
+ */
+void slot_desync_info_write_end(slot_desync_info_t *block, unsigned int dzone);
+
+/**
+ * Release the retained dirty zones that were not written during the
+ * retention interval, or all of them. The block needs to be flushed if one
+ * has no write pending anymore.
+ *
+ * Must be called with the lock of the block held.
+ *
+ * @param[inout] block  The metadata block
+ * @param[in]    all    Whether to release all the retained dirty zones
+ */
+void slot_desync_info_release(slot_desync_info_t *block, bool all);
+
+/**
+ * Tag the dirty zones never written by the node as such in memory, so that
+ * the next flushes of the block keep them blank on disk and the rebuilds
+ * skip them. A dirty zone is never written if it is blank in the metadata
+ * block of the node read on disk, and wasn't written since the block was
+ * allocated.
+ *
+ * Nothing is done while the block is being flushed, as the metadata read
+ * may be outdated: returns false and the caller retries later.
+ *
+ * Must be called with the lock of the block held.
+ *
+ * @param[inout] block     The metadata block
+ * @param[in]    on_disk   The metadata block of the node read on disk
+ *
+ * @return true if the dirty zones never written are now known
+ */
+bool slot_desync_info_load_unwritten(slot_desync_info_t *block,
+                                     const desync_info_t *on_disk);
+
+/**
+ * Tag all the dirty zones as written with a given synchronization tag,
+ * when they were written without going through the metadata. The block
+ * needs to be flushed if a tag changed.
+ *
+ * Must be called with the lock of the block held.
+ *
+ * @param[inout] block     The metadata block
+ * @param[in]    sync_tag  The current synchronization tag
+ */
+void slot_desync_info_set_all_written(slot_desync_info_t *block,
+                                      sync_tag_t sync_tag);
+
 /**
  * Allocate memory to store information about each block of on-disk metadata.
  * Metadata on disks are stored on blocks of 1 sector * that cannot be written
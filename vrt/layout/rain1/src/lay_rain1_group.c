@@ -169,14 +169,15 @@ unsigned int rain1_group_get_sync_jobs_count(const rain1_group_t *rxg)
     /* Legacy comment: We cannot lock more than NBMAX_DISK_LOCKED_ZONES areas
      * simultaneously on a disk, so we cannot use more jobs than that
      *
-     * FIXME: this limitation means that the locking interface is quite poor and that
-     * there is good chances that it cannot handle the limit cases properly.
-     * Anyway, NBMAX_DISK_LOCKED_ZONES = 32 and it is the size of 2 an uint64 arrays
-     * It could be set to a bigger value without pb.
+     * The serverd indexes the locked zones in an interval tree, thus
+     * NBMAX_DISK_LOCKED_ZONES is only a sanity limit.
+     *
+     * A rebuild keeps RAIN1_SYNC_SLOTS_IN_FLIGHT slots in flight, each
+     * with as many jobs as a single slot used to have.
      */
 
     return MIN(NBMAX_DISK_LOCKED_ZONES,
-               RAIN1_DZONE_SYNC_BLK_SIZE * 8 / blksize);
+               RAIN1_SYNC_SLOTS_IN_FLIGHT * RAIN1_DZONE_SYNC_BLK_SIZE * 8 / blksize);
 }
 
 bool rain1_group_equals(const rain1_group_t *rxg1,
@@ -163,6 +163,9 @@ static inline uint64_t rain1_group_get_slot_data_size(const rain1_group_t *rxg)
  */
 uint64_t rain1_group_get_dzone_per_slot_count(const rain1_group_t *rxg);
 
+/** Number of slots synchronized at once by a rebuild */
+#define RAIN1_SYNC_SLOTS_IN_FLIGHT 4
+
 unsigned int rain1_group_get_sync_job_blksize(const rain1_group_t *rxg);
 unsigned int rain1_group_get_sync_jobs_count(const rain1_group_t *rxg);
 
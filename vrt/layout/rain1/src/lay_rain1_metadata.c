@@ -152,15 +152,18 @@ int rain1_read_slot_metadata (const rain1_group_t *rxg,
 /**
  * Flush to disk (metadata logical space) the dirty zone metadata of the slot
  *
- * @param[in]    rxg    The rain1 group
- * @param[in]    slot   The slot
- * @param[inout] block  The slot metadata manipulation structure
+ * @param[in]    rxg          The rain1 group
+ * @param[in]    slot         The slot
+ * @param[inout] block        The slot metadata manipulation structure
+ * @param[in]    release_all  Whether to release all the retained dirty
+ *                            zones, or only those no longer written
  *
  * @return EXA_SUCCESS or a negative error code
  */
 static int rain1_group_flush_slot_metadata(const rain1_group_t *rxg,
                                            const slot_t *slot,
-                                           slot_desync_info_t *block)
+                                           slot_desync_info_t *block,
+                                           bool release_all)
 {
     bool on_disk_is_synchronized;
     unsigned int dzone;
@@ -169,6 +172,10 @@ static int rain1_group_flush_slot_metadata(const rain1_group_t *rxg,
 
     os_thread_mutex_lock(&block->lock);
 
+    /* The dirty zones not written for a while are not worth keeping
+     * marked on disk anymore */
+    slot_desync_info_release(block, release_all);
+
     /* The background flushing is just a best-effort optimization.
      * If the IO path is already synchronizing the metadata, we don't do anything.
      */
@@ -253,6 +260,56 @@ static int rain1_group_flush_slot_metadata(const rain1_group_t *rxg,
     return ret;
 }
 
+/**
+ * Read back the metadata block of the node to learn which dirty zones of
+ * the slot it never wrote. This is done once per slot, lazily, by the
+ * background flush.
+ *
+ * @param[in]    rxg    The rain1 group
+ * @param[in]    slot   The slot
+ * @param[inout] block  The slot metadata manipulation structure
+ */
+static void rain1_group_load_slot_unwritten_dzones(const rain1_group_t *rxg,
+                                                   const slot_t *slot,
+                                                   slot_desync_info_t *block)
+{
+    desync_info_t metadatas[DZONE_PER_METADATA_BLOCK];
+    int ret;
+
+    ret = rain1_read_slot_metadata(rxg, slot, vrt_node_get_local_id(), metadatas);
+    if (ret != EXA_SUCCESS)
+    {
+        /* Not a problem: the dirty zones stay tagged as written until the
+         * next attempt */
+        exalog_debug("Failed to read the dirty zones of the node: %s (%d)",
+                     exa_error_msg(ret), ret);
+        return;
+    }
+
+    os_thread_mutex_lock(&block->lock);
+    slot_desync_info_load_unwritten(block, metadatas);
+    os_thread_mutex_unlock(&block->lock);
+}
+
+void rain1_group_release_retained_dzones(const rain1_group_t *rxg)
+{
+    const assembly_volume_t *subspace;
+    uint64_t slot_index;
+
+    for (subspace = rxg->assembly_group.subspaces; subspace != NULL;
+         subspace = subspace->next)
+        for (slot_index = 0; slot_index < subspace->total_slots_count; slot_index++)
+        {
+            const slot_t *slot = subspace->slots[slot_index];
+            int err;
+
+            err = rain1_group_flush_slot_metadata(rxg, slot, slot->private, true);
+            if (err != EXA_SUCCESS)
+                exalog_warning("Failed to flush the dirty zones of slot %"PRIu64
+                               ": %s (%d)", slot_index, exa_error_msg(err), err);
+        }
+}
+
 typedef struct
 {
     exa_uuid_t current_subspace_uuid;
@@ -334,7 +391,10 @@ int rain1_group_metadata_flush_step(void *private_data, void *context,
 
     block = slot->private;
 
-    err = rain1_group_flush_slot_metadata(rxg, slot, block);
+    if (!block->unwritten_known)
+        rain1_group_load_slot_unwritten_dzones(rxg, slot, block);
+
+    err = rain1_group_flush_slot_metadata(rxg, slot, block, false);
 
     /* wake up the thread to build the woken up requests */
     vrt_thread_wakeup();
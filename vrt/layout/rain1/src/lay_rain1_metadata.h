@@ -62,6 +62,14 @@ int rain1_read_slot_metadata(const rain1_group_t *rxg,
  */
 int rain1_wipe_slot_metadata(const rain1_group_t *rxg, const slot_t *slot);
 
+/**
+ * Release all the retained dirty zones of the group and flush the metadata
+ * that need it, so that a group stopped cleanly has no dirty zone left.
+ *
+ * @param[in] rxg  The layout data
+ */
+void rain1_group_release_retained_dzones(const rain1_group_t *rxg);
+
 int rain1_group_metadata_flush_step(void *private_data, void *context,
                                     bool *more_work);
 void *rain1_group_metadata_flush_context_alloc(void *layout_data);
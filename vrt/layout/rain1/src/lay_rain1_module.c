@@ -32,6 +32,7 @@
 #include "vrt/layout/rain1/src/lay_rain1_check.h"
 #include "vrt/layout/rain1/src/lay_rain1_request.h"
 #include "vrt/layout/rain1/src/lay_rain1_metadata.h"
+#include "vrt/layout/rain1/src/lay_rain1_rdev.h"
 #include "vrt/layout/rain1/src/lay_rain1_status.h"
 #include "vrt/layout/rain1/src/lay_rain1_superblock.h"
 #include "vrt/layout/rain1/src/lay_rain1_sync.h"
@@ -427,6 +428,10 @@ static int rain1_group_stop(void *private_data)
     rain1_group_t *rxg = private_data;
 
     EXA_ASSERT(rxg);
+
+    /* No more writes: the dirty zones retained don't need to be marked */
+    rain1_group_release_retained_dzones(rxg);
+
     sync_job_pool_free(rxg->sync_job_pool);
 
     return EXA_SUCCESS;
@@ -505,6 +510,7 @@ static int rain1_group_post_resync_subspace(rain1_group_t *rxg,
         RAINX_PERF_POST_RESYNC_BEGIN();
 
         block = slot->private;
+        slot_desync_info_release(block, true);
         block->flush_needed = false;
 
         ret = rain1_read_slot_metadata(rxg, slot, vrt_node_get_local_id(),
@@ -880,6 +886,7 @@ static struct vrt_layout layout_rain1 =
     .build_io_for_req =              rain1_build_io_for_req,
     .init_req =                      rain1_init_req,
     .cancel_req =                    rain1_cancel_req,
+    .get_request_max_sectors =       rain1_get_request_max_sectors,
     .declare_io_needs =              rain1_declare_io_needs,
     .group_rdev_down =               NULL,
     .group_rdev_up =                 NULL,
@@ -901,10 +908,16 @@ static struct vrt_layout layout_rain1 =
 };
 
 int rain1_init(int rebuilding_slowdown_ms,
-               int degraded_rebuilding_slowdown_ms)
+               int degraded_rebuilding_slowdown_ms,
+               rain1_read_policy_t read_policy,
+               int dzone_retention_s,
+               int sync_latency_target_ms)
 {
     rain1_set_rebuilding_slowdown(rebuilding_slowdown_ms,
                                   degraded_rebuilding_slowdown_ms);
+    rain1_set_sync_latency_target(sync_latency_target_ms);
+    rain1_set_read_policy(read_policy);
+    rain1_set_dzone_retention(dzone_retention_s);
     return vrt_register_layout(&layout_rain1);
 }
 
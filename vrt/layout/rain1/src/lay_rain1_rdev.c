@@ -13,6 +13,9 @@
 
 #include "vrt/virtualiseur/include/vrt_group.h"
 
+#include "common/include/exa_error.h"
+
+#include "os/include/os_error.h"
 #include "os/include/os_mem.h"
 
 void rain1_rdev_init_rebuild_context(struct rain1_realdev *lr,
@@ -79,9 +82,122 @@ exa_bool_t rain1_rdev_location_readable(const struct rdev_location *rdev_loc)
     return rdev_loc->uptodate;
 }
 
-exa_bool_t rain1_rdev_location_update_needed(const struct rdev_location *rdev_loc)
+static rain1_read_policy_t read_policy = RAIN1_READ_POLICY_LEAST_OUTSTANDING;
+
+/* Replica the next round robin read starts looking from. Updated without
+ * lock, as losing an increment now and then does not matter. */
+static unsigned int round_robin_next = 0;
+
+static const char *read_policy_names[] =
+{
+    [RAIN1_READ_POLICY_FIRST]             = "first",
+    [RAIN1_READ_POLICY_ROUND_ROBIN]       = "round_robin",
+    [RAIN1_READ_POLICY_LEAST_OUTSTANDING] = "least_outstanding",
+    [RAIN1_READ_POLICY_LOCAL]             = "local"
+};
+
+int rain1_read_policy_from_str(const char *str, rain1_read_policy_t *policy)
+{
+    rain1_read_policy_t p;
+
+    if (str == NULL)
+        return -EINVAL;
+
+    for (p = RAIN1_READ_POLICY__FIRST; p <= RAIN1_READ_POLICY__LAST; p++)
+        if (strcmp(str, read_policy_names[p]) == 0)
+        {
+            *policy = p;
+            return EXA_SUCCESS;
+        }
+
+    return -EINVAL;
+}
+
+void rain1_set_read_policy(rain1_read_policy_t policy)
+{
+    EXA_ASSERT(RAIN1_READ_POLICY_IS_VALID(policy));
+    read_policy = policy;
+}
+
+/* Time a new IO on the replica is expected to take: the IOs already
+ * submitted on the device are served before */
+static uint64_t read_location_cost(const struct rdev_location *rdev_loc)
+{
+    const struct vrt_realdev *rdev = rdev_loc->rdev;
+
+    return ((uint64_t)vrt_rdev_inflight_ios(rdev) + 1)
+           * ((uint64_t)rdev->avg_latency_us + 1);
+}
+
+/* Readable replica expected to answer first. Among equivalent replicas,
+ * the local one is preferred, then the first one. */
+static int select_least_outstanding(const struct rdev_location *rdev_loc,
+                                    unsigned int nb_rdev_loc)
+{
+    uint64_t best_cost = 0;
+    int best = -1;
+    unsigned int i;
+
+    for (i = 0; i < nb_rdev_loc; i++)
+    {
+        uint64_t cost;
+
+        if (!rain1_rdev_location_readable(&rdev_loc[i]))
+            continue;
+
+        cost = read_location_cost(&rdev_loc[i]);
+        if (best < 0 || cost < best_cost
+            || (cost == best_cost && rdev_is_local(rdev_loc[i].rdev)
+                && !rdev_is_local(rdev_loc[best].rdev)))
+        {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+int rain1_select_read_location(const struct rdev_location *rdev_loc,
+                               unsigned int nb_rdev_loc)
 {
-    return rdev_loc->never_replicated;
+    unsigned int i, start;
+
+    switch (read_policy)
+    {
+    case RAIN1_READ_POLICY_FIRST:
+        break;
+
+    case RAIN1_READ_POLICY_ROUND_ROBIN:
+        if (nb_rdev_loc == 0)
+            return -1;
+
+        start = round_robin_next++ % nb_rdev_loc;
+        for (i = 0; i < nb_rdev_loc; i++)
+        {
+            unsigned int src = (start + i) % nb_rdev_loc;
+
+            if (rain1_rdev_location_readable(&rdev_loc[src]))
+                return src;
+        }
+        return -1;
+
+    case RAIN1_READ_POLICY_LEAST_OUTSTANDING:
+        return select_least_outstanding(rdev_loc, nb_rdev_loc);
+
+    case RAIN1_READ_POLICY_LOCAL:
+        for (i = 0; i < nb_rdev_loc; i++)
+            if (rain1_rdev_location_readable(&rdev_loc[i])
+                && rdev_is_local(rdev_loc[i].rdev))
+                return i;
+        return select_least_outstanding(rdev_loc, nb_rdev_loc);
+    }
+
+    for (i = 0; i < nb_rdev_loc; i++)
+        if (rain1_rdev_location_readable(&rdev_loc[i]))
+            return i;
+
+    return -1;
 }
 
 struct rain1_realdev *rain1_alloc_rdev_layout_data(vrt_realdev_t *rdev)
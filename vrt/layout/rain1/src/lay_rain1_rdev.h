@@ -9,6 +9,7 @@
 #ifndef __RAIN1_RDEV_H__
 #define __RAIN1_RDEV_H__
 
+#include "vrt/layout/rain1/include/rain1.h"
 #include "vrt/layout/rain1/src/lay_rain1_sync_tag.h"
 #include "vrt/layout/rain1/src/lay_rain1_group.h"
 
@@ -158,7 +159,6 @@ struct rdev_location
     uint64_t sector;		/**< The position in the device */
     unsigned long size;		/**< The size of the location */
     int uptodate;		/**< Is the location up-to-date*/
-    int never_replicated;	/**< Is the location in the case 'never replicated' */
 };
 
 /**
@@ -171,13 +171,22 @@ struct rdev_location
 exa_bool_t rain1_rdev_location_readable(const struct rdev_location *rdev_loc);
 
 /**
- * Tells whether a location on a real device needs an update.
+ * Set the policy used to choose the replica a read is done from.
  *
- * @param[in] rdev_loc 	The real device location
+ * @param[in] policy  The read policy
+ */
+void rain1_set_read_policy(rain1_read_policy_t policy);
+
+/**
+ * Choose the replica to read from, according to the read policy.
+ *
+ * @param[in] rdev_loc     The replicas
+ * @param[in] nb_rdev_loc  Number of replicas
  *
- * @return TRUE if the location needs an updat or FALSE if not.
+ * @return the index of the replica in rdev_loc, or -1 if none is readable
  */
-exa_bool_t rain1_rdev_location_update_needed(const struct rdev_location *rdev_loc);
+int rain1_select_read_location(const struct rdev_location *rdev_loc,
+                               unsigned int nb_rdev_loc);
 
 struct rain1_realdev *rain1_alloc_rdev_layout_data(vrt_realdev_t *rdev);
 
@@ -134,7 +134,29 @@ rain1_req_get_state(const struct vrt_request *vrt_req)
 }
 
 /**
- * Fill the list of IOs given by the VRT engine for read requests
+ * Get the size of the part of a request that starts at a given position
+ * and ends at the latest at the end of its striping unit. Consecutive
+ * striping units are on different chunks, so this part is the largest one
+ * that has a single location on each replica.
+ *
+ * @param[in] vrt_req    The request header from the VRT engine
+ * @param[in] vsector    Position of the part in the volume
+ * @param[in] remaining  Size left in the request, in bytes
+ *
+ * @return the size of the part, in bytes
+ */
+static uint32_t rain1_req_su_part_size(const struct vrt_request *vrt_req,
+                                       uint64_t vsector, uint32_t remaining)
+{
+    uint64_t su_size = RAIN1_GROUP(vrt_req->ref_vol->group)->su_size;
+
+    return MIN(remaining, SECTORS_TO_BYTES(su_size - vsector % su_size));
+}
+
+/**
+ * Fill the list of IOs given by the VRT engine for read requests: one IO
+ * per striping unit spanned by the request, each one on a readable
+ * replica.
  *
  * Called from the RAIN1_REQUEST_BEGIN state
  *
@@ -146,7 +168,9 @@ rain1_fill_io_read(struct vrt_request *vrt_req)
     struct rdev_location rdev_loc[3];
     unsigned int nb_rdev_loc;
     struct vrt_io_op *io;
-    unsigned int src;
+    uint64_t vsector = vrt_req->ref_bio->start_sector;
+    char *data = vrt_req->ref_bio->buf;
+    uint32_t remaining = vrt_req->ref_bio->size;
 
     EXA_ASSERT (vrt_req->iotype == VRT_IO_TYPE_READ);
 
@@ -155,34 +179,43 @@ rain1_fill_io_read(struct vrt_request *vrt_req)
     if (vrt_req->barrier != NULL)
 	vrt_req->barrier->state = BARRIER_DONT_PROCESS;
 
-    /* Convert the logical position on the volume into several physical positions */
-    rain1_volume2rdev(RAIN1_GROUP(vrt_req->ref_vol->group),
-                      vrt_req->ref_vol->assembly_volume,
-                      vrt_req->ref_bio->start_sector,
-                      rdev_loc, &nb_rdev_loc, 3);
-
     /* Initialize all vrt_io_op to IO_DONT_PROCESS */
     for (io = vrt_req->io_list ; io != NULL ; io = io->next)
 	io->state = IO_DONT_PROCESS;
 
     io = vrt_req->io_list;
 
-    /* Find a replica to read */
-    for (src = 0; src < nb_rdev_loc; src++)
-	if (rain1_rdev_location_readable(& rdev_loc[src]))
-	    break;
+    do {
+        uint32_t size = rain1_req_su_part_size(vrt_req, vsector, remaining);
+        int src;
+
+        /* Convert the logical position on the volume into several physical positions */
+        rain1_volume2rdev(RAIN1_GROUP(vrt_req->ref_vol->group),
+                          vrt_req->ref_vol->assembly_volume, vsector,
+                          rdev_loc, &nb_rdev_loc, 3);
+
+        /* Find a replica to read */
+        src = rain1_select_read_location(rdev_loc, nb_rdev_loc);
+
+        /* No readable replica have been found */
+        if (src < 0)
+            return RAIN1_REQUEST_FAILED;
 
-    /* No readable replica have been found */
-    if (src == nb_rdev_loc)
-	return RAIN1_REQUEST_FAILED;
+        EXA_ASSERT(io != NULL);
 
-    io->iotype  = VRT_IO_TYPE_READ;
-    io->data    = vrt_req->ref_bio->buf;
-    io->size    = vrt_req->ref_bio->size;
-    io->vrt_req = vrt_req;
-    io->rdev    = rdev_loc[src].rdev;
-    io->offset  = rdev_loc[src].sector;
-    io->state   = IO_TO_PROCESS;
+        io->iotype  = VRT_IO_TYPE_READ;
+        io->data    = data;
+        io->size    = size;
+        io->vrt_req = vrt_req;
+        io->rdev    = rdev_loc[src].rdev;
+        io->offset  = rdev_loc[src].sector;
+        io->state   = IO_TO_PROCESS;
+
+        io = io->next;
+        vsector += BYTES_TO_SECTORS(size);
+        data += size;
+        remaining -= size;
+    } while (remaining > 0);
 
     return RAIN1_REQUEST_READ;
 }
@@ -213,56 +246,75 @@ static void rain1_fill_barrier(struct vrt_request *vrt_req)
     vrt_req->barrier->state = BARRIER_TO_PROCESS;
 }
 
-static void rain1_init_io_replicas(struct vrt_request *vrt_req,
-                                   struct rdev_location rdev_loc[3],
-                                   unsigned int nb_rdev_loc, void *data,
-                                   uint32_t size, vrt_io_type_t io_type,
-                                   bool process_all_replicas)
+/**
+ * Reset the list of I/Os given by the VRT engine before filling it with
+ * replicas: the I/Os left without rdev are not used by the request.
+ *
+ * @param[in] vrt_req      The request header from the VRT engine
+ */
+static void rain1_reset_io_replicas(struct vrt_request *vrt_req)
 {
     struct vrt_io_op *io;
-    unsigned int dst;
-    unsigned int io_to_process = 0;
 
     /* Initialize barrier to BARRIER_DONT_PROCESS
      * FIXME why ? */
     vrt_req->barrier->state = BARRIER_DONT_PROCESS;
 
-    EXA_ASSERT(nb_rdev_loc >= 1);
-
-    for (dst = 0, io = vrt_req->io_list; io != NULL; io = io->next, dst++)
+    for (io = vrt_req->io_list; io != NULL; io = io->next)
     {
         io->state = IO_DONT_PROCESS;
+        /* set rdev to NULL: it will be used in rain1_fill_io_metadata_second */
+        io->rdev = NULL;
+    }
+}
+
+/**
+ * Fill the next I/Os of the list with the replicas of a piece of data.
+ *
+ * @param[in]     vrt_req  The request header from the VRT engine
+ * @param[in,out] io       The next unused I/O, updated to the one after
+ *                         the replicas
+ */
+static void rain1_add_io_replicas(struct vrt_request *vrt_req,
+                                  struct vrt_io_op **io,
+                                  struct rdev_location rdev_loc[3],
+                                  unsigned int nb_rdev_loc, void *data,
+                                  uint32_t size, vrt_io_type_t io_type,
+                                  bool process_all_replicas)
+{
+    unsigned int dst;
+    unsigned int io_to_process = 0;
+
+    EXA_ASSERT(nb_rdev_loc >= 1);
 
-	if (dst < nb_rdev_loc)
+    for (dst = 0; dst < nb_rdev_loc; dst++, *io = (*io)->next)
+    {
+        /* Not all the replicas can be written */
+        EXA_ASSERT_VERBOSE(*io != NULL,
+                           "Not enough IO in the writing request: i=%u nb_rdev_loc=%u\n",
+                           dst, nb_rdev_loc);
+
+	(*io)->iotype  = io_type;
+	(*io)->data    = data;
+	(*io)->size    = size;
+	(*io)->vrt_req = vrt_req;
+	(*io)->rdev    = rdev_loc[dst].rdev;
+	(*io)->offset  = rdev_loc[dst].sector;
+	if (rdev_loc[dst].uptodate || process_all_replicas)
 	{
-	    io->iotype  = io_type;
-	    io->data    = data;
-	    io->size    = size;
-	    io->vrt_req = vrt_req;
-	    io->rdev    = rdev_loc[dst].rdev;
-	    io->offset  = rdev_loc[dst].sector;
-	    if (rdev_loc[dst].uptodate || process_all_replicas)
-	    {
-		io->state   = IO_TO_PROCESS;
-		io_to_process++;
-	    }
+	    (*io)->state = IO_TO_PROCESS;
+	    io_to_process++;
 	}
-	else
-	    /* set rdev to NULL: it will be used in rain1_fill_io_metadata_second */
-	    io->rdev = NULL;
     }
 
-    /* Not all the replicas have been tested */
-    EXA_ASSERT_VERBOSE(dst >= nb_rdev_loc,
-		       "Not enough IO in the writing request: i=%u nb_rdev_loc=%u\n",
-		       dst, nb_rdev_loc);
     EXA_ASSERT(io_to_process > 0);
 }
 
 /**
  * Fill the list of I/Os given by the VRT engine for write requests when
  * we are in rebuilding. This will perform the I/Os sequentially: first
- * on up-to-date devices and then on non-up-to-date devices.
+ * on up-to-date devices and then on non-up-to-date devices. Each striping
+ * unit spanned by the request is written with its own I/Os.
  *
  * This function perform the 1st part.
  *
@@ -275,20 +327,34 @@ static void rain1_fill_io_write(struct vrt_request *vrt_req)
 {
     struct rdev_location rdev_loc[3];
     unsigned int nb_rdev_loc;
+    struct vrt_io_op *io;
+    uint64_t vsector = vrt_req->ref_bio->start_sector;
+    char *data = vrt_req->ref_bio->buf;
+    uint32_t remaining = vrt_req->ref_bio->size;
 
     EXA_ASSERT(vrt_req->iotype == VRT_IO_TYPE_WRITE
             || vrt_req->iotype == VRT_IO_TYPE_WRITE_BARRIER);
 
-    /* Convert the logical position on the volume into several physical positions. */
-    rain1_volume2rdev(RAIN1_GROUP(vrt_req->ref_vol->group),
-                      vrt_req->ref_vol->assembly_volume,
-                      vrt_req->ref_bio->start_sector,
-                      rdev_loc, &nb_rdev_loc, 3);
+    rain1_reset_io_replicas(vrt_req);
 
-    rain1_init_io_replicas(vrt_req, rdev_loc, nb_rdev_loc,
-                           vrt_req->ref_bio->buf, vrt_req->ref_bio->size,
-                           vrt_req->iotype, false /* don't process outdated
-                                                     replica */);
+    io = vrt_req->io_list;
+
+    do {
+        uint32_t size = rain1_req_su_part_size(vrt_req, vsector, remaining);
+
+        /* Convert the logical position on the volume into several physical positions. */
+        rain1_volume2rdev(RAIN1_GROUP(vrt_req->ref_vol->group),
+                          vrt_req->ref_vol->assembly_volume, vsector,
+                          rdev_loc, &nb_rdev_loc, 3);
+
+        rain1_add_io_replicas(vrt_req, &io, rdev_loc, nb_rdev_loc, data, size,
+                              vrt_req->iotype, false /* don't process outdated
+                                                        replica */);
+
+        vsector += BYTES_TO_SECTORS(size);
+        data += size;
+        remaining -= size;
+    } while (remaining > 0);
 }
 
 
@@ -341,6 +407,7 @@ static void rain1_fill_io_metadata(struct vrt_request *vrt_req)
 {
     struct rdev_location rdev_loc[3];
     unsigned int nb_rdev_loc;
+    struct vrt_io_op *io;
 
     rain1_group_t *lg = RAIN1_GROUP(vrt_req->ref_vol->group);
     unsigned int dzone_index, slot_index;
@@ -364,9 +431,12 @@ static void rain1_fill_io_metadata(struct vrt_request *vrt_req)
 
     process_all_replicas = !rain1_group_is_rebuilding(lg);
 
-    rain1_init_io_replicas(vrt_req, rdev_loc, nb_rdev_loc,
-                           block->in_memory_metadata, METADATA_BLOCK_SIZE,
-                           VRT_IO_TYPE_WRITE_BARRIER, process_all_replicas);
+    rain1_reset_io_replicas(vrt_req);
+
+    io = vrt_req->io_list;
+    rain1_add_io_replicas(vrt_req, &io, rdev_loc, nb_rdev_loc,
+                          block->in_memory_metadata, METADATA_BLOCK_SIZE,
+                          VRT_IO_TYPE_WRITE_BARRIER, process_all_replicas);
 }
 
 static bool rain1_fill_io_metadata_second(struct vrt_request *vrt_req)
@@ -406,7 +476,10 @@ static rain1_request_state_t rain1_metadata_write_needed(struct vrt_request *vrt
 
     os_thread_mutex_lock(&block->lock);
 
-    if (block->ongoing_flush)
+    /* Only the writes on a dirty zone that isn't already marked have to
+       wait for the block being flushed */
+    if (block->ongoing_flush
+        && !slot_desync_info_dzone_is_marked(block, dzone_index, lg->sync_tag))
     {
 	/* add the request in the waiting list */
 	list_add_tail(&vrt_req->wait_list, &block->wait_avail_list);
@@ -418,14 +491,18 @@ static rain1_request_state_t rain1_metadata_write_needed(struct vrt_request *vrt
     on_disk = &block->on_disk_metadata[dzone_index];
 
     in_mem->write_pending_counter++;
-    EXA_ASSERT(in_mem->write_pending_counter <= vrt_get_max_requests());
+    EXA_ASSERT(in_mem->write_pending_counter <= vrt_get_max_requests() + 1);
+
+    block->written[dzone_index] = true;
 
     /* We must write the metadata to the disk before performing the real
      * requests in two different cases:
      *
      * 1) The write_pending_counter is 1 in memory and 0 on disk, which means
      *     we're current the only write request on this dirty zone. So we must
-     *     mark it as being accessed before really writing to it.
+     *     mark it as being accessed before really writing to it. A dirty
+     *     zone retained after its last write is still marked on disk, so
+     *     writing it again does not need a metadata write.
      *
      * 2) The global sync_tag is different from the sync_tag
      *    of the dirty zone we're accessing. The global sync_tag is
@@ -562,13 +639,17 @@ static void schedule_requests_waiting_avail(slot_desync_info_t *block)
 
         in_mem = &block->in_memory_metadata[dzone_index];
 
-        metadata_flush_needed = (in_mem->write_pending_counter == 0
-                                 || sync_tag_is_greater(rxg->sync_tag, in_mem->sync_tag));
+        /* The dirty zone must be marked on disk too: the first request of
+           a dirty zone being marked would otherwise let the next ones
+           write before the marking is done */
+        metadata_flush_needed = !slot_desync_info_dzone_is_marked(block, dzone_index,
+                                                                  rxg->sync_tag);
 
-        EXA_ASSERT(in_mem->write_pending_counter < vrt_get_max_requests());
+        EXA_ASSERT(in_mem->write_pending_counter <= vrt_get_max_requests());
 
         in_mem->write_pending_counter++;
         in_mem->sync_tag = sync_tag_max(rxg->sync_tag, in_mem->sync_tag);
+        block->written[dzone_index] = true;
 
         if (!metadata_flush_needed)
         {
@@ -679,7 +760,7 @@ static void block_signal_metadata_write_end(struct vrt_request *vrt_req,
 /**
  * This function is called at the end of the write request. It allows
  * to decrement the pending write counter, so that when all writes are
- * done, the counter is equal to 0.
+ * done, the counter is equal to 0 (or 1 while the dirty zone is retained).
  *
  * @param[in] vrt_req The request
  */
@@ -689,7 +770,6 @@ static void block_signal_pending_write_end(struct vrt_request *vrt_req)
     rain1_group_t *lg = RAIN1_GROUP(vrt_req->ref_vol->group);
     assembly_volume_t *subspace = vrt_req->ref_vol->assembly_volume;
     slot_desync_info_t *block;
-    desync_info_t *in_mem;
 
     /* Find the dirty zone and the metadata block */
     rain1_volume2dzone(lg, subspace, vrt_req->ref_bio->start_sector,
@@ -699,13 +779,7 @@ static void block_signal_pending_write_end(struct vrt_request *vrt_req)
 
     os_thread_mutex_lock(&block->lock);
 
-    in_mem = &block->in_memory_metadata[dzone_index];
-
-    EXA_ASSERT(in_mem->write_pending_counter > 0);
-    in_mem->write_pending_counter--;
-
-    if (in_mem->write_pending_counter == 0)
-	block->flush_needed = true;
+    slot_desync_info_write_end(block, dzone_index);
 
     os_thread_mutex_unlock(&block->lock);
 }
@@ -1001,16 +1075,22 @@ void rain1_declare_io_needs(struct vrt_request *vrt_req,
                             unsigned int *io_count,
                             bool *sync_afterward)
 {
+    const rain1_group_t *rxg;
+
     EXA_ASSERT(vrt_req != NULL);
     EXA_ASSERT(io_count != NULL);
     EXA_ASSERT(sync_afterward != NULL);
 
+    rxg = RAIN1_GROUP(vrt_req->ref_vol->group);
+
     EXA_ASSERT(VRT_IO_TYPE_IS_VALID(vrt_req->iotype));
     switch (vrt_req->iotype)
     {
     case VRT_IO_TYPE_WRITE:
     case VRT_IO_TYPE_WRITE_BARRIER:
-	*io_count = 3;
+        /* The replicas of each striping unit, which are also enough for
+         * the replicas of the metadata block */
+	*io_count = 3 * vrt_request_get_nb_su(vrt_req, rxg->su_size);
         /* If the I/O type is WRITE_BARRIER, the VRT engine MUST
          * perform a barrier because it is requested by the upper
          * layer.
@@ -1022,7 +1102,7 @@ void rain1_declare_io_needs(struct vrt_request *vrt_req,
         break;
 
     case VRT_IO_TYPE_READ:
-	*io_count = 1;
+	*io_count = vrt_request_get_nb_su(vrt_req, rxg->su_size);
         *sync_afterward = false;
         break;
 
@@ -1030,3 +1110,20 @@ void rain1_declare_io_needs(struct vrt_request *vrt_req,
         EXA_ASSERT(false);
     }
 }
+
+/**
+ * Function called by the virtualizer to know how far a request starting at
+ * a given position can go. A request stays within a dirty zone, so that
+ * its writes only need the metadata of this dirty zone.
+ *
+ * @param[in] volume   The volume
+ * @param[in] vsector  Position of the request in the volume
+ *
+ * @return the maximum size of the request, in sectors
+ */
+uint64_t rain1_get_request_max_sectors(const struct vrt_volume *volume,
+                                       uint64_t vsector)
+{
+    return rain1_volume_dzone_remaining(RAIN1_GROUP(volume->group),
+                                        volume->assembly_volume, vsector);
+}
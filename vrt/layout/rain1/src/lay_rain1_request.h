@@ -22,6 +22,8 @@ void rain1_cancel_req (struct vrt_request *vrt_req);
 void rain1_declare_io_needs(struct vrt_request *vrt_req,
                             unsigned int *io_count,
                             bool *sync_afterward);
+uint64_t rain1_get_request_max_sectors(const struct vrt_volume *volume,
+                                       uint64_t vsector);
 
 void rain1_schedule_aggregated_metadata(slot_desync_info_t *block, bool failure);
 
@@ -224,7 +224,6 @@ static void slot_to_rdev_location(const rain1_group_t *rxg,
 	unsigned int chunk;
 	struct vrt_realdev *rdev;
 	uint64_t rdev_sector;
-        sync_tag_t max_sync_tag = SYNC_TAG_ZERO;
 
 	/* Store the current chunk index in the chain of chunk indexes */
 	chunk = (replica_chunk[i] + stripe) % slot->width;
@@ -234,12 +233,6 @@ static void slot_to_rdev_location(const rain1_group_t *rxg,
 			&rdev, &rdev_sector);
 	EXA_ASSERT(rdev);
 
-	/* we compute the maximum outdate tag in the chain of sparing 'correction'
-	 * that leads to this position. This maximum tag is used to find out if this
-	 * position is should have been replicated while it was down.
-	 */
-	max_sync_tag = sync_tag_max(max_sync_tag, RAIN1_REALDEV(rxg, rdev)->sync_tag);
-
 	/* Skip this replica position if the rain1 layout MUST NOT
 	 * write on this position.
 	 * We ensure that all the returned positions are writable.
@@ -257,8 +250,6 @@ static void slot_to_rdev_location(const rain1_group_t *rxg,
 	rdev_loc[*nb_rdev_loc].size = rxg->su_size - offset;
 	rdev_loc[*nb_rdev_loc].uptodate =
 		rain1_rdev_is_uptodate(RAIN1_REALDEV(rxg, rdev), rxg->sync_tag);
-	rdev_loc[*nb_rdev_loc].never_replicated =
-		sync_tag_is_greater(max_sync_tag, RAIN1_REALDEV(rxg, rdev)->sync_tag);
 
 	(*nb_rdev_loc)++;
     }
@@ -285,6 +276,22 @@ void rain1_volume2dzone(const rain1_group_t *rxg,
     EXA_ASSERT(*dzone_index_in_slot < rain1_group_get_dzone_per_slot_count(rxg));
 }
 
+uint64_t rain1_volume_dzone_remaining(const rain1_group_t *rxg,
+                                      const assembly_volume_t *av,
+                                      uint64_t vsector)
+{
+    uint64_t slot_data_size = rain1_group_get_slot_data_size(rxg);
+    unsigned int slot_index;
+    uint64_t offset_in_slot;
+
+    assembly_volume_map_sector_to_slot(av, slot_data_size, vsector,
+                                       &slot_index, &offset_in_slot);
+
+    /* The last dirty zone of a slot may be cut by the end of the slot */
+    return MIN(rxg->dirty_zone_size - offset_in_slot % rxg->dirty_zone_size,
+               slot_data_size - offset_in_slot);
+}
+
 void rain1_slot_raw2rdev(const rain1_group_t *rxg,
                          const slot_t *slot,
                          uint64_t ssector,
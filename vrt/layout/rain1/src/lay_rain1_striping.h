@@ -35,6 +35,19 @@ void rain1_volume2dzone(const rain1_group_t *rxg,
                         unsigned int *slot_index,
                         unsigned int *dzone_index_in_slot);
 
+/**
+ * Get the number of sectors from a position in a given volume to the end
+ * of the dirty zone containing it.
+ *
+ * @param[in]  rxg      The rain1 group supporting the volume
+ * @param[in]  av       The assembly volume supporting the volume
+ * @param[in]  vsector  The sector being accessed in the volume
+ *
+ * @return the number of sectors left in the dirty zone
+ */
+uint64_t rain1_volume_dzone_remaining(const rain1_group_t *rxg,
+                                      const assembly_volume_t *av,
+                                      uint64_t vsector);
 
 /**
  * Convert a logical position in the volume into an array of physical
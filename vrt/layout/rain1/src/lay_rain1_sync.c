@@ -54,9 +54,14 @@ typedef struct {
 } rebuild_data_t;
 
 typedef struct {
+    const slot_t *slot;
+    void *data;          /**< Opaque data passed to rebuild or resync */
     bool first_call;
+    bool done;           /**< No more block to synchronize */
+    bool pending;        /**< Next block found but not started yet */
     uint64_t next_su;
-    uint64_t next_part;
+    uint64_t next_offset;
+    uint64_t next_size;
 } slot_sync_context_t;
 
 static int rebuilding_slowdown_ms = 0;
@@ -115,13 +120,12 @@ static bool su_needs_rebuild(rain1_group_t *rxg,
             if (sector < slot_metadata_size)
                 return true;
 
-            /* the dirty zones are computed based on the data space */
+            /* the dirty zones are computed based on the data space. Even
+             * a blank device only gets the dirty zones written at least
+             * once: the others hold no data. */
             dzone_index = (sector - slot_metadata_size) / rxg->dirty_zone_size;
             if (MBLOCK_GET_BIT(rdev_ctx->dzone_to_rebuild, dzone_index))
                 return true;
-
-            if (rain1_rdev_location_update_needed(&rdev_loc[i]))
-                return true;
         }
     }
 
@@ -167,50 +171,48 @@ static bool su_needs_resync(rain1_group_t *rxg,
 
 
  /**
-  * Find the next striping unit and part of striping unit that must be syncronized.
+  * Find the next block of striping unit that must be syncronized.
   * If blksize is smaller than the striping unit size, then we need several steps
-  * to copy a single striping units. That's what 'next_part' is for.
+  * to copy a single striping units. That's what 'next_offset' is for.
   *
   * @param[in] rxg           The layout data
-  * @param[in] slot          The slot
   * @param[in] rebuild       true if rebuilding, false if resyncing
   * @param[in] blksize       The size of the blocks used to make the
-  *                          rebuilding or resync
+  *                          rebuilding or resync, which may change from
+  *                          one call to the other
   * @param[in:out] ctx       synchronization context to track progression.
   *
-  * Rq: The input values next_su/next_part are relevant only if the condition
-  *     first_call is false.
+  * Rq: The input values next_su/next_offset/next_size are relevant only if the
+  *     condition first_call is false.
   *
-  * @return true if it found a su/part to synchronize
+  * @return true if it found a block to synchronize
   */
-static bool get_next_su_and_part_to_sync(rain1_group_t *rxg,
-                                         const slot_t *slot,
-                                         bool rebuild, void *data,
-                                         unsigned int blksize,
-                                         slot_sync_context_t *ctx)
+static bool get_next_block_to_sync(rain1_group_t *rxg, bool rebuild,
+                                   unsigned int blksize,
+                                   slot_sync_context_t *ctx)
 {
     unsigned int i;
 
-    EXA_ASSERT(rxg->su_size % blksize == 0);
-
     /* First we look if there is more resync to do on current su
      * (if this is the first job there is nothing to continue)
      */
-    if (!ctx->first_call && ctx->next_part + 1 < rxg->su_size / blksize)
+    if (!ctx->first_call && ctx->next_offset + ctx->next_size < rxg->su_size)
     {
-        ctx->next_part++;
+        ctx->next_offset += ctx->next_size;
+        ctx->next_size = MIN(blksize, rxg->su_size - ctx->next_offset);
         return true;
     }
 
     for (i = ctx->first_call ? 0 : ctx->next_su + 1;
          i < rxg->logical_slot_size / rxg->su_size; i++)
     {
-        if ((rebuild && su_needs_rebuild(rxg, data, slot, i)) ||
-            (!rebuild && su_needs_resync(rxg, data, slot, i)))
+        if ((rebuild && su_needs_rebuild(rxg, ctx->data, ctx->slot, i)) ||
+            (!rebuild && su_needs_resync(rxg, ctx->data, ctx->slot, i)))
         {
-            ctx->next_su    = i;
-            ctx->next_part  = 0;
-            ctx->first_call = false;
+            ctx->next_su     = i;
+            ctx->next_offset = 0;
+            ctx->next_size   = MIN(blksize, rxg->su_size);
+            ctx->first_call  = false;
             return true;
         }
     }
@@ -218,16 +220,79 @@ static bool get_next_su_and_part_to_sync(rain1_group_t *rxg,
     return false;
 }
 
-void rain1_slot_sync_context_init(slot_sync_context_t *ctx)
+static void rain1_slot_sync_context_init(slot_sync_context_t *ctx,
+                                         const slot_t *slot, void *data)
+{
+    ctx->slot        = slot;
+    ctx->data        = data;
+    ctx->first_call  = true;
+    ctx->done        = false;
+    ctx->pending     = false;
+    ctx->next_offset = 0;
+    ctx->next_size   = 0;
+    ctx->next_su     = 0;
+}
+
+/**
+ * Find a block for an idle job, from the slots in turn.
+ *
+ * @return true if the job was prepared for a block
+ */
+static bool find_block_for_job(rain1_group_t *lg, slot_sync_context_t *slots,
+                               unsigned int nb_slots, unsigned int *next_slot,
+                               bool rebuild, sync_job_t *job)
 {
-    ctx->first_call = true;
-    ctx->next_part  = 0;
-    ctx->next_su    = 0;
+    sync_job_pool_t *pool = lg->sync_job_pool;
+    unsigned int k;
+
+    for (k = 0; k < nb_slots; k++)
+    {
+        slot_sync_context_t *ctx = &slots[(*next_slot + k) % nb_slots];
+
+        if (ctx->done)
+            continue;
+
+        if (!ctx->pending)
+        {
+            if (!get_next_block_to_sync(lg, rebuild, pool->qos.blksize, ctx))
+            {
+                ctx->done = true;
+                continue;
+            }
+            ctx->pending = true;
+        }
+
+        sync_job_prepare(job, lg, rebuild, ctx->slot, ctx->next_su,
+                         ctx->next_offset, ctx->next_size);
+
+        /* Keep the block for later, when its devices are less busy */
+        if (sync_job_pool_rdevs_busy(pool, job))
+            continue;
+
+        ctx->pending = false;
+        *next_slot = (*next_slot + k + 1) % nb_slots;
+        return true;
+    }
+
+    return false;
+}
+
+static bool all_slots_done(const slot_sync_context_t *slots,
+                           unsigned int nb_slots)
+{
+    unsigned int k;
+
+    for (k = 0; k < nb_slots; k++)
+        if (!slots[k].done)
+            return false;
+
+    return true;
 }
 
 /**
- * Synchronize the real devices of DZONE_PER_METADATA_BLOCK dirty zones. This
- * function is used for 3 different types of synchronization:
+ * Synchronize the real devices of the DZONE_PER_METADATA_BLOCK dirty zones of
+ * several slots at once. This function is used for 3 different types of
+ * synchronization:
  *
  * - resync, during which we have to synchronize an uptodate replica with all
  *   other replicas of the same striping unit. Such a synchronization occurs
@@ -249,43 +314,67 @@ void rain1_slot_sync_context_init(slot_sync_context_t *ctx)
  * rdev locations that are not uptodate for spare spaces in the case of
  * replicate.
  *
- * The caller specify if the dzones are dirty. If a dirty zone is dirty, all
- * its su will be synchronized. If not, only su tagged as "never replicated"
- * will be synchronized.
+ * Only the su of the dirty zones selected by the slot contexts data are
+ * synchronized, along with the metadata zones when rebuilding. A resync
+ * selects the dirty zones with pending writes. A rebuild selects, from the
+ * metadata blocks of all nodes, the dirty zones written since the device
+ * was up to date when updating, and the ones written at least once (whose
+ * sync tag is not SYNC_TAG_BLANK) when replicating.
+ *
+ * The jobs take their blocks from each slot in turn, so that all the devices
+ * of the slots are kept busy. A job doesn't start a block while one of its
+ * devices already has SYNC_JOB_MAX_PER_RDEV jobs in flight: the blocks of
+ * the other slots go on while a slow device catches up.
  *
- * @param[in] slot         Index of the slot to synchronize
  * @param[in] lg           The rain1 group data
+ * @param[in] slots        Contexts of the slots to synchronize
+ * @param[in] nb_slots     Number of slots
  * @param[in] rebuild      Is the synchronization triggered by a rebuilding
  *                         (if not it means it has been triggered by a resync)
- * @param[in] slowdown_ms  Amount of ms to sleep when a job finishes.
- * @param[in] data         Opaque data passed to rebuild or resync.
+ * @param[in] slowdown_ms  Amount of ms to sleep when a job finishes, unless
+ *                         the rate is controlled by a latency target.
  *
  * @return EXA_SUCESS on success, a negative error code on failure
  */
-static int synchronize_slot(const slot_t *slot, rain1_group_t *lg,
-                            bool rebuild, int slowdown_ms, void *data)
+static int synchronize_slots(rain1_group_t *lg, slot_sync_context_t *slots,
+                             unsigned int nb_slots, bool rebuild,
+                             int slowdown_ms)
 {
-    slot_sync_context_t ctx;
-    unsigned int njobs, blksize;
+    sync_job_pool_t *pool = lg->sync_job_pool;
+    sync_qos_t *qos = &pool->qos;
+    unsigned int njobs;
     sync_job_t *jobs;
+    unsigned int next_slot = 0;
+    bool resume_parked = false;
     int error = EXA_SUCCESS;
     int i;
 
-    njobs   = lg->sync_job_pool->nb_jobs;
-    blksize = lg->sync_job_pool->block_size;
-    jobs    = lg->sync_job_pool->jobs;
+    njobs   = pool->nb_jobs;
+    jobs    = pool->jobs;
 
     EXA_ASSERT(jobs != NULL && njobs > 0);
+    EXA_ASSERT(nb_slots > 0);
 
     /* Initialize the jobs */
-    sync_job_pool_init(lg->sync_job_pool);
+    sync_job_pool_init(pool);
 
-    rain1_slot_sync_context_init(&ctx);
+    sync_qos_start(qos, lg, slowdown_ms);
 
-    while (sync_job_pool_is_any_active(lg->sync_job_pool))
+    while (sync_job_pool_is_any_active(pool))
     {
         sync_job_t *job = NULL;
 
+        /* Resume the jobs parked until a job is done, which frees its
+         * devices and may change the rate */
+        if (resume_parked && !all_slots_done(slots, nb_slots))
+            for (i = 0; i < qos->nb_jobs; i++)
+                if (jobs[i].parked)
+                {
+                    jobs[i].parked = false;
+                    jobs[i].active = true;
+                }
+        resume_parked = false;
+
   	for (i = 0; i < njobs; i++)
  	    if (jobs[i].completed && jobs[i].active)
  		break;
@@ -293,69 +382,105 @@ static int synchronize_slot(const slot_t *slot, rain1_group_t *lg,
         /* If no job has finished a step, wait for completion */
         if (i == njobs)
         {
-            sync_job_pool_wait_step_completion(lg->sync_job_pool);
+            sync_job_pool_wait_step_completion(pool);
             continue;
         }
 
         job = &jobs[i];
 
+        /* The error of a step is overwritten by the next steps of the job:
+         * keep the first one */
+        if (job->error != EXA_SUCCESS && error == EXA_SUCCESS)
+        {
+            error = job->error;
+            exalog_debug("Job %i failed with error %s (%d)",
+                         i, exa_error_msg(error), error);
+        }
+
         EXA_ASSERT(SYNC_JOB_STEP_IS_VALID(job->step));
         switch(job->step)
         {
         case SYNC_JOB_IDLE:
+            /* Too many jobs in flight for the rate allowed */
+            if (i >= qos->nb_jobs)
+            {
+                exalog_debug("Job %i is parked", i);
+                job->active = false;
+                job->parked = true;
+                break;
+            }
+
             /* Look for some synchronization work to do */
-            if (!get_next_su_and_part_to_sync(lg, slot, rebuild, data,
-                                              blksize, &ctx))
+            if (!find_block_for_job(lg, slots, nb_slots, &next_slot,
+                                    rebuild, job))
             {
-                exalog_debug("Job %i is no more active", i);
-                job->error  = EXA_SUCCESS;
                 job->active = false;
+
+                if (all_slots_done(slots, nb_slots))
+                    exalog_debug("Job %i is no more active", i);
+                else
+                {
+                    /* All the blocks left are on busy devices */
+                    exalog_debug("Job %i is parked", i);
+                    job->parked = true;
+                }
                 break;
             }
 
-            sync_job_prepare(job, lg, rebuild, slot, ctx.next_su, ctx.next_part);
+            sync_job_pool_take_rdevs(pool, job);
 
             if (rebuild)
-                if (sync_job_lock(job, blksize) != EXA_SUCCESS)
+                if (sync_job_lock(job) != EXA_SUCCESS)
+                {
+                    sync_job_pool_release_rdevs(pool, job);
+                    resume_parked = true;
                     break;
+                }
 
-            exalog_debug("Job %i is reading su=%"PRIu64" and part=%"PRIu64,
-                         i, job->su, job->part);
+            exalog_debug("Job %i is reading su=%"PRIu64" and offset=%"PRIu64,
+                         i, job->su, job->offset);
 
-            sync_job_read(job, blksize);
+            sync_job_read(job);
             break;
 
         case SYNC_JOB_WRITE:
-            exalog_debug("Job %i is writing su=%"PRIu64" and part=%"PRIu64,
-                         i, job->su, job->part);
-            sync_job_write(job, blksize);
+            exalog_debug("Job %i is writing su=%"PRIu64" and offset=%"PRIu64,
+                         i, job->su, job->offset);
+            sync_job_write(job);
             break;
 
         case SYNC_JOB_UNLOCK:
-            exalog_debug("Job %i complete treatment of su=%"PRIu64" and part=%"PRIu64,
-                         i, ctx.next_su, ctx.next_part);
+            exalog_debug("Job %i complete treatment of su=%"PRIu64" and offset=%"PRIu64,
+                         i, job->su, job->offset);
+
+            sync_job_pool_release_rdevs(pool, job);
+            resume_parked = true;
 
             if (rebuild)
-                if (sync_job_unlock(job, blksize) != EXA_SUCCESS)
+                if (sync_job_unlock(job) != EXA_SUCCESS)
                     break;
 
-            if (slowdown_ms != 0)
-                os_millisleep(slowdown_ms);
+            sync_qos_update(qos, lg);
+
+            if (qos->delay_ms != 0)
+                os_millisleep(qos->delay_ms);
 
             job->step = SYNC_JOB_IDLE;
             break;
         }
     }
 
+    /* Jobs whose lock or unlock failed were stopped right away */
     for (i = 0; i < njobs; i++)
         if (jobs[i].error != EXA_SUCCESS)
         {
-            error = jobs[i].error;
-            exalog_debug("Job %i finished with error %s (%d)",
-                         i, exa_error_msg(error), error);
+            exalog_debug("Job %i finished with error %s (%d)", i,
+                         exa_error_msg(jobs[i].error), jobs[i].error);
+            if (error == EXA_SUCCESS)
+                error = jobs[i].error;
         }
 
-    sync_job_pool_clear(lg->sync_job_pool);
+    sync_job_pool_clear(pool);
 
     return error;
 }
@@ -373,6 +498,7 @@ static int slot_resync(const slot_t *slot, rain1_group_t *lg,
                        const exa_nodeset_t *nodes)
 {
     mblock_bitfield_t dzone_to_resync;
+    slot_sync_context_t ctx;
     uint node, j;
     int err;
     bool do_resync = false;
@@ -423,8 +549,10 @@ static int slot_resync(const slot_t *slot, rain1_group_t *lg,
     if (!do_resync)
         return EXA_SUCCESS;
 
-    err = synchronize_slot(slot, lg, false /* not rebuilding */,
-                           0 /* no slowdown */, &dzone_to_resync);
+    rain1_slot_sync_context_init(&ctx, slot, &dzone_to_resync);
+
+    err = synchronize_slots(lg, &ctx, 1, false /* not rebuilding */,
+                            0 /* no slowdown */);
     if (err != EXA_SUCCESS)
         return err;
 
@@ -660,7 +788,8 @@ typedef struct {
     exa_uuid_t current_subspace_uuid;
     uint64_t current_slot_index;
     uint64_t nb_slots_synchronized;
-    rebuild_data_t rebuild_data;
+    /** Rebuilding description of each slot in flight */
+    rebuild_data_t rebuild_data[RAIN1_SYNC_SLOTS_IN_FLIGHT];
     rain1_rebuild_step_t step;
     sync_tag_t sync_tag;
 } rain1_rebuild_context_t;
@@ -701,32 +830,19 @@ void rain1_group_rebuild_context_free(void *context)
     os_free(context);
 }
 
-static int rain1_group_rebuild_slot(rain1_group_t *rxg, const slot_t *slot,
-                                    rain1_rebuild_context_t *ctx)
-{
-    int slowdown_ms;
-    int ret = rain1_group_rebuild_get_dirty_zones(rxg, slot, &ctx->rebuild_data);
-    if (ret != EXA_SUCCESS)
-	return ret;
-
-    if (ctx->group->status == EXA_GROUP_DEGRADED)
-        slowdown_ms = degraded_rebuilding_slowdown_ms;
-    else
-        slowdown_ms = rebuilding_slowdown_ms;
-
-    return synchronize_slot(slot, rxg, true /* rebuilding */, slowdown_ms,
-                           &ctx->rebuild_data);
-}
-
-static int rain1_group_rebuild_next_slot(rain1_rebuild_context_t *ctx)
+/**
+ * Move the rebuild to the next slot.
+ *
+ * @param     ctx  The rebuild context
+ * @param[in] lg   The rain1 group
+ *
+ * @return the slot, or NULL if all the slots were rebuilt
+ */
+static const slot_t *rain1_group_rebuild_advance_slot(rain1_rebuild_context_t *ctx,
+                                                      rain1_group_t *lg)
 {
-    rain1_group_t *lg;
-    const slot_t *slot;
     assembly_volume_t *subspace;
-    int err;
-
-    EXA_ASSERT(ctx->group != NULL);
-    lg = RAIN1_GROUP(ctx->group);
+    const slot_t *slot;
 
     subspace = assembly_group_lookup_volume(&lg->assembly_group,
                                             &ctx->current_subspace_uuid);
@@ -739,22 +855,16 @@ static int rain1_group_rebuild_next_slot(rain1_rebuild_context_t *ctx)
         ctx->current_slot_index++;
 
     if (subspace == NULL)
-    {
         /* Nothing to do. */
-        ctx->step = RAIN1_REBUILD_FINISH;
-        return EXA_SUCCESS;
-    }
+        return NULL;
 
-    if (ctx->current_slot_index >= subspace->total_slots_count)
+    while (ctx->current_slot_index >= subspace->total_slots_count)
     {
         /* We finished the current subspace. */
         subspace = subspace->next;
         if (subspace == NULL)
-        {
             /* We're done. */
-            ctx->step = RAIN1_REBUILD_FINISH;
-            return EXA_SUCCESS;
-        }
+            return NULL;
 
         /* Start working on the next subspace. */
         ctx->current_slot_index = 0;
@@ -765,17 +875,88 @@ static int rain1_group_rebuild_next_slot(rain1_rebuild_context_t *ctx)
     slot = subspace->slots[ctx->current_slot_index];
     EXA_ASSERT (slot != NULL);
 
-    err = rain1_group_rebuild_slot(lg, slot, ctx);
+    return slot;
+}
+
+/**
+ * Rebuild the next RAIN1_SYNC_SLOTS_IN_FLIGHT slots at once, so that the
+ * IOs are spread over the devices of all of them.
+ */
+static int rain1_group_rebuild_next_slots(rain1_rebuild_context_t *ctx)
+{
+    slot_sync_context_t slots[RAIN1_SYNC_SLOTS_IN_FLIGHT];
+    unsigned int nb_slots = 0;
+    uint64_t first_slot_index = 0;
+    exa_uuid_t first_subspace_uuid;
+    exa_uuid_t prev_subspace_uuid;
+    uint64_t prev_slot_index;
+    rain1_group_t *lg;
+    int slowdown_ms;
+    int err;
+
+    EXA_ASSERT(ctx->group != NULL);
+    lg = RAIN1_GROUP(ctx->group);
+
+    /* Where to resume if the slots can't be all rebuilt */
+    uuid_copy(&prev_subspace_uuid, &ctx->current_subspace_uuid);
+    prev_slot_index = ctx->current_slot_index;
+
+    while (nb_slots < RAIN1_SYNC_SLOTS_IN_FLIGHT)
+    {
+        const slot_t *slot = rain1_group_rebuild_advance_slot(ctx, lg);
+
+        if (slot == NULL)
+            break;
+
+        if (nb_slots == 0)
+        {
+            first_slot_index = ctx->current_slot_index;
+            uuid_copy(&first_subspace_uuid, &ctx->current_subspace_uuid);
+        }
+
+        err = rain1_group_rebuild_get_dirty_zones(lg, slot,
+                                                  &ctx->rebuild_data[nb_slots]);
+        if (err != EXA_SUCCESS)
+        {
+            exalog_error("Failed to read the metadata of slot %"PRIu64" of subspace "
+                         UUID_FMT ": %s (%d)", ctx->current_slot_index,
+                         UUID_VAL(&ctx->current_subspace_uuid),
+                         exa_error_msg(err), err);
+            uuid_copy(&ctx->current_subspace_uuid, &prev_subspace_uuid);
+            ctx->current_slot_index = prev_slot_index;
+            return err;
+        }
+
+        rain1_slot_sync_context_init(&slots[nb_slots], slot,
+                                     &ctx->rebuild_data[nb_slots]);
+        nb_slots++;
+    }
+
+    if (nb_slots == 0)
+    {
+        ctx->step = RAIN1_REBUILD_FINISH;
+        return EXA_SUCCESS;
+    }
+
+    if (ctx->group->status == EXA_GROUP_DEGRADED)
+        slowdown_ms = degraded_rebuilding_slowdown_ms;
+    else
+        slowdown_ms = rebuilding_slowdown_ms;
+
+    err = synchronize_slots(lg, slots, nb_slots, true /* rebuilding */,
+                            slowdown_ms);
     if (err != EXA_SUCCESS)
     {
-        exalog_error("Failed to synchronize slot %"PRIu64" of subspace "
-                     UUID_FMT ": %s (%d)", ctx->current_slot_index,
-                     UUID_VAL(&subspace->uuid),
+        exalog_error("Failed to synchronize %u slots from slot %"PRIu64
+                     " of subspace " UUID_FMT ": %s (%d)", nb_slots,
+                     first_slot_index, UUID_VAL(&first_subspace_uuid),
                      exa_error_msg(err), err);
+        uuid_copy(&ctx->current_subspace_uuid, &prev_subspace_uuid);
+        ctx->current_slot_index = prev_slot_index;
         return err;
     }
 
-    ctx->nb_slots_synchronized++;
+    ctx->nb_slots_synchronized += nb_slots;
     update_rebuild_progression(lg, ctx->nb_slots_synchronized);
 
     return EXA_SUCCESS;
@@ -818,6 +999,7 @@ int rain1_group_rebuild_step(void *context, bool *more_work)
 {
     rain1_rebuild_context_t *ctx = context;
     rain1_group_t *lg;
+    int i;
 
     EXA_ASSERT(ctx->group);
     lg = RAIN1_GROUP(ctx->group);
@@ -854,15 +1036,18 @@ int rain1_group_rebuild_step(void *context, bool *more_work)
             || !rain1_group_is_rebuilding(lg))
             return EXA_SUCCESS;
 
-        if (!rdev_context_array_init(&ctx->rebuild_data, lg))
+        if (!rdev_context_array_init(&ctx->rebuild_data[0], lg))
             return EXA_SUCCESS;
 
+        for (i = 1; i < RAIN1_SYNC_SLOTS_IN_FLIGHT; i++)
+            rdev_context_array_init(&ctx->rebuild_data[i], lg);
+
         *more_work = true;
         ctx->step = RAIN1_REBUILD_SLOTS;
         /* Fallback: start rebuild first slot */
     case RAIN1_REBUILD_SLOTS:
         *more_work = true;
-        return rain1_group_rebuild_next_slot(ctx);
+        return rain1_group_rebuild_next_slots(ctx);
     case RAIN1_REBUILD_FINISH:
         *more_work = false;
         return rain1_group_rebuild_finish(ctx);
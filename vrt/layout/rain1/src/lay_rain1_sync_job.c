@@ -12,6 +12,8 @@
 #include "log/include/log.h"
 #include "os/include/os_mem.h"
 
+#include <string.h>
+
 #include "vrt/layout/rain1/src/lay_rain1_striping.h"
 #include "vrt/virtualiseur/include/vrt_request.h"
 
@@ -38,6 +40,8 @@ sync_job_pool_t *sync_job_pool_alloc(unsigned int blksize, unsigned int nb_jobs)
     job_pool->nb_jobs = nb_jobs;
     job_pool->block_size = blksize;
 
+    sync_qos_init(&job_pool->qos, nb_jobs, blksize);
+
     /* Allocate the buffers for the IOs */
     for (i = 0; i < nb_jobs; i++)
     {
@@ -80,16 +84,20 @@ void sync_job_pool_init(sync_job_pool_t *job_pool)
 
     os_sem_init(&job_pool->sem, 0);
 
+    memset(job_pool->jobs_on_rdev, 0, sizeof(job_pool->jobs_on_rdev));
+
     for (i = 0; i < job_pool->nb_jobs; i++)
     {
 	sync_job_t *job = &job_pool->jobs[i];
 
 	job->completed = true;
 	job->active    = true;
+	job->parked    = false;
 	job->error     = EXA_SUCCESS;
 	job->step      = SYNC_JOB_IDLE;
 	job->su        = 0;
-	job->part      = 0;
+	job->offset    = 0;
+	job->size      = 0;
 	job->sem       = &job_pool->sem;
 
 	job->locked_rd              = NULL;
@@ -108,12 +116,12 @@ void sync_job_pool_clear(sync_job_pool_t *job_pool)
 	/* Unlock remaining locks */
 	if (job->locked_rd)
         {
-            exalog_warning("Job %u still got a lock su=%"PRIu64" and part=%"PRIu64
+            exalog_warning("Job %u still got a lock su=%"PRIu64" and offset=%"PRIu64
                            " -> force unlock",
-                           i, job->su, job->part);
+                           i, job->su, job->offset);
 	    vrt_rdev_unlock_sectors(job->locked_rd,
                                     job->locked_rd_sector_start,
-                                    job_pool->block_size);
+                                    job->size);
         }
     }
 
@@ -145,7 +153,7 @@ void sync_job_pool_wait_step_completion(sync_job_pool_t *job_pool)
 
 void sync_job_prepare(sync_job_t *job, rain1_group_t *rxg,
                       bool rebuild, const slot_t *slot,
-                      uint64_t su, uint64_t part)
+                      uint64_t su, uint64_t offset, uint64_t size)
 {
     unsigned int i, nb_src, nb_dst;
     struct rdev_location rdev_loc[3];
@@ -184,10 +192,50 @@ void sync_job_prepare(sync_job_t *job, rain1_group_t *rxg,
     job->nb_dst         = nb_dst;
     job->nb_dst_written = 0;
     job->su             = su;
-    job->part           = part;
+    job->offset         = offset;
+    job->size           = size;
+}
+
+bool sync_job_pool_rdevs_busy(const sync_job_pool_t *job_pool,
+                              const sync_job_t *job)
+{
+    unsigned int i;
+
+    if (job_pool->jobs_on_rdev[job->src_rdev_loc.rdev->index] >= SYNC_JOB_MAX_PER_RDEV)
+        return true;
+
+    for (i = 0; i < job->nb_dst; i++)
+        if (job_pool->jobs_on_rdev[job->dst_rdev_loc[i].rdev->index]
+            >= SYNC_JOB_MAX_PER_RDEV)
+            return true;
+
+    return false;
+}
+
+void sync_job_pool_take_rdevs(sync_job_pool_t *job_pool, const sync_job_t *job)
+{
+    unsigned int i;
+
+    job_pool->jobs_on_rdev[job->src_rdev_loc.rdev->index]++;
+    for (i = 0; i < job->nb_dst; i++)
+        job_pool->jobs_on_rdev[job->dst_rdev_loc[i].rdev->index]++;
+}
+
+void sync_job_pool_release_rdevs(sync_job_pool_t *job_pool, const sync_job_t *job)
+{
+    unsigned int i;
+
+    EXA_ASSERT(job_pool->jobs_on_rdev[job->src_rdev_loc.rdev->index] > 0);
+    job_pool->jobs_on_rdev[job->src_rdev_loc.rdev->index]--;
+
+    for (i = 0; i < job->nb_dst; i++)
+    {
+        EXA_ASSERT(job_pool->jobs_on_rdev[job->dst_rdev_loc[i].rdev->index] > 0);
+        job_pool->jobs_on_rdev[job->dst_rdev_loc[i].rdev->index]--;
+    }
 }
 
-int sync_job_lock(sync_job_t *job, uint64_t blksize)
+int sync_job_lock(sync_job_t *job)
 {
     int ret;
 
@@ -199,10 +247,10 @@ int sync_job_lock(sync_job_t *job, uint64_t blksize)
      */
 
     job->locked_rd = job->dst_rdev_loc[0].rdev;
-    job->locked_rd_sector_start = job->dst_rdev_loc[0].sector + job->part * blksize;
+    job->locked_rd_sector_start = job->dst_rdev_loc[0].sector + job->offset;
 
     ret = vrt_rdev_lock_sectors(job->locked_rd, job->locked_rd_sector_start,
-                                blksize);
+                                job->size);
     if (ret != EXA_SUCCESS)
     {
         job->locked_rd = NULL;
@@ -214,13 +262,13 @@ int sync_job_lock(sync_job_t *job, uint64_t blksize)
     return ret;
 }
 
-int sync_job_unlock(sync_job_t *job, uint64_t blksize)
+int sync_job_unlock(sync_job_t *job)
 {
     /* Unlock previous round */
     if (job->locked_rd)
     {
         int ret = vrt_rdev_unlock_sectors(job->locked_rd, job->locked_rd_sector_start,
-                                          blksize);
+                                          job->size);
         if (ret != EXA_SUCCESS)
         {
             job->error  = ret;
@@ -263,25 +311,25 @@ static void sync_job_w_endio(blockdevice_io_t *bio, int error)
     sync_job_signal_step_completed(job);
 }
 
-void sync_job_read(sync_job_t *job, uint64_t blksize)
+void sync_job_read(sync_job_t *job)
 {
     job->completed = false;
 
     __blockdevice_submit_io(job->src_rdev_loc.rdev->blockdevice, &job->bio,
                             BLOCKDEVICE_IO_READ,
-                            job->src_rdev_loc.sector + job->part * blksize,
-                            job->buffer, SECTORS_TO_BYTES(blksize), false,
+                            job->src_rdev_loc.sector + job->offset,
+                            job->buffer, SECTORS_TO_BYTES(job->size), false,
                             true /* bypass_lock */, job, sync_job_r_endio);
 }
 
-void sync_job_write(sync_job_t *job, uint64_t blksize)
+void sync_job_write(sync_job_t *job)
 {
     EXA_ASSERT(job->nb_dst_written < job->nb_dst);
     job->completed = false;
 
     __blockdevice_submit_io(job->dst_rdev_loc[job->nb_dst_written].rdev->blockdevice,
                             &job->bio, BLOCKDEVICE_IO_WRITE,
-                            job->dst_rdev_loc[job->nb_dst_written].sector + job->part * blksize,
-                            job->buffer, SECTORS_TO_BYTES(blksize), true,
+                            job->dst_rdev_loc[job->nb_dst_written].sector + job->offset,
+                            job->buffer, SECTORS_TO_BYTES(job->size), true,
                             true /* bypass_lock */, job, sync_job_w_endio);
 }
@@ -11,10 +11,15 @@
 
 #include "vrt/layout/rain1/src/lay_rain1_group.h"
 #include "vrt/layout/rain1/src/lay_rain1_rdev.h"
+#include "vrt/layout/rain1/src/lay_rain1_sync_qos.h"
 
 #include "os/include/os_inttypes.h"
 #include "os/include/os_semaphore.h"
 
+/** Maximum number of jobs in flight reading or writing a given device, so
+ * that a slow device does not hold all the jobs */
+#define SYNC_JOB_MAX_PER_RDEV  8
+
 typedef enum
 {
 #define SYNC_JOB_STEP__FIRST SYNC_JOB_WRITE
@@ -38,12 +43,14 @@ typedef struct
     blockdevice_io_t bio;
     void * buffer;
     uint64_t su;
-    unsigned long part;
+    uint64_t offset;            /**< Start of the block in the su, in sectors */
+    uint64_t size;              /**< Size of the block, in sectors */
     sync_job_step_t step;
     struct vrt_realdev *locked_rd;
     uint64_t locked_rd_sector_start;
     bool completed;
     bool active;
+    bool parked;                /**< Inactive because of the rate control */
     int error;
     os_sem_t *sem;
 
@@ -59,9 +66,12 @@ typedef struct
 typedef struct sync_job_pool
 {
     unsigned int nb_jobs;
-    unsigned int block_size;
+    unsigned int block_size;    /**< Size of the buffers, in sectors */
     sync_job_t *jobs;
     os_sem_t sem;
+    sync_qos_t qos;
+    /** Number of jobs in flight on each device, by index of the device */
+    unsigned int jobs_on_rdev[NBMAX_DISKS_PER_GROUP];
 } sync_job_pool_t;
 
 /**
@@ -103,11 +113,24 @@ void sync_job_pool_wait_step_completion(sync_job_pool_t *job_pool);
 
 void sync_job_prepare(sync_job_t *job, rain1_group_t *rxg,
                       bool rebuild, const slot_t *slot,
-                      uint64_t su, uint64_t part);
+                      uint64_t su, uint64_t offset, uint64_t size);
+
+/**
+ * Test if a job prepared can't start because one of the devices it reads
+ * or writes has already SYNC_JOB_MAX_PER_RDEV jobs in flight.
+ */
+bool sync_job_pool_rdevs_busy(const sync_job_pool_t *job_pool,
+                              const sync_job_t *job);
+
+/**
+ * Account for the devices of a job starting or being done.
+ */
+void sync_job_pool_take_rdevs(sync_job_pool_t *job_pool, const sync_job_t *job);
+void sync_job_pool_release_rdevs(sync_job_pool_t *job_pool, const sync_job_t *job);
 
-int sync_job_lock(sync_job_t *job, uint64_t blksize);
-int sync_job_unlock(sync_job_t *job, uint64_t blksize);
-void sync_job_read(sync_job_t *job, uint64_t blksize);
-void sync_job_write(sync_job_t *job, uint64_t blksize);
+int sync_job_lock(sync_job_t *job);
+int sync_job_unlock(sync_job_t *job);
+void sync_job_read(sync_job_t *job);
+void sync_job_write(sync_job_t *job);
 
 #endif
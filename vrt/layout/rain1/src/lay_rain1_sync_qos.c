@@ -0,0 +1,178 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include "vrt/layout/rain1/src/lay_rain1_sync_qos.h"
+
+#include "vrt/layout/rain1/src/lay_rain1_rdev.h"
+#include "vrt/virtualiseur/include/vrt_realdev.h"
+
+#include "common/include/exa_assert.h"
+#include "common/include/exa_math.h"
+#include "log/include/log.h"
+
+#include "os/include/os_time.h"
+
+#include <string.h>
+
+static uint64_t latency_target_us = 0;
+
+void rain1_set_sync_latency_target(int target_ms)
+{
+    if (target_ms < 0)
+        target_ms = 0;
+
+    latency_target_us = (uint64_t)MIN(target_ms, SYNC_QOS_MAX_TARGET_MS) * 1000;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Latencies of all the foreground IOs done on the devices of the group.
+ * The IOs of the synchronization are not submitted through the VRT engine,
+ * so they are not counted. */
+static void foreground_latencies(const rain1_group_t *rxg,
+                                 exa_histogram_snapshot_t *snap,
+                                 int *queue_depth)
+{
+    exa_histogram_snapshot_t rdev_snap;
+    rain1_realdev_t *lr;
+    unsigned int i, b;
+    int type;
+
+    memset(snap, 0, sizeof(*snap));
+    *queue_depth = 0;
+
+    foreach_rainx_rdev(rxg, lr, i)
+    {
+        *queue_depth = MAX(*queue_depth, vrt_rdev_inflight_ios(lr->rdev));
+
+        for (type = 0; type < VRT_LATENCY_TYPES; type++)
+        {
+            exa_histogram_snapshot(&lr->rdev->latency[type], &rdev_snap);
+
+            snap->total += rdev_snap.total;
+            for (b = 0; b < EXA_HISTOGRAM_NB_BUCKETS; b++)
+                snap->count[b] += rdev_snap.count[b];
+        }
+    }
+}
+
+void sync_qos_init(sync_qos_t *qos, unsigned int max_jobs,
+                   unsigned int max_blksize)
+{
+    EXA_ASSERT(max_jobs > 0 && max_blksize > 0);
+
+    memset(qos, 0, sizeof(*qos));
+
+    qos->max_jobs = max_jobs;
+    qos->nb_jobs = max_jobs;
+    qos->max_blksize = max_blksize;
+    qos->blksize = max_blksize;
+}
+
+void sync_qos_start(sync_qos_t *qos, const rain1_group_t *rxg,
+                    int slowdown_ms)
+{
+    int queue_depth;
+
+    qos->target_us = latency_target_us;
+
+    if (qos->target_us == 0)
+    {
+        qos->nb_jobs = qos->max_jobs;
+        qos->blksize = qos->max_blksize;
+        qos->delay_ms = slowdown_ms;
+        return;
+    }
+
+    qos->window_start_ms = now_ms();
+    foreground_latencies(rxg, &qos->window_start, &queue_depth);
+}
+
+void sync_qos_update(sync_qos_t *qos, const rain1_group_t *rxg)
+{
+    exa_histogram_snapshot_t current;
+    uint64_t now = now_ms();
+    int queue_depth;
+    unsigned int b;
+
+    if (qos->target_us == 0 || now < qos->window_start_ms + SYNC_QOS_PERIOD_MS)
+        return;
+
+    foreground_latencies(rxg, &current, &queue_depth);
+
+    /* Keep only the IOs of the period in the window. The latencies of the
+     * devices are reset along with their statistics: if so, all the IOs
+     * recorded are taken. */
+    for (b = 0; b < EXA_HISTOGRAM_NB_BUCKETS; b++)
+        if (current.count[b] < qos->window_start.count[b])
+            break;
+
+    if (b == EXA_HISTOGRAM_NB_BUCKETS && current.total >= qos->window_start.total)
+    {
+        exa_histogram_snapshot_t window;
+
+        window.total = current.total - qos->window_start.total;
+        for (b = 0; b < EXA_HISTOGRAM_NB_BUCKETS; b++)
+            window.count[b] = current.count[b] - qos->window_start.count[b];
+
+        sync_qos_adjust(qos, exa_histogram_percentile(&window, 99),
+                        window.total, queue_depth);
+    }
+    else
+        sync_qos_adjust(qos, exa_histogram_percentile(&current, 99),
+                        current.total, queue_depth);
+
+    qos->window_start = current;
+    qos->window_start_ms = now;
+}
+
+void sync_qos_adjust(sync_qos_t *qos, uint64_t p99_us, uint64_t nb_ios,
+                     int queue_depth)
+{
+    unsigned int min_blksize = MIN(qos->max_blksize, SYNC_QOS_MIN_BLKSIZE);
+
+    if (qos->target_us == 0)
+        return;
+
+    if (nb_ios >= SYNC_QOS_MIN_IOS && p99_us > qos->target_us)
+    {
+        /* Slow down: fewer jobs, then smaller blocks, then pauses */
+        if (qos->nb_jobs > 1)
+            qos->nb_jobs /= 2;
+        else if (qos->blksize > min_blksize)
+            qos->blksize = MAX(qos->blksize / 2, min_blksize);
+        else
+            qos->delay_ms = MIN(MAX(2 * qos->delay_ms, 1), SYNC_QOS_MAX_DELAY_MS);
+    }
+    else if (nb_ios < SYNC_QOS_MIN_IOS
+             || (p99_us <= qos->target_us * 3 / 4
+                 && queue_depth <= SYNC_QOS_MAX_QUEUE_DEPTH))
+    {
+        /* Speed up the other way round, the jobs one at a time */
+        if (qos->delay_ms > 0)
+            qos->delay_ms /= 2;
+        else if (qos->blksize < qos->max_blksize)
+            qos->blksize = MIN(2 * qos->blksize, qos->max_blksize);
+        else if (qos->nb_jobs < qos->max_jobs)
+            qos->nb_jobs++;
+    }
+    else
+        /* Close to the target: keep the rate */
+        return;
+
+    exalog_debug("Synchronization rate: %u jobs of %u sectors, %u ms pause"
+                 " (p99 %" PRIu64 " us on %" PRIu64 " IOs, queue depth %d)",
+                 qos->nb_jobs, qos->blksize, qos->delay_ms, p99_us, nb_ios,
+                 queue_depth);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#ifndef __RAIN1_SYNC_QOS_H__
+#define __RAIN1_SYNC_QOS_H__
+
+/** \file
+ * Rate control of the resync and rebuild of a rain1 group.
+ *
+ * When a latency target is set, the latency of the foreground IOs on the
+ * real devices of the group is looked at periodically. While its 99th
+ * percentile stays under the target, the synchronization speeds up: first
+ * by pausing less after each block, then with larger blocks, then with
+ * more blocks in flight. As soon as the target is exceeded, it slows down
+ * the other way round, more blocks in flight being halved at once.
+ *
+ * Without target, the synchronization goes at full speed, pausing a fixed
+ * amount of time after each block.
+ */
+
+#include "vrt/layout/rain1/src/lay_rain1_group.h"
+
+#include "common/include/exa_histogram.h"
+
+#include "os/include/os_inttypes.h"
+
+/** Period between two adjustments of the rate, in ms */
+#define SYNC_QOS_PERIOD_MS          100
+
+/** Minimum number of foreground IOs in a period for their latency to be
+ * meaningful: with less, the synchronization does not disturb anything */
+#define SYNC_QOS_MIN_IOS            16
+
+/** Foreground IOs in flight on a device above which the synchronization
+ * doesn't speed up, the device being busy */
+#define SYNC_QOS_MAX_QUEUE_DEPTH    32
+
+/** Smallest block synchronized, in sectors */
+#define SYNC_QOS_MIN_BLKSIZE        32
+
+/** Longest pause after each block, in ms */
+#define SYNC_QOS_MAX_DELAY_MS       100
+
+/** Maximum latency target, in ms */
+#define SYNC_QOS_MAX_TARGET_MS      10000
+
+typedef struct
+{
+    uint64_t target_us;       /**< p99 latency target, 0 if none */
+    unsigned int max_jobs;    /**< Number of jobs of the pool */
+    unsigned int nb_jobs;     /**< Number of jobs allowed in flight */
+    unsigned int max_blksize; /**< Size of the buffers of the jobs, in sectors */
+    unsigned int blksize;     /**< Size of the blocks, in sectors */
+    unsigned int delay_ms;    /**< Pause after each block */
+    uint64_t window_start_ms; /**< Start of the current period */
+    /** Foreground latencies recorded at the start of the period */
+    exa_histogram_snapshot_t window_start;
+} sync_qos_t;
+
+/**
+ * Set the latency target of the synchronizations.
+ *
+ * @param[in] target_ms  Maximum p99 latency of the foreground IOs in ms,
+ *                       0 to synchronize at a fixed speed
+ */
+void rain1_set_sync_latency_target(int target_ms);
+
+/**
+ * Initialize the rate control of a pool of sync jobs, at full speed.
+ *
+ * @param[out] qos          Rate control
+ * @param[in]  max_jobs     Number of jobs of the pool
+ * @param[in]  max_blksize  Size of the buffers of the jobs, in sectors
+ */
+void sync_qos_init(sync_qos_t *qos, unsigned int max_jobs,
+                   unsigned int max_blksize);
+
+/**
+ * Start a synchronization. The rate reached by the previous one is kept.
+ *
+ * @param      qos          Rate control
+ * @param[in]  rxg          The group synchronized
+ * @param[in]  slowdown_ms  Pause after each block without latency target
+ */
+void sync_qos_start(sync_qos_t *qos, const rain1_group_t *rxg,
+                    int slowdown_ms);
+
+/**
+ * Adjust the rate if a period elapsed. Called when a job completes.
+ *
+ * @param      qos  Rate control
+ * @param[in]  rxg  The group synchronized
+ */
+void sync_qos_update(sync_qos_t *qos, const rain1_group_t *rxg);
+
+/**
+ * Adjust the rate to the foreground IOs of the last period.
+ *
+ * @param      qos          Rate control
+ * @param[in]  p99_us       99th percentile of their latency
+ * @param[in]  nb_ios       Number of IOs completed
+ * @param[in]  queue_depth  Largest number of IOs in flight on a device
+ */
+void sync_qos_adjust(sync_qos_t *qos, uint64_t p99_us, uint64_t nb_ios,
+                     int queue_depth);
+
+#endif
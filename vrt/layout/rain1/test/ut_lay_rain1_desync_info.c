@@ -0,0 +1,239 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "vrt/layout/rain1/src/lay_rain1_desync_info.h"
+
+#include "vrt/virtualiseur/fakes/empty_request_definitions.h"
+
+#include <string.h>
+
+#define TAG    42
+#define DZONE  3
+
+static slot_desync_info_t *block;
+
+ut_setup()
+{
+    block = slot_desync_info_alloc(TAG);
+    rain1_set_dzone_retention(RAIN1_DEFAULT_DZONE_RETENTION_S);
+}
+
+ut_cleanup()
+{
+    slot_desync_info_free(block);
+}
+
+/* What rain1_metadata_write_needed() and the metadata write do */
+static void write_begin(unsigned int dzone)
+{
+    block->in_memory_metadata[dzone].write_pending_counter++;
+    block->written[dzone] = true;
+    block->on_disk_metadata[dzone] = block->in_memory_metadata[dzone];
+}
+
+/* What the background flush does */
+static void flush(void)
+{
+    memcpy(block->on_disk_metadata, block->in_memory_metadata,
+           sizeof(block->on_disk_metadata));
+    block->flush_needed = false;
+}
+
+ut_test(dzone_is_unmarked_once_written_without_retention)
+{
+    rain1_set_dzone_retention(0);
+
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+
+    UT_ASSERT_EQUAL(0, block->in_memory_metadata[DZONE].write_pending_counter);
+    UT_ASSERT(block->flush_needed);
+    UT_ASSERT_EQUAL(0, block->nb_retained);
+}
+
+ut_test(dzone_stays_marked_after_its_last_write)
+{
+    write_begin(DZONE);
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+    slot_desync_info_write_end(block, DZONE);
+
+    UT_ASSERT(!block->flush_needed);
+    UT_ASSERT(block->retained[DZONE]);
+    UT_ASSERT(slot_desync_info_dzone_is_marked(block, DZONE, TAG));
+
+    /* Writing it again neither retains it twice nor needs a flush */
+    block->in_memory_metadata[DZONE].write_pending_counter++;
+    slot_desync_info_write_end(block, DZONE);
+
+    UT_ASSERT_EQUAL(1, block->in_memory_metadata[DZONE].write_pending_counter);
+    UT_ASSERT_EQUAL(1, block->nb_retained);
+    UT_ASSERT(!block->flush_needed);
+}
+
+ut_test(dzone_written_recently_is_not_released)
+{
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+
+    slot_desync_info_release(block, false);
+
+    UT_ASSERT(block->retained[DZONE]);
+    UT_ASSERT(!block->flush_needed);
+}
+
+ut_test(dzone_not_written_for_a_while_is_released)
+{
+    write_begin(DZONE);
+    write_begin(DZONE + 1);
+    slot_desync_info_write_end(block, DZONE);
+    slot_desync_info_write_end(block, DZONE + 1);
+
+    block->last_write_s[DZONE] -= RAIN1_DEFAULT_DZONE_RETENTION_S;
+
+    slot_desync_info_release(block, false);
+
+    UT_ASSERT(!block->retained[DZONE]);
+    UT_ASSERT(block->retained[DZONE + 1]);
+    UT_ASSERT_EQUAL(1, block->nb_retained);
+    UT_ASSERT(block->flush_needed);
+
+    flush();
+    UT_ASSERT(!slot_desync_info_dzone_is_marked(block, DZONE, TAG));
+    UT_ASSERT(slot_desync_info_dzone_is_marked(block, DZONE + 1, TAG));
+}
+
+ut_test(released_dzone_still_written_stays_marked)
+{
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+    write_begin(DZONE);
+
+    slot_desync_info_release(block, true);
+
+    UT_ASSERT_EQUAL(1, block->in_memory_metadata[DZONE].write_pending_counter);
+    UT_ASSERT(!block->flush_needed);
+    UT_ASSERT_EQUAL(0, block->nb_retained);
+}
+
+ut_test(retention_is_bounded)
+{
+    slot_desync_info_t *blocks[RAIN1_MAX_RETAINED_DZONES / DZONE_PER_METADATA_BLOCK];
+    unsigned int i, dzone;
+
+    /* Use up the budget */
+    for (i = 0; i < RAIN1_MAX_RETAINED_DZONES / DZONE_PER_METADATA_BLOCK; i++)
+    {
+        blocks[i] = slot_desync_info_alloc(TAG);
+        for (dzone = 0; dzone < DZONE_PER_METADATA_BLOCK; dzone++)
+        {
+            blocks[i]->in_memory_metadata[dzone].write_pending_counter++;
+            slot_desync_info_write_end(blocks[i], dzone);
+        }
+        UT_ASSERT_EQUAL(DZONE_PER_METADATA_BLOCK, blocks[i]->nb_retained);
+    }
+
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+
+    UT_ASSERT(!block->retained[DZONE]);
+    UT_ASSERT(block->flush_needed);
+
+    /* Freeing a block gives its budget back */
+    slot_desync_info_free(blocks[0]);
+
+    write_begin(DZONE);
+    slot_desync_info_write_end(block, DZONE);
+    UT_ASSERT(block->retained[DZONE]);
+
+    for (i = 1; i < RAIN1_MAX_RETAINED_DZONES / DZONE_PER_METADATA_BLOCK; i++)
+        slot_desync_info_free(blocks[i]);
+}
+
+ut_test(dzone_with_another_sync_tag_is_not_marked)
+{
+    write_begin(DZONE);
+
+    UT_ASSERT(slot_desync_info_dzone_is_marked(block, DZONE, TAG));
+    UT_ASSERT(!slot_desync_info_dzone_is_marked(block, DZONE, TAG + 1));
+
+    /* Being marked in memory only is not enough */
+    block->in_memory_metadata[DZONE + 1].write_pending_counter++;
+    UT_ASSERT(!slot_desync_info_dzone_is_marked(block, DZONE + 1, TAG));
+}
+
+/* The metadata block of the node on disk, where only DZONE was written */
+static void on_disk_with_dzone_written(desync_info_t *on_disk)
+{
+    dzone_metadata_block_init(on_disk, SYNC_TAG_BLANK);
+    on_disk[DZONE].sync_tag = TAG - 1;
+}
+
+ut_test(dzones_never_written_are_loaded_blank)
+{
+    desync_info_t on_disk[DZONE_PER_METADATA_BLOCK];
+
+    on_disk_with_dzone_written(on_disk);
+
+    UT_ASSERT(!block->unwritten_known);
+    UT_ASSERT(slot_desync_info_load_unwritten(block, on_disk));
+    UT_ASSERT(block->unwritten_known);
+
+    UT_ASSERT_EQUAL(TAG, block->in_memory_metadata[DZONE].sync_tag);
+    UT_ASSERT_EQUAL(SYNC_TAG_BLANK, block->in_memory_metadata[DZONE + 1].sync_tag);
+    UT_ASSERT_EQUAL(SYNC_TAG_BLANK, block->on_disk_metadata[DZONE + 1].sync_tag);
+
+    /* Loading is not a reason to flush */
+    UT_ASSERT(!block->flush_needed);
+}
+
+ut_test(dzone_written_before_the_load_is_not_blank)
+{
+    desync_info_t on_disk[DZONE_PER_METADATA_BLOCK];
+
+    write_begin(DZONE + 1);
+    slot_desync_info_write_end(block, DZONE + 1);
+    flush();
+
+    on_disk_with_dzone_written(on_disk);
+    UT_ASSERT(slot_desync_info_load_unwritten(block, on_disk));
+
+    UT_ASSERT_EQUAL(TAG, block->in_memory_metadata[DZONE + 1].sync_tag);
+    UT_ASSERT_EQUAL(SYNC_TAG_BLANK, block->in_memory_metadata[DZONE + 2].sync_tag);
+}
+
+ut_test(load_is_retried_after_a_flush)
+{
+    desync_info_t on_disk[DZONE_PER_METADATA_BLOCK];
+
+    on_disk_with_dzone_written(on_disk);
+
+    block->ongoing_flush = true;
+    UT_ASSERT(!slot_desync_info_load_unwritten(block, on_disk));
+    UT_ASSERT(!block->unwritten_known);
+    UT_ASSERT_EQUAL(TAG, block->in_memory_metadata[DZONE + 1].sync_tag);
+
+    block->ongoing_flush = false;
+    UT_ASSERT(slot_desync_info_load_unwritten(block, on_disk));
+}
+
+ut_test(dzones_written_bypassing_the_metadata_need_a_flush)
+{
+    desync_info_t on_disk[DZONE_PER_METADATA_BLOCK];
+
+    on_disk_with_dzone_written(on_disk);
+    UT_ASSERT(slot_desync_info_load_unwritten(block, on_disk));
+
+    slot_desync_info_set_all_written(block, TAG);
+
+    UT_ASSERT(block->flush_needed);
+    UT_ASSERT(block->written[DZONE + 1]);
+    UT_ASSERT_EQUAL(TAG, block->in_memory_metadata[DZONE + 1].sync_tag);
+}
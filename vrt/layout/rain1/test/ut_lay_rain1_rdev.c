@@ -0,0 +1,141 @@
+/*
+ * Copyright 2002, 2011 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "vrt/layout/rain1/src/lay_rain1_rdev.h"
+
+#include "common/include/exa_error.h"
+#include "os/include/os_error.h"
+
+#include "vrt/virtualiseur/fakes/empty_realdev_definitions.h"
+#include "vrt/virtualiseur/fakes/empty_request_definitions.h"
+
+#include <string.h>
+
+static vrt_realdev_t rdevs[2];
+static struct rdev_location rdev_loc[2];
+
+ut_setup()
+{
+    int i;
+
+    memset(rdevs, 0, sizeof(rdevs));
+    memset(rdev_loc, 0, sizeof(rdev_loc));
+
+    for (i = 0; i < 2; i++)
+    {
+        os_atomic_set(&rdevs[i].inflight_ios, 0);
+        rdev_loc[i].rdev = &rdevs[i];
+        rdev_loc[i].uptodate = TRUE;
+    }
+}
+
+ut_cleanup()
+{
+    rain1_set_read_policy(RAIN1_READ_POLICY_LEAST_OUTSTANDING);
+}
+
+ut_test(read_policy_from_str)
+{
+    rain1_read_policy_t policy;
+
+    UT_ASSERT_EQUAL(EXA_SUCCESS, rain1_read_policy_from_str("round_robin", &policy));
+    UT_ASSERT_EQUAL(RAIN1_READ_POLICY_ROUND_ROBIN, policy);
+    UT_ASSERT_EQUAL(EXA_SUCCESS, rain1_read_policy_from_str("local", &policy));
+    UT_ASSERT_EQUAL(RAIN1_READ_POLICY_LOCAL, policy);
+    UT_ASSERT_EQUAL(-EINVAL, rain1_read_policy_from_str("fastest", &policy));
+    UT_ASSERT_EQUAL(-EINVAL, rain1_read_policy_from_str(NULL, &policy));
+}
+
+ut_test(no_readable_replica)
+{
+    rain1_read_policy_t policy;
+
+    rdev_loc[0].uptodate = FALSE;
+    rdev_loc[1].uptodate = FALSE;
+
+    for (policy = RAIN1_READ_POLICY__FIRST; policy <= RAIN1_READ_POLICY__LAST;
+         policy++)
+    {
+        rain1_set_read_policy(policy);
+        UT_ASSERT_EQUAL(-1, rain1_select_read_location(rdev_loc, 2));
+    }
+}
+
+ut_test(first_policy_reads_first_readable_replica)
+{
+    rain1_set_read_policy(RAIN1_READ_POLICY_FIRST);
+
+    UT_ASSERT_EQUAL(0, rain1_select_read_location(rdev_loc, 2));
+
+    rdev_loc[0].uptodate = FALSE;
+    UT_ASSERT_EQUAL(1, rain1_select_read_location(rdev_loc, 2));
+}
+
+ut_test(round_robin_policy_alternates_replicas)
+{
+    int first, i;
+
+    rain1_set_read_policy(RAIN1_READ_POLICY_ROUND_ROBIN);
+
+    first = rain1_select_read_location(rdev_loc, 2);
+    for (i = 1; i < 10; i++)
+        UT_ASSERT_EQUAL((first + i) % 2, rain1_select_read_location(rdev_loc, 2));
+
+    /* Unreadable replicas are skipped */
+    rdev_loc[1].uptodate = FALSE;
+    for (i = 0; i < 10; i++)
+        UT_ASSERT_EQUAL(0, rain1_select_read_location(rdev_loc, 2));
+}
+
+ut_test(least_outstanding_policy_reads_least_loaded_replica)
+{
+    rain1_set_read_policy(RAIN1_READ_POLICY_LEAST_OUTSTANDING);
+
+    vrt_rdev_begin_io(&rdevs[0]);
+    UT_ASSERT_EQUAL(1, rain1_select_read_location(rdev_loc, 2));
+
+    vrt_rdev_begin_io(&rdevs[1]);
+    vrt_rdev_begin_io(&rdevs[1]);
+    UT_ASSERT_EQUAL(0, rain1_select_read_location(rdev_loc, 2));
+
+    /* A replica twice as slow with half the IOs is as good: the local one
+     * is preferred */
+    rdevs[0].avg_latency_us = 199;
+    rdevs[1].avg_latency_us = 99;
+    rdevs[1].local = true;
+    vrt_rdev_begin_io(&rdevs[1]);
+    UT_ASSERT_EQUAL(1, rain1_select_read_location(rdev_loc, 2));
+}
+
+ut_test(local_policy_prefers_local_replica)
+{
+    rain1_set_read_policy(RAIN1_READ_POLICY_LOCAL);
+
+    rdevs[1].local = true;
+    vrt_rdev_begin_io(&rdevs[1]);
+    UT_ASSERT_EQUAL(1, rain1_select_read_location(rdev_loc, 2));
+
+    rdev_loc[1].uptodate = FALSE;
+    UT_ASSERT_EQUAL(0, rain1_select_read_location(rdev_loc, 2));
+}
+
+ut_test(rdev_latency_converges)
+{
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        vrt_rdev_begin_io(&rdevs[0]);
+        vrt_rdev_end_io(&rdevs[0], VRT_IO_TYPE_READ, 800);
+    }
+
+    UT_ASSERT_EQUAL(0, vrt_rdev_inflight_ios(&rdevs[0]));
+    UT_ASSERT(rdevs[0].avg_latency_us > 700 && rdevs[0].avg_latency_us <= 800);
+}
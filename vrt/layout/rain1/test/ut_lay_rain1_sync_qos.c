@@ -0,0 +1,139 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+#include <unit_testing.h>
+
+#include "vrt/layout/rain1/src/lay_rain1_sync_qos.h"
+
+#define MAX_JOBS     8
+#define MAX_BLKSIZE  256
+
+#define TARGET_US    10000
+
+static sync_qos_t qos;
+
+ut_setup()
+{
+    sync_qos_init(&qos, MAX_JOBS, MAX_BLKSIZE);
+    qos.target_us = TARGET_US;
+}
+
+ut_cleanup()
+{
+}
+
+static void too_slow(void)
+{
+    sync_qos_adjust(&qos, 2 * TARGET_US, 1000, 4);
+}
+
+static void fast_enough(void)
+{
+    sync_qos_adjust(&qos, TARGET_US / 2, 1000, 4);
+}
+
+ut_test(starts_at_full_speed)
+{
+    UT_ASSERT_EQUAL(MAX_JOBS, qos.nb_jobs);
+    UT_ASSERT_EQUAL(MAX_BLKSIZE, qos.blksize);
+    UT_ASSERT_EQUAL(0, qos.delay_ms);
+}
+
+ut_test(jobs_are_halved_first_when_over_the_target)
+{
+    too_slow();
+    UT_ASSERT_EQUAL(MAX_JOBS / 2, qos.nb_jobs);
+    UT_ASSERT_EQUAL(MAX_BLKSIZE, qos.blksize);
+
+    too_slow();
+    too_slow();
+    UT_ASSERT_EQUAL(1, qos.nb_jobs);
+    UT_ASSERT_EQUAL(MAX_BLKSIZE, qos.blksize);
+    UT_ASSERT_EQUAL(0, qos.delay_ms);
+}
+
+ut_test(blocks_shrink_then_pauses_grow_with_a_single_job)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        too_slow();
+
+    too_slow();
+    UT_ASSERT_EQUAL(MAX_BLKSIZE / 2, qos.blksize);
+
+    for (i = 0; i < 10; i++)
+        too_slow();
+    UT_ASSERT_EQUAL(1, qos.nb_jobs);
+    UT_ASSERT_EQUAL(SYNC_QOS_MIN_BLKSIZE, qos.blksize);
+    UT_ASSERT(qos.delay_ms > 0);
+
+    for (i = 0; i < 20; i++)
+        too_slow();
+    UT_ASSERT_EQUAL(SYNC_QOS_MAX_DELAY_MS, qos.delay_ms);
+}
+
+ut_test(speeds_up_back_to_full_speed_under_the_target)
+{
+    int i;
+
+    for (i = 0; i < 30; i++)
+        too_slow();
+
+    fast_enough();
+    UT_ASSERT_EQUAL(SYNC_QOS_MAX_DELAY_MS / 2, qos.delay_ms);
+
+    for (i = 0; i < 100; i++)
+        fast_enough();
+
+    UT_ASSERT_EQUAL(MAX_JOBS, qos.nb_jobs);
+    UT_ASSERT_EQUAL(MAX_BLKSIZE, qos.blksize);
+    UT_ASSERT_EQUAL(0, qos.delay_ms);
+}
+
+ut_test(jobs_are_added_one_at_a_time)
+{
+    too_slow();
+    too_slow();
+    UT_ASSERT_EQUAL(MAX_JOBS / 4, qos.nb_jobs);
+
+    fast_enough();
+    UT_ASSERT_EQUAL(MAX_JOBS / 4 + 1, qos.nb_jobs);
+}
+
+ut_test(rate_is_kept_close_to_the_target)
+{
+    too_slow();
+    sync_qos_adjust(&qos, TARGET_US * 9 / 10, 1000, 4);
+
+    UT_ASSERT_EQUAL(MAX_JOBS / 2, qos.nb_jobs);
+}
+
+ut_test(busy_devices_prevent_speeding_up)
+{
+    too_slow();
+    sync_qos_adjust(&qos, TARGET_US / 2, 1000, SYNC_QOS_MAX_QUEUE_DEPTH + 1);
+
+    UT_ASSERT_EQUAL(MAX_JOBS / 2, qos.nb_jobs);
+}
+
+ut_test(few_foreground_ios_do_not_slow_down)
+{
+    sync_qos_adjust(&qos, 2 * TARGET_US, SYNC_QOS_MIN_IOS - 1, 4);
+
+    UT_ASSERT_EQUAL(MAX_JOBS, qos.nb_jobs);
+}
+
+ut_test(nothing_changes_without_target)
+{
+    qos.target_us = 0;
+    too_slow();
+
+    UT_ASSERT_EQUAL(MAX_JOBS, qos.nb_jobs);
+    UT_ASSERT_EQUAL(MAX_BLKSIZE, qos.blksize);
+}
@@ -34,6 +34,8 @@ void sstriping_cancel_req (struct vrt_request *vrt_req);
 void sstriping_declare_io_needs(struct vrt_request *vrt_req,
                                 unsigned int *io_count,
                                 bool *sync_afterward);
+uint64_t sstriping_get_request_max_sectors(const struct vrt_volume *volume,
+                                           uint64_t vsector);
 int sstriping_max_sectors(struct vrt_volume *volume);
 
 #endif /* __VRT_LAYOUT_SSTRIPING_H__ */
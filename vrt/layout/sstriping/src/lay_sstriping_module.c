@@ -472,6 +472,7 @@ static struct vrt_layout layout_sstriping =
     .init_req =                      sstriping_init_req,
     .cancel_req =                    sstriping_cancel_req,
     .get_slot_width =                sstriping_get_slot_width,
+    .get_request_max_sectors =       sstriping_get_request_max_sectors,
     .declare_io_needs =              sstriping_declare_io_needs,
     .group_rdev_down =               sstriping_group_rdev_down,
     .group_rdev_up =                 sstriping_group_rdev_up,
@@ -48,15 +48,19 @@ sstriping_req_get_state(const struct vrt_request *vrt_req)
 
 /**
  * This function fills the list of IOs given by the VRT engine
- * according to the sstriping data placement policy.
+ * according to the sstriping data placement policy: one IO per
+ * striping unit spanned by the request.
  *
  * @param[in] vrt_req The descriptor of the original request.
  */
 static vrt_req_status_t
 sstriping_fill_io(struct vrt_request *vrt_req)
 {
-    uint64_t sec_rd;
-    vrt_realdev_t *rd;
+    uint64_t su_size = SSTRIPING_GROUP(vrt_req->ref_vol->group)->su_size;
+    uint64_t vsector = vrt_req->ref_bio->start_sector;
+    char *data = vrt_req->ref_bio->buf;
+    uint32_t remaining = vrt_req->ref_bio->size;
+    vrt_req_status_t ret = VRT_REQ_UNCOMPLETED;
     struct vrt_io_op *io;
 
     EXA_ASSERT (vrt_req != NULL);
@@ -65,32 +69,42 @@ sstriping_fill_io(struct vrt_request *vrt_req)
     for (io = vrt_req->io_list ; io != NULL ; io = io->next)
 	io->state = IO_DONT_PROCESS;
 
-    /* Convert position in the virtual device into a position in a
-       disk */
-    sstriping_volume2rdev(vrt_req->ref_vol, vrt_req->ref_bio->start_sector,
-			  & rd, & sec_rd);
-
     io = vrt_req->io_list;
 
-    /* There should be only one IO in the list */
-    EXA_ASSERT (io != NULL);
-    EXA_ASSERT (io->next == NULL);
+    do {
+        uint32_t size = MIN(remaining,
+                            SECTORS_TO_BYTES(su_size - vsector % su_size));
+        uint64_t sec_rd;
+        vrt_realdev_t *rd;
 
-    io->iotype  = vrt_req->iotype;
-    if (!rdev_is_ok(rd))
-	io->state = IO_DONT_PROCESS;
-    else
-	io->state = IO_TO_PROCESS;
-    io->data    = vrt_req->ref_bio->buf;
-    io->size    = vrt_req->ref_bio->size;
-    io->vrt_req = vrt_req;
-    io->rdev    = rd;
-    io->offset  = sec_rd;
-
-    if (io->state == IO_DONT_PROCESS)
-	return VRT_REQ_FAILED;
-    else
-	return VRT_REQ_UNCOMPLETED;
+        /* There should be one IO per striping unit */
+        EXA_ASSERT (io != NULL);
+
+        /* Convert position in the virtual device into a position in a
+           disk */
+        sstriping_volume2rdev(vrt_req->ref_vol, vsector, & rd, & sec_rd);
+
+        io->iotype  = vrt_req->iotype;
+        if (!rdev_is_ok(rd))
+        {
+            io->state = IO_DONT_PROCESS;
+            ret = VRT_REQ_FAILED;
+        }
+        else
+            io->state = IO_TO_PROCESS;
+        io->data    = data;
+        io->size    = size;
+        io->vrt_req = vrt_req;
+        io->rdev    = rd;
+        io->offset  = sec_rd;
+
+        io = io->next;
+        vsector += BYTES_TO_SECTORS(size);
+        data += size;
+        remaining -= size;
+    } while (remaining > 0);
+
+    return ret;
 }
 
 /**
@@ -166,12 +180,15 @@ sstriping_build_io_for_req(struct vrt_request *vrt_req)
     }
     else if (state == SSTRIPING_REQUEST_END)
     {
-	EXA_ASSERT(vrt_req->io_list->state == IO_OK ||
-		   vrt_req->io_list->state == IO_FAILURE);
-	if (vrt_req->io_list->state == IO_FAILURE)
-	    ret = VRT_REQ_FAILED;
-	else
-	    ret = VRT_REQ_SUCCESS;
+        struct vrt_io_op *io;
+
+	ret = VRT_REQ_SUCCESS;
+	for (io = vrt_req->io_list; io != NULL; io = io->next)
+	{
+	    EXA_ASSERT(io->state == IO_OK || io->state == IO_FAILURE);
+	    if (io->state == IO_FAILURE)
+		ret = VRT_REQ_FAILED;
+	}
     }
     else
     {
@@ -213,9 +230,9 @@ sstriping_cancel_req (struct vrt_request *vrt_req)
  * IO structure of the layout. It is called once for each request
  * received by the VRT engine.
  *
- * In this simple striping layout, we need one IO for a READ or WRITE
- * request. If the request type is WRITE_BARRIER, we also need a
- * barrier.
+ * In this simple striping layout, we need one IO per striping unit
+ * spanned by a READ or WRITE request. If the request type is
+ * WRITE_BARRIER, we also need a barrier.
  */
 void sstriping_declare_io_needs(struct vrt_request *vrt_req,
                                 unsigned int *io_count,
@@ -225,9 +242,34 @@ void sstriping_declare_io_needs(struct vrt_request *vrt_req,
     EXA_ASSERT (io_count != NULL);
     EXA_ASSERT (sync_afterward != NULL);
 
-    *io_count  = 1;
+    *io_count  = vrt_request_get_nb_su(vrt_req,
+                                       SSTRIPING_GROUP(vrt_req->ref_vol->group)->su_size);
     if (vrt_req->iotype == VRT_IO_TYPE_WRITE_BARRIER)
 	*sync_afterward = true;
     else
 	*sync_afterward = false;
 }
+
+/**
+ * Function called by the virtualizer to know how far a request starting at
+ * a given position can go. A request stays within a slot, whose striping
+ * units are all mapped the same way.
+ *
+ * @param[in] volume   The volume
+ * @param[in] vsector  Position of the request in the volume
+ *
+ * @return the maximum size of the request, in sectors
+ */
+uint64_t sstriping_get_request_max_sectors(const struct vrt_volume *volume,
+                                           uint64_t vsector)
+{
+    const sstriping_group_t *lg = SSTRIPING_GROUP(volume->group);
+    const slot_t *slot;
+    uint64_t offset;
+
+    assembly_group_map_sector_to_slot(&lg->assembly_group, volume->assembly_volume,
+                                      lg->logical_slot_size, vsector,
+                                      &slot, &offset);
+
+    return lg->logical_slot_size - offset;
+}
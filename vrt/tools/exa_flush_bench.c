@@ -0,0 +1,388 @@
+/*
+ * Copyright 2002, 2010 Seanodes Ltd http://www.seanodes.com. All rights
+ * reserved and protected by French, UK, U.S. and other countries' copyright laws.
+ * This file is part of Exanodes project and is subject to the terms
+ * and conditions defined in the LICENSE file which is present in the root
+ * directory of the project.
+ */
+
+/*
+ * Benchmark of flushes in a mixed load: some threads do small random reads
+ * and writes on a device while others write and flush it as a database
+ * committing transactions would (write then fdatasync). The latency
+ * percentiles of each kind of operation are reported.
+ *
+ * On an Exanodes volume, each fdatasync is a request with flush_cache. The
+ * latency of the reads and writes that are not flushed should not depend
+ * much on the number of syncing threads (compare with -f 0).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/include/exa_conversion.h"
+#include "common/include/exa_error.h"
+
+#include "os/include/os_disk.h"
+#include "os/include/os_error.h"
+#include "os/include/os_getopt.h"
+#include "os/include/os_inttypes.h"
+#include "os/include/os_mem.h"
+#include "os/include/os_thread.h"
+#include "os/include/os_time.h"
+
+#define IO_SIZE         4096
+#define MAX_THREADS     64
+
+typedef enum
+{
+    OP_READ,
+    OP_WRITE,
+    OP_SYNC,
+#define OP__FIRST  OP_READ
+#define OP__LAST   OP_SYNC
+} op_t;
+
+#define OP_COUNT  (OP__LAST - OP__FIRST + 1)
+
+static const char *op_names[OP_COUNT] = { "read", "write", "write+sync" };
+
+/** Latencies of the operations of a kind done by a thread, in microseconds */
+typedef struct
+{
+    uint32_t *us;
+    size_t count;
+    size_t alloc;
+} latencies_t;
+
+typedef struct
+{
+    os_thread_t tid;
+    unsigned int seed;
+    bool syncer;
+    void *buf;
+    latencies_t lat[OP_COUNT];
+    int err;
+} bench_thread_t;
+
+/** Name of this program */
+static const char *program = NULL;
+
+static int fd = -1;
+static uint64_t nb_blocks;
+static unsigned int read_percent = 50;
+static volatile bool stop = false;
+
+static void usage(void)
+{
+    printf("Usage: %s [OPTIONS] DEVICE\n"
+           "Benchmark the latency of reads and writes while other threads\n"
+           "write and flush DEVICE. DEVICE is overwritten.\n"
+           "  -f, --syncers  Number of threads writing and flushing (default 1)\n"
+           "  -r, --reads    Percentage of reads of the other threads (default 50)\n"
+           "  -s, --size     Size of DEVICE in MiB, needed for a regular file\n"
+           "  -t, --time     Duration in seconds (default 10)\n"
+           "  -w, --workers  Number of threads reading and writing (default 8)\n"
+           "  -h, --help     Display this help and exit\n",
+           program);
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int latencies_add(latencies_t *lat, uint64_t us)
+{
+    if (lat->count == lat->alloc)
+    {
+        size_t alloc = lat->alloc == 0 ? 4096 : 2 * lat->alloc;
+        uint32_t *grown = os_realloc(lat->us, alloc * sizeof(*lat->us));
+
+        if (grown == NULL)
+            return -ENOMEM;
+
+        lat->us = grown;
+        lat->alloc = alloc;
+    }
+
+    lat->us[lat->count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+
+    return 0;
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench_thread(void *data)
+{
+    bench_thread_t *thread = data;
+
+    while (!stop)
+    {
+        off_t offset = (off_t)(rand_r(&thread->seed) % nb_blocks) * IO_SIZE;
+        uint64_t begin = now_us();
+        ssize_t done;
+        op_t op;
+
+        if (thread->syncer)
+            op = OP_SYNC;
+        else if ((unsigned int)(rand_r(&thread->seed) % 100) < read_percent)
+            op = OP_READ;
+        else
+            op = OP_WRITE;
+
+        if (op == OP_READ)
+            done = pread(fd, thread->buf, IO_SIZE, offset);
+        else
+            done = pwrite(fd, thread->buf, IO_SIZE, offset);
+
+        if (done == IO_SIZE && op == OP_SYNC && fdatasync(fd) != 0)
+            done = -1;
+
+        if (done != IO_SIZE)
+        {
+            thread->err = done < 0 ? -errno : -EIO;
+            return;
+        }
+
+        thread->err = latencies_add(&thread->lat[op], now_us() - begin);
+        if (thread->err != 0)
+            return;
+    }
+}
+
+static void report(bench_thread_t *threads, unsigned int nb_threads,
+                   op_t op, unsigned int duration)
+{
+    latencies_t all = { NULL, 0, 0 };
+    uint64_t sum = 0;
+    unsigned int i;
+    size_t j;
+
+    for (i = 0; i < nb_threads; i++)
+        for (j = 0; j < threads[i].lat[op].count; j++)
+        {
+            if (latencies_add(&all, threads[i].lat[op].us[j]) != 0)
+            {
+                fprintf(stderr, "out of memory\n");
+                os_free(all.us);
+                return;
+            }
+            sum += threads[i].lat[op].us[j];
+        }
+
+    if (all.count == 0)
+        return;
+
+    qsort(all.us, all.count, sizeof(*all.us), compare_us);
+
+    printf("%-10s: %8.0f op/s, latency (us) avg %"PRIu64", p50 %u, p99 %u,"
+           " p99.9 %u, max %u\n", op_names[op],
+           (double)all.count / duration, sum / all.count,
+           all.us[all.count / 2], all.us[all.count * 99 / 100],
+           all.us[all.count * 999 / 1000], all.us[all.count - 1]);
+
+    os_free(all.us);
+}
+
+static int run_bench(const char *path, uint64_t dev_size,
+                     unsigned int nb_workers, unsigned int nb_syncers,
+                     unsigned int duration)
+{
+    bench_thread_t threads[MAX_THREADS];
+    unsigned int nb_threads = 0, i;
+    int err = 0;
+    op_t op;
+
+    nb_blocks = dev_size / IO_SIZE;
+    if (nb_blocks == 0)
+    {
+        fprintf(stderr, "'%s' is too small\n", path);
+        return -EINVAL;
+    }
+
+    fd = os_disk_open_raw(path, OS_DISK_RDWR | OS_DISK_DIRECT);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot open '%s': %s\n", path, exa_error_msg(fd));
+        return fd;
+    }
+
+    memset(threads, 0, sizeof(threads));
+
+    for (i = 0; i < nb_workers + nb_syncers; i++)
+    {
+        bench_thread_t *thread = &threads[i];
+
+        thread->seed = i + 1;
+        thread->syncer = i >= nb_workers;
+        thread->buf = os_aligned_malloc(IO_SIZE, IO_SIZE, NULL);
+        if (thread->buf == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            err = -ENOMEM;
+            break;
+        }
+        memset(thread->buf, (int)i, IO_SIZE);
+
+        if (!os_thread_create(&thread->tid, 0, bench_thread, thread))
+        {
+            fprintf(stderr, "cannot create thread\n");
+            os_aligned_free(thread->buf);
+            err = -ENOMEM;
+            break;
+        }
+        nb_threads++;
+    }
+
+    if (err == 0)
+        os_sleep(duration);
+
+    stop = true;
+    for (i = 0; i < nb_threads; i++)
+    {
+        os_thread_join(threads[i].tid);
+        if (threads[i].err != 0 && err == 0)
+        {
+            err = threads[i].err;
+            fprintf(stderr, "IO error: %s\n", exa_error_msg(err));
+        }
+    }
+
+    if (err == 0)
+    {
+        printf("%u workers (%u%% reads), %u syncers, %u s\n", nb_workers,
+               read_percent, nb_syncers, duration);
+        for (op = OP__FIRST; op <= OP__LAST; op++)
+            report(threads, nb_threads, op, duration);
+    }
+
+    for (i = 0; i < nb_threads; i++)
+    {
+        for (op = OP__FIRST; op <= OP__LAST; op++)
+            os_free(threads[i].lat[op].us);
+        os_aligned_free(threads[i].buf);
+    }
+
+    close(fd);
+
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_opts[] =
+    {
+        { "syncers", required_argument, NULL, 'f' },
+        { "reads",   required_argument, NULL, 'r' },
+        { "size",    required_argument, NULL, 's' },
+        { "time",    required_argument, NULL, 't' },
+        { "workers", required_argument, NULL, 'w' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL,      0,                 NULL, 0   }
+    };
+    unsigned int nb_workers = 8, nb_syncers = 1, duration = 10;
+    uint64_t size_mb = 0, dev_size;
+    int c, err;
+
+    program = argv[0];
+
+    while ((c = os_getopt_long(argc, argv, "f:r:s:t:w:h", long_opts, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'f':
+            if (to_uint(optarg, &nb_syncers) != EXA_SUCCESS)
+            {
+                fprintf(stderr, "invalid number of syncers: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'r':
+            if (to_uint(optarg, &read_percent) != EXA_SUCCESS
+                || read_percent > 100)
+            {
+                fprintf(stderr, "invalid read percentage: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 's':
+            if (to_uint64(optarg, &size_mb) != EXA_SUCCESS || size_mb == 0)
+            {
+                fprintf(stderr, "invalid size: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 't':
+            if (to_uint(optarg, &duration) != EXA_SUCCESS || duration == 0)
+            {
+                fprintf(stderr, "invalid duration: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'w':
+            if (to_uint(optarg, &nb_workers) != EXA_SUCCESS)
+            {
+                fprintf(stderr, "invalid number of workers: '%s'\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage();
+        return 1;
+    }
+
+    if (nb_workers + nb_syncers == 0 || nb_workers + nb_syncers > MAX_THREADS)
+    {
+        fprintf(stderr, "between 1 and %d threads are needed\n", MAX_THREADS);
+        return 1;
+    }
+
+    if (size_mb != 0)
+        dev_size = size_mb * 1024 * 1024;
+    else
+    {
+        int dev_fd = os_disk_open_raw(argv[optind], OS_DISK_READ);
+
+        err = dev_fd < 0 ? dev_fd : os_disk_get_size(dev_fd, &dev_size);
+        if (dev_fd >= 0)
+            close(dev_fd);
+        if (err != 0)
+        {
+            fprintf(stderr, "cannot get the size of '%s': %s\n", argv[optind],
+                    exa_error_msg(err));
+            return 1;
+        }
+    }
+
+    err = run_bench(argv[optind], dev_size, nb_workers, nb_syncers, duration);
+
+    return err ? 1 : 0;
+}
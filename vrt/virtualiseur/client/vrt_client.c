@@ -951,6 +951,30 @@ int vrt_client_stat_get(ExamsgHandle mh, struct vrt_stats_request *stats_request
 }
 
 
+int vrt_client_rdev_stat_get(ExamsgHandle mh,
+                             const struct vrt_rdev_stats_request *stats_request,
+                             struct vrt_rdev_stats_reply *stats)
+{
+    vrt_cmd_t req;
+    vrt_reply_t reply;
+    int ret;
+
+    req.type = VRTRECV_RDEV_STATS;
+    req.d.vrt_rdev_stats_request = *stats_request;
+
+    ret =  admwrk_daemon_query_nointr(mh, EXAMSG_VRT_ID, EXAMSG_DAEMON_RQST,
+				      &req, sizeof(req),
+				      &reply, sizeof(reply));
+
+    *stats = reply.rdev_stats;
+
+    if (ret != 0)
+	return ret;
+
+    return reply.retval;
+}
+
+
 int vrt_client_pending_group_cleanup(ExamsgHandle mh)
 {
     vrt_cmd_t req;
@@ -15,7 +15,12 @@ void vrt_thread_wakeup(void)
 {
 }
 
-int vrt_engine_init(int max_requests)
+unsigned int vrt_engine_assign_thread(void)
+{
+    return 0;
+}
+
+int vrt_engine_init(int max_requests, unsigned int nb_threads)
 {
     return 0;
 }
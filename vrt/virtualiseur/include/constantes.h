@@ -28,4 +28,17 @@
  */
 #define VRT_THREAD_STACK_SIZE (MIN_THREAD_STACK_SIZE + 128 * 1024)
 
+/**
+ * Maximum number of striping units a request can span. It bounds the
+ * number of I/Os of a request, which are taken from pools shared by all
+ * the requests.
+ */
+#define VRT_MAX_SU_PER_REQUEST  32
+
+/**
+ * Maximum number of I/Os a layout needs per striping unit of a request: a
+ * rain1 write has one per replica and one for the metadata.
+ */
+#define VRT_MAX_IO_PER_SU  3
+
 #endif /* __VRT_CONSTANTES_H__ */
@@ -110,6 +110,9 @@ int vrt_client_rdev_reintegrate_info(ExamsgHandle mh, const exa_uuid_t *groupUui
 
 int vrt_client_stat_get(ExamsgHandle mh, struct vrt_stats_request *request,
 			struct vrt_stats_reply *stats);
+int vrt_client_rdev_stat_get(ExamsgHandle mh,
+                             const struct vrt_rdev_stats_request *request,
+                             struct vrt_rdev_stats_reply *stats);
 
 /*** Misc ***/
 
@@ -80,6 +80,9 @@ typedef struct vrt_group
      *  FIXME this is guessed from the previous giant group->lock */
     os_thread_rwlock_t suspend_lock;
 
+    /** Index of the VRT engine thread processing the requests of the group */
+    unsigned int engine_thread;
+
     /** Number of volumes created in this group */
     uint32_t nb_volumes;
 
@@ -9,9 +9,15 @@
 #ifndef _VRT_INIT
 #define _VRT_INIT
 
-void vrt_init(int adm_my_id, int max_requests, exa_bool_t io_barriers,
+#include "vrt/layout/rain1/include/rain1.h"
+
+void vrt_init(int adm_my_id, int max_requests, int engine_threads,
+              exa_bool_t io_barriers,
               int rebuilding_slowdown_ms,
-              int degraded_rebuilding_slowdown_ms);
+              int degraded_rebuilding_slowdown_ms,
+              rain1_read_policy_t rain1_read_policy,
+              int rain1_dzone_retention_s,
+              int rain1_sync_latency_target_ms);
 
 void vrt_exit(void);
 
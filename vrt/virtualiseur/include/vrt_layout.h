@@ -291,6 +291,21 @@ struct vrt_layout
      */
     int (*group_rebuild_step) (void *context, bool *more_work);
 
+    /**
+     * Get the number of sectors a request starting at a given position
+     * of a volume can span, whatever its number of striping units. The
+     * requests crossing this bound are split before reaching the layout.
+     * Layouts that don't provide it only get requests fitting in a
+     * striping unit.
+     *
+     * @param[in] volume   The volume
+     * @param[in] vsector  Start of the request in the volume
+     *
+     * @return the number of sectors, at least 1
+     */
+    uint64_t (*get_request_max_sectors)(const struct vrt_volume *volume,
+                                        uint64_t vsector);
+
     /**
      * Declare the number of parallel I/O needed by the layout to
      * perform the request.
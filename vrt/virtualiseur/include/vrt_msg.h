@@ -280,6 +280,19 @@ struct vrt_stats_reply
     uint64_t now;
     struct vrt_stats_begin begin;
     struct vrt_stats_done done;
+    struct vrt_stats_latency latency[VRT_LATENCY_TYPES];
+};
+
+struct vrt_rdev_stats_request
+{
+    exa_bool_t reset;
+    exa_uuid_t group_uuid;
+    exa_uuid_t rdev_uuid;
+};
+
+struct vrt_rdev_stats_reply
+{
+    struct vrt_stats_latency latency[VRT_LATENCY_TYPES];
 };
 
 struct vrt_group_resync_request
@@ -339,6 +352,7 @@ typedef struct  VrtRecv
         VRTRECV_DEVICE_REPLACE,
 	VRTRECV_GET_VOLUME_STATUS,
 	VRTRECV_STATS,
+	VRTRECV_RDEV_STATS,
         VRTRECV_GROUP_RESYNC,
 	VRTRECV_PENDING_GROUP_CLEANUP
 #define VRTRECV_TYPE_LAST VRTRECV_PENDING_GROUP_CLEANUP
@@ -374,6 +388,7 @@ typedef struct  VrtRecv
 	struct VrtGetVolumeStatus         vrt_get_volume_status;
 	struct VrtVolumeStatReset         vrt_volume_stat_reset;
 	struct vrt_stats_request          vrt_stats_request;
+	struct vrt_rdev_stats_request     vrt_rdev_stats_request;
         struct vrt_group_resync_request   vrt_group_resync;
     } d;
 } vrt_cmd_t;
@@ -390,6 +405,7 @@ typedef struct {
         struct vrt_realdev_rebuild_info rdev_rebuild_info;
         struct vrt_realdev_reintegrate_info rdev_reintegrate_info;
         struct vrt_stats_reply stats;
+        struct vrt_rdev_stats_reply rdev_stats;
         struct vrt_group_create group_create;
     };
 } vrt_reply_t;
@@ -11,6 +11,7 @@
 
 #include "vrt/virtualiseur/include/realdev_superblock.h"
 #include "vrt/virtualiseur/include/vrt_common.h"
+#include "vrt/virtualiseur/include/vrt_volume_stats.h"
 
 #include "vrt/common/include/spof.h"
 #include "vrt/common/include/vrt_stream.h"
@@ -23,6 +24,8 @@
 #include "common/include/exa_constants.h"
 #include "common/include/exa_nodeset.h"
 
+#include "os/include/os_atomic.h"
+
 #include <sys/types.h>
 
 /** Size of VRT's superblock area (for both "positions" 0 and 1 of the
@@ -90,6 +93,17 @@ typedef struct vrt_realdev
 
     /** The streams that compute the checksums for the superblocks  */
     stream_t *checksum_sb_streams[2];
+
+    /** Number of IOs submitted on the rdev and not completed yet */
+    os_atomic_t inflight_ios;
+
+    /** Moving average of the latency of the IOs on the rdev, in
+     * microseconds. Updated without lock: an update may be lost. */
+    uint32_t avg_latency_us;
+
+    /** Latencies of the IOs on the rdev since the last reset, per latency
+     * kind of the requests they belong to */
+    exa_histogram_t latency[VRT_LATENCY_TYPES];
 } vrt_realdev_t;
 
 /** Internal flat structure describing an rdev */
@@ -170,6 +184,48 @@ static inline exa_bool_t rdev_is_ok(const struct vrt_realdev *rdev)
     return rdev->up && !rdev->corrupted;
 }
 
+/** Weight of the last IO in vrt_realdev::avg_latency_us, as a shift */
+#define VRT_RDEV_LATENCY_SHIFT  3
+
+/**
+ * Account for an IO submitted on a real device.
+ *
+ * @param[in] rdev The real device
+ */
+static inline void vrt_rdev_begin_io(struct vrt_realdev *rdev)
+{
+    os_atomic_inc(&rdev->inflight_ios);
+}
+
+/**
+ * Account for an IO completed on a real device.
+ *
+ * @param[in] rdev        The real device
+ * @param[in] iotype      Type of the request the IO belongs to
+ * @param[in] latency_us  Time the IO took, in microseconds
+ */
+static inline void vrt_rdev_end_io(struct vrt_realdev *rdev,
+                                   vrt_io_type_t iotype, uint32_t latency_us)
+{
+    uint32_t avg = rdev->avg_latency_us;
+
+    exa_histogram_add(&rdev->latency[vrt_latency_type(iotype)], latency_us);
+
+    rdev->avg_latency_us = avg - (avg >> VRT_RDEV_LATENCY_SHIFT)
+                           + (latency_us >> VRT_RDEV_LATENCY_SHIFT);
+    os_atomic_dec(&rdev->inflight_ios);
+}
+
+/**
+ * Number of IOs submitted on a real device and not completed yet.
+ *
+ * @param[in] rdev The real device
+ */
+static inline int vrt_rdev_inflight_ios(const struct vrt_realdev *rdev)
+{
+    return os_atomic_read(&rdev->inflight_ios);
+}
+
 int vrt_rdev_lock_sectors(struct vrt_realdev *rdev, unsigned long start,
                           unsigned long end);
 int vrt_rdev_unlock_sectors(struct vrt_realdev *rdev, unsigned long start,
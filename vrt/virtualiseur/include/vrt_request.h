@@ -13,6 +13,9 @@
 #include "vrt/common/include/list.h"
 #include "os/include/os_atomic.h"
 
+#include "common/include/exa_constants.h"
+#include "common/include/exa_math.h"
+
 #include "vrt/virtualiseur/include/vrt_volume.h"
 
 typedef struct vrt_request vrt_request_t;
@@ -49,6 +52,9 @@ struct vrt_io_op
     /** Size of the I/O. */
     uint32_t size;
 
+    /** Date of submission in microseconds, to measure the rdev latency */
+    uint64_t start_us;
+
 #ifdef WITH_PERF
     /** Date of submition */
     uint64_t submit_date;
@@ -121,6 +127,9 @@ struct vrt_request
     /** The number of remaining I/O to perform or msg to receive */
     os_atomic_t remaining;
 
+    /** Date the request began, in microseconds, to measure its latency */
+    uint64_t start_us;
+
     /** Do not perfom IO before this date. Used for "replay request" feature. */
     uint64_t replay_date;
 
@@ -136,10 +145,31 @@ struct vrt_request
 
 #define VRT_REQ_GET_GROUP(vrt_req) ((vrt_req)->ref_vol->group)
 
+/**
+ * Get the number of striping units a request spans.
+ *
+ * @param[in] vrt_req  The request
+ * @param[in] su_size  Size of a striping unit, in sectors
+ *
+ * @return the number of striping units, at least 1
+ */
+static inline unsigned int vrt_request_get_nb_su(const struct vrt_request *vrt_req,
+                                                 uint32_t su_size)
+{
+    uint64_t start = vrt_req->ref_bio->start_sector;
+    uint64_t end = start + BYTES_TO_SECTORS(vrt_req->ref_bio->size);
+
+    if (end == start)
+        return 1;
+
+    return quotient_ceil64(end, su_size) - start / su_size;
+}
+
 void vrt_wakeup_request(struct vrt_request *vrt_req);
 void vrt_thread_wakeup(void);
+unsigned int vrt_engine_assign_thread(void);
 
-int vrt_engine_init(int max_requests);
+int vrt_engine_init(int max_requests, unsigned int nb_threads);
 void vrt_engine_cleanup(void);
 void vrt_make_request(void *private_data, blockdevice_io_t *bio);
 unsigned int vrt_get_max_requests(void);
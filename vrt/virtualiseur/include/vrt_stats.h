@@ -15,6 +15,9 @@
 
 void vrt_stats_restart(struct vrt_stats_volume *stats);
 void vrt_stats_handle_message(const struct vrt_stats_request *request, vrt_reply_t *reply);
+void vrt_stats_handle_rdev_message(const struct vrt_rdev_stats_request *request,
+                                   vrt_reply_t *reply);
+uint64_t vrt_stats_date_us(void);
 void vrt_stat_request_begin(struct vrt_request *request);
 void vrt_stat_request_done(struct vrt_request *request, bool failed);
 
@@ -60,19 +60,6 @@ typedef struct vrt_volume
 	defined below, becomes 0). */
     wait_queue_head_t cmd_wq;
 
-    /** Set when a barrier on the volume is ongoing. */
-    blockdevice_io_t *barrier_bio;
-
-    /** Mutex used to do an atomic test and set of barrier bio */
-    os_thread_mutex_t barrier_lock;
-
-    /** Waitqueue on which the task that requested the barrier is registered. */
-    wait_queue_head_t barrier_req_wq;
-
-    /** Waitqueue on which processes waiting to access the volume after
-	a barrier are registered. */
-    wait_queue_head_t barrier_post_req_wq;
-
     /** The number of request handled by the virtualizer that are in progress.
 	It is used to be able to wait until all requests have finished. We do not
 	count request of type "normal-sub". */
@@ -10,8 +10,49 @@
 #define VRT_VOLUME_STATS_H
 
 #include "vrt/virtualiseur/include/vrt_common.h"
+#include "common/include/exa_histogram.h"
 #include "os/include/os_inttypes.h"
 
+/** Kinds of requests whose latency is measured separately */
+typedef enum
+{
+#define VRT_LATENCY__FIRST  VRT_LATENCY_READ
+    VRT_LATENCY_READ,
+    VRT_LATENCY_WRITE,
+    VRT_LATENCY_BARRIER
+#define VRT_LATENCY__LAST   VRT_LATENCY_BARRIER
+} vrt_latency_type_t;
+
+#define VRT_LATENCY_TYPES  (VRT_LATENCY__LAST - VRT_LATENCY__FIRST + 1)
+
+/**
+ * Get the latency kind of a request type.
+ *
+ * @param[in] iotype  Type of request, other than VRT_IO_TYPE_NONE
+ */
+static inline vrt_latency_type_t vrt_latency_type(vrt_io_type_t iotype)
+{
+    switch (iotype)
+    {
+    case VRT_IO_TYPE_READ:
+        return VRT_LATENCY_READ;
+    case VRT_IO_TYPE_WRITE_BARRIER:
+        return VRT_LATENCY_BARRIER;
+    default:
+        return VRT_LATENCY_WRITE;
+    }
+}
+
+/** Latency percentiles of the requests of a kind, in microseconds */
+struct vrt_stats_latency
+{
+    uint64_t nb_req;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t pad;
+};
+
 struct vrt_stats_begin
 {
     uint64_t nb_sect_read;
@@ -47,6 +88,18 @@ struct vrt_stats_volume
     struct {
 	struct vrt_stats_done info;
     } done;
+
+    /** Latencies of the requests since the last reset, per latency kind */
+    exa_histogram_t latency[VRT_LATENCY_TYPES];
 };
 
+/**
+ * Get the percentiles of a latency histogram.
+ *
+ * @param[in]  hist     Histogram of latencies in microseconds
+ * @param[out] latency  Percentiles
+ */
+void vrt_stats_get_latency(const exa_histogram_t *hist,
+                           struct vrt_stats_latency *latency);
+
 #endif /* VRT_VOLUME_STATS_H */
@@ -7,6 +7,7 @@
  */
 
 #include "vrt/virtualiseur/include/volume_blockdevice.h"
+#include "vrt/virtualiseur/include/constantes.h"
 #include "vrt/virtualiseur/include/vrt_group.h"
 #include "vrt/virtualiseur/include/vrt_layout.h"
 #include "vrt/virtualiseur/include/vrt_request.h"
@@ -26,7 +27,6 @@ typedef struct
     vrt_volume_t *volume;
     uint64_t su_size;
 
-    os_thread_mutex_t lock;
     struct nbd_root_list bio_for_split;
     struct nbd_root_list bio_split;
 } volume_bdev_t;
@@ -97,35 +97,32 @@ static void bio_split_callback(blockdevice_io_t *bio, int err)
     }
 }
 
-static bool __io_fits_striping_unit(const blockdevice_io_t *bio, uint64_t su_size)
+/**
+ * Get the number of sectors a request starting at a given sector can span:
+ * what the layout accepts in a single request, without going over
+ * VRT_MAX_SU_PER_REQUEST striping units.
+ */
+static uint64_t bdev_request_max_sectors(const volume_bdev_t *bdev,
+                                         uint64_t sector)
 {
-    int64_t end_sector;
+    const struct vrt_layout *layout = bdev->volume->group->layout;
+    uint64_t su_offset = sector % bdev->su_size;
 
-    if (su_size == 0 || bio->size == 0)
-        return true;
+    if (layout->get_request_max_sectors == NULL)
+        return bdev->su_size - su_offset;
 
-    end_sector = bio->start_sector + BYTES_TO_SECTORS(bio->size) - 1;
-    return bio->start_sector / su_size == end_sector / su_size;
+    return MIN(layout->get_request_max_sectors(bdev->volume, sector),
+               VRT_MAX_SU_PER_REQUEST * bdev->su_size - su_offset);
 }
 
-static void bdev_submit_io(volume_bdev_t *bdev, blockdevice_io_t *bio)
+static bool __io_fits_request(const volume_bdev_t *bdev,
+                              const blockdevice_io_t *bio)
 {
-    char err = 0;
-
-    EXA_ASSERT(__io_fits_striping_unit(bio, bdev->su_size));
-
-    os_thread_mutex_lock(&bdev->lock);
-
-    if (bio->size > 0
-        && bio->start_sector + BYTES_TO_SECTORS(bio->size) > bdev->volume->size)
-        err = -EIO;
-
-    os_thread_mutex_unlock(&bdev->lock);
+    if (bdev->su_size == 0 || bio->size == 0)
+        return true;
 
-    if (err != 0)
-        blockdevice_end_io(bio, err);
-    else
-        vrt_make_request(bdev->volume, bio);
+    return BYTES_TO_SECTORS(bio->size)
+           <= bdev_request_max_sectors(bdev, bio->start_sector);
 }
 
 /**
@@ -136,17 +133,26 @@ static void bdev_submit_io(volume_bdev_t *bdev, blockdevice_io_t *bio)
 static int volume_blockdevice_submit_io(void *ctx, blockdevice_io_t *bio)
 {
   volume_bdev_t *bdev = ctx;
-  uint64_t su_size   = bdev->su_size;
   uint64_t bio_size_in_sector = BYTES_TO_SECTORS(bio->size);
   blockdevice_io_split_t *split;
-  int len_sector = 0;
+  uint64_t len_sector = 0;
   int bv_off = 0;
   int split_bio_count = 0, split_bio_waiting = 0;
 
-  /* IO fits inside a striping unit: it's submittable unsplit. */
-  if (__io_fits_striping_unit(bio, su_size))
+  /* The size of a volume only changes while the volume is frozen, i.e.
+   * without IO in progress: no need for a lock to check against it. */
+  if (bio->size > 0
+      && bio->start_sector + bio_size_in_sector > bdev->volume->size)
   {
-      bdev_submit_io(bdev, bio);
+      blockdevice_end_io(bio, -EIO);
+      return 0;
+  }
+
+  /* IO fits inside what the layout handles at once: it's submittable
+   * unsplit. */
+  if (__io_fits_request(bdev, bio))
+  {
+      vrt_make_request(bdev->volume, bio);
       return 0;
   }
 
@@ -160,24 +166,31 @@ static int volume_blockdevice_submit_io(void *ctx, blockdevice_io_t *bio)
   split->bdev     = bdev;
   split->err      = 0;
 
-  /* The IO overlaps multiple striping units, so it must be split
-   * in IOs fitting inside them.
+  /* The IO overlaps multiple requests, so it must be split in IOs fitting
+   * inside them. The number of parts must be known before submitting the
+   * first one, which may end right away.
    */
-  split->bio_waiting = quotient_ceil64(bio_size_in_sector + bio->start_sector, su_size)
-                       - bio->start_sector / su_size;
+  split->bio_waiting = 0;
+  while (len_sector < bio_size_in_sector)
+  {
+      len_sector += MIN(bio_size_in_sector - len_sector,
+                        bdev_request_max_sectors(bdev, bio->start_sector + len_sector));
+      split->bio_waiting++;
+  }
 
   split_bio_waiting = split->bio_waiting;
 
+  len_sector = 0;
   while (len_sector < bio_size_in_sector)
   {
       blockdevice_io_t *bio_temp;
-      int io_size;
+      uint64_t io_size;
 
       /* FIXME stop messing up with sectors and bytes here... */
 
-      /* Make sure the IO doesn't cross the SU bound. */
-      io_size = MIN(BYTES_TO_SECTORS(bio->size - bv_off),
-                    su_size - (bio->start_sector + len_sector) % su_size);
+      /* Make sure the IO doesn't cross the request bound. */
+      io_size = MIN(bio_size_in_sector - len_sector,
+                    bdev_request_max_sectors(bdev, bio->start_sector + len_sector));
 
       bio_temp = nbd_list_remove(&bdev->bio_for_split.free,
                                  NULL, LISTWAIT);
@@ -204,7 +217,7 @@ static int volume_blockdevice_submit_io(void *ctx, blockdevice_io_t *bio)
                      "Error in bio split: expected=%d performed=%d."
                      " size=%"PRIu64" su_size=%" PRIu64,
                      split_bio_waiting, split_bio_count, bio->size,
-                     su_size);
+                     bdev->su_size);
 
   return 0;
 }
@@ -214,8 +227,6 @@ static void bdev_delete(volume_bdev_t *bdev)
     nbd_close_root(&bdev->bio_split);
     nbd_close_root(&bdev->bio_for_split);
 
-    os_thread_mutex_destroy(&bdev->lock);
-
     os_free(bdev);
 }
 
@@ -246,8 +257,6 @@ static volume_bdev_t *volume_bdev_create(vrt_volume_t *volume)
     bd->volume  = volume;
     bd->su_size = su_size;
 
-    os_thread_mutex_init(&bd->lock);
-
     nbd_init_root(NB_BIO_IN_SPLIT_POOL, sizeof(blockdevice_io_split_t),
 	          &bd->bio_split);
     nbd_init_root(NB_BIO_PER_POOL, sizeof(blockdevice_io_t),
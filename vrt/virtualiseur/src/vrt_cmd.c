@@ -1142,9 +1142,10 @@ void vrt_cmd_handle_message(const vrt_cmd_t *recv, vrt_reply_t *reply)
 
     case VRTRECV_ASK_INFO:
     case VRTRECV_STATS:
+    case VRTRECV_RDEV_STATS:
 	EXA_ASSERT_VERBOSE(FALSE,
 		"Type %s (%d) Should not be handled by this thread\n",
-		recv->type == VRTRECV_STATS ?  "stats" : "info", recv->type);
+		recv->type == VRTRECV_ASK_INFO ?  "info" : "stats", recv->type);
     }
 }
 
@@ -66,6 +66,9 @@ static void vrt_cmd_thread_loop(void *data)
 	    vrt_info_handle_message(&recv.d.vrt_ask_info, th->reply);
 	else if (recv.type == VRTRECV_STATS)
 	    vrt_stats_handle_message(&recv.d.vrt_stats_request, th->reply);
+	else if (recv.type == VRTRECV_RDEV_STATS)
+	    vrt_stats_handle_rdev_message(&recv.d.vrt_rdev_stats_request,
+					  th->reply);
 	else
 	    vrt_cmd_handle_message(&recv, th->reply);
 
@@ -343,6 +343,8 @@ vrt_group_t *vrt_group_alloc(const char *group_name, const exa_uuid_t *group_uui
     os_thread_rwlock_init(&group->status_lock);
     os_thread_rwlock_init(&group->suspend_lock);
 
+    group->engine_thread = vrt_engine_assign_thread();
+
     group->sb_version = 0;
 
     return group;
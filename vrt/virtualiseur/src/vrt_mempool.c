@@ -61,6 +61,15 @@ struct vrt_object_pool *vrt_mempool_create (unsigned int object_size,
 	os_free(pool);
 	return NULL;
     }
+
+    /* Requests are allocated and freed by many threads */
+    if (nbd_root_cache_free(&pool->root) < 0)
+    {
+	nbd_close_root(&pool->root);
+	os_free(pool);
+	return NULL;
+    }
+
     return pool;
 }
 
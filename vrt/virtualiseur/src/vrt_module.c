@@ -272,6 +272,7 @@ exa_bool_t vrt_barriers_enabled(void)
 
 static int vrt_module_init(int param_node_id,
                            int param_max_requests,
+                           int param_engine_threads,
                            exa_bool_t param_io_barriers)
 {
     int retval;
@@ -286,14 +287,14 @@ static int vrt_module_init(int param_node_id,
 
     INIT_LIST_HEAD(&vrt_groups_list);
 
-    if (node_id < 0 || max_requests < 0)
+    if (node_id < 0 || max_requests < 0 || param_engine_threads < 1)
 	return -EINVAL;
 
     vrt_nodes_init(node_id);
 
     exalog_as(EXAMSG_VRT_ID);
 
-    retval = vrt_engine_init(max_requests);
+    retval = vrt_engine_init(max_requests, param_engine_threads);
     if (retval < 0)
 	goto error_vrt_engine_init;
 
@@ -339,14 +340,20 @@ static void vrt_module_exit(void)
     exalog_end();
 }
 
-void vrt_init(int adm_my_id, int max_requests, exa_bool_t io_barriers,
+void vrt_init(int adm_my_id, int max_requests, int engine_threads,
+              exa_bool_t io_barriers,
               int rebuilding_slowdown_ms,
-              int degraded_rebuilding_slowdown_ms)
+              int degraded_rebuilding_slowdown_ms,
+              rain1_read_policy_t rain1_read_policy,
+              int rain1_dzone_retention_s,
+              int rain1_sync_latency_target_ms)
 {
     sstriping_init();
-    rain1_init(rebuilding_slowdown_ms, degraded_rebuilding_slowdown_ms);
+    rain1_init(rebuilding_slowdown_ms, degraded_rebuilding_slowdown_ms,
+               rain1_read_policy, rain1_dzone_retention_s,
+               rain1_sync_latency_target_ms);
 
-    vrt_module_init(adm_my_id, max_requests, io_barriers);
+    vrt_module_init(adm_my_id, max_requests, engine_threads, io_barriers);
 }
 
 void vrt_exit(void)
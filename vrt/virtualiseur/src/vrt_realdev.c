@@ -172,6 +172,9 @@ struct vrt_realdev *vrt_rdev_new(exa_nodeid_t node_id,
     rdev->spof_id = spof_id;
     rdev->index   = index;
 
+    os_atomic_set(&rdev->inflight_ios, 0);
+    rdev->avg_latency_us = 0;
+
     /* Initialize the device status */
     rdev->up = up;
     rdev->corrupted = FALSE;
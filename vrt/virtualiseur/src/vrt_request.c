@@ -65,11 +65,15 @@
  * Otherwise, the new I/O have to be performed. As the
  * vrt_next_step_io() is executed in an interrupt context, we cannot ask
  * the kernel to perform this I/O directly. Instead, we had them in a
- * global linked list (vrt_pending_req_list), and wake up a kernel
- * thread (vrt_thread()), which will later on process the I/Os of all
- * pending requests in the global linked list. To do so, the thread
- * fills the bios and calls vrt_request_perform(), just as we
- * did for the first round of I/Os.
+ * linked list (the pending_req_list of an engine thread), and wake up
+ * that thread (vrt_thread_engine()), which will later on process the I/Os
+ * of all pending requests in the list. To do so, the thread fills the bios
+ * and calls vrt_request_perform(), just as we did for the first round of
+ * I/Os.
+ *
+ * The engine runs several threads. Each group is handled by one thread
+ * only, so that the layout functions are never called concurrently for a
+ * given group, but independent groups are processed in parallel.
  *
  * When these new I/Os are completed, the vrt_end_io() function is
  * called again, and the process repeats again and again, until the
@@ -83,9 +87,13 @@
 #include "common/include/exa_error.h"
 #include "common/include/threadonize.h"
 
+#include "exatrace/include/exatrace.h"
+
 #include "os/include/os_time.h"
 #include "os/include/os_atomic.h"
 #include "os/include/os_error.h"
+#include "os/include/os_semaphore.h"
+#include "os/include/os_stdio.h"
 
 #include "log/include/log.h"
 
@@ -123,53 +131,58 @@
  */
 struct vrt_object_pool *vrt_req_pool, *io_pool, *bio_pool, *barrier_pool;
 
-static struct {
-    os_thread_t tid;    /** vrt thread id */
-    bool ask_terminate; /** ask the vrt_thread() to terminate */
-    os_atomic_t event;
-    wait_queue_head_t wq;
-} vrt_thread;
-
 /**
- * The list of request headers that needs to be processed by the
+ * The list of request headers that needs to be processed by an engine
  * thread.
  *
- * We do not use the kernel <linux/list.h> facilities, because we
- * don't want to hold the lock for too much time in the kernel
- * thread. Using a head and tail pointer, we can simply save them in
- * the thread, set them to NULL, and release the lock.
- *
- * We have both a head and tail pointers because we want to add the
- * new request headers to be processed at the end of the list, in
- * order to keep the good order.
+ * Requests are added from any thread (vrt_end_io() and friends,
+ * vrt_make_request(), the layouts) and taken all at once by the engine
+ * thread, so the list is a lock-free stack: adding is a compare and
+ * exchange of the head, taking is an exchange of the head with NULL.
+ * The taken stack is reversed to process the requests in the order they
+ * were added.
  */
 struct vrt_request_list
 {
-    struct vrt_request *head;
-    struct vrt_request *tail;
-    unsigned int count;
-    os_thread_mutex_t lock;
+    struct vrt_request * volatile head;
 };
 
-/** List of requests reinitialized by vrt_request_cancel(). Requests in that
- * list are not counted in initialized_request_count.
- */
-
-static struct vrt_request_list vrt_suspended_req_list;
+/** A thread of the VRT engine and the lists of requests it processes */
+struct vrt_engine_thread
+{
+    os_thread_t tid;
+    os_atomic_t event;
+    wait_queue_head_t wq;
 
-/** List of requests which need to be rebuilt with build_io_for_req. They are
- * added in that list by layouts with vrt_wakeup_request() or when the group is
- * resumed from vrt_suspended_req_list. Requests in that list are counted in
- * initialized_request_count.
- */
+    /** List of requests reinitialized by vrt_request_cancel(). Requests in
+     * that list are not counted in initialized_request_count.
+     */
+    struct vrt_request_list suspended_req_list;
 
-static struct vrt_request_list vrt_tobuild_req_list;
+    /** List of requests which need to be rebuilt with build_io_for_req. They
+     * are added in that list by layouts with vrt_wakeup_request() or when the
+     * group is resumed from suspended_req_list. Requests in that list are
+     * counted in initialized_request_count.
+     */
+    struct vrt_request_list tobuild_req_list;
 
-/** List of requests already built by build_io_for_req. Their IO are ready to
- * perform. Requests in that list are counted in initialized_request_count.
- */
+    /** List of requests already built by build_io_for_req. Their IO are
+     * ready to perform. Requests in that list are counted in
+     * initialized_request_count.
+     */
+    struct vrt_request_list pending_req_list;
+};
 
-static struct vrt_request_list vrt_pending_req_list;
+static struct {
+    bool ask_terminate;         /** ask the engine threads to terminate */
+    unsigned int nb_threads;    /** number of engine threads */
+    unsigned int next_thread;   /** thread handling the next group */
+    unsigned int io_pool_size;  /** number of IOs in the IO and bio pools */
+    os_atomic_t io_available;   /** IOs not reserved by a request */
+    os_atomic_t io_waiters;     /** requests waiting for IOs to be freed */
+    os_sem_t io_freed;          /** posted when IOs are freed while waited */
+    struct vrt_engine_thread thread[VRT_MAX_ENGINE_THREADS];
+} vrt_engine;
 
 /* XXX 512 is legacy, I do not know if this value is not too large nor large
  * enougth*/
@@ -197,93 +210,81 @@ static blockdevice_io_t *bio_alloc(void)
 static void vrt_req_list_init(struct vrt_request_list *list)
 {
     list->head = NULL;
-    list->tail = NULL;
-    list->count = 0;
-    os_thread_mutex_init(&list->lock);
-}
-
-static void vrt_req_list_clean(struct vrt_request_list *list)
-{
-    os_thread_mutex_destroy(&list->lock);
 }
 
 /**
  * Add a request header in a list of requests to be handled
- * later by the virtualizer thread
+ * later by an engine thread
  *
  * @param[in] list    The list of requests
  * @param[in] vrt_req The request header
  */
 static void vrt_req_list_add(struct vrt_request_list *list, struct vrt_request *vrt_req)
 {
-    os_thread_mutex_lock(& list->lock);
+    struct vrt_request *head;
 
     EXA_ASSERT (vrt_req->next == NULL);
 
-    /* Add the request to the list of pending requests that have to
-       be handled by the kernel thread */
-    if (list->tail != NULL)
-    {
-	EXA_ASSERT (list->head != NULL);
-	list->tail->next = vrt_req;
-	list->tail       = vrt_req;
-    }
-    else
+    do
     {
-	EXA_ASSERT (list->head == NULL);
-	list->tail = vrt_req;
-	list->head = vrt_req;
-    }
-
-    list->count ++;
-
-    os_thread_mutex_unlock(& list->lock);
+        head = list->head;
+        vrt_req->next = head;
+    } while (os_atomic_ptr_cmpxchg((void * volatile *)&list->head,
+                                   head, vrt_req) != head);
 }
 
 /**
  * Take a list of requests from the specified list to be handled
- * by the virtualizer thread. The caller can go through the list
+ * by an engine thread. The caller can go through the list
  * with ->next.
  *
  * The specified list will be empty after this function.
  *
  * @param[in] list    The list of requests
- * @return The first request header of the list
+ * @return The first request header of the list, in the order the requests
+ *         were added, or NULL if the list is empty
  */
 static struct vrt_request *vrt_req_list_take(struct vrt_request_list *list)
 {
-    struct vrt_request *cur;
-
-    /* The global list of tobuild request headers can be accessed
-       concurrently by other functions (e.g. vrt_end_io() and
-       friends). */
-    os_thread_mutex_lock(& list->lock);
-
-    /* As the semaphore used to wake us up is not a binary
-       semaphore, we can be woken up without anything to do (all
-       requests were processed by a previous turn of the loop). We
-       detect this case early and go to sleep again. */
-    if (list->count == 0)
+    struct vrt_request *cur, *next, *first = NULL;
+
+    /* The list can be accessed concurrently by other functions (e.g.
+       vrt_end_io() and friends): empty it at once. */
+    cur = os_atomic_ptr_xchg((void * volatile *)&list->head, NULL);
+
+    /* The list is a stack, reverse it to keep the good order */
+    while (cur != NULL)
     {
-	EXA_ASSERT (list->head == NULL);
-	EXA_ASSERT (list->tail == NULL);
-	os_thread_mutex_unlock(& list->lock);
-	return NULL;
+        next = cur->next;
+        cur->next = first;
+        first = cur;
+        cur = next;
     }
 
-    /* Keep the list head somewhere in a local variable, empty the
-       list and immediatly release the lock, so that it doesn't
-       remain held for a long time */
-    EXA_ASSERT (list->head != NULL);
-    EXA_ASSERT (list->tail != NULL);
-    cur = list->head;
-    list->head  = NULL;
-    list->tail  = NULL;
-    list->count = 0;
+    return first;
+}
+
+/**
+ * Get the engine thread handling the group of a request.
+ *
+ * @param[in] vrt_req The request header
+ */
+static struct vrt_engine_thread *vrt_req_thread(const struct vrt_request *vrt_req)
+{
+    unsigned int index = VRT_REQ_GET_GROUP(vrt_req)->engine_thread;
 
-    os_thread_mutex_unlock(& list->lock);
+    EXA_ASSERT(index < vrt_engine.nb_threads);
 
-    return cur;
+    return &vrt_engine.thread[index];
+}
+
+/**
+ * Wake up an engine thread
+ */
+static void vrt_engine_thread_wakeup(struct vrt_engine_thread *thread)
+{
+    os_atomic_set(&thread->event, 1);
+    wake_up(&thread->wq);
 }
 
 /**
@@ -327,7 +328,7 @@ static void vrt_request_schedule_replay(struct vrt_request *vrt_req)
 {
     /* add the request in the pending list in order to be replayed later */
     vrt_req->replay_date = os_gettimeofday_msec() + VRT_REPLAY_REQUEST_DELAY_MSEC;
-    vrt_req_list_add(&vrt_pending_req_list, vrt_req);
+    vrt_req_list_add(&vrt_req_thread(vrt_req)->pending_req_list, vrt_req);
 }
 
 /**
@@ -356,8 +357,8 @@ static void vrt_next_step_io(struct vrt_request *vrt_req)
             return;
         }
 
-    vrt_req_list_add(&vrt_tobuild_req_list, vrt_req);
-    vrt_thread_wakeup();
+    vrt_req_list_add(&vrt_req_thread(vrt_req)->tobuild_req_list, vrt_req);
+    vrt_engine_thread_wakeup(vrt_req_thread(vrt_req));
 }
 
 /**
@@ -400,6 +401,9 @@ static void vrt_end_io(blockdevice_io_t *bio, int error)
 
     EXA_ASSERT(ref_io->state == IO_TO_PROCESS);
 
+    vrt_rdev_end_io(ref_io->rdev, ref_io->vrt_req->iotype,
+                    vrt_stats_date_us() - ref_io->start_us);
+
     /* An IO FAILURE may be either a real error or a temporary error due to
      * the NBD locking. */
     switch (error)
@@ -425,6 +429,7 @@ static void vrt_end_io(blockdevice_io_t *bio, int error)
     }
 
     VRT_PERF_IO_OP_END(ref_io);
+    EXATRACE(VRT_IO_END, bio, 0, error);
 
     /* If there aren't any remaining processing I/O in the list, we call
        vrt_next_step_io() to process the next step of the request */
@@ -490,6 +495,11 @@ static int vrt_request_perform(struct vrt_request *vrt_req)
                 break;
         }
 
+        curr_io->start_us = vrt_stats_date_us();
+        vrt_rdev_begin_io(curr_io->rdev);
+
+        EXATRACE(VRT_IO_BEGIN, curr_io->bio, vrt_req, curr_io->size);
+
         blockdevice_submit_io(curr_io->rdev->blockdevice, curr_io->bio, type,
                               curr_io->offset, curr_io->data, curr_io->size,
                               flush_cache, curr_io, vrt_end_io);
@@ -538,6 +548,56 @@ static int vrt_request_perform(struct vrt_request *vrt_req)
     return EXA_SUCCESS;
 }
 
+/**
+ * Reserve IOs in the IO and bio pools, waiting for other requests to free
+ * them if there are not enough available.
+ *
+ * @param[in] io_count  Number of IOs to reserve
+ */
+static void vrt_io_reserve(unsigned int io_count)
+{
+    while (true)
+    {
+        int available = os_atomic_read(&vrt_engine.io_available);
+
+        if (available >= (int)io_count)
+        {
+            if (os_atomic_cmpxchg(&vrt_engine.io_available, available,
+                                  available - io_count) == available)
+                return;
+            continue;
+        }
+
+        /* Declare ourself waiting before checking again, so that a request
+         * freeing its IOs in between does post the semaphore */
+        os_atomic_inc(&vrt_engine.io_waiters);
+        if (os_atomic_read(&vrt_engine.io_available) < (int)io_count)
+            os_sem_wait(&vrt_engine.io_freed);
+        os_atomic_dec(&vrt_engine.io_waiters);
+    }
+}
+
+/**
+ * Give back IOs reserved with vrt_io_reserve() and wake up the requests
+ * waiting for them.
+ *
+ * @param[in] io_count  Number of IOs to give back
+ */
+static void vrt_io_release(unsigned int io_count)
+{
+    int available;
+    int waiters;
+
+    do {
+        available = os_atomic_read(&vrt_engine.io_available);
+    } while (os_atomic_cmpxchg(&vrt_engine.io_available, available,
+                               available + io_count) != available);
+
+    /* Each waiter checks again whether its IOs are available now */
+    for (waiters = os_atomic_read(&vrt_engine.io_waiters); waiters > 0; waiters--)
+        os_sem_post(&vrt_engine.io_freed);
+}
+
 /**
  * Allocate IO structures and associated bios for the given request
  * header. It also builds the chained list of IO structures and
@@ -561,6 +621,14 @@ static void vrt_alloc_structs(struct vrt_request *vrt_req,
 
     EXA_ASSERT (io_count != 0);
 
+    EXA_ASSERT (io_count <= vrt_engine.io_pool_size);
+
+    /* A request spanning several striping units needs several IOs: if the
+     * pools were exhausted by requests each holding part of what they
+     * need, none of them could go on. Requests thus reserve all their IOs
+     * at once, and the allocations below never wait. */
+    vrt_io_reserve(io_count);
+
     vrt_req->io_list = NULL;
     for (i = 0; i < io_count; i++)
     {
@@ -599,6 +667,7 @@ static void vrt_alloc_structs(struct vrt_request *vrt_req,
 static void vrt_free_structs(struct vrt_request *vrt_req)
 {
     struct vrt_io_op *io;
+    unsigned int io_count = 0;
 
     io = vrt_req->io_list;
     while (io != NULL)
@@ -610,10 +679,14 @@ static void vrt_free_structs(struct vrt_request *vrt_req)
 
 	vrt_mempool_object_free (bio_pool, io->bio);
 	vrt_mempool_object_free (io_pool, io);
+	io_count++;
 
 	io = next;
     }
 
+    if (io_count != 0)
+        vrt_io_release(io_count);
+
     if (vrt_req->barrier != NULL)
         vrt_mempool_object_free(barrier_pool, vrt_req->barrier);
 }
@@ -705,29 +778,16 @@ static void vrt_end_request(struct vrt_request *vrt_req, bool failed)
     os_atomic_dec(& group->initialized_request_count);
     EXA_ASSERT (os_atomic_read (& group->initialized_request_count) >= 0);
 
-    /* The barrier is completed. Wake up all tasks that were waiting for
-     * the barrier completion.
-     */
-    if (bio == volume->barrier_bio)
-    {
-	volume->barrier_bio = NULL;
-	wake_up_all(&volume->barrier_post_req_wq);
-    }
-
     if (os_atomic_read (& group->initialized_request_count) == 0)
 	wake_up_all (& group->recover_wq);
 
-    /* If the request count reaches 0, then it's time to wake up the
-     * process (if any) that want to submit its barrier.
-     */
-    if (os_atomic_dec_and_test(&volume->inprogress_request_count))
-	wake_up_all(&volume->barrier_req_wq);
-
+    os_atomic_dec(&volume->inprogress_request_count);
     EXA_ASSERT (os_atomic_read (& volume->inprogress_request_count) >= 0);
 
     wake_up_all (& volume->cmd_wq);
 
     VRT_PERF_END_REQUEST(vrt_req);
+    EXATRACE(VRT_END, vrt_req, 0, failed ? -EIO : 0);
     vrt_stat_request_done(vrt_req, failed);
 
     vrt_free_structs(vrt_req);
@@ -762,12 +822,12 @@ vrt_request_cancel (struct vrt_request *vrt_req)
 	wake_up_all (& group->recover_wq);
 
     EXA_ASSERT(vrt_check_for_build_io_for_req(vrt_req));
-    vrt_req_list_add(& vrt_suspended_req_list, vrt_req);
+    vrt_req_list_add(&vrt_req_thread(vrt_req)->suspended_req_list, vrt_req);
 }
 
 /**
- * Process suspended requests of the global vrt_suspended_req_list
- * list. This function is called by the virtualizer thread in order to
+ * Process suspended requests of the suspended_req_list of an engine
+ * thread. This function is called by the engine thread in order to
  * resume requests if theses requests can be resumed.
  */
 static void vrt_process_suspended_requests(struct vrt_request *list)
@@ -792,11 +852,11 @@ static void vrt_process_suspended_requests(struct vrt_request *list)
 
 	os_thread_rwlock_rdlock(&group->suspend_lock);
 	if (group->suspended)
-	    vrt_req_list_add(& vrt_suspended_req_list, cur);
+	    vrt_req_list_add(&vrt_req_thread(cur)->suspended_req_list, cur);
 	else
 	{
 	    os_atomic_inc (& group->initialized_request_count);
-	    vrt_req_list_add(& vrt_tobuild_req_list, cur);
+	    vrt_req_list_add(&vrt_req_thread(cur)->tobuild_req_list, cur);
 	}
 
         os_thread_rwlock_unlock(&group->suspend_lock);
@@ -806,8 +866,8 @@ static void vrt_process_suspended_requests(struct vrt_request *list)
 }
 
 /**
- * Process tobuild requests of the global vrt_tobuild_req_list
- * list. This function is called by the virtualizer thread in order to
+ * Process tobuild requests of the tobuild_req_list of an engine
+ * thread. This function is called by the engine thread in order to
  * process the next step of all tobuild requests.
  */
 static void vrt_process_tobuild_requests(struct vrt_request *list)
@@ -865,7 +925,7 @@ static void vrt_process_tobuild_requests(struct vrt_request *list)
 	    break;
 
         case VRT_REQ_UNCOMPLETED:
-	    vrt_req_list_add(& vrt_pending_req_list, cur);
+	    vrt_req_list_add(&vrt_req_thread(cur)->pending_req_list, cur);
 	    /* No need to wake up ourselves */
 	    break;
 
@@ -882,8 +942,8 @@ static void vrt_process_tobuild_requests(struct vrt_request *list)
 }
 
 /**
- * Process pending requests of the global vrt_pending_req_list
- * list. This function is called by the virtualizer thread in order to
+ * Process pending requests of the pending_req_list of an engine
+ * thread. This function is called by the engine thread in order to
  * process the next step of all pending requests.
  */
 static void vrt_process_pending_requests(struct vrt_request *list)
@@ -928,7 +988,7 @@ static void vrt_process_pending_requests(struct vrt_request *list)
 	    /* We are too early to perform this request. Add it to the pending
 	     * list to perform it later */
 	    os_thread_rwlock_unlock(&group->suspend_lock);
-	    vrt_req_list_add(& vrt_pending_req_list, cur);
+	    vrt_req_list_add(&vrt_req_thread(cur)->pending_req_list, cur);
 
 	    /* we do not need to wake up the thread: the timer will do it */
 
@@ -949,17 +1009,38 @@ static void vrt_process_pending_requests(struct vrt_request *list)
 }
 
 /**
- * Wake up the virtualizer thread
+ * Wake up all the engine threads
  */
 void vrt_thread_wakeup (void)
 {
-    os_atomic_set(&vrt_thread.event, 1);
-    wake_up(& vrt_thread.wq);
+    unsigned int i;
+
+    for (i = 0; i < vrt_engine.nb_threads; i++)
+        vrt_engine_thread_wakeup(&vrt_engine.thread[i]);
 }
 
 /**
- * The thread of the VRT engine. Its role is to run all the pending
- * IOs of the request headers registered in the global vrt_vrt_req_list.
+ * Choose the engine thread handling the requests of a new group.
+ * Groups are spread among the threads in turn.
+ *
+ * @return the index of the engine thread
+ */
+unsigned int vrt_engine_assign_thread(void)
+{
+    unsigned int index;
+
+    if (vrt_engine.nb_threads == 0)
+        return 0;
+
+    index = vrt_engine.next_thread % vrt_engine.nb_threads;
+    vrt_engine.next_thread++;
+
+    return index;
+}
+
+/**
+ * A thread of the VRT engine. Its role is to run all the pending
+ * IOs of the request headers registered in its lists.
  *
  * We cannot directly ask the kernel to perform the I/Os in
  * vrt_next_step_io() because this function runs in an
@@ -976,20 +1057,22 @@ void vrt_thread_wakeup (void)
  * @see vrt_next_step_io for more information on the use of this
  * thread
  *
- * @param[in] data Unused.
+ * @param[in] data The engine thread (struct vrt_engine_thread).
  */
 static void vrt_thread_engine(void *data)
 {
+    struct vrt_engine_thread *thread = data;
+
     exalog_as(EXAMSG_VRT_ID);
 
     while (1)
     {
 	struct vrt_request *vrt_req_list;
 
-	wait_event_or_timeout(vrt_thread.wq, os_atomic_read(&vrt_thread.event) != 0, VRT_REPLAY_REQUEST_DELAY_MSEC);
-	os_atomic_set(&vrt_thread.event, 0);
+	wait_event_or_timeout(thread->wq, os_atomic_read(&thread->event) != 0, VRT_REPLAY_REQUEST_DELAY_MSEC);
+	os_atomic_set(&thread->event, 0);
 
-	if (vrt_thread.ask_terminate)
+	if (vrt_engine.ask_terminate)
 	    break;
 
 	/* resume suspended requests if the group is resumed. If the group's
@@ -997,18 +1080,18 @@ static void vrt_thread_engine(void *data)
          * FIXME Ain't that stupid? Shouldn't we check if the group's
          * resumed here?
          */
-	vrt_req_list = vrt_req_list_take(& vrt_suspended_req_list);
+	vrt_req_list = vrt_req_list_take(&thread->suspended_req_list);
 	vrt_process_suspended_requests(vrt_req_list);
 
 	/* build requests with build_io_for_req. They'll come out of here
          * either done, uncompleted or postponed. If uncompleted,
          * they'll move to the the pending_req list.
          */
-	vrt_req_list = vrt_req_list_take(& vrt_tobuild_req_list);
+	vrt_req_list = vrt_req_list_take(&thread->tobuild_req_list);
 	vrt_process_tobuild_requests(vrt_req_list);
 
 	/* perform IO of each requests */
-	vrt_req_list = vrt_req_list_take(& vrt_pending_req_list);
+	vrt_req_list = vrt_req_list_take(&thread->pending_req_list);
 	vrt_process_pending_requests(vrt_req_list);
     }
 }
@@ -1022,7 +1105,7 @@ void vrt_wakeup_request (struct vrt_request *vrt_req)
     EXA_ASSERT(vrt_req);
 
     /* add the request in the tobuild list */
-    vrt_req_list_add(& vrt_tobuild_req_list, vrt_req);
+    vrt_req_list_add(&vrt_req_thread(vrt_req)->tobuild_req_list, vrt_req);
 }
 
 /**
@@ -1100,43 +1183,16 @@ void vrt_make_request(void *private_data, blockdevice_io_t *bio)
     while (volume->frozen)
     {
 	if (os_atomic_dec_and_test(&volume->inprogress_request_count))
-	    wake_up_all(&volume->barrier_req_wq);
+	    wake_up_all(&volume->cmd_wq);
 	wait_event(volume->frozen_req_wq, (volume->frozen == FALSE));
 	os_atomic_inc(&volume->inprogress_request_count);
     }
 
-    /* A barrier is requested. */
-    if (bio->flush_cache)
-    {
-        do
-        {
-            /* we loop here, because even if volume->barrier_bio == NULL another
-             * process can began to process its barrier before this one */
-            wait_event(volume->barrier_post_req_wq, (volume->barrier_bio == NULL));
-            os_thread_mutex_lock(&volume->barrier_lock);
-            if (volume->barrier_bio == NULL)
-                volume->barrier_bio = bio;
-            os_thread_mutex_unlock(&volume->barrier_lock);
-        }
-        while (volume->barrier_bio != bio);
-
-	/* Wait until all previous requests are completed. */
-	if (! os_atomic_dec_and_test(&volume->inprogress_request_count))
-	    wait_event(volume->barrier_req_wq,
-		       os_atomic_read(&volume->inprogress_request_count) == 0);
-	os_atomic_inc(&volume->inprogress_request_count);
-    }
-
-    /* If a barrier is in-progress, and if we are not issuing the bio
-     * flagged as barrier, we sleep until the end of the barrier.
-     */
-    else if (volume->barrier_bio != NULL)
-    {
-	if (os_atomic_dec_and_test(&volume->inprogress_request_count))
-	    wake_up_all(&volume->barrier_req_wq);
-	wait_event(volume->barrier_post_req_wq, (volume->barrier_bio == NULL));
-	os_atomic_inc(&volume->inprogress_request_count);
-    }
+    /* A request with flush_cache is a flush of the disk caches followed by a
+     * write that is itself flushed (FUA), both done by the layout. The flush
+     * covers the writes that completed before, so there is no need to wait
+     * for the requests in progress nor to hold the next ones: ordering the
+     * requests in flight is up to the upper layer. */
 
     vrt_req = vrt_mempool_object_alloc (vrt_req_pool);
     EXA_ASSERT (vrt_req);
@@ -1155,6 +1211,8 @@ void vrt_make_request(void *private_data, blockdevice_io_t *bio)
 
     vrt_req->ref_vol = volume;
 
+    EXATRACE(VRT_BEGIN, vrt_req, bio, bio->size);
+
     /* Update statistics */
     vrt_stat_request_begin(vrt_req);
 
@@ -1167,23 +1225,56 @@ void vrt_make_request(void *private_data, blockdevice_io_t *bio)
 
     os_atomic_inc (& group->initialized_request_count);
 
-    vrt_req_list_add(&vrt_tobuild_req_list, vrt_req);
-    vrt_thread_wakeup();
+    vrt_req_list_add(&vrt_req_thread(vrt_req)->tobuild_req_list, vrt_req);
+    vrt_engine_thread_wakeup(vrt_req_thread(vrt_req));
 }
 
-static int vrt_thread_start(void)
+static void vrt_threads_stop(void)
 {
-    init_waitqueue_head(&vrt_thread.wq);
-    os_atomic_set(&vrt_thread.event, 1);
+    unsigned int i;
 
-    vrt_thread.ask_terminate = false;
+    vrt_engine.ask_terminate = true;
+    vrt_thread_wakeup();
 
-    if (!exathread_create_named(&vrt_thread.tid, VRT_THREAD_STACK_SIZE,
-                                vrt_thread_engine, NULL, "vrt_thread"))
+    for (i = 0; i < vrt_engine.nb_threads; i++)
     {
-        clean_waitqueue_head(&vrt_thread.wq);
-        exalog_error("Cannot spawn virtualizer thread.");
-        return -EXA_ERR_THREAD_CREATE;
+        os_thread_join(vrt_engine.thread[i].tid);
+        clean_waitqueue_head(&vrt_engine.thread[i].wq);
+    }
+
+    vrt_engine.nb_threads = 0;
+}
+
+static int vrt_threads_start(unsigned int nb_threads)
+{
+    vrt_engine.ask_terminate = false;
+    vrt_engine.nb_threads = 0;
+    vrt_engine.next_thread = 0;
+
+    while (vrt_engine.nb_threads < nb_threads)
+    {
+        struct vrt_engine_thread *thread = &vrt_engine.thread[vrt_engine.nb_threads];
+        char name[32];
+
+        init_waitqueue_head(&thread->wq);
+        os_atomic_set(&thread->event, 1);
+
+        vrt_req_list_init(&thread->suspended_req_list);
+        vrt_req_list_init(&thread->tobuild_req_list);
+        vrt_req_list_init(&thread->pending_req_list);
+
+        os_snprintf(name, sizeof(name), "vrt_thread_%u", vrt_engine.nb_threads);
+        if (!exathread_create_named(&thread->tid, VRT_THREAD_STACK_SIZE,
+                                    vrt_thread_engine, thread, name))
+        {
+            clean_waitqueue_head(&thread->wq);
+            exalog_error("Cannot spawn virtualizer thread %u.",
+                         vrt_engine.nb_threads);
+            vrt_threads_stop();
+            return -EXA_ERR_THREAD_CREATE;
+        }
+
+        vrt_engine.nb_threads++;
     }
 
     return EXA_SUCCESS;
@@ -1191,14 +1282,24 @@ static int vrt_thread_start(void)
 
 /**
  * Initialize the VRT engine (allocate memory, initialize locks
- * and semaphores, create the vrt_thread() kernel thread)
+ * and semaphores, create the engine threads)
+ *
+ * @param[in] max_requests  Maximum number of requests handled at once
+ * @param[in] nb_threads    Number of engine threads, between 1 and
+ *                          VRT_MAX_ENGINE_THREADS
  *
  * @return EXA_SUCCESS on success, a negative error code on failure
  */
-int vrt_engine_init (int max_requests)
+int vrt_engine_init (int max_requests, unsigned int nb_threads)
 {
     int ret;
 
+    if (nb_threads < 1 || nb_threads > VRT_MAX_ENGINE_THREADS)
+    {
+        exalog_error("Invalid number of virtualizer threads: %u", nb_threads);
+        return -EINVAL;
+    }
+
     vrt_req_pool = vrt_mempool_create (sizeof(struct vrt_request),
 				       max_requests);
     if (vrt_req_pool == NULL)
@@ -1209,20 +1310,27 @@ int vrt_engine_init (int max_requests)
 	goto vrt_request_pool_error;
     }
 
-    io_pool = vrt_mempool_create (sizeof(struct vrt_io_op), max_requests);
+    /* A request needs up to VRT_MAX_IO_PER_SU IOs per striping unit it
+     * spans, and there must be enough IOs for the largest request */
+    vrt_engine.io_pool_size = MAX(max_requests, VRT_MAX_SU_PER_REQUEST)
+                              * VRT_MAX_IO_PER_SU;
+
+    io_pool = vrt_mempool_create (sizeof(struct vrt_io_op),
+                                  vrt_engine.io_pool_size);
     if (io_pool == NULL)
     {
-	exalog_error("Cannot create object pool for vrt_io_op (%d objs of size %" PRIzu ")",
-                     max_requests, sizeof (struct vrt_io_op));
+	exalog_error("Cannot create object pool for vrt_io_op (%u objs of size %" PRIzu ")",
+                     vrt_engine.io_pool_size, sizeof (struct vrt_io_op));
 	ret = -ENOMEM;
 	goto vrt_io_op_pool_error;
     }
 
-    bio_pool = vrt_mempool_create (sizeof(blockdevice_io_t), max_requests);
+    bio_pool = vrt_mempool_create (sizeof(blockdevice_io_t),
+                                   vrt_engine.io_pool_size);
     if (bio_pool == NULL)
     {
-	exalog_error("Cannot create object pool for bio (%d objs of size %" PRIzu ")",
-                     max_requests, sizeof (blockdevice_io_t));
+	exalog_error("Cannot create object pool for bio (%u objs of size %" PRIzu ")",
+                     vrt_engine.io_pool_size, sizeof (blockdevice_io_t));
 	ret = -ENOMEM;
 	goto vrt_bio_pool_error;
     }
@@ -1237,20 +1345,25 @@ int vrt_engine_init (int max_requests)
     }
 
    nbd_init_root(NB_BIO_PER_POOL, sizeof(blockdevice_io_t), &pool_of_bio);
+    if (nbd_root_cache_free(&pool_of_bio) < 0)
+    {
+	exalog_error("Cannot create cache of bio pool (%d objs)", NB_BIO_PER_POOL);
+	ret = -ENOMEM;
+	goto vrt_bio_cache_error;
+    }
 
-    vrt_req_list_init(&vrt_pending_req_list);
-    vrt_req_list_init(&vrt_tobuild_req_list);
-    vrt_req_list_init(&vrt_suspended_req_list);
+    os_atomic_set(&vrt_engine.io_available, vrt_engine.io_pool_size);
+    os_atomic_set(&vrt_engine.io_waiters, 0);
+    os_sem_init(&vrt_engine.io_freed, 0);
 
-    ret = vrt_thread_start();
+    ret = vrt_threads_start(nb_threads);
     if (ret == EXA_SUCCESS)
         return EXA_SUCCESS;
 
-    vrt_req_list_clean(&vrt_pending_req_list);
-    vrt_req_list_clean(&vrt_tobuild_req_list);
-    vrt_req_list_clean(&vrt_suspended_req_list);
-    vrt_mempool_destroy(barrier_pool);
+    os_sem_destroy(&vrt_engine.io_freed);
+vrt_bio_cache_error:
     nbd_close_root(&pool_of_bio);
+    vrt_mempool_destroy(barrier_pool);
 vrt_barrier_pool_error:
     vrt_mempool_destroy(bio_pool);
 vrt_bio_pool_error:
@@ -1262,26 +1375,14 @@ vrt_request_pool_error:
 }
 
 
-static void vrt_thread_stop(void)
-{
-    vrt_thread.ask_terminate = true;
-    vrt_thread_wakeup();
-
-    os_thread_join(vrt_thread.tid);
-
-    clean_waitqueue_head(&vrt_thread.wq);
-}
-
 /**
  * Cleanup the VRT engine
  */
 void vrt_engine_cleanup(void)
 {
-    vrt_thread_stop();
+    vrt_threads_stop();
 
-    vrt_req_list_clean(&vrt_pending_req_list);
-    vrt_req_list_clean(&vrt_tobuild_req_list);
-    vrt_req_list_clean(&vrt_suspended_req_list);
+    os_sem_destroy(&vrt_engine.io_freed);
 
     vrt_mempool_destroy(bio_pool);
     vrt_mempool_destroy(barrier_pool);
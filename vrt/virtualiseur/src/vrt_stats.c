@@ -9,8 +9,10 @@
 #include <string.h>
 
 #include "vrt/virtualiseur/include/constantes.h"
+#include "vrt/virtualiseur/include/storage.h"
 #include "vrt/virtualiseur/include/vrt_group.h"
 #include "vrt/virtualiseur/include/vrt_msg.h"
+#include "vrt/virtualiseur/include/vrt_realdev.h"
 #include "vrt/virtualiseur/include/vrt_request.h"
 #include "vrt/virtualiseur/include/vrt_volume.h"
 
@@ -20,6 +22,31 @@
 
 #include "vrt/virtualiseur/src/vrt_module.h"
 
+uint64_t vrt_stats_date_us(void)
+{
+    struct timespec now;
+
+    os_get_monotonic_time(&now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+void vrt_stats_get_latency(const exa_histogram_t *hist,
+                           struct vrt_stats_latency *latency)
+{
+    exa_histogram_snapshot_t snap;
+
+    exa_histogram_snapshot(hist, &snap);
+
+    latency->nb_req = snap.total;
+    latency->p50_us = exa_histogram_percentile(&snap, 50);
+    latency->p99_us = exa_histogram_percentile(&snap, 99);
+    latency->p999_us = exa_histogram_percentile(&snap, 99.9);
+    latency->pad = 0;
+}
+
+
 void vrt_stats_handle_message(const struct vrt_stats_request *request,
                               vrt_reply_t *reply)
 {
@@ -51,6 +78,10 @@ void vrt_stats_handle_message(const struct vrt_stats_request *request,
 	    reply->stats.begin = volume->stats.begin.info;
 	    reply->stats.done = volume->stats.done.info;
 
+	    for (i = VRT_LATENCY__FIRST; i <= VRT_LATENCY__LAST; i++)
+		vrt_stats_get_latency(&volume->stats.latency[i],
+				      &reply->stats.latency[i]);
+
 	    if (request->reset)
 		vrt_volume_reset_stats(volume);
 	}
@@ -62,6 +93,43 @@ void vrt_stats_handle_message(const struct vrt_stats_request *request,
 }
 
 
+void vrt_stats_handle_rdev_message(const struct vrt_rdev_stats_request *request,
+                                   vrt_reply_t *reply)
+{
+    struct vrt_group *group = vrt_get_group_from_uuid(&request->group_uuid);
+    struct vrt_realdev *rdev;
+    vrt_latency_type_t type;
+
+    memset(&reply->rdev_stats, 0, sizeof(reply->rdev_stats));
+
+    if (group == NULL)
+    {
+        reply->retval = -VRT_ERR_UNKNOWN_GROUP_UUID;
+        return;
+    }
+
+    rdev = storage_get_rdev(group->storage, &request->rdev_uuid);
+    if (rdev == NULL)
+    {
+        vrt_group_unref(group);
+        reply->retval = -VRT_ERR_UNKNOWN_DISK_UUID;
+        return;
+    }
+
+    for (type = VRT_LATENCY__FIRST; type <= VRT_LATENCY__LAST; type++)
+    {
+        vrt_stats_get_latency(&rdev->latency[type],
+                              &reply->rdev_stats.latency[type]);
+        if (request->reset)
+            exa_histogram_reset(&rdev->latency[type]);
+    }
+
+    vrt_group_unref(group);
+
+    reply->retval = EXA_SUCCESS;
+}
+
+
 static uint64_t distance(uint64_t offset1, uint64_t offset2)
 {
     return offset1 > offset2 ? offset1 - offset2 : offset2 - offset1;
@@ -112,6 +180,8 @@ void vrt_stat_request_begin(struct vrt_request *request)
 	EXA_ASSERT_VERBOSE(false, "Unexpected request type 'none'");
     }
 
+    request->start_us = vrt_stats_date_us();
+
     request->ref_vol->stats.begin.prev_request_type = request->iotype;
     request->ref_vol->stats.begin.next_sector = sect + nbsect;
 }
@@ -146,4 +216,7 @@ void vrt_stat_request_done(struct vrt_request *request, bool failed)
         case VRT_IO_TYPE_NONE:
             EXA_ASSERT(false);
     }
+
+    exa_histogram_add(&request->ref_vol->stats.latency[vrt_latency_type(request->iotype)],
+                      vrt_stats_date_us() - request->start_us);
 }
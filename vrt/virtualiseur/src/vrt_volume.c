@@ -44,10 +44,6 @@ static void vrt_volume_init(struct vrt_volume *volume)
     volume->status = EXA_VOLUME_STOPPED;
     init_waitqueue_head(&volume->frozen_req_wq);
     init_waitqueue_head(&volume->cmd_wq);
-    volume->barrier_bio = NULL;
-    os_thread_mutex_init(&volume->barrier_lock);
-    init_waitqueue_head(&volume->barrier_req_wq);
-    init_waitqueue_head(&volume->barrier_post_req_wq);
     os_atomic_set (& volume->inprogress_request_count, 0);
 }
 
@@ -106,8 +102,12 @@ bool vrt_volume_equals(const vrt_volume_t *a, const vrt_volume_t *b)
 
 static void vrt_volume_init_stats(vrt_volume_t *volume)
 {
+    vrt_latency_type_t i;
+
     memset(&volume->stats.begin, 0, sizeof(volume->stats.begin));
     memset(&volume->stats.done, 0, sizeof(volume->stats.done));
+    for (i = VRT_LATENCY__FIRST; i <= VRT_LATENCY__LAST; i++)
+        exa_histogram_reset(&volume->stats.latency[i]);
 
     /* Ensure a value different from both READ, WRITE and WRITE_BARRIER,
      * so that the first request is not counted as a seek. */
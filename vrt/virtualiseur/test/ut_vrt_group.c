@@ -88,7 +88,7 @@ ut_setup()
     UT_ASSERT(sto2 != NULL);
 
     sstriping_init();
-    rain1_init(0, 0);
+    rain1_init(0, 0, RAIN1_READ_POLICY_FIRST, 0, 0);
 
     __buf = os_malloc(SECTORS_TO_BYTES(VRT_SB_AREA_SIZE));
     UT_ASSERT_EQUAL(0, memory_stream_open(&memory_stream, __buf,